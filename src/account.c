@@ -84,6 +84,7 @@
 #include "file.h"
 #include "filing.h"
 #include "flexutils.h"
+#include "forecast.h"
 #include "interest.h"
 #include "preset.h"
 #include "print_dialogue.h"
@@ -138,6 +139,10 @@ struct account {
 
 	acct_t				offset_against;				/* The account against which interest is offset, or NULL_ACCOUNT. */
 
+	/* The number of references to the account from elsewhere in the file. */
+
+	int				usage_count;				/* References from transactions, standing orders, presets and offsets. */
+
 	/* User-set values used for calculation. */
 
 	amt_t				opening_balance;			/* The opening balance for accounts, from which everything else is calculated. */
@@ -174,6 +179,8 @@ struct account_block {
 	/* Recalculation data. */
 
 	date_t				last_full_recalc;			/**< The last time a full recalculation was done on the file.	*/
+	acct_t				removed_from;				/**< The from account of the last transaction removed.		*/
+	acct_t				removed_to;				/**< The to account of the last transaction removed.		*/
 };
 
 
@@ -185,10 +192,11 @@ static osbool account_delete_from_edit_window(struct account_block *instance, ac
 static void account_add_to_lists(struct file_block *file, acct_t account);
 static int account_find_window_entry_from_type(struct file_block *file, enum account_type type);
 static osbool account_used_in_file(struct account_block *instance, acct_t account);
-static osbool account_check_account(struct account_block *instance, acct_t account);
+static void account_calculate_balances(struct file_block *file, struct account *accounts, date_t date);
 
 
 static void			account_recalculate_windows(struct account_block *instance);
+static void			account_recalculate_window_entry(struct account_block *instance, acct_t account);
 
 /**
  * Test whether an account number is safe to look up in the account data array.
@@ -236,6 +244,8 @@ struct account_block *account_create_instance(struct file_block *file)
 	new->account_count = 0;
 
 	new->last_full_recalc = NULL_DATE;
+	new->removed_from = NULL_ACCOUNT;
+	new->removed_to = NULL_ACCOUNT;
 
 	/* Initialise the account and heading windows. */
 
@@ -545,6 +555,8 @@ debug_printf("Two");
 	accview_recalculate(instance->file, content->account, 0);
 	transact_redraw_all(instance->file);
 	accview_redraw_all(instance->file);
+	sorder_redraw_all(instance->file);
+	preset_redraw_all(instance->file);
 	file_set_data_integrity(instance->file, TRUE);
 
 	return TRUE;
@@ -607,6 +619,8 @@ static osbool account_process_heading_edit_window(void *parent, struct account_h
 	account_recalculate_all(instance->file);
 	transact_redraw_all(instance->file);
 	accview_redraw_all(instance->file);
+	sorder_redraw_all(instance->file);
+	preset_redraw_all(instance->file);
 	file_set_data_integrity(instance->file, TRUE);
 
 	return TRUE;
@@ -801,6 +815,7 @@ acct_t account_add(struct file_block *file, char *name, char *ident, enum accoun
 	file->accounts->accounts[new].credit_limit = 0;
 	file->accounts->accounts[new].budget_amount = 0;
 	file->accounts->accounts[new].offset_against = NULL_ACCOUNT;
+	file->accounts->accounts[new].usage_count = 0;
 	account_idnum_initialise(&(file->accounts->accounts[new].cheque_number));
 	account_idnum_initialise(&(file->accounts->accounts[new].payin_number));
 
@@ -1326,6 +1341,95 @@ amt_t account_get_opening_balance(struct file_block *file, acct_t account)
 }
 
 
+/**
+ * Return the account against which interest on an account is offset.
+ *
+ * \param *file		The file containing the account.
+ * \param account	The account for which to return the offset account.
+ * \return		The offset account, or NULL_ACCOUNT.
+ */
+
+acct_t account_get_offset_against(struct file_block *file, acct_t account)
+{
+	if (file == NULL || file->accounts == NULL)
+		return NULL_ACCOUNT;
+
+	if (!account_valid(file->accounts, account) || file->accounts->accounts[account].type == ACCOUNT_NULL)
+		return NULL_ACCOUNT;
+
+	return file->accounts->accounts[account].offset_against;
+}
+
+
+/**
+ * Move a reference from elsewhere in a file from one account to another,
+ * keeping the accounts' usage counts up to date. This must be called by
+ * anything which changes the accounts referenced by a transaction, standing
+ * order or preset.
+ *
+ * \param *file		The file containing the accounts.
+ * \param old		The account previously referenced, or NULL_ACCOUNT.
+ * \param new		The account now referenced, or NULL_ACCOUNT.
+ */
+
+void account_change_usage(struct file_block *file, acct_t old, acct_t new)
+{
+	if (file == NULL || file->accounts == NULL || old == new)
+		return;
+
+	if (account_valid(file->accounts, old) && file->accounts->accounts[old].usage_count > 0)
+		file->accounts->accounts[old].usage_count--;
+
+	if (account_valid(file->accounts, new))
+		file->accounts->accounts[new].usage_count++;
+}
+
+
+/**
+ * Rebuild the usage counts for all of the accounts in a file from scratch,
+ * in a single pass through the transactions, standing orders, presets and
+ * interest offsets.
+ *
+ * \param *file		The file to rebuild the counts for.
+ */
+
+void account_rebuild_usage(struct file_block *file)
+{
+	acct_t		account;
+	tran_t		transaction;
+	sorder_t	sorder;
+	preset_t	preset;
+
+	if (file == NULL || file->accounts == NULL)
+		return;
+
+	for (account = 0; account < file->accounts->account_count; account++)
+		file->accounts->accounts[account].usage_count = 0;
+
+	/* Accounts which have their interest offset against another are counted
+	 * as using it, whether or not they are still in use themselves.
+	 */
+
+	for (account = 0; account < file->accounts->account_count; account++)
+		account_change_usage(file, NULL_ACCOUNT, file->accounts->accounts[account].offset_against);
+
+	for (transaction = 0; transaction < transact_get_count(file); transaction++) {
+		account_change_usage(file, NULL_ACCOUNT, transact_get_from(file, transaction));
+		account_change_usage(file, NULL_ACCOUNT, transact_get_to(file, transaction));
+	}
+
+	for (sorder = 0; sorder < sorder_get_count(file); sorder++) {
+		account_change_usage(file, NULL_ACCOUNT, sorder_get_from(file, sorder));
+		account_change_usage(file, NULL_ACCOUNT, sorder_get_to(file, sorder));
+	}
+
+	for (preset = 0; preset < preset_get_count(file); preset++) {
+		account_change_usage(file, NULL_ACCOUNT, preset_get_from(file, preset));
+		account_change_usage(file, NULL_ACCOUNT, preset_get_to(file, preset));
+	}
+}
+
+
 /**
  * Adjust the opening balance for an account by adding or subtracting a
  * specified amount.
@@ -1344,6 +1448,8 @@ void account_adjust_opening_balance(struct file_block *file, acct_t account, amt
 		return;
 
 	file->accounts->accounts[account].opening_balance += adjust;
+
+	forecast_invalidate_account(file, account);
 }
 
 
@@ -1438,49 +1544,10 @@ amt_t account_get_budget_amount(struct file_block *file, acct_t account)
 
 static osbool account_used_in_file(struct account_block *instance, acct_t account)
 {
-	if (instance == NULL || instance->file == NULL)
-		return FALSE;
-
-	if (account_check_account(instance, account))
-		return TRUE;
-
-	if (transact_check_account(instance->file, account))
-		return TRUE;
-
-	if (sorder_check_account(instance->file, account))
-		return TRUE;
-
-	if (preset_check_account(instance->file, account))
-		return TRUE;
-
-	return FALSE;
-}
-
-
-/**
- * Check the accounts in a file to see if the given account is referenced
- * in any of them.
- *
- * \param *instance		The accounts instance to check.
- * \param account		The account to search for.
- * \return			TRUE if the account is used; FALSE if not.
- */
-
-static osbool account_check_account(struct account_block *instance, acct_t account)
-{
-	int	i;
-
-	if (instance == NULL || instance->accounts == NULL)
+	if (instance == NULL || instance->file == NULL || !account_valid(instance, account))
 		return FALSE;
 
-	/* Check to see if any other accounts offset to this one. */
-
-	for (i = 0; i < instance->account_count; i++) {
-		if (instance->accounts[i].offset_against == account)
-			return TRUE;
-	}
-
-	return FALSE;
+	return (instance->accounts[account].usage_count > 0) ? TRUE : FALSE;
 }
 
 
@@ -1579,36 +1646,37 @@ char *account_get_next_cheque_number(struct file_block *file, acct_t from_accoun
 
 
 /**
- * Fully recalculate all of the accounts in a file.
+ * Calculate the balances of all of the accounts in a file from scratch,
+ * storing the results in an account array.
  *
- * \param *file		The file to recalculate.
+ * \param *file		The file to calculate the balances for.
+ * \param *accounts	The account array to hold the results, which
+ *			must hold a copy of the file's account details.
+ * \param date		The date to use as today.
  */
 
-void account_recalculate_all(struct file_block *file)
+static void account_calculate_balances(struct file_block *file, struct account *accounts, date_t date)
 {
 	acct_t			account, transaction_account;
 	date_t			budget_start, budget_finish;
 	amt_t			transaction_amount;
 	enum transact_flags	transaction_flags;
 	int			transaction;
-	date_t			date, post_date, transaction_date;
+	date_t			post_date, transaction_date;
 	osbool			limit_postdated;
 
-	if (file == NULL || file->accounts == NULL)
+	if (file == NULL || file->accounts == NULL || accounts == NULL)
 		return;
 
-	hourglass_on();
-
 	/* Initialise the accounts, based on the opening balances. */
 
 	for (account = 0; account < file->accounts->account_count; account++) {
-		file->accounts->accounts[account].statement_balance = file->accounts->accounts[account].opening_balance;
-		file->accounts->accounts[account].current_balance = file->accounts->accounts[account].opening_balance;
-		file->accounts->accounts[account].future_balance = file->accounts->accounts[account].opening_balance;
-		file->accounts->accounts[account].budget_balance = 0; /* was file->accounts->accounts[account].opening_balance; */
+		accounts[account].statement_balance = accounts[account].opening_balance;
+		accounts[account].current_balance = accounts[account].opening_balance;
+		accounts[account].future_balance = accounts[account].opening_balance;
+		accounts[account].budget_balance = 0; /* was file->accounts->accounts[account].opening_balance; */
 	}
 
-	date = date_today();
 	post_date = date_add_period(date, DATE_PERIOD_DAYS, budget_get_sorder_trial(file));
 	budget_get_dates(file, &budget_start, &budget_finish);
 	limit_postdated = budget_get_limit_postdated(file);
@@ -1622,44 +1690,77 @@ void account_recalculate_all(struct file_block *file)
 
 		if ((transaction_account = transact_get_from(file, transaction)) != NULL_ACCOUNT) {
 			if (transaction_flags & TRANS_REC_FROM)
-				file->accounts->accounts[transaction_account].statement_balance -= transaction_amount;
+				accounts[transaction_account].statement_balance -= transaction_amount;
 
 			if (transaction_date <= date)
-				file->accounts->accounts[transaction_account].current_balance -= transaction_amount;
+				accounts[transaction_account].current_balance -= transaction_amount;
 
 			if ((budget_start == NULL_DATE || transaction_date >= budget_start) &&
 					(budget_finish == NULL_DATE || transaction_date <= budget_finish))
-				file->accounts->accounts[transaction_account].budget_balance -= transaction_amount;
+				accounts[transaction_account].budget_balance -= transaction_amount;
 
 			if (!limit_postdated || transaction_date <= post_date)
-				file->accounts->accounts[transaction_account].future_balance -= transaction_amount;
+				accounts[transaction_account].future_balance -= transaction_amount;
 		}
 
 		if ((transaction_account = transact_get_to(file, transaction)) != NULL_ACCOUNT) {
 			if (transaction_flags & TRANS_REC_TO)
-				file->accounts->accounts[transaction_account].statement_balance += transaction_amount;
+				accounts[transaction_account].statement_balance += transaction_amount;
 
 			if (transaction_date <= date)
-				file->accounts->accounts[transaction_account].current_balance += transaction_amount;
+				accounts[transaction_account].current_balance += transaction_amount;
 
 			if ((budget_start == NULL_DATE || transaction_date >= budget_start) &&
 					(budget_finish == NULL_DATE || transaction_date <= budget_finish))
-				file->accounts->accounts[transaction_account].budget_balance += transaction_amount;
+				accounts[transaction_account].budget_balance += transaction_amount;
 
 			if (!limit_postdated || transaction_date <= post_date)
-				file->accounts->accounts[transaction_account].future_balance += transaction_amount;
+				accounts[transaction_account].future_balance += transaction_amount;
 		}
 	}
 
 	/* Calculate the outstanding data for each account. */
 
 	for (account = 0; account < file->accounts->account_count; account++) {
-		file->accounts->accounts[account].available_balance = file->accounts->accounts[account].future_balance + file->accounts->accounts[account].credit_limit;
-		file->accounts->accounts[account].trial_balance = file->accounts->accounts[account].available_balance + file->accounts->accounts[account].sorder_trial;
+		accounts[account].available_balance = accounts[account].future_balance + accounts[account].credit_limit;
+		accounts[account].trial_balance = accounts[account].available_balance + accounts[account].sorder_trial;
 	}
+}
+
+
+/**
+ * Fully recalculate all of the accounts in a file.
+ *
+ * \param *file		The file to recalculate.
+ */
+
+void account_recalculate_all(struct file_block *file)
+{
+	date_t			date;
+
+	if (file == NULL || file->accounts == NULL)
+		return;
+
+	hourglass_on();
+
+	date = date_today();
+	account_calculate_balances(file, file->accounts->accounts, date);
 
 	file->accounts->last_full_recalc = date;
 
+	/* Check that the balance checkpoints still agree with a walk through
+	 * the whole file.
+	 */
+
+	#ifdef DEBUG
+	if (!transact_verify_checkpoints(file))
+		debug_printf("\\RBalance checkpoints were inconsistent and have been discarded");
+	#endif
+
+	/* Any cash flow forecasts must be rebuilt from scratch. */
+
+	forecast_invalidate_all(file);
+
 	/* Calculate the accounts windows data and force a redraw of the windows that are open. */
 
 	account_recalculate_windows(file->accounts);
@@ -1669,6 +1770,63 @@ void account_recalculate_all(struct file_block *file)
 }
 
 
+#ifdef DEBUG
+/**
+ * Check the calculated balances of all of the accounts in a file against a
+ * full recalculation, reporting any which disagree. The current balances
+ * are only checked if the last full recalculation happened today, and the
+ * future, available and trial balances are only checked if post-dated
+ * transactions are not being limited, as the incremental updates do not
+ * follow these rules.
+ *
+ * \param *file		The file to check.
+ * \return		TRUE if the balances agree; FALSE if not.
+ */
+
+osbool account_verify_balances(struct file_block *file)
+{
+	struct account	*accounts;
+	acct_t		account;
+	date_t		date;
+	osbool		check_current, check_future, consistent = TRUE;
+
+	if (file == NULL || file->accounts == NULL || file->accounts->account_count == 0)
+		return TRUE;
+
+	accounts = heap_alloc(sizeof(struct account) * file->accounts->account_count);
+	if (accounts == NULL)
+		return TRUE;
+
+	memcpy(accounts, file->accounts->accounts, sizeof(struct account) * file->accounts->account_count);
+
+	date = date_today();
+	check_current = (file->accounts->last_full_recalc == date);
+	check_future = !budget_get_limit_postdated(file);
+
+	account_calculate_balances(file, accounts, date);
+
+	for (account = 0; account < file->accounts->account_count; account++) {
+		if (file->accounts->accounts[account].type == ACCOUNT_NULL)
+			continue;
+
+		if ((accounts[account].statement_balance != file->accounts->accounts[account].statement_balance) ||
+				(accounts[account].budget_balance != file->accounts->accounts[account].budget_balance) ||
+				(check_current && accounts[account].current_balance != file->accounts->accounts[account].current_balance) ||
+				(check_future && accounts[account].future_balance != file->accounts->accounts[account].future_balance) ||
+				(check_future && accounts[account].available_balance != file->accounts->accounts[account].available_balance) ||
+				(check_future && accounts[account].trial_balance != file->accounts->accounts[account].trial_balance)) {
+			debug_printf("\\RAccount %d balances differ from a full recalculation", account);
+			consistent = FALSE;
+		}
+	}
+
+	heap_free(accounts);
+
+	return consistent;
+}
+#endif
+
+
 /**
  * Remove a transaction from all the calculated accounts, so that limited
  * changes can be made to its details. Once updated, it can be resored
@@ -1695,6 +1853,16 @@ void account_remove_transaction(struct file_block *file, tran_t transaction)
 	transaction_flags = transact_get_flags(file, transaction);
 	transaction_amount = transact_get_amount(file, transaction);
 
+	/* Note the accounts involved, so that their window entries can be
+	 * updated when the transaction is restored.
+	 */
+
+	file->accounts->removed_from = transact_get_from(file, transaction);
+	file->accounts->removed_to = transact_get_to(file, transaction);
+
+	forecast_invalidate_account(file, file->accounts->removed_from);
+	forecast_invalidate_account(file, file->accounts->removed_to);
+
 	/* Remove the current transaction from the fully-caluculated records. */
 
 	if ((transaction_account = transact_get_from(file, transaction)) != NULL_ACCOUNT) {
@@ -1791,7 +1959,38 @@ void account_restore_transaction(struct file_block *file, int transaction)
 		file->accounts->accounts[transaction_account].available_balance += transaction_amount;
 	}
 
-	/* Calculate the accounts windows data and force a redraw of the windows that are open. */
+	forecast_invalidate_account(file, transact_get_from(file, transaction));
+	forecast_invalidate_account(file, transact_get_to(file, transaction));
+
+	/* Update the window entries for the accounts which were affected
+	 * on removal and restoration, unless a batch update will recalculate
+	 * the windows in full later. Updating an entry which has already
+	 * been brought up to date has no effect, so duplicates don't matter.
+	 */
+
+	if (!file_defer_batch_effects(file, FILE_BATCH_ACCOUNT_WINDOWS)) {
+		account_recalculate_window_entry(file->accounts, file->accounts->removed_from);
+		account_recalculate_window_entry(file->accounts, file->accounts->removed_to);
+		account_recalculate_window_entry(file->accounts, transact_get_from(file, transaction));
+		account_recalculate_window_entry(file->accounts, transact_get_to(file, transaction));
+	}
+
+	file->accounts->removed_from = NULL_ACCOUNT;
+	file->accounts->removed_to = NULL_ACCOUNT;
+}
+
+
+/**
+ * Recalculate the totals in the account list windows of a file, and redraw
+ * the windows that are open.
+ *
+ * \param *file		The file to update.
+ */
+
+void account_update_windows(struct file_block *file)
+{
+	if (file == NULL || file->accounts == NULL)
+		return;
 
 	account_recalculate_windows(file->accounts);
 	account_redraw_all(file);
@@ -1817,6 +2016,30 @@ static void account_recalculate_windows(struct account_block *instance)
 }
 
 
+/**
+ * Recalculate the entry for a single account in the account list window
+ * which holds it, updating the section sub-totals and window totals and
+ * redrawing the affected lines.
+ *
+ * \param *instance		The accounts instance holding the account.
+ * \param account		The account to recalculate.
+ */
+
+static void account_recalculate_window_entry(struct account_block *instance, acct_t account)
+{
+	int	entry;
+
+	if (instance == NULL || !account_valid(instance, account))
+		return;
+
+	entry = account_find_window_entry_from_type(instance->file, instance->accounts[account].type);
+	if (entry == -1)
+		return;
+
+	account_list_window_recalculate_account(instance->account_windows[entry], account);
+}
+
+
 /**
  * Save the account and account list details from a file to a CashBook file
  *
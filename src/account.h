@@ -459,6 +459,42 @@ enum account_type account_get_type(struct file_block *file, acct_t account);
 amt_t account_get_opening_balance(struct file_block *file, acct_t account);
 
 
+/**
+ * Return the account against which interest on an account is offset.
+ *
+ * \param *file		The file containing the account.
+ * \param account	The account for which to return the offset account.
+ * \return		The offset account, or NULL_ACCOUNT.
+ */
+
+acct_t account_get_offset_against(struct file_block *file, acct_t account);
+
+
+/**
+ * Move a reference from elsewhere in a file from one account to another,
+ * keeping the accounts' usage counts up to date. This must be called by
+ * anything which changes the accounts referenced by a transaction, standing
+ * order or preset.
+ *
+ * \param *file		The file containing the accounts.
+ * \param old		The account previously referenced, or NULL_ACCOUNT.
+ * \param new		The account now referenced, or NULL_ACCOUNT.
+ */
+
+void account_change_usage(struct file_block *file, acct_t old, acct_t new);
+
+
+/**
+ * Rebuild the usage counts for all of the accounts in a file from scratch,
+ * in a single pass through the transactions, standing orders, presets and
+ * interest offsets.
+ *
+ * \param *file		The file to rebuild the counts for.
+ */
+
+void account_rebuild_usage(struct file_block *file);
+
+
 /**
  * Adjust the opening balance for an account by adding or subtracting a
  * specified amount.
@@ -566,6 +602,23 @@ char *account_get_next_cheque_number(struct file_block *file, acct_t from_accoun
 void account_recalculate_all(struct file_block *file);
 
 
+#ifdef DEBUG
+/**
+ * Check the calculated balances of all of the accounts in a file against a
+ * full recalculation, reporting any which disagree. The current balances
+ * are only checked if the last full recalculation happened today, and the
+ * future, available and trial balances are only checked if post-dated
+ * transactions are not being limited, as the incremental updates do not
+ * follow these rules.
+ *
+ * \param *file		The file to check.
+ * \return		TRUE if the balances agree; FALSE if not.
+ */
+
+osbool account_verify_balances(struct file_block *file);
+#endif
+
+
 /**
  * Remove a transaction from all the calculated accounts, so that limited
  * changes can be made to its details. Once updated, it can be resored
@@ -592,6 +645,16 @@ void account_remove_transaction(struct file_block *file, tran_t transaction);
 void account_restore_transaction(struct file_block *file, tran_t transaction);
 
 
+/**
+ * Recalculate the totals in the account list windows of a file, and redraw
+ * the windows that are open.
+ *
+ * \param *file		The file to update.
+ */
+
+void account_update_windows(struct file_block *file);
+
+
 /**
  * Save the account and account list details from a file to a CashBook file
  *
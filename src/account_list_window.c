@@ -256,6 +256,12 @@ struct account_list_window_redraw {
 	 * Flags showing the overdrawn status for the line.
 	 */
 	enum account_list_window_overdrawn	overdrawn;
+
+	/**
+	 * The next section footer line whose sub-total includes this line,
+	 * or -1 if there is none.
+	 */
+	int					footer;
 };
 
 
@@ -313,6 +319,27 @@ struct account_list_window {
 	 * Flex array holding the line data for the window.
 	 */
 	struct account_list_window_redraw	*line_data;
+
+	/**
+	 * The totals for the whole window, as shown in the footer pane.
+	 */
+	amt_t					total[ACCOUNT_LIST_WINDOW_NUM_COLUMNS];
+
+	/**
+	 * TRUE if the line totals, footer links and account index reflect
+	 * the current line layout; FALSE if a full recalculation is needed.
+	 */
+	osbool					totals_valid;
+
+	/**
+	 * Heap array giving the line on which each account appears, or -1.
+	 */
+	int					*account_lines;
+
+	/**
+	 * The number of entries in the account line index.
+	 */
+	int					account_lines_size;
 };
 
 /**
@@ -406,6 +433,9 @@ static osbool account_list_window_process_section_edit_window(void *parent, stru
 static void account_list_window_open_print_window(struct account_list_window *window, wimp_pointer *ptr, osbool restore);
 static struct report *account_list_window_print(struct report *report, void *data, date_t from, date_t to);
 static int account_list_window_add_line(struct account_list_window *windat);
+static void account_list_window_calculate_line(struct account_list_window *windat, int line);
+static void account_list_window_index_accounts(struct account_list_window *windat);
+static void account_list_window_update_footer_icons(struct account_list_window *windat);
 static void account_list_window_start_drag(struct account_list_window *windat, wimp_window_state *window, int line);
 static void account_list_window_terminate_drag(wimp_dragged *drag, void *data);
 static osbool account_list_window_save_csv(char *filename, osbool selection, void *data);
@@ -474,6 +504,10 @@ struct account_list_window *account_list_window_create_instance(struct account_b
 	new->display_lines = 0;
 	new->line_data = NULL;
 
+	new->totals_valid = FALSE;
+	new->account_lines = NULL;
+	new->account_lines_size = 0;
+
 	/* Blank out the footer icons. */
 
 	*new->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] = '\0';
@@ -517,6 +551,9 @@ void account_list_window_delete_instance(struct account_list_window *windat)
 	if (windat->line_data != NULL)
 		flexutils_free((void **) &(windat->line_data));
 
+	if (windat->account_lines != NULL)
+		heap_free(windat->account_lines);
+
 	column_delete_instance(windat->columns);
 
 	account_list_window_delete(windat);
@@ -671,6 +708,7 @@ static void account_list_window_delete(struct account_list_window *windat)
 	if (windat->account_window != NULL) {
 		ihelp_remove_window(windat->account_window);
 		event_delete_window(windat->account_window);
+		window_cancel_redraws(windat->account_window);
 		wimp_delete_window(windat->account_window);
 		windat->account_window = NULL;
 	}
@@ -1244,6 +1282,7 @@ void account_list_window_remove_account(struct account_list_window *windat, acct
 			}
 
 			windat->display_lines--;
+			windat->totals_valid = FALSE;
 			line--; /* Take into account that the array has just shortened. */
 		}
 	}
@@ -1370,7 +1409,7 @@ static void account_list_window_force_redraw(struct account_list_window *windat,
 	window.extent.y1 = WINDOW_ROW_TOP(ACCOUNT_LIST_WINDOW_TOOLBAR_HEIGHT, from);
 	window.extent.y0 = WINDOW_ROW_BASE(ACCOUNT_LIST_WINDOW_TOOLBAR_HEIGHT, to);
 
-	wimp_force_redraw(windat->account_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
+	window_queue_redraw(windat->account_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
 
 	/* Force a redraw of the three total icons in the footer. */
 
@@ -1503,6 +1542,7 @@ static osbool account_list_window_process_section_edit_window(void *parent, stru
 
 		string_copy(windat->line_data[content->line].heading, content->name, ACCOUNT_SECTION_LEN);
 		windat->line_data[content->line].type = content->type;
+		windat->totals_valid = FALSE;
 
 		/* Set the redraw range. */
 
@@ -1526,6 +1566,7 @@ static osbool account_list_window_process_section_edit_window(void *parent, stru
 		}
 
 		windat->display_lines--;
+		windat->totals_valid = FALSE;
 
 		/* Set the redraw range. */
 
@@ -1599,6 +1640,8 @@ static struct report *account_list_window_print(struct report *report, void *dat
 	char				*filename, date_buffer[DATE_FIELD_LEN];
 	date_t				start, finish;
 	wimp_i				columns[ACCOUNT_LIST_WINDOW_COLUMNS];
+	struct stringbuild_block	builder;
+	char				buffer[PRINT_MAX_LINE_LEN];
 
 	if (report == NULL || windat->instance == NULL)
 		return NULL;
@@ -1610,104 +1653,107 @@ static struct report *account_list_window_print(struct report *report, void *dat
 	if (!column_get_icons(windat->columns, columns, ACCOUNT_LIST_WINDOW_COLUMNS, FALSE))
 		return NULL;
 
+	if (!stringbuild_initialise(&builder, buffer, PRINT_MAX_LINE_LEN))
+		return NULL;
+
 	hourglass_on();
 
 	/* Output the page title. */
 
-	stringbuild_reset();
-	stringbuild_add_string("\\b\\u");
+	stringbuild_reset(&builder);
+	stringbuild_add_string(&builder, "\\b\\u");
 
 	filename = file_get_leafname(file, NULL, 0);
 
 	switch (windat->type) {
 	case ACCOUNT_FULL:
-		stringbuild_add_message_param("AcclistTitleAcc", filename, NULL, NULL, NULL);
+		stringbuild_add_message_param(&builder, "AcclistTitleAcc", filename, NULL, NULL, NULL);
 		break;
 
 	case ACCOUNT_IN:
-		stringbuild_add_message_param("AcclistTitleHIn", filename, NULL, NULL, NULL);
+		stringbuild_add_message_param(&builder, "AcclistTitleHIn", filename, NULL, NULL, NULL);
 		break;
 
 	case ACCOUNT_OUT:
-		stringbuild_add_message_param("AcclistTitleHOut", filename, NULL, NULL, NULL);
+		stringbuild_add_message_param(&builder, "AcclistTitleHOut", filename, NULL, NULL, NULL);
 		break;
 
 	default:
 		break;
 	}
 
-	stringbuild_report_line(report, 1);
+	stringbuild_report_line(&builder, report, 1);
 
 	/* Output budget title. */
 
 	budget_get_dates(file, &start, &finish);
 
 	if (start != NULL_DATE || finish != NULL_DATE) {
-		stringbuild_reset();
+		stringbuild_reset(&builder);
 
-		stringbuild_add_message("AcclistBudgetTitle");
+		stringbuild_add_message(&builder, "AcclistBudgetTitle");
 
 		if (start != NULL_DATE) {
 			date_convert_to_string(start, date_buffer, DATE_FIELD_LEN);
-			stringbuild_add_message_param("AcclistBudgetFrom", date_buffer, NULL, NULL, NULL);
+			stringbuild_add_message_param(&builder, "AcclistBudgetFrom", date_buffer, NULL, NULL, NULL);
 		}
 
 		if (finish != NULL_DATE) {
 			date_convert_to_string(finish, date_buffer, DATE_FIELD_LEN);
-			stringbuild_add_message_param("AcclistBudgetTo", date_buffer, NULL, NULL, NULL);
+			stringbuild_add_message_param(&builder, "AcclistBudgetTo", date_buffer, NULL, NULL, NULL);
 		}
 
-		stringbuild_add_string(".");
+		stringbuild_add_string(&builder, ".");
 
-		stringbuild_report_line(report, 1);
+		stringbuild_report_line(&builder, report, 1);
 	}
 
 	report_write_line(report, 1, "");
 
 	/* Output the headings line, taking the text from the window icons. */
 
-	stringbuild_reset();
-	columns_print_heading_names(windat->columns, windat->account_pane);
-	stringbuild_report_line(report, 0);
+	stringbuild_reset(&builder);
+	columns_print_heading_names(windat->columns, windat->account_pane, &builder);
+	stringbuild_report_line(&builder, report, 0);
 
 	/* Output the account data as a set of delimited lines. */
 
 	for (line = 0; line < windat->display_lines; line++) {
-		stringbuild_reset();
+		stringbuild_reset(&builder);
 
 		for (column = 0; column < ACCOUNT_LIST_WINDOW_COLUMNS; column++) {
 			if (column == 0)
-				stringbuild_add_string("\\k\\v");
+				stringbuild_add_string(&builder, "\\k\\v");
 			else
-				stringbuild_add_string("\\t\\v");
+				stringbuild_add_string(&builder, "\\t\\v");
 
 			switch (windat->line_data[line].type) {
 			case ACCOUNT_LINE_DATA:
 				switch (columns[column]) {
 				case ACCOUNT_LIST_WINDOW_IDENT:
-					stringbuild_add_string(account_get_ident(file, windat->line_data[line].account));
+					stringbuild_add_string(&builder, account_get_ident(file, windat->line_data[line].account));
 					break;
 				case ACCOUNT_LIST_WINDOW_NAME:
-					stringbuild_add_string(account_get_name(file, windat->line_data[line].account));
+					stringbuild_add_string(&builder, account_get_name(file, windat->line_data[line].account));
 					break;
 				case ACCOUNT_LIST_WINDOW_STATEMENT:
-					stringbuild_add_string("\\r\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT], FALSE);
+					stringbuild_add_string(&builder, "\\r\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT], FALSE);
 					break;
 				case ACCOUNT_LIST_WINDOW_CURRENT:
-					stringbuild_add_string("\\r\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT], FALSE);
+					stringbuild_add_string(&builder, "\\r\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT], FALSE);
 					break;
 				case ACCOUNT_LIST_WINDOW_FINAL:
-					stringbuild_add_string("\\r\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL], FALSE);
+					stringbuild_add_string(&builder, "\\r\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL], FALSE);
 					break;
 				case ACCOUNT_LIST_WINDOW_BUDGET:
-					stringbuild_add_string("\\r\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET], FALSE);
+					stringbuild_add_string(&builder, "\\r\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET], FALSE);
 					break;
 				default:
-					stringbuild_add_string("\\s");
+					stringbuild_add_string(&builder, "\\s");
 					break;
 				}
 				break;
@@ -1715,26 +1761,26 @@ static struct report *account_list_window_print(struct report *report, void *dat
 			case ACCOUNT_LINE_FOOTER:
 				switch (columns[column]) {
 				case ACCOUNT_LIST_WINDOW_IDENT:
-					stringbuild_add_string(windat->line_data[line].heading);
+					stringbuild_add_string(&builder, windat->line_data[line].heading);
 					break;
 				case ACCOUNT_LIST_WINDOW_STATEMENT:
-					stringbuild_add_string("\\r\\b\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT], FALSE);
+					stringbuild_add_string(&builder, "\\r\\b\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT], FALSE);
 					break;
 				case ACCOUNT_LIST_WINDOW_CURRENT:
-					stringbuild_add_string("\\r\\b\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT], FALSE);
+					stringbuild_add_string(&builder, "\\r\\b\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT], FALSE);
 					break;
 				case ACCOUNT_LIST_WINDOW_FINAL:
-					stringbuild_add_string("\\r\\b\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL], FALSE);
+					stringbuild_add_string(&builder, "\\r\\b\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL], FALSE);
 					break;
 				case ACCOUNT_LIST_WINDOW_BUDGET:
-					stringbuild_add_string("\\r\\b\\d");
-					stringbuild_add_currency(windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET], FALSE);
+					stringbuild_add_string(&builder, "\\r\\b\\d");
+					stringbuild_add_currency(&builder, windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET], FALSE);
 					break;
 				default:
-					stringbuild_add_string("\\s");
+					stringbuild_add_string(&builder, "\\s");
 					break;
 				}
 				break;
@@ -1742,61 +1788,63 @@ static struct report *account_list_window_print(struct report *report, void *dat
 			case ACCOUNT_LINE_HEADER:
 				switch (columns[column]) {
 				case ACCOUNT_LIST_WINDOW_IDENT:
-					stringbuild_add_printf("\\u%s", windat->line_data[line].heading);
+					stringbuild_add_printf(&builder, "\\u%s", windat->line_data[line].heading);
 					break;
 				default:
-					stringbuild_add_string("\\s");
+					stringbuild_add_string(&builder, "\\s");
 					break;
 				}
 				break;
 
 			default:
-				stringbuild_add_string("\\s");
+				stringbuild_add_string(&builder, "\\s");
 				break;
 			}
 		}
 
-		stringbuild_report_line(report, 0);
+		stringbuild_report_line(&builder, report, 0);
 	}
 
 	/* Output the grand total line, taking the text from the window icons. */
 
-	stringbuild_reset();
+	stringbuild_reset(&builder);
 
 	for (column = 0; column < ACCOUNT_LIST_WINDOW_COLUMNS; column++) {
 		if (column == 0)
-			stringbuild_add_string("\\k\\v");
+			stringbuild_add_string(&builder, "\\k\\v");
 		else
-			stringbuild_add_string("\\t\\v");
+			stringbuild_add_string(&builder, "\\t\\v");
 
 		switch (columns[column]) {
 		case ACCOUNT_LIST_WINDOW_IDENT:
-			stringbuild_add_string("\\b\\u");
-			stringbuild_add_icon(windat->account_footer, ACCOUNT_LIST_WINDOW_FOOT_NAME);
+			stringbuild_add_string(&builder, "\\b\\u");
+			stringbuild_add_icon(&builder, windat->account_footer, ACCOUNT_LIST_WINDOW_FOOT_NAME);
 			break;
 		case ACCOUNT_LIST_WINDOW_STATEMENT:
-			stringbuild_add_string("\\r\\b\\u");
-			stringbuild_add_string(windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT]);
+			stringbuild_add_string(&builder, "\\r\\b\\u");
+			stringbuild_add_string(&builder, windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT]);
 			break;
 		case ACCOUNT_LIST_WINDOW_CURRENT:
-			stringbuild_add_string("\\r\\b\\u");
-			stringbuild_add_string(windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT]);
+			stringbuild_add_string(&builder, "\\r\\b\\u");
+			stringbuild_add_string(&builder, windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT]);
 			break;
 		case ACCOUNT_LIST_WINDOW_FINAL:
-			stringbuild_add_string("\\r\\b\\u");
-			stringbuild_add_string(windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL]);
+			stringbuild_add_string(&builder, "\\r\\b\\u");
+			stringbuild_add_string(&builder, windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL]);
 			break;
 		case ACCOUNT_LIST_WINDOW_BUDGET:
-			stringbuild_add_string("\\r\\b\\u");
-			stringbuild_add_string(windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET]);
+			stringbuild_add_string(&builder, "\\r\\b\\u");
+			stringbuild_add_string(&builder, windat->footer_icon[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET]);
 			break;
 		default:
-			stringbuild_add_string("\\s");
+			stringbuild_add_string(&builder, "\\s");
 			break;
 		}
 	}
 
-	stringbuild_report_line(report, 0);
+	stringbuild_report_line(&builder, report, 0);
+
+	stringbuild_cancel(&builder);
 
 	hourglass_off();
 
@@ -1823,6 +1871,7 @@ static int account_list_window_add_line(struct account_list_window *windat)
 		return -1;
 
 	line = windat->display_lines++;
+	windat->totals_valid = FALSE;
 
 	#ifdef DEBUG
 	debug_printf("Creating new display line %d", line);
@@ -2058,6 +2107,7 @@ static void account_list_window_terminate_drag(wimp_dragged *drag, void *data)
 	/* Move the blocks around. */
 
 	block = windat->line_data[drag_data->start_line];
+	windat->totals_valid = FALSE;
 
 	if (line < drag_data->start_line) {
 		memmove(&(windat->line_data[line + 1]), &(windat->line_data[line]),
@@ -2094,8 +2144,8 @@ static void account_list_window_terminate_drag(wimp_dragged *drag, void *data)
 
 void account_list_window_recalculate(struct account_list_window *windat)
 {
-	int line, column, sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMNS], total[ACCOUNT_LIST_WINDOW_NUM_COLUMNS];
-	amt_t statement_balance, current_balance, future_balance, budget_amount, budget_balance, trial_balance, budget_result, credit_limit;
+	int	line, column, footer;
+	amt_t	sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMNS];
 
 	if (windat == NULL)
 		return;
@@ -2104,119 +2154,282 @@ void account_list_window_recalculate(struct account_list_window *windat)
 
 	for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++) {
 		sub_total[column] = 0;
-		total[column] = 0;
+		windat->total[column] = 0;
 	}
 
 	/* Add up the line data. */
 
 	for (line = 0; line < windat->display_lines; line++) {
-		windat->line_data[line].overdrawn = ACCOUNT_LIST_WINDOW_OVERDRAWN_NONE;
-
 		switch (windat->line_data[line].type) {
 		case ACCOUNT_LINE_DATA:
-			if (!account_get_data(windat->instance, windat->line_data[line].account,
-					&statement_balance, &current_balance, &future_balance, &credit_limit,
-					&budget_amount, &budget_balance, &trial_balance, NULL))
-				continue;
+			account_list_window_calculate_line(windat, line);
 
-			switch (windat->type) {
-			case ACCOUNT_FULL:
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] += statement_balance;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] += current_balance;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] += trial_balance;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] += budget_balance;
+			for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++) {
+				sub_total[column] += windat->line_data[line].total[column];
+				windat->total[column] += windat->line_data[line].total[column];
+			}
+			break;
 
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] += statement_balance;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] += current_balance;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] += trial_balance;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] += budget_balance;
+		case ACCOUNT_LINE_HEADER:
+			windat->line_data[line].overdrawn = ACCOUNT_LIST_WINDOW_OVERDRAWN_NONE;
 
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] = statement_balance;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] = current_balance;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] = trial_balance;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] = budget_balance;
+			for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
+				sub_total[column] = 0;
+			break;
 
-				if (statement_balance < -credit_limit)
-					windat->line_data[line].overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_STATEMENT;
+		case ACCOUNT_LINE_FOOTER:
+			windat->line_data[line].overdrawn = ACCOUNT_LIST_WINDOW_OVERDRAWN_NONE;
 
-				if (current_balance < -credit_limit)
-					windat->line_data[line].overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_CURRENT;
+			for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
+				windat->line_data[line].total[column] = sub_total[column];
+			break;
 
-				if (trial_balance < 0)
-					windat->line_data[line].overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_FUTURE;
-				break;
+		default:
+			windat->line_data[line].overdrawn = ACCOUNT_LIST_WINDOW_OVERDRAWN_NONE;
+			break;
+		}
+	}
 
-			case ACCOUNT_IN:
-				if (budget_amount != NULL_CURRENCY)
-					budget_result = -budget_amount - budget_balance;
-				else
-					budget_result = NULL_CURRENCY;
+	/* Link each line to the footers whose sub-totals include it. Sub-totals
+	 * run on until the next section heading, so a line feeds the first
+	 * footer below it, which in turn feeds the next footer down, and so on
+	 * until a heading is reached.
+	 */
 
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] -= future_balance;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] += budget_amount;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] -= budget_balance;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] += budget_result;
+	footer = -1;
 
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] -= future_balance;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] += budget_amount;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] -= budget_balance;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] += budget_result;
+	for (line = windat->display_lines - 1; line >= 0; line--) {
+		if (windat->line_data[line].type == ACCOUNT_LINE_HEADER)
+			footer = -1;
 
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] = -future_balance;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] = budget_amount;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] = -budget_balance;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] = budget_result;
+		windat->line_data[line].footer = footer;
 
-				if (-budget_balance < budget_amount)
-					windat->line_data[line].overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_BUDGET;
-				break;
+		if (windat->line_data[line].type == ACCOUNT_LINE_FOOTER)
+			footer = line;
+	}
 
-			case ACCOUNT_OUT:
-				if (budget_amount != NULL_CURRENCY)
-					budget_result = budget_amount - budget_balance;
-				else
-					budget_result = NULL_CURRENCY;
+	account_list_window_index_accounts(windat);
+	account_list_window_update_footer_icons(windat);
 
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] += future_balance;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] += budget_amount;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] += budget_balance;
-				sub_total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] += budget_result;
+	windat->totals_valid = TRUE;
+}
 
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] += future_balance;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] += budget_amount;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] += budget_balance;
-				total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] += budget_result;
 
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] = future_balance;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] = budget_amount;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] = budget_balance;
-				windat->line_data[line].total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] = budget_result;
+/**
+ * Recalculate the data for a single account in the given Account List
+ * window instance, passing any change in its balances up through the
+ * section sub-totals which include it and into the window totals, then
+ * redraw the affected lines. If the window's layout has changed since it
+ * was last fully calculated, a full recalculation is carried out instead.
+ *
+ * \param *windat		The Account List Window instance to update.
+ * \param account		The account which has changed.
+ */
 
-				if (budget_balance > budget_amount)
-					windat->line_data[line].overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_BUDGET;
-				break;
-			default:
-				break;
-			}
-			break;
+void account_list_window_recalculate_account(struct account_list_window *windat, acct_t account)
+{
+	int					line, footer, column;
+	amt_t					change[ACCOUNT_LIST_WINDOW_NUM_COLUMNS];
+	enum account_list_window_overdrawn	overdrawn;
+	osbool					changed = FALSE;
 
-		case ACCOUNT_LINE_HEADER:
-			for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
-				sub_total[column] = 0;
-			break;
+	if (windat == NULL || account == NULL_ACCOUNT)
+		return;
 
-		case ACCOUNT_LINE_FOOTER:
-			for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
-				windat->line_data[line].total[column] = sub_total[column];
-			break;
+	if (!windat->totals_valid || windat->account_lines == NULL) {
+		account_list_window_recalculate(windat);
+		account_list_window_redraw_all(windat);
+		return;
+	}
 
-		default:
-			break;
-		}
+	if (account < 0 || account >= windat->account_lines_size || windat->account_lines[account] == -1)
+		return;
+
+	line = windat->account_lines[account];
+
+	/* Recalculate the line, and find out how much it has changed by. */
+
+	for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
+		change[column] = windat->line_data[line].total[column];
+
+	overdrawn = windat->line_data[line].overdrawn;
+
+	account_list_window_calculate_line(windat, line);
+
+	for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++) {
+		change[column] = windat->line_data[line].total[column] - change[column];
+		if (change[column] != 0)
+			changed = TRUE;
 	}
 
+	if (!changed) {
+		if (overdrawn != windat->line_data[line].overdrawn)
+			account_list_window_force_redraw(windat, line, line, wimp_ICON_WINDOW);
+
+		return;
+	}
+
+	/* Pass the change on to the section footers and the window totals. */
+
+	for (footer = windat->line_data[line].footer; footer != -1; footer = windat->line_data[footer].footer) {
+		for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
+			windat->line_data[footer].total[column] += change[column];
+
+		account_list_window_force_redraw(windat, footer, footer, wimp_ICON_WINDOW);
+	}
+
+	for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
+		windat->total[column] += change[column];
+
+	account_list_window_update_footer_icons(windat);
+
+	account_list_window_force_redraw(windat, line, line, wimp_ICON_WINDOW);
+}
+
+
+/**
+ * Calculate the totals and overdrawn flags for a single account line in
+ * an Account List window instance. The values placed in the line's totals
+ * are those which are added into the sub-totals and totals for the window.
+ *
+ * \param *windat		The Account List Window instance to update.
+ * \param line			The line to be calculated.
+ */
+
+static void account_list_window_calculate_line(struct account_list_window *windat, int line)
+{
+	struct account_list_window_redraw	*data;
+	int					column;
+	amt_t					statement_balance, current_balance, future_balance, budget_amount, budget_balance, trial_balance, budget_result, credit_limit;
+
+	if (windat == NULL || !account_list_window_line_valid(windat, line))
+		return;
+
+	data = windat->line_data + line;
+
+	data->overdrawn = ACCOUNT_LIST_WINDOW_OVERDRAWN_NONE;
+
+	if (data->type != ACCOUNT_LINE_DATA || !account_get_data(windat->instance, data->account,
+			&statement_balance, &current_balance, &future_balance, &credit_limit,
+			&budget_amount, &budget_balance, &trial_balance, NULL)) {
+		for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
+			data->total[column] = 0;
+
+		return;
+	}
+
+	switch (windat->type) {
+	case ACCOUNT_FULL:
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] = statement_balance;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] = current_balance;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] = trial_balance;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] = budget_balance;
+
+		if (statement_balance < -credit_limit)
+			data->overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_STATEMENT;
+
+		if (current_balance < -credit_limit)
+			data->overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_CURRENT;
+
+		if (trial_balance < 0)
+			data->overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_FUTURE;
+		break;
+
+	case ACCOUNT_IN:
+		if (budget_amount != NULL_CURRENCY)
+			budget_result = -budget_amount - budget_balance;
+		else
+			budget_result = NULL_CURRENCY;
+
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] = -future_balance;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] = budget_amount;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] = -budget_balance;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] = budget_result;
+
+		if (-budget_balance < budget_amount)
+			data->overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_BUDGET;
+		break;
+
+	case ACCOUNT_OUT:
+		if (budget_amount != NULL_CURRENCY)
+			budget_result = budget_amount - budget_balance;
+		else
+			budget_result = NULL_CURRENCY;
+
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_STATEMENT] = future_balance;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_CURRENT] = budget_amount;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_FINAL] = budget_balance;
+		data->total[ACCOUNT_LIST_WINDOW_NUM_COLUMN_BUDGET] = budget_result;
+
+		if (budget_balance > budget_amount)
+			data->overdrawn |= ACCOUNT_LIST_WINDOW_OVERDRAWN_BUDGET;
+		break;
+
+	default:
+		for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
+			data->total[column] = 0;
+		break;
+	}
+}
+
+
+/**
+ * Rebuild the index of the lines on which accounts appear in an Account
+ * List window instance. If memory can't be found for the index, it is
+ * left empty and updates will fall back to full recalculations.
+ *
+ * \param *windat		The Account List Window instance to index.
+ */
+
+static void account_list_window_index_accounts(struct account_list_window *windat)
+{
+	int	line, size = 0;
+
+	if (windat == NULL)
+		return;
+
+	for (line = 0; line < windat->display_lines; line++) {
+		if (windat->line_data[line].type == ACCOUNT_LINE_DATA && windat->line_data[line].account >= size)
+			size = windat->line_data[line].account + 1;
+	}
+
+	if (size > windat->account_lines_size) {
+		if (windat->account_lines != NULL)
+			heap_free(windat->account_lines);
+
+		windat->account_lines = heap_alloc(size * sizeof(int));
+		windat->account_lines_size = (windat->account_lines != NULL) ? size : 0;
+	}
+
+	if (windat->account_lines == NULL)
+		return;
+
+	for (line = 0; line < windat->account_lines_size; line++)
+		windat->account_lines[line] = -1;
+
+	for (line = 0; line < windat->display_lines; line++) {
+		if (windat->line_data[line].type == ACCOUNT_LINE_DATA && windat->line_data[line].account >= 0)
+			windat->account_lines[windat->line_data[line].account] = line;
+	}
+}
+
+
+/**
+ * Update the text of the total icons in the footer pane of an Account
+ * List window instance from the current window totals.
+ *
+ * \param *windat		The Account List Window instance to update.
+ */
+
+static void account_list_window_update_footer_icons(struct account_list_window *windat)
+{
+	int	column;
+
+	if (windat == NULL)
+		return;
+
 	for (column = 0; column < ACCOUNT_LIST_WINDOW_NUM_COLUMNS; column++)
-		currency_convert_to_string(total[column], windat->footer_icon[column], AMOUNT_FIELD_LEN);
+		currency_convert_to_string(windat->total[column], windat->footer_icon[column], AMOUNT_FIELD_LEN);
 }
 
 
@@ -2313,6 +2526,7 @@ osbool account_list_window_read_file(struct account_list_window *windat, struct
 				}
 			}
 			line = windat->display_lines - 1;
+			windat->totals_valid = FALSE;
 			*(windat->line_data[line].heading) = '\0';
 			windat->line_data[line].type = account_get_account_line_type_field(in);
 			windat->line_data[line].account = account_get_account_field(in);
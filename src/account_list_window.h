@@ -173,6 +173,20 @@ char *account_list_window_get_entry_text(struct account_list_window *windat, int
 void account_list_window_recalculate(struct account_list_window *windat);
 
 
+/**
+ * Recalculate the data for a single account in the given Account List
+ * window instance, passing any change in its balances up through the
+ * section sub-totals which include it and into the window totals, then
+ * redraw the affected lines. If the window's layout has changed since it
+ * was last fully calculated, a full recalculation is carried out instead.
+ *
+ * \param *windat		The Account List Window instance to update.
+ * \param account		The account which has changed.
+ */
+
+void account_list_window_recalculate_account(struct account_list_window *windat, acct_t account);
+
+
 /**
  * Save an Account List Window's details to a CashBook file
  *
@@ -0,0 +1,650 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: accrual.c
+ *
+ * Interest accrual implementation.
+ *
+ * Interest is calculated from each account's daily balance, but the
+ * balance only changes on the dates of the account's postings and the rate
+ * only changes on the dates in the account's rate timeline. The engine
+ * therefore walks each account's postings in date order alongside its rate
+ * changes, and integrates balance x rate over the piecewise-constant
+ * segments between them, so that the cost for an account depends on the
+ * number of postings and rate changes rather than the number of days.
+ *
+ * Where accounts have their interest offset against another account, their
+ * postings and opening balances are added into the other account's balance,
+ * and they do not earn interest in their own right.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files */
+
+#include "oslib/hourglass.h"
+#include "oslib/os.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/debug.h"
+#include "sflib/heap.h"
+
+/* Application header files */
+
+#include "global.h"
+#include "accrual.h"
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+#include "interest.h"
+#include "transact.h"
+
+/**
+ * The number of proposed transactions to allocate space for at a time.
+ */
+
+#define ACCRUAL_ENTRY_ALLOCATION 64
+
+#ifdef DEBUG
+
+/**
+ * The amount by which the interest found by accrual_verify_account() may
+ * differ from a proposed transaction beyond rounding, to allow for the
+ * sums being made in a different order.
+ */
+
+#define ACCRUAL_VERIFY_TOLERANCE 0.001
+
+#endif
+
+/**
+ * A posting into or out of an account, collected while calculating.
+ */
+
+struct accrual_posting {
+	date_t			date;			/**< The date of the posting.					*/
+	amt_t			amount;			/**< The amount moved into the account.				*/
+};
+
+/**
+ * A proposed interest transaction.
+ */
+
+struct accrual_entry {
+	date_t			date;			/**< The date on which the interest falls due.			*/
+	acct_t			account;		/**< The account to which the interest applies.		*/
+	amt_t			amount;			/**< The amount of interest.					*/
+};
+
+/**
+ * An interest accrual instance.
+ */
+
+struct accrual_block {
+	struct accrual_entry	*entries;		/**< The proposed interest transactions.			*/
+	int			entry_count;		/**< The number of proposed transactions.			*/
+	int			entry_size;		/**< The number of transactions which space is allocated for.	*/
+};
+
+/* Static Function Prototypes. */
+
+static osbool accrual_calculate_account(struct accrual_block *instance, struct file_block *file, acct_t account, amt_t balance,
+		struct accrual_posting *postings, int count, date_t start, date_t end, enum date_period unit, int period);
+static date_t accrual_find_period_start(date_t start, enum date_period unit, int period, int count);
+static osbool accrual_add_entry(struct accrual_block *instance, date_t date, acct_t account, double interest);
+static int accrual_compare_postings(const void *a, const void *b);
+#ifdef DEBUG
+static int accrual_verify_account(struct accrual_block *instance, int *entry, struct file_block *file, acct_t account, amt_t balance,
+		struct accrual_posting *postings, int count, date_t start, date_t end, enum date_period unit, int period);
+#endif
+
+
+/**
+ * Calculate the interest accrued on all of the accounts in a file between
+ * two dates, from the daily balances of the accounts and the interest rates
+ * in force on each day. The interest is totalled over a series of regular
+ * periods starting on the start date, and one proposed interest transaction
+ * is produced for each account in each period.
+ *
+ * \param *file			The file to calculate interest for.
+ * \param start			The first date on which to accrue interest.
+ * \param end			The last date on which to accrue interest.
+ * \param unit			The unit of the interest periods.
+ * \param period		The number of units in each interest period.
+ * \return			The new instance handle, or NULL on failure.
+ */
+
+struct accrual_block *accrual_calculate(struct file_block *file, date_t start, date_t end, enum date_period unit, int period)
+{
+	struct accrual_block	*new;
+	struct accrual_posting	*postings = NULL;
+	acct_t			*targets = NULL, account, target, from, to;
+	amt_t			*balances = NULL, amount;
+	int			*first = NULL, accounts, count, pass, i;
+	tran_t			transaction;
+	date_t			date;
+	osbool			success = TRUE;
+#ifdef DEBUG
+	os_t			started, segment_time, daily_time;
+	int			entry, failures = 0;
+#endif
+
+	if (file == NULL || file->interest == NULL || start == NULL_DATE || end == NULL_DATE || start > end ||
+			unit == DATE_PERIOD_NONE || period <= 0)
+		return NULL;
+
+	new = heap_alloc(sizeof(struct accrual_block));
+	if (new == NULL)
+		return NULL;
+
+	new->entries = NULL;
+	new->entry_count = 0;
+	new->entry_size = 0;
+
+	accounts = account_get_count(file);
+	if (accounts == 0)
+		return new;
+
+	targets = heap_alloc(sizeof(acct_t) * accounts);
+	balances = heap_alloc(sizeof(amt_t) * accounts);
+	first = heap_alloc(sizeof(int) * (accounts + 1));
+
+	if (targets == NULL || balances == NULL || first == NULL)
+		success = FALSE;
+
+	hourglass_on();
+
+	/* Work out which account's balance each account contributes to, and
+	 * start each balance from the accounts' opening balances.
+	 */
+
+	for (account = 0; success && account < accounts; account++) {
+		balances[account] = 0;
+		first[account] = 0;
+
+		target = account_get_offset_against(file, account);
+		if (target == NULL_ACCOUNT || target == account || target >= accounts ||
+				(account_get_type(file, target) & ACCOUNT_FULL) == 0)
+			target = account;
+
+		targets[account] = target;
+	}
+
+	for (account = 0; success && account < accounts; account++)
+		balances[targets[account]] += account_get_opening_balance(file, account);
+
+	/* Bucket the postings by account in two passes through the transactions:
+	 * the first adds anything before the start date into the starting
+	 * balances and counts the postings for each account, and the second
+	 * distributes the postings into the buckets. Undated transactions can't
+	 * be placed, so are left out.
+	 */
+
+	for (pass = 0; success && pass < 2; pass++) {
+		for (transaction = 0; transaction < transact_get_count(file); transaction++) {
+			date = transact_get_date(file, transaction);
+			if (date == NULL_DATE || date > end)
+				continue;
+
+			from = transact_get_from(file, transaction);
+			to = transact_get_to(file, transaction);
+			amount = transact_get_amount(file, transaction);
+
+			if (from != NULL_ACCOUNT && from < accounts) {
+				if (date < start) {
+					if (pass == 0)
+						balances[targets[from]] -= amount;
+				} else if (pass == 0) {
+					first[targets[from]]++;
+				} else {
+					postings[first[targets[from]]].date = date;
+					postings[first[targets[from]]++].amount = -amount;
+				}
+			}
+
+			if (to != NULL_ACCOUNT && to < accounts) {
+				if (date < start) {
+					if (pass == 0)
+						balances[targets[to]] += amount;
+				} else if (pass == 0) {
+					first[targets[to]]++;
+				} else {
+					postings[first[targets[to]]].date = date;
+					postings[first[targets[to]]++].amount = amount;
+				}
+			}
+		}
+
+		/* After the first pass, turn the counts into bucket offsets and
+		 * allocate the space for the postings. After the second, each
+		 * offset has moved on to the start of the following bucket.
+		 */
+
+		if (pass == 0) {
+			count = 0;
+
+			for (account = 0; account < accounts; account++) {
+				i = first[account];
+				first[account] = count;
+				count += i;
+			}
+
+			first[accounts] = count;
+
+			if (count > 0) {
+				postings = heap_alloc(sizeof(struct accrual_posting) * count);
+				if (postings == NULL)
+					success = FALSE;
+			}
+		} else {
+			for (account = accounts; account > 0; account--)
+				first[account] = first[account - 1];
+
+			first[0] = 0;
+		}
+	}
+
+	/* Calculate the interest for each full account which isn't offset
+	 * against another. The transactions are usually already in date order,
+	 * so the buckets only need sorting if they are not.
+	 */
+
+	#ifdef DEBUG
+	started = os_read_monotonic_time();
+	#endif
+
+	for (account = 0; success && account < accounts; account++) {
+		if (targets[account] != account || (account_get_type(file, account) & ACCOUNT_FULL) == 0)
+			continue;
+
+		count = first[account + 1] - first[account];
+
+		for (i = 1; i < count && postings[first[account] + i - 1].date <= postings[first[account] + i].date; i++);
+
+		if (i < count)
+			qsort(postings + first[account], count, sizeof(struct accrual_posting), accrual_compare_postings);
+
+		success = accrual_calculate_account(new, file, account, balances[account], postings + first[account], count,
+				start, end, unit, period);
+	}
+
+	/* Check the proposed transactions against a day-by-day walk through
+	 * the same postings, timing the two approaches.
+	 */
+
+	#ifdef DEBUG
+	segment_time = os_read_monotonic_time() - started;
+	started = os_read_monotonic_time();
+
+	for (account = 0, entry = 0; success && account < accounts; account++) {
+		if (targets[account] == account && (account_get_type(file, account) & ACCOUNT_FULL) != 0)
+			failures += accrual_verify_account(new, &entry, file, account, balances[account], postings + first[account],
+					first[account + 1] - first[account], start, end, unit, period);
+	}
+
+	daily_time = os_read_monotonic_time() - started;
+
+	debug_printf("Calculated %d interest entries, with %d failures; segments %dcs, daily %dcs",
+			new->entry_count, failures, segment_time, daily_time);
+	#endif
+
+	hourglass_off();
+
+	if (postings != NULL)
+		heap_free(postings);
+
+	if (first != NULL)
+		heap_free(first);
+
+	if (balances != NULL)
+		heap_free(balances);
+
+	if (targets != NULL)
+		heap_free(targets);
+
+	if (!success) {
+		accrual_destroy(new);
+		return NULL;
+	}
+
+	return new;
+}
+
+
+/**
+ * Destroy an interest accrual instance, freeing the memory associated
+ * with it.
+ *
+ * \param *instance		The instance to be destroyed.
+ */
+
+void accrual_destroy(struct accrual_block *instance)
+{
+	if (instance == NULL)
+		return;
+
+	if (instance->entries != NULL)
+		heap_free(instance->entries);
+
+	heap_free(instance);
+}
+
+
+/**
+ * Return the number of proposed interest transactions held in an interest
+ * accrual instance.
+ *
+ * \param *instance		The instance to interrogate.
+ * \return			The number of proposed transactions.
+ */
+
+int accrual_get_count(struct accrual_block *instance)
+{
+	if (instance == NULL)
+		return 0;
+
+	return instance->entry_count;
+}
+
+
+/**
+ * Return the details of a proposed interest transaction held in an interest
+ * accrual instance. The transactions are held in order of account, and then
+ * by date.
+ *
+ * \param *instance		The instance to interrogate.
+ * \param entry			The index of the proposed transaction.
+ * \param *date			Pointer to a variable to take the date on which
+ *				the interest falls due, or NULL.
+ * \param *account		Pointer to a variable to take the account to
+ *				which the interest applies, or NULL.
+ * \return			The amount of interest, or 0 on failure.
+ */
+
+amt_t accrual_get_entry(struct accrual_block *instance, int entry, date_t *date, acct_t *account)
+{
+	if (date != NULL)
+		*date = NULL_DATE;
+
+	if (account != NULL)
+		*account = NULL_ACCOUNT;
+
+	if (instance == NULL || entry < 0 || entry >= instance->entry_count)
+		return 0;
+
+	if (date != NULL)
+		*date = instance->entries[entry].date;
+
+	if (account != NULL)
+		*account = instance->entries[entry].account;
+
+	return instance->entries[entry].amount;
+}
+
+
+/**
+ * Calculate the interest accrued on a single account, adding a proposed
+ * transaction to the instance for each period in which any is due.
+ *
+ * \param *instance		The instance to add the transactions to.
+ * \param *file			The file containing the account.
+ * \param account		The account to calculate interest for.
+ * \param balance		The account's balance at the start of the
+ *				first day.
+ * \param *postings		The account's postings, in date order.
+ * \param count			The number of postings.
+ * \param start			The first date on which to accrue interest.
+ * \param end			The last date on which to accrue interest.
+ * \param unit			The unit of the interest periods.
+ * \param period		The number of units in each interest period.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool accrual_calculate_account(struct accrual_block *instance, struct file_block *file, acct_t account, amt_t balance,
+		struct accrual_posting *postings, int count, date_t start, date_t end, enum date_period unit, int period)
+{
+	date_t	day, next, change, period_end, period_next, after_end;
+	rate_t	rate;
+	double	interest = 0.0;
+	int	posting = 0, periods = 1;
+
+	after_end = date_add_period(end, DATE_PERIOD_DAYS, 1);
+	period_next = accrual_find_period_start(start, unit, period, periods);
+
+	/* Step through the segments over which both the balance and the rate
+	 * are constant. Each day earns interest on its closing balance, so all
+	 * of the postings dated on or before the day are applied first.
+	 */
+
+	for (day = start; day <= end; day = next) {
+		while (posting < count && postings[posting].date <= day)
+			balance += postings[posting++].amount;
+
+		/* The segment runs up to the next posting, the next rate change,
+		 * the end of the period or the end of the calculation, whichever
+		 * comes first.
+		 */
+
+		next = (period_next < after_end) ? period_next : after_end;
+
+		if (posting < count && postings[posting].date < next)
+			next = postings[posting].date;
+
+		change = interest_get_next_change(file->interest, account, day);
+		if (change != NULL_DATE && change < next)
+			next = change;
+
+		rate = interest_get_rate_for_balance(file->interest, account, day, balance);
+		if (rate != NULL_RATE && balance != 0)
+			interest += (double) balance * interest_get_daily_factor(rate) * (date_count_days(day, next) - 1);
+
+		/* At the end of each period, propose a transaction for any
+		 * interest which has built up on its last day.
+		 */
+
+		if (next == period_next || next == after_end) {
+			period_end = date_add_period(next, DATE_PERIOD_DAYS, -1);
+
+			if (!accrual_add_entry(instance, period_end, account, interest))
+				return FALSE;
+
+			interest = 0.0;
+			period_next = accrual_find_period_start(start, unit, period, ++periods);
+		}
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Find the start of one of a series of regular interest periods. Each
+ * period is calculated from the start of the first, so that month-end
+ * dates do not drift.
+ *
+ * \param start			The start of the first period.
+ * \param unit			The unit of the interest periods.
+ * \param period		The number of units in each interest period.
+ * \param count			The number of periods to move on from the
+ *				first.
+ * \return			The start of the requested period.
+ */
+
+static date_t accrual_find_period_start(date_t start, enum date_period unit, int period, int count)
+{
+	return date_find_valid_day(date_add_period(start, unit, period * count), DATE_ADJUST_FORWARD);
+}
+
+
+/**
+ * Add a proposed interest transaction to an instance, rounding the interest
+ * to a whole amount. Interest which rounds to nothing is not proposed.
+ *
+ * \param *instance		The instance to add the transaction to.
+ * \param date			The date on which the interest falls due.
+ * \param account		The account to which the interest applies.
+ * \param interest		The unrounded interest.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool accrual_add_entry(struct accrual_block *instance, date_t date, acct_t account, double interest)
+{
+	struct accrual_entry	*entries;
+	amt_t			amount;
+	int			size;
+
+	amount = (amt_t) ((interest < 0.0) ? (interest - 0.5) : (interest + 0.5));
+	if (amount == 0)
+		return TRUE;
+
+	if (instance->entry_count >= instance->entry_size) {
+		size = instance->entry_size + ((instance->entry_size > ACCRUAL_ENTRY_ALLOCATION) ? instance->entry_size : ACCRUAL_ENTRY_ALLOCATION);
+
+		if (instance->entries == NULL)
+			entries = heap_alloc(sizeof(struct accrual_entry) * size);
+		else
+			entries = heap_extend(instance->entries, sizeof(struct accrual_entry) * size);
+
+		if (entries == NULL)
+			return FALSE;
+
+		instance->entries = entries;
+		instance->entry_size = size;
+	}
+
+	instance->entries[instance->entry_count].date = date;
+	instance->entries[instance->entry_count].account = account;
+	instance->entries[instance->entry_count].amount = amount;
+
+	instance->entry_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Compare two postings for qsort(), ordering them by date.
+ *
+ * \param *a			The first posting to compare.
+ * \param *b			The second posting to compare.
+ * \return			The result of the comparison.
+ */
+
+static int accrual_compare_postings(const void *a, const void *b)
+{
+	const struct accrual_posting	*first = a, *second = b;
+
+	if (first->date != second->date)
+		return (first->date < second->date) ? -1 : 1;
+
+	return 0;
+}
+
+
+#ifdef DEBUG
+
+/**
+ * Check the proposed interest transactions for an account by walking
+ * through every day between the start and end dates, applying the postings
+ * and adding up each day's interest on its closing balance. At the end of
+ * each period, the total should round to the amount of the proposed
+ * transaction, or to nothing if there isn't one. Any mismatches are written
+ * to the debug output.
+ *
+ * \param *instance		The instance holding the proposed transactions.
+ * \param *entry		Pointer to the index of the account's first
+ *				proposed transaction, which is updated to
+ *				index the first transaction after the account's.
+ * \param *file		The file containing the account.
+ * \param account		The account to check.
+ * \param balance		The account's balance at the start of the
+ *				first day.
+ * \param *postings		The account's postings, in date order.
+ * \param count			The number of postings.
+ * \param start			The first date on which to accrue interest.
+ * \param end			The last date on which to accrue interest.
+ * \param unit			The unit of the interest periods.
+ * \param period		The number of units in each interest period.
+ * \return			The number of mismatches found.
+ */
+
+static int accrual_verify_account(struct accrual_block *instance, int *entry, struct file_block *file, acct_t account, amt_t balance,
+		struct accrual_posting *postings, int count, date_t start, date_t end, enum date_period unit, int period)
+{
+	date_t	day, next, period_next;
+	rate_t	rate;
+	double	interest = 0.0, difference;
+	amt_t	amount;
+	int	posting = 0, periods = 1, failures = 0;
+
+	period_next = accrual_find_period_start(start, unit, period, periods);
+
+	for (day = start; day <= end; day = next) {
+		next = date_add_period(day, DATE_PERIOD_DAYS, 1);
+
+		while (posting < count && postings[posting].date <= day)
+			balance += postings[posting++].amount;
+
+		rate = interest_get_rate_for_balance(file->interest, account, day, balance);
+		if (rate != NULL_RATE)
+			interest += (double) balance * interest_get_daily_factor(rate);
+
+		if (next != period_next && day != end)
+			continue;
+
+		amount = 0;
+
+		if (*entry < instance->entry_count && instance->entries[*entry].account == account && instance->entries[*entry].date == day)
+			amount = instance->entries[(*entry)++].amount;
+
+		difference = (double) amount - interest;
+
+		if (difference > 0.5 + ACCRUAL_VERIFY_TOLERANCE || difference < -0.5 - ACCRUAL_VERIFY_TOLERANCE) {
+			debug_printf("\\RInterest on account %d to 0x%x is %d, not %d", account, day, amount, (int) interest);
+			failures++;
+		}
+
+		interest = 0.0;
+		period_next = accrual_find_period_start(start, unit, period, ++periods);
+	}
+
+	/* Any remaining transactions for the account fall outside its periods. */
+
+	while (*entry < instance->entry_count && instance->entries[*entry].account == account) {
+		debug_printf("\\RUnexpected interest on account %d to 0x%x", account, instance->entries[*entry].date);
+		(*entry)++;
+		failures++;
+	}
+
+	return failures;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: accrual.h
+ *
+ * Interest accrual interface.
+ */
+
+#ifndef CASHBOOK_ACCRUAL
+#define CASHBOOK_ACCRUAL
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+
+/**
+ * An interest accrual instance handle.
+ */
+
+struct accrual_block;
+
+
+/**
+ * Calculate the interest accrued on all of the accounts in a file between
+ * two dates, from the daily balances of the accounts and the interest rates
+ * in force on each day. The interest is totalled over a series of regular
+ * periods starting on the start date, and one proposed interest transaction
+ * is produced for each account in each period.
+ *
+ * \param *file			The file to calculate interest for.
+ * \param start			The first date on which to accrue interest.
+ * \param end			The last date on which to accrue interest.
+ * \param unit			The unit of the interest periods.
+ * \param period		The number of units in each interest period.
+ * \return			The new instance handle, or NULL on failure.
+ */
+
+struct accrual_block *accrual_calculate(struct file_block *file, date_t start, date_t end, enum date_period unit, int period);
+
+
+/**
+ * Destroy an interest accrual instance, freeing the memory associated
+ * with it.
+ *
+ * \param *instance		The instance to be destroyed.
+ */
+
+void accrual_destroy(struct accrual_block *instance);
+
+
+/**
+ * Return the number of proposed interest transactions held in an interest
+ * accrual instance.
+ *
+ * \param *instance		The instance to interrogate.
+ * \return			The number of proposed transactions.
+ */
+
+int accrual_get_count(struct accrual_block *instance);
+
+
+/**
+ * Return the details of a proposed interest transaction held in an interest
+ * accrual instance. The transactions are held in order of account, and then
+ * by date.
+ *
+ * \param *instance		The instance to interrogate.
+ * \param entry			The index of the proposed transaction.
+ * \param *date			Pointer to a variable to take the date on which
+ *				the interest falls due, or NULL.
+ * \param *account		Pointer to a variable to take the account to
+ *				which the interest applies, or NULL.
+ * \return			The amount of interest, or 0 on failure.
+ */
+
+amt_t accrual_get_entry(struct accrual_block *instance, int entry, date_t *date, acct_t *account);
+
+#endif
+
@@ -0,0 +1,188 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: accrual_report.c
+ *
+ * Interest Accrual Report implementation.
+ */
+
+/* ANSI C header files */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/hourglass.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/errors.h"
+#include "sflib/msgs.h"
+
+/* Application header files */
+
+#include "global.h"
+#include "accrual_report.h"
+
+#include "account.h"
+#include "accrual.h"
+#include "currency.h"
+#include "date.h"
+#include "file.h"
+#include "report.h"
+#include "stringbuild.h"
+
+
+/* Buffers used in the accrual report. */
+
+#define ACCRUAL_REPORT_LINE_LENGTH 1024
+#define ACCRUAL_REPORT_BUF1_LENGTH 256
+#define ACCRUAL_REPORT_BUF2_LENGTH 32
+
+
+/**
+ * Generate a report showing the interest proposed for each month of the
+ * past year, on all of the accounts in a file.
+ *
+ * \param *file			The file to report on.
+ */
+
+void accrual_report(struct file_block *file)
+{
+	struct report			*report;
+	struct accrual_block		*accrual;
+	acct_t				account, previous = NULL_ACCOUNT;
+	int				entry, count;
+	date_t				start, end, date;
+	amt_t				amount, total = 0;
+	char				line[ACCRUAL_REPORT_LINE_LENGTH], numbuf1[ACCRUAL_REPORT_BUF1_LENGTH], numbuf2[ACCRUAL_REPORT_BUF2_LENGTH];
+	struct stringbuild_block	builder;
+
+	if (file == NULL)
+		return;
+
+	end = date_today();
+	start = date_add_period(date_add_period(end, DATE_PERIOD_YEARS, -1), DATE_PERIOD_DAYS, 1);
+
+	accrual = accrual_calculate(file, start, end, DATE_PERIOD_MONTHS, 1);
+
+	if (accrual == NULL) {
+		error_msgs_report_error("NoMemReport");
+		return;
+	}
+
+	if (!stringbuild_initialise(&builder, line, ACCRUAL_REPORT_LINE_LENGTH)) {
+		accrual_destroy(accrual);
+		return;
+	}
+
+	msgs_lookup("ACRWinT", line, ACCRUAL_REPORT_LINE_LENGTH);
+	report = report_open(file, line, NULL);
+
+	if (report == NULL) {
+		stringbuild_cancel(&builder);
+		accrual_destroy(accrual);
+		return;
+	}
+
+	hourglass_on();
+
+	stringbuild_reset(&builder);
+	stringbuild_add_message_param(&builder, "ACRTitle", file_get_leafname(file, NULL, 0), NULL, NULL, NULL);
+	stringbuild_report_line(&builder, report, 0);
+
+	stringbuild_reset(&builder);
+	date_convert_to_string(start, numbuf1, ACCRUAL_REPORT_BUF1_LENGTH);
+	date_convert_to_string(end, numbuf2, ACCRUAL_REPORT_BUF2_LENGTH);
+	stringbuild_add_message_param(&builder, "ACRHeader", numbuf1, numbuf2, NULL, NULL);
+	stringbuild_report_line(&builder, report, 0);
+
+	/* The proposed transactions come grouped by account, so output each
+	 * account's heading as its first transaction is reached, and its total
+	 * after its last.
+	 */
+
+	count = accrual_get_count(accrual);
+
+	for (entry = 0; entry < count; entry++) {
+		amount = accrual_get_entry(accrual, entry, &date, &account);
+
+		if (account != previous) {
+			report_write_line(report, 0, ""); /* Separate each entry with a blank line. */
+
+			report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+			report_add_text_cell(report, 0, REPORT_CELL_FLAGS_UNDERLINE, account_get_name(file, account));
+			report_end_line(report);
+
+			previous = account;
+			total = 0;
+		}
+
+		total += amount;
+
+		date_convert_to_string(date, numbuf1, ACCRUAL_REPORT_BUF1_LENGTH);
+		currency_convert_to_string(amount, numbuf2, ACCRUAL_REPORT_BUF2_LENGTH);
+
+		report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+		report_add_text_cell(report, 0, REPORT_CELL_FLAGS_INDENT, numbuf1);
+		report_add_text_cell(report, 1, REPORT_CELL_FLAGS_NUMERIC, numbuf2);
+		report_end_line(report);
+
+		if (entry + 1 < count) {
+			accrual_get_entry(accrual, entry + 1, NULL, &account);
+			if (account == previous)
+				continue;
+		}
+
+		currency_convert_to_string(total, numbuf2, ACCRUAL_REPORT_BUF2_LENGTH);
+
+		report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, "ACRTotal", NULL, NULL, NULL, NULL);
+		report_add_text_cell(report, 1, REPORT_CELL_FLAGS_NUMERIC | REPORT_CELL_FLAGS_UNDERLINE, numbuf2);
+		report_end_line(report);
+	}
+
+	if (count == 0) {
+		report_write_line(report, 0, "");
+
+		stringbuild_reset(&builder);
+		stringbuild_add_message(&builder, "ACRNone");
+		stringbuild_report_line(&builder, report, 0);
+	}
+
+	/* Close the report. */
+
+	stringbuild_cancel(&builder);
+
+	report_close(report);
+
+	accrual_destroy(accrual);
+
+	hourglass_off();
+}
+
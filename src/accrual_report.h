@@ -0,0 +1,45 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: accrual_report.h
+ *
+ * Interest Accrual Report interface.
+ */
+
+#ifndef CASHBOOK_ACCRUAL_REPORT
+#define CASHBOOK_ACCRUAL_REPORT
+
+
+/**
+ * Generate a report showing the interest proposed for each month of the
+ * past year, on all of the accounts in a file.
+ *
+ * \param *file			The file to report on.
+ */
+
+void accrual_report(struct file_block *file);
+
+#endif
+
@@ -69,6 +69,7 @@
 #include "edit.h"
 #include "file.h"
 #include "flexutils.h"
+#include "linecache.h"
 #include "print_dialogue.h"
 #include "report.h"
 #include "sort.h"
@@ -143,6 +144,7 @@
 #define ACCVIEW_COLUMNS 10
 #define ACCVIEW_TOOLBAR_HEIGHT 132
 #define MIN_ACCVIEW_ENTRIES 10
+#define ACCVIEW_CACHE_LINES 128
 
 /* Account View window column mapping. */
 
@@ -194,6 +196,13 @@ struct accview_redraw {
 	int			sort_index;					/**< Point to another line, to allow the window to be sorted.		*/
 };
 
+struct accview_cache {
+	char			date[DATE_FIELD_LEN];				/**< The formatted transaction date.					*/
+	char			ident[ACCOUNT_IDENT_LEN];			/**< The ident of the other account in the transaction.			*/
+	char			name[ACCOUNT_NAME_LEN];				/**< The name of the other account in the transaction.			*/
+	char			amount[AMOUNT_FIELD_LEN];			/**< The formatted transaction amount.					*/
+};
+
 struct accview_window {
 	struct file_block	*file;						/**< The handle of the parent file.					*/
 	acct_t			account;					/**< The account number of the parent account.				*/
@@ -218,6 +227,7 @@ struct accview_window {
 
 	int			display_lines;					/**< Count of the lines in the window.					*/
 	struct accview_redraw	*line_data;					/**< Pointer to array of line data for the redraw.			*/
+	struct linecache_block	*line_cache;					/**< Cache of formatted line text, keyed on transaction.		*/
 };
 
 
@@ -448,6 +458,13 @@ void accview_open_window(struct file_block *file, acct_t account)
 
 	view->line_data = NULL;
 
+	view->line_cache = linecache_create(ACCVIEW_CACHE_LINES, sizeof(struct accview_cache));
+	if (view->line_cache == NULL) {
+		accview_delete_window(file, account);
+		error_msgs_report_info("AccviewMemErr1");
+		return;
+	}
+
 	if (!accview_build(view)) {
 		accview_delete_window(file, account);
 		return;
@@ -605,6 +622,7 @@ void accview_delete_window(struct file_block *file, acct_t account)
 	if (view->accview_window != NULL) {
 		ihelp_remove_window(view->accview_window);
 		event_delete_window(view->accview_window);
+		window_cancel_redraws(view->accview_window);
 		wimp_delete_window(view->accview_window);
 	}
 
@@ -617,6 +635,8 @@ void accview_delete_window(struct file_block *file, acct_t account)
 	if (view->line_data != NULL)
 		flexutils_free((void **) &(view->line_data));
 
+	linecache_destroy(view->line_cache);
+
 	account_set_accview(file, account, NULL);
 	heap_free(view);
 
@@ -1025,6 +1045,7 @@ static void accview_window_scroll_handler(wimp_scroll *scroll)
 static void accview_window_redraw_handler(wimp_draw *redraw)
 {
 	struct accview_window	*windat;
+	struct accview_cache	*cache;
 	enum accview_direction	transaction_direction;
 	acct_t			account, transaction_account;
 	date_t			transaction_date;
@@ -1033,7 +1054,7 @@ static void accview_window_redraw_handler(wimp_draw *redraw)
 	tran_t			transaction;
 	wimp_colour		shade_budget_col, shade_overdrawn_col, icon_fg_col, icon_fg_balance_col;
 	char			icon_buffer[TRANSACT_DESCRIPT_FIELD_LEN]; /* Assumes descript is longest. */
-	osbool			more, shade_budget, shade_overdrawn;
+	osbool			more, shade_budget, shade_overdrawn, cached;
 	date_t			budget_start, budget_finish;
 
 	windat = event_get_window_user_data(redraw->w);
@@ -1112,33 +1133,56 @@ static void accview_window_redraw_handler(wimp_draw *redraw)
 				icon_fg_balance_col = wimp_COLOUR_BLACK;
 			}
 
+			/* Find the formatted text for the line, building it if it
+			 * isn't already in the cache.
+			 */
+
+			cache = linecache_find(windat->line_cache, transaction, &cached);
+			if (cache == NULL)
+				continue;
+
+			if (!cached) {
+				switch (transaction_direction) {
+				case ACCVIEW_DIRECTION_FROM:
+					transaction_account = transact_get_to(windat->file, transaction);
+					break;
+				case ACCVIEW_DIRECTION_TO:
+					transaction_account = transact_get_from(windat->file, transaction);
+					break;
+				default:
+					transaction_account = NULL_ACCOUNT;
+					break;
+				}
+
+				date_convert_to_string(transaction_date, cache->date, DATE_FIELD_LEN);
+				string_copy(cache->ident, account_get_ident(windat->file, transaction_account), ACCOUNT_IDENT_LEN);
+				string_copy(cache->name, account_get_name(windat->file, transaction_account), ACCOUNT_NAME_LEN);
+				currency_convert_to_string(transact_get_amount(windat->file, transaction), cache->amount, AMOUNT_FIELD_LEN);
+			}
+
 			/* Row field */
 
 			window_plot_int_field(ACCVIEW_ICON_ROW, transact_get_transaction_number(transaction), icon_fg_col);
 
 			/* Date field */
 
-			window_plot_date_field(ACCVIEW_ICON_DATE, transaction_date, icon_fg_col);
+			window_plot_text_field(ACCVIEW_ICON_DATE, cache->date, icon_fg_col);
 
 			/* From / To field */
 
-			transaction_account = NULL_ACCOUNT;
-
 			switch (transaction_direction) {
 			case ACCVIEW_DIRECTION_FROM:
-				transaction_account = transact_get_to(windat->file, transaction);
 				window_plot_reconciled_field(ACCVIEW_ICON_REC, (transact_get_flags(windat->file, transaction) & TRANS_REC_FROM), icon_fg_col);
 				break;
 			case ACCVIEW_DIRECTION_TO:
-				transaction_account = transact_get_from(windat->file, transaction);
 				window_plot_reconciled_field(ACCVIEW_ICON_REC, (transact_get_flags(windat->file, transaction) & TRANS_REC_TO), icon_fg_col);
 				break;
 			case ACCVIEW_DIRECTION_NONE:
 				window_plot_empty_field(ACCVIEW_ICON_REC);
 			}
 
-			window_plot_text_field(ACCVIEW_ICON_IDENT, account_get_ident(windat->file, transaction_account), icon_fg_col);
-			window_plot_text_field(ACCVIEW_ICON_FROMTO, account_get_name(windat->file, transaction_account), icon_fg_col);
+			window_plot_text_field(ACCVIEW_ICON_IDENT, cache->ident, icon_fg_col);
+			window_plot_text_field(ACCVIEW_ICON_FROMTO, cache->name, icon_fg_col);
 
 			/* Reference field */
 
@@ -1148,12 +1192,12 @@ static void accview_window_redraw_handler(wimp_draw *redraw)
 
 			switch (transaction_direction) {
 			case ACCVIEW_DIRECTION_FROM:
-				window_plot_currency_field(ACCVIEW_ICON_PAYMENTS, transact_get_amount(windat->file, transaction), icon_fg_col);
+				window_plot_text_field(ACCVIEW_ICON_PAYMENTS, cache->amount, icon_fg_col);
 				window_plot_empty_field(ACCVIEW_ICON_RECEIPTS);
 				break;
 			case ACCVIEW_DIRECTION_TO:
 				window_plot_empty_field(ACCVIEW_ICON_PAYMENTS);
-				window_plot_currency_field(ACCVIEW_ICON_RECEIPTS, transact_get_amount(windat->file, transaction), icon_fg_col);
+				window_plot_text_field(ACCVIEW_ICON_RECEIPTS, cache->amount, icon_fg_col);
 				break;
 			case ACCVIEW_DIRECTION_NONE:
 				window_plot_empty_field(ACCVIEW_ICON_PAYMENTS);
@@ -1349,7 +1393,7 @@ static void accview_force_window_redraw(struct accview_window *view, int from, i
 	window.extent.y1 = WINDOW_ROW_TOP(ACCVIEW_TOOLBAR_HEIGHT, from);
 	window.extent.y0 = WINDOW_ROW_BASE(ACCVIEW_TOOLBAR_HEIGHT, to);
 
-	wimp_force_redraw(view->accview_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
+	window_queue_redraw(view->accview_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
 }
 
 
@@ -1474,6 +1518,8 @@ static struct report *accview_print(struct report *report, void *data, date_t fr
 	acct_t			transaction_account;
 	char			rec_char[REC_FIELD_LEN];
 	wimp_i			columns[ACCVIEW_COLUMNS];
+	struct stringbuild_block	builder;
+	char			buffer[PRINT_MAX_LINE_LEN];
 
 	if (report == NULL || view == NULL || view->file == NULL)
 		return NULL;
@@ -1483,27 +1529,30 @@ static struct report *accview_print(struct report *report, void *data, date_t fr
 
 	msgs_lookup("RecChar", rec_char, REC_FIELD_LEN);
 
+	if (!stringbuild_initialise(&builder, buffer, PRINT_MAX_LINE_LEN))
+		return NULL;
+
 	hourglass_on();
 
 	/* Output the page title. */
 
-	stringbuild_reset();
+	stringbuild_reset(&builder);
 
-	stringbuild_add_string("\\b\\u");
-	stringbuild_add_message_param("AccviewTitle",
+	stringbuild_add_string(&builder, "\\b\\u");
+	stringbuild_add_message_param(&builder, "AccviewTitle",
 			account_get_name(view->file, view->account),
 			file_get_leafname(view->file, NULL, 0),
 			NULL, NULL);
 
-	stringbuild_report_line(report, 1);
+	stringbuild_report_line(&builder, report, 1);
 
 	report_write_line(report, 1, "");
 
 	/* Output the headings line, taking the text from the window icons. */
 
-	stringbuild_reset();
-	columns_print_heading_names(view->columns, view->accview_pane);
-	stringbuild_report_line(report, 0);
+	stringbuild_reset(&builder);
+	columns_print_heading_names(view->columns, view->accview_pane, &builder);
+	stringbuild_report_line(&builder, report, 0);
 
 	/* Output the transaction data as a set of delimited lines. */
 
@@ -1523,69 +1572,71 @@ static struct report *accview_print(struct report *report, void *data, date_t fr
 		else
 			transaction_account = transact_get_from(view->file, transaction);
 
-		stringbuild_reset();
+		stringbuild_reset(&builder);
 
 		for (column = 0; column < ACCVIEW_COLUMNS; column++) {
 			if (column == 0)
-				stringbuild_add_string("\\k");
+				stringbuild_add_string(&builder, "\\k");
 			else
-				stringbuild_add_string("\\t");
+				stringbuild_add_string(&builder, "\\t");
 
 			switch (columns[column]) {
 			case ACCVIEW_ICON_ROW:
-				stringbuild_add_printf("\\v\\d\\r%d", transact_get_transaction_number(transaction));
+				stringbuild_add_printf(&builder, "\\v\\d\\r%d", transact_get_transaction_number(transaction));
 				break;
 			case ACCVIEW_ICON_DATE:
-				stringbuild_add_string("\\v\\c");
-				stringbuild_add_date(transaction_date);
+				stringbuild_add_string(&builder, "\\v\\c");
+				stringbuild_add_date(&builder, transaction_date);
 				break;
 			case ACCVIEW_ICON_IDENT:
-				stringbuild_add_string(account_get_ident(view->file, transaction_account));
+				stringbuild_add_string(&builder, account_get_ident(view->file, transaction_account));
 				break;
 			case ACCVIEW_ICON_REC:
 				if (transaction_direction == ACCVIEW_DIRECTION_FROM) {
 					if (transact_get_flags(view->file, transaction) & TRANS_REC_FROM)
-						stringbuild_add_string(rec_char);
+						stringbuild_add_string(&builder, rec_char);
 				} else {
 					if (transact_get_flags(view->file, transaction) & TRANS_REC_TO)
-						stringbuild_add_string(rec_char);
+						stringbuild_add_string(&builder, rec_char);
 				}
 				break;
 			case ACCVIEW_ICON_FROMTO:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(account_get_name(view->file, transaction_account));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, account_get_name(view->file, transaction_account));
 				break;
 			case ACCVIEW_ICON_REFERENCE:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(transact_get_reference(view->file, transaction, NULL, 0));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, transact_get_reference(view->file, transaction, NULL, 0));
 				break;
 			case ACCVIEW_ICON_PAYMENTS:
-				stringbuild_add_string("\\v\\d\\r");
+				stringbuild_add_string(&builder, "\\v\\d\\r");
 				if (transaction_direction == ACCVIEW_DIRECTION_FROM)
-					stringbuild_add_currency(transact_get_amount(view->file, transaction), FALSE);
+					stringbuild_add_currency(&builder, transact_get_amount(view->file, transaction), FALSE);
 				break;
 			case ACCVIEW_ICON_RECEIPTS:
-				stringbuild_add_string("\\v\\d\\r");
+				stringbuild_add_string(&builder, "\\v\\d\\r");
 				if (transaction_direction == ACCVIEW_DIRECTION_TO)
-					stringbuild_add_currency(transact_get_amount(view->file, transaction), FALSE);
+					stringbuild_add_currency(&builder, transact_get_amount(view->file, transaction), FALSE);
 				break;
 			case ACCVIEW_ICON_BALANCE:
-				stringbuild_add_string("\\v\\d\\r");
-				stringbuild_add_currency(view->line_data[sort].balance, FALSE);
+				stringbuild_add_string(&builder, "\\v\\d\\r");
+				stringbuild_add_currency(&builder, view->line_data[sort].balance, FALSE);
 				break;
 			case ACCVIEW_ICON_DESCRIPTION:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(transact_get_description(view->file, transaction, NULL, 0));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, transact_get_description(view->file, transaction, NULL, 0));
 				break;
 			default:
-				stringbuild_add_string("\\s");
+				stringbuild_add_string(&builder, "\\s");
 				break;
 			}
 		}
 
-		stringbuild_report_line(report, 0);
+		stringbuild_report_line(&builder, report, 0);
 	}
 
+	stringbuild_cancel(&builder);
+
 	hourglass_off();
 
 	return report;
@@ -1743,6 +1794,8 @@ static osbool accview_build(struct accview_window *view)
 
 	lines = accview_calculate(view);
 
+	linecache_invalidate_all(view->line_cache);
+
 	if (!flexutils_resize((void **) &(view->line_data), sizeof(struct accview_redraw), lines)) {
 		flexutils_free((void **) &(view->line_data));
 		error_msgs_report_info("BadMemory");
@@ -1874,6 +1927,7 @@ void accview_recalculate(struct file_block *file, acct_t account, int transactio
 	transact_sort_file_data(file);
 
 	accview_calculate(view);
+	linecache_invalidate(view->line_cache, transaction);
 	accview_force_window_redraw(view, accview_get_line_from_transaction(view, transaction),
 			view->display_lines - 1, wimp_ICON_WINDOW);
 }
@@ -1900,6 +1954,8 @@ void accview_redraw_transaction(struct file_block *file, acct_t account, int tra
 	if (view == NULL)
 		return;
 
+	linecache_invalidate(view->line_cache, transaction);
+
 	line = accview_get_line_from_transaction(view, transaction);
 
 	if (view != NULL && line != -1)
@@ -1932,6 +1988,8 @@ void accview_reindex_all(struct file_block *file)
 		view = account_get_accview(file, account);
 
 		if (view != NULL && view->line_data != NULL) {
+			linecache_invalidate_all(view->line_cache);
+
 			for (line = 0; line < view->display_lines; line++) {
 				transaction = (view->line_data)[line].transaction;
 				(view->line_data)[line].transaction = transact_get_new_sort_index(file, transaction);
@@ -1962,8 +2020,10 @@ void accview_redraw_all(struct file_block *file)
 	for (account = 0; account < account_get_count(file); account++) {
 		view = account_get_accview(file, account);
 
-		if (view != NULL && view->accview_window != NULL)
+		if (view != NULL && view->accview_window != NULL) {
+			linecache_invalidate_all(view->line_cache);
 			windows_redraw(view->accview_window);
+		}
 	}
 }
 
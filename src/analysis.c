@@ -36,6 +36,7 @@
 /* OSLib header files */
 
 #include "oslib/hourglass.h"
+#include "oslib/os.h"
 #include "oslib/wimp.h"
 
 /* SF-Lib header files. */
@@ -65,6 +66,7 @@
 #include "analysis_data.h"
 #include "analysis_dialogue.h"
 #include "analysis_period.h"
+#include "analysis_scan.h"
 #include "analysis_template.h"
 #include "analysis_template_save.h"
 #include "analysis_transaction.h"
@@ -74,7 +76,6 @@
 #include "date.h"
 #include "file.h"
 #include "report.h"
-#include "stringbuild.h"
 #include "transact.h"
 
 /**
@@ -90,10 +91,10 @@
 #define ANALYSIS_MAX_TITLE_LEN 1024
 
 /**
- * The maximum space allocated for a report line.
+ * The time to spend generating reports on each Null Event, in centiseconds.
  */
 
-#define ANALYSIS_MAX_LINE_LEN 2048
+#define ANALYSIS_JOB_SLICE 5
 
 /**
  * The analysis report details in a file.
@@ -120,6 +121,30 @@ struct analysis_block
 	void					*reports[ANALYSIS_REPORT_TYPE_COUNT];
 };
 
+/**
+ * A report which is being generated in the background.
+ */
+
+struct analysis_job {
+	struct analysis_block		*instance;				/**< The analysis instance owning the report.			*/
+	struct analysis_report_details	*details;				/**< The details of the report type.				*/
+
+	void				*settings;				/**< The report settings, held in the report's template.	*/
+	struct report			*report;				/**< The report being written to.				*/
+	struct analysis_data_block	*scratch;				/**< The scratch space used to build the report.		*/
+	struct analysis_scan_block	*scan;					/**< A shared transaction scan to use, or NULL.			*/
+
+	osbool				started;				/**< TRUE if the generator has been started.			*/
+	void				*state;					/**< The generator's state, or NULL.				*/
+	unsigned			version;				/**< The file's data version when the generator started.	*/
+	date_t				date;					/**< The date when the generator started.			*/
+	unsigned			key;					/**< The hash of the template and title, for the cache.	*/
+
+	char				title[ANALYSIS_MAX_TITLE_LEN];		/**< The title of the report.					*/
+
+	struct analysis_job		*next;					/**< The next job in the queue, or NULL.			*/
+};
+
 //static struct analysis_report		analysis_report_template;			/**< New report settings for passing to the Report module.			*/
 
 
@@ -129,10 +154,20 @@ struct analysis_block
 
 static struct analysis_report_details	*analysis_report_types[ANALYSIS_REPORT_TYPE_COUNT];
 
+/**
+ * The queue of reports waiting to be generated, in order.
+ */
+
+static struct analysis_job		*analysis_jobs = NULL;
+
 
 /* Static Function Prototypes. */
 
 static void analysis_remove_account_from_report_template(struct analysis_report *template, void *data);
+static void analysis_queue_report(struct analysis_block *instance, enum analysis_report_type type, void *settings, template_t template, struct analysis_scan_block *scan);
+static void analysis_finish_job(struct analysis_job *job, char *error);
+static void analysis_cancel_job(void *data);
+static void analysis_delete_job(struct analysis_job *job);
 
 
 
@@ -229,10 +264,26 @@ void analysis_delete_instance(struct analysis_block *instance)
 {
 	enum analysis_report_type	type;
 	struct analysis_report_details	*report_details;
+	struct analysis_job		*job, *next;
 
 	if (instance == NULL)
 		return;
 
+	/* Abandon any reports which are still waiting to be generated; deleting
+	 * the report will remove the job from the queue.
+	 */
+
+	job = analysis_jobs;
+
+	while (job != NULL) {
+		next = job->next;
+
+		if (job->instance == instance)
+			report_delete(job->report);
+
+		job = next;
+	}
+
 	/* Free any saved report data. */
 
 	if (instance->templates != NULL)
@@ -419,7 +470,8 @@ static void analysis_remove_account_from_report_template(struct analysis_report
 
 
 /**
- * Run a report, using supplied template data.
+ * Run a report, using supplied template data. The report is queued, and
+ * then generated in the background by analysis_generate_in_background().
  *
  * \param *instance		The analysis instance owning the report.
  * \param type			The type of report to run.
@@ -429,35 +481,117 @@ static void analysis_remove_account_from_report_template(struct analysis_report
 
 void analysis_run_report(struct analysis_block *instance, enum analysis_report_type type, void *settings, template_t template)
 {
-	struct analysis_report_details	*report_details;
-	struct analysis_report		*report_template = NULL, *new_template = NULL;
-	struct analysis_data_block	*data = NULL;
-	struct report			*report = NULL;
-	char				*filename, title[ANALYSIS_MAX_TITLE_LEN], name[ANALYSIS_SAVED_NAME_LEN];
-	char				report_line[ANALYSIS_MAX_LINE_LEN];
+	struct analysis_scan_block	*scan;
 
-	/* Identify the report type. */
-
-	report_details = analysis_get_report_details(type);
-	if (report_details == NULL || instance == NULL || instance->file == NULL || instance->templates == NULL || settings == NULL)
+	if (instance == NULL)
 		return;
 
-	/* Initialise the stringbuilder for the client to use. */
+	/* Even a single report can save on passes through the transactions,
+	 * if it covers several periods. If the scan can't be created, the
+	 * report will fall back to scanning the transactions itself.
+	 */
+
+	scan = analysis_scan_create(instance->file);
+	analysis_queue_report(instance, type, settings, template, scan);
+	analysis_scan_release(scan);
+}
+
+
+/**
+ * Run a batch of saved report templates, sharing a single pass through the
+ * transactions between those reports which can make use of it. The reports
+ * are queued, and then generated in the background in the order given.
+ *
+ * \param *instance		The analysis instance owning the templates.
+ * \param *templates		Pointer to an array of templates to run.
+ * \param count			The number of templates in the array.
+ */
+
+void analysis_run_batch(struct analysis_block *instance, template_t *templates, size_t count)
+{
+	struct analysis_scan_block	*scan;
+	struct analysis_report		*template;
+	size_t				i;
 
-	if (!stringbuild_initialise(report_line, ANALYSIS_MAX_LINE_LEN))
+	if (instance == NULL || instance->templates == NULL || templates == NULL)
 		return;
 
-	hourglass_on();
+	scan = analysis_scan_create(instance->file);
 
-	/* Claim the necessary report scratch space for the client to use. */
+	for (i = 0; i < count; i++) {
+		template = analysis_template_get_report(instance->templates, templates[i]);
+		if (template == NULL)
+			continue;
 
-	data = analysis_data_claim(instance->file);
-	if (data == NULL) {
-		hourglass_off();
+		analysis_queue_report(instance, analysis_template_type(instance->templates, templates[i]),
+				analysis_template_get_data(template), templates[i], scan);
+	}
+
+	analysis_scan_release(scan);
+}
+
+
+/**
+ * Run all of the saved report templates in an analysis instance, as a
+ * single batch.
+ *
+ * \param *instance		The analysis instance owning the templates.
+ */
+
+void analysis_run_all_templates(struct analysis_block *instance)
+{
+	template_t	*templates;
+	int		i, count;
+
+	if (instance == NULL || instance->templates == NULL)
+		return;
+
+	count = analysis_template_get_count(instance->templates);
+	if (count <= 0)
+		return;
+
+	templates = heap_alloc(sizeof(template_t) * count);
+	if (templates == NULL) {
 		error_msgs_report_info("NoMemReport");
 		return;
 	}
 
+	for (i = 0; i < count; i++)
+		templates[i] = i;
+
+	analysis_run_batch(instance, templates, count);
+
+	heap_free(templates);
+}
+
+
+/**
+ * Queue a report to be generated in the background, using supplied
+ * template data.
+ *
+ * \param *instance		The analysis instance owning the report.
+ * \param type			The type of report to run.
+ * \param *settings		The template data for the report.
+ * \param template		The template on which the report is based, or NULL_TEMPLATE.
+ * \param *scan			A shared transaction scan to register with, or NULL.
+ */
+
+static void analysis_queue_report(struct analysis_block *instance, enum analysis_report_type type, void *settings, template_t template, struct analysis_scan_block *scan)
+{
+	struct analysis_report_details	*report_details;
+	struct analysis_report		*report_template = NULL, *new_template = NULL;
+	struct analysis_data_block	*data = NULL;
+	struct report			*report = NULL;
+	struct analysis_job		*job = NULL, **tail;
+	char				*filename, title[ANALYSIS_MAX_TITLE_LEN], heading[ANALYSIS_MAX_TITLE_LEN], name[ANALYSIS_SAVED_NAME_LEN];
+	unsigned			key;
+
+	/* Identify the report type. */
+
+	report_details = analysis_get_report_details(type);
+	if (report_details == NULL || instance == NULL || instance->file == NULL || instance->templates == NULL || settings == NULL)
+		return;
+
 	/* Create a new report template to save with the report. */
 
 	if (template != NULL_TEMPLATE) {
@@ -474,9 +608,37 @@ void analysis_run_report(struct analysis_block *instance, enum analysis_report_t
 	new_template = analysis_template_create_new(instance->templates, name, type, settings);
 
 	if (new_template == NULL) {
-		if (data != NULL)
-			analysis_data_free(data);
-		hourglass_off();
+		error_msgs_report_info("NoMemReport");
+		return;
+	}
+
+	/* Construct the report title. */
+
+	filename = file_get_leafname(instance->file, NULL, 0);
+	if (name == NULL || *name == '\0')
+		msgs_param_lookup(report_details->report_title_token, heading, ANALYSIS_MAX_TITLE_LEN, filename, NULL, NULL, NULL);
+	else
+		msgs_param_lookup("GRTitle", heading, ANALYSIS_MAX_TITLE_LEN, name, filename, NULL, NULL);
+
+	/* If an identical report has been run against the same data today,
+	 * and is still in the cache, reopen it instead of starting again.
+	 */
+
+	key = analysis_template_get_hash(new_template, heading);
+
+	report = report_find_cached(instance->file, new_template, key, file_get_data_version(instance->file), date_today());
+
+	if (report != NULL) {
+		heap_free(new_template);
+		report_reopen(report);
+		return;
+	}
+
+	/* Claim the necessary report scratch space for the client to use. */
+
+	data = analysis_data_claim(instance->file);
+	if (data == NULL) {
+		heap_free(new_template);
 		error_msgs_report_info("NoMemReport");
 		return;
 	}
@@ -491,41 +653,222 @@ void analysis_run_report(struct analysis_block *instance, enum analysis_report_t
 			analysis_data_free(data);
 		if (new_template != NULL)
 			heap_free(new_template);
-		hourglass_off();
 		error_msgs_report_info("NoMemReport");
 		return;
 	}
 
-	/* Construct the report title. */
+	/* Create a job to generate the report. The settings are taken from
+	 * the report's own template, as the ones passed in belong to the
+	 * dialogue and may change before the report is complete.
+	 */
 
-	filename = file_get_leafname(instance->file, NULL, 0);
-	if (name == NULL || *name == '\0')
-		msgs_param_lookup(report_details->report_title_token, title, ANALYSIS_MAX_TITLE_LEN, filename, NULL, NULL, NULL);
+	job = heap_alloc(sizeof(struct analysis_job));
+
+	if (job == NULL) {
+		if (data != NULL)
+			analysis_data_free(data);
+		report_delete(report);
+		error_msgs_report_info("NoMemReport");
+		return;
+	}
+
+	job->instance = instance;
+	job->details = report_details;
+	job->settings = analysis_template_get_data(new_template);
+	job->report = report;
+	job->scratch = data;
+	job->scan = NULL;
+	job->started = FALSE;
+	job->state = NULL;
+	job->version = 0;
+	job->date = NULL_DATE;
+	job->key = key;
+	job->next = NULL;
+
+	string_copy(job->title, heading, ANALYSIS_MAX_TITLE_LEN);
+
+	/* If the report can take its totals from a shared scan, tell the
+	 * scan which dates it will need.
+	 */
+
+	if (scan != NULL && report_details->prepare_scan != NULL) {
+		job->scan = analysis_scan_claim(scan);
+		report_details->prepare_scan(instance, job->settings, scan);
+		analysis_data_set_scan(data, scan);
+	}
+
+	/* Add the job to the end of the queue, and show the report's window. */
+
+	tail = &analysis_jobs;
+
+	while (*tail != NULL)
+		tail = &((*tail)->next);
+
+	*tail = job;
+
+	report_set_cancel_handler(report, analysis_cancel_job, job);
+	report_show_progress(report, 0);
+}
+
+
+/**
+ * Test whether there are any reports waiting to be generated by calling
+ * analysis_generate_in_background().
+ *
+ * \return			TRUE if there is work pending; otherwise FALSE.
+ */
+
+osbool analysis_generate_pending(void)
+{
+	return (analysis_jobs != NULL) ? TRUE : FALSE;
+}
+
+
+/**
+ * Continue generating the report at the head of the queue, for a short
+ * period of time. This should be called on Null Events while
+ * analysis_generate_pending() returns TRUE.
+ */
+
+void analysis_generate_in_background(void)
+{
+	struct analysis_job	*job = analysis_jobs;
+	struct file_block	*file;
+	os_t			deadline;
+	int			progress;
+
+	if (job == NULL)
+		return;
+
+	deadline = os_read_monotonic_time() + ANALYSIS_JOB_SLICE;
+	file = job->instance->file;
+
+	if (!job->started) {
+		/* Sort the file data, ready for the report. This is left
+		 * until now, as the file could be edited while the job waits.
+		 */
+
+		transact_sort_file_data(file);
+
+		job->started = TRUE;
+		job->version = file_get_data_version(file);
+		job->date = date_today();
+
+		/* Report types which can't be generated in stages are run to
+		 * completion in one go, as they always were.
+		 */
+
+		if (job->details->start_report == NULL || job->details->step_report == NULL) {
+			hourglass_on();
+			job->details->run_report(job->instance, job->settings, job->report, job->scratch, job->title);
+			hourglass_off();
+
+			analysis_finish_job(job, NULL);
+			return;
+		}
+
+		job->state = job->details->start_report(job->instance, job->settings, job->report, job->scratch, job->title);
+		if (job->state == NULL) {
+			analysis_finish_job(job, "NoMemReport");
+			return;
+		}
+	} else if (file_get_data_version(file) != job->version) {
+		/* The report holds references to transactions and accounts
+		 * by index, so there's no safe way to carry on if the file
+		 * has been changed since the last slice.
+		 */
+
+		analysis_finish_job(job, "RepChanged");
+		return;
+	}
+
+	progress = 0;
+
+	if (job->details->step_report(job->state, deadline, &progress))
+		analysis_finish_job(job, NULL);
 	else
-		msgs_param_lookup("GRTitle", title, ANALYSIS_MAX_TITLE_LEN, name, filename, NULL, NULL);
+		report_show_progress(job->report, progress);
+}
+
 
-	/* Sort the file data, ready for the report. */
+/**
+ * Complete a report job, removing it from the queue, and either close the
+ * report so that it can be displayed or discard it with an error.
+ *
+ * \param *job			The job to finish.
+ * \param *error		The token of an error to report, or NULL for success.
+ */
 
-	transact_sort_file_data(instance->file);
+static void analysis_finish_job(struct analysis_job *job, char *error)
+{
+	struct report	*report;
+
+	if (job == NULL)
+		return;
 
-	/* Run the report. */
+	report = job->report;
 
-	report_details->run_report(instance, settings, report, data, title);
+	report_set_cancel_handler(report, NULL, NULL);
+
+	if (error == NULL)
+		report_set_cache_key(report, job->key, job->version, job->date);
+
+	analysis_delete_job(job);
+
+	if (error == NULL) {
+		report_close(report);
+	} else {
+		report_delete(report);
+		error_msgs_report_info(error);
+	}
+}
+
+
+/**
+ * Callback from the report module when a report is deleted before its job
+ * has completed, to abandon the job.
+ *
+ * \param *data		The job to be abandoned.
+ */
+
+static void analysis_cancel_job(void *data)
+{
+	analysis_delete_job(data);
+}
+
+
+/**
+ * Remove a report job from the queue and free its memory. The report
+ * itself is left alone.
+ *
+ * \param *job			The job to delete.
+ */
+
+static void analysis_delete_job(struct analysis_job *job)
+{
+	struct analysis_job	**list;
+
+	if (job == NULL)
+		return;
 
-	/* Close the report. */
+	list = &analysis_jobs;
 
-	report_close(report);
+	while (*list != NULL && *list != job)
+		list = &((*list)->next);
 
-	/* Free the account scratch space. */
+	if (*list != NULL)
+		*list = job->next;
 
-	if (data != NULL)
-		analysis_data_free(data);
+	if (job->state != NULL && job->details->end_report != NULL)
+		job->details->end_report(job->state);
 
-	/* Terminate the stringbuilder. */
+	if (job->scratch != NULL)
+		analysis_data_free(job->scratch);
 
-	stringbuild_cancel();
+	if (job->scan != NULL)
+		analysis_scan_release(job->scan);
 
-	hourglass_off();
+	heap_free(job);
 }
 
 
@@ -56,6 +56,12 @@ typedef int template_t;
 
 #define ANALYSIS_ACC_LIST_LEN 64
 
+/**
+ * The maximum space allocated for a report line.
+ */
+
+#define ANALYSIS_MAX_LINE_LEN 2048
+
 #include "account.h"
 #include "analysis_balance.h"
 #include "analysis_cashflow.h"
@@ -144,6 +150,30 @@ struct analysis_report_details {
 	 * Remove a template definition.
 	 */
 	void		(*remove_template)(struct analysis_block *parent, template_t template);
+
+	/**
+	 * Start generating an analysis report in the background, returning
+	 * the generator's state, or NULL on failure. If this is NULL, the
+	 * report will be generated in one go by run_report.
+	 */
+	void*		(*start_report)(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title);
+
+	/**
+	 * Continue generating an analysis report until the deadline passes,
+	 * returning TRUE when it is complete.
+	 */
+	osbool		(*step_report)(void *state, os_t deadline, int *progress);
+
+	/**
+	 * Free the generator's state for an analysis report.
+	 */
+	void		(*end_report)(void *state);
+
+	/**
+	 * Register the date ranges that an analysis report will need from
+	 * a shared transaction scan, or NULL if it can't use one.
+	 */
+	void		(*prepare_scan)(struct analysis_block *parent, void *template, struct analysis_scan_block *scan);
 };
 
 
@@ -249,7 +279,8 @@ void analysis_remove_account_from_templates(struct file_block *file, acct_t acco
 
 
 /**
- * Run a report, using supplied template data.
+ * Run a report, using supplied template data. The report is queued, and
+ * then generated in the background by analysis_generate_in_background().
  *
  * \param *instance		The analysis instance owning the report.
  * \param type			The type of report to run.
@@ -259,6 +290,48 @@ void analysis_remove_account_from_templates(struct file_block *file, acct_t acco
 
 void analysis_run_report(struct analysis_block *instance, enum analysis_report_type type, void *settings, template_t template);
 
+
+/**
+ * Run a batch of saved report templates, sharing a single pass through the
+ * transactions between those reports which can make use of it. The reports
+ * are queued, and then generated in the background in the order given.
+ *
+ * \param *instance		The analysis instance owning the templates.
+ * \param *templates		Pointer to an array of templates to run.
+ * \param count			The number of templates in the array.
+ */
+
+void analysis_run_batch(struct analysis_block *instance, template_t *templates, size_t count);
+
+
+/**
+ * Run all of the saved report templates in an analysis instance, as a
+ * single batch.
+ *
+ * \param *instance		The analysis instance owning the templates.
+ */
+
+void analysis_run_all_templates(struct analysis_block *instance);
+
+
+/**
+ * Test whether there are any reports waiting to be generated by calling
+ * analysis_generate_in_background().
+ *
+ * \return			TRUE if there is work pending; otherwise FALSE.
+ */
+
+osbool analysis_generate_pending(void);
+
+
+/**
+ * Continue generating the report at the head of the queue, for a short
+ * period of time. This should be called on Null Events while
+ * analysis_generate_pending() returns TRUE.
+ */
+
+void analysis_generate_in_background(void);
+
 /**
  * Establish and return the range of dates to report over, based on the values
  * in a dialogue box and the data in the file concerned.
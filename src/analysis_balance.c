@@ -33,6 +33,7 @@
 
 /* OSLib header files */
 
+#include "oslib/os.h"
 #include "oslib/wimp.h"
 
 /* SF-Lib header files. */
@@ -52,12 +53,12 @@
 #include "analysis_data.h"
 #include "analysis_dialogue.h"
 #include "analysis_period.h"
+#include "analysis_scan.h"
 #include "analysis_template.h"
 #include "currency.h"
 #include "date.h"
 #include "file.h"
 #include "report.h"
-#include "stringbuild.h"
 #include "transact.h"
 
 /* Balance Report window. */
@@ -133,6 +134,25 @@ struct analysis_balance_block {
 	struct analysis_balance_report		saved;
 };
 
+/**
+ * The state of a Balance Report which is being generated.
+ */
+
+struct analysis_balance_job {
+	struct file_block			*file;				/**< The file being reported on.				*/
+	struct analysis_balance_report		*settings;			/**< The settings for the report.				*/
+	struct report				*report;			/**< The report being written to.				*/
+	struct analysis_data_block		*scratch;			/**< The scratch space used to build the report.		*/
+
+	date_t					start_date;			/**< The start date of the report.				*/
+	int					total_days;			/**< The number of days covered by the report.			*/
+
+	struct analysis_period_block		periods;			/**< The report period iterator.				*/
+	date_t					next_start;			/**< The start date of the current period.			*/
+	date_t					next_end;			/**< The end date of the current period.			*/
+	char					date_text[ANALYSIS_PERIOD_NAME_LEN];	/**< The name of the current period.				*/
+};
+
 /**
  * The dialogue instance used for this report.
  */
@@ -149,6 +169,12 @@ static void analysis_balance_rename_template(struct analysis_block *parent, temp
 static void analysis_balance_fill_window(struct analysis_block *parent, wimp_w window, void *block);
 static void analysis_balance_process_window(struct analysis_block *parent, wimp_w window, void *block);
 static void analysis_balance_generate(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title);
+static void *analysis_balance_start(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title);
+static osbool analysis_balance_step(void *state, os_t deadline, int *progress);
+static void analysis_balance_end(void *state);
+static void analysis_balance_write_period(struct analysis_balance_job *job);
+static int analysis_balance_get_progress(struct analysis_balance_job *job);
+static void analysis_balance_prepare_scan(struct analysis_block *parent, void *template, struct analysis_scan_block *scan);
 static void analysis_balance_remove_template(struct analysis_block *parent, template_t template);
 static void analysis_balance_remove_account(void *report, acct_t account);
 static void analysis_balance_copy_template(void *to, void *from);
@@ -170,7 +196,11 @@ static struct analysis_report_details analysis_balance_details = {
 	analysis_balance_copy_template,
 	analysis_balance_rename_template,
 	analysis_balance_remove_account,
-	analysis_balance_remove_template
+	analysis_balance_remove_template,
+	analysis_balance_start,
+	analysis_balance_step,
+	analysis_balance_end,
+	analysis_balance_prepare_scan
 };
 
 /* The Balance Report Dialogue Icon Details. */
@@ -476,7 +506,7 @@ static void analysis_balance_process_window(struct analysis_block *parent, wimp_
 
 
 /**
- * Generate a balance report.
+ * Generate a balance report in one go.
  *
  * \param *parent		The parent analysis instance.
  * \param *template		The template data to use for the report.
@@ -486,34 +516,68 @@ static void analysis_balance_process_window(struct analysis_block *parent, wimp_
  */
 
 static void analysis_balance_generate(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title)
+{
+	void	*state;
+
+	state = analysis_balance_start(parent, template, report, scratch, title);
+	if (state == NULL)
+		return;
+
+	while (!analysis_balance_step(state, os_read_monotonic_time() + 100, NULL));
+
+	analysis_balance_end(state);
+}
+
+
+/**
+ * Start generating a balance report, writing the heading and setting up the
+ * state required for analysis_balance_step() to work through the report
+ * periods.
+ *
+ * \param *parent		The parent analysis instance.
+ * \param *template		The template data to use for the report.
+ * \param *report		The report to write to.
+ * \param *scratch		The scratch space to use to build the report.
+ * \param *title		Pointer to the report title.
+ * \return			The report generator state, or NULL on failure.
+ */
+
+static void *analysis_balance_start(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title)
 {
 	struct analysis_balance_report		*settings = template;
+	struct analysis_balance_job		*job;
 	struct file_block			*file;
-
-	char			date_text[1024];
-	date_t			start_date, end_date, next_start, next_end;
-	int			entries, acc_group, group_line, groups = 3, sequence[]={ACCOUNT_FULL,ACCOUNT_IN,ACCOUNT_OUT};
-	acct_t			acc;
-	amt_t			amount, total;
+	date_t					end_date;
+	int					entries, column, acc_group, group_line, groups = 3, sequence[]={ACCOUNT_FULL,ACCOUNT_IN,ACCOUNT_OUT};
+	acct_t					acc;
 
 	if (parent == NULL || report == NULL || settings == NULL || scratch == NULL || title == NULL)
-		return;
+		return NULL;
 
 	file = analysis_get_file(parent);
 	if (file == NULL)
-		return;
+		return NULL;
+
+	job = heap_alloc(sizeof(struct analysis_balance_job));
+	if (job == NULL)
+		return NULL;
+
+	job->file = file;
+	job->settings = settings;
+	job->report = report;
+	job->scratch = scratch;
 
 	/* Read the include list. */
 
 	if (settings->accounts_count == 0 && settings->incoming_count == 0 && settings->outgoing_count == 0) {
-		analysis_data_set_flags_from_account_list(scratch, ACCOUNT_FULL | ACCOUNT_IN | ACCOUNT_OUT,
+		analysis_data_set_flags_from_account_list(job->scratch, ACCOUNT_FULL | ACCOUNT_IN | ACCOUNT_OUT,
 				ANALYSIS_DATA_INCLUDE, NULL, 1);
 	} else {
-		analysis_data_set_flags_from_account_list(scratch, ACCOUNT_FULL, ANALYSIS_DATA_INCLUDE,
+		analysis_data_set_flags_from_account_list(job->scratch, ACCOUNT_FULL, ANALYSIS_DATA_INCLUDE,
 				settings->accounts, settings->accounts_count);
-		analysis_data_set_flags_from_account_list(scratch, ACCOUNT_IN, ANALYSIS_DATA_INCLUDE,
+		analysis_data_set_flags_from_account_list(job->scratch, ACCOUNT_IN, ANALYSIS_DATA_INCLUDE,
 				settings->incoming, settings->incoming_count);
-		analysis_data_set_flags_from_account_list(scratch, ACCOUNT_OUT, ANALYSIS_DATA_INCLUDE,
+		analysis_data_set_flags_from_account_list(job->scratch, ACCOUNT_OUT, ANALYSIS_DATA_INCLUDE,
 				settings->outgoing, settings->outgoing_count);
 	}
 
@@ -523,17 +587,19 @@ static void analysis_balance_generate(struct analysis_block *parent, void *templ
 
 	/* Read the date settings and output their details. */
 
-	analysis_find_date_range(parent, &start_date, &end_date, settings->date_from, settings->date_to, settings->budget, report);
+	analysis_find_date_range(parent, &(job->start_date), &end_date, settings->date_from, settings->date_to, settings->budget, report);
+
+	job->total_days = date_count_days(job->start_date, end_date);
 
 	/* Start to output the report. */
 
 	if (settings->tabular) {
 		report_write_line(report, 0, "");
 
-		stringbuild_reset();
+		column = 0;
 
-		stringbuild_add_string("\\k\\v\\b");
-		stringbuild_add_message("BRDate");
+		report_begin_line(report, 1, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+		report_add_message_cell(report, column++, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_BOLD, "BRDate", NULL, NULL, NULL, NULL);
 
 		for (acc_group = 0; acc_group < groups; acc_group++) {
 			entries = account_get_list_length(file, sequence[acc_group]);
@@ -541,92 +607,193 @@ static void analysis_balance_generate(struct analysis_block *parent, void *templ
 			for (group_line = 0; group_line < entries; group_line++) {
 				if ((acc = account_get_list_entry_account(file, sequence[acc_group], group_line)) != NULL_ACCOUNT) {
 					if (analysis_data_test_account(scratch, acc, ANALYSIS_DATA_INCLUDE)) {
-						stringbuild_add_printf("\\t\\v\\r\\b%s", account_get_name(file, acc));
+						report_add_text_cell(report, column++, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_RIGHT | REPORT_CELL_FLAGS_BOLD, account_get_name(file, acc));
 					}
 				}
 			}
 		}
-		stringbuild_add_string("\\t\\v\\r\\b");
-		stringbuild_add_message("BRTotal");
+		report_add_message_cell(report, column, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_RIGHT | REPORT_CELL_FLAGS_BOLD, "BRTotal", NULL, NULL, NULL, NULL);
+		report_end_line(report);
+	}
+
+	/* Set up the report time groups. */
+
+	analysis_period_initialise(&(job->periods), job->start_date, end_date, settings->group, settings->period, settings->period_unit, settings->lock);
+
+	job->next_start = NULL_DATE;
+	job->next_end = NULL_DATE;
+
+	return job;
+}
+
+
+/**
+ * Continue generating a balance report, one time group at a time, until
+ * either it is complete or the deadline has passed.
+ *
+ * \param *state		The report generator state.
+ * \param deadline		The time at which to stop and return.
+ * \param *progress		Pointer to a variable to take the percentage
+ *				complete, or NULL.
+ * \return			TRUE if the report is complete; else FALSE.
+ */
+
+static osbool analysis_balance_step(void *state, os_t deadline, int *progress)
+{
+	struct analysis_balance_job	*job = state;
+
+	if (job == NULL)
+		return TRUE;
+
+	while (analysis_period_get_next_dates(&(job->periods), &(job->next_start), &(job->next_end), job->date_text, sizeof(job->date_text))) {
+		analysis_data_calculate_balances(job->scratch, NULL_DATE, job->next_end, TRUE);
+		analysis_balance_write_period(job);
 
-		stringbuild_report_line(report, 1);
+		if ((int) (os_read_monotonic_time() - deadline) >= 0) {
+			if (progress != NULL)
+				*progress = analysis_balance_get_progress(job);
+
+			return FALSE;
+		}
 	}
 
-	/* Process the report time groups. */
+	return TRUE;
+}
+
+
+/**
+ * Free the state of a balance report generator.
+ *
+ * \param *state		The report generator state.
+ */
+
+static void analysis_balance_end(void *state)
+{
+	if (state != NULL)
+		heap_free(state);
+}
 
-	analysis_period_initialise(start_date, end_date, settings->group, settings->period, settings->period_unit, settings->lock);
 
-	while (analysis_period_get_next_dates(&next_start, &next_end, date_text, sizeof(date_text))) {
-		analysis_data_calculate_balances(scratch, NULL_DATE, next_end, TRUE);
+/**
+ * Write the balances for the current time group to a balance report.
+ *
+ * \param *job			The report generator state.
+ */
 
-		/* Print the transaction summaries. */
+static void analysis_balance_write_period(struct analysis_balance_job *job)
+{
+	int	entries, column, acc_group, group_line, groups = 3, sequence[]={ACCOUNT_FULL,ACCOUNT_IN,ACCOUNT_OUT};
+	acct_t	acc;
+	amt_t	amount, total;
 
-		if (settings->tabular) {
-			stringbuild_reset();
+	if (job->settings->tabular) {
+		column = 0;
 
-			stringbuild_add_printf("\\k\\v%s", date_text);
+		report_begin_line(job->report, 1, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+		report_add_text_cell(job->report, column++, REPORT_CELL_FLAGS_RULE_AFTER, job->date_text);
 
-			total = 0;
+		total = 0;
 
 
-			for (acc_group = 0; acc_group < groups; acc_group++) {
-				entries = account_get_list_length(file, sequence[acc_group]);
+		for (acc_group = 0; acc_group < groups; acc_group++) {
+			entries = account_get_list_length(job->file, sequence[acc_group]);
 
-				for (group_line = 0; group_line < entries; group_line++) {
-					if ((acc = account_get_list_entry_account(file, sequence[acc_group], group_line)) != NULL_ACCOUNT) {
-						if (analysis_data_test_account(scratch, acc, ANALYSIS_DATA_INCLUDE)) {
-							amount = analysis_data_get_total(scratch, acc);
+			for (group_line = 0; group_line < entries; group_line++) {
+				if ((acc = account_get_list_entry_account(job->file, sequence[acc_group], group_line)) != NULL_ACCOUNT) {
+					if (analysis_data_test_account(job->scratch, acc, ANALYSIS_DATA_INCLUDE)) {
+						amount = analysis_data_get_total(job->scratch, acc);
 
-							total += amount;
+						total += amount;
 
-							stringbuild_add_string("\\t\\v\\d\\r");
-							stringbuild_add_currency(amount, TRUE);
-						}
+						report_add_currency_cell(job->report, column++, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_RIGHT, amount, TRUE);
 					}
 				}
 			}
-			stringbuild_add_string("\\t\\v\\d\\r");
-			stringbuild_add_currency(total, TRUE);
-			stringbuild_report_line(report, 1);
-		} else {
-			report_write_line(report, 0, "");
-			if (settings->group) {
-				stringbuild_reset();
-				stringbuild_add_printf("\\u%s", date_text);
-				stringbuild_report_line(report, 0);
-			}
+		}
+		report_add_currency_cell(job->report, column, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_RIGHT, total, TRUE);
+		report_end_line(job->report);
+	} else {
+		report_write_line(job->report, 0, "");
+		if (job->settings->group) {
+			report_begin_line(job->report, 0, REPORT_LINE_FLAGS_NONE);
+			report_add_text_cell(job->report, 0, REPORT_CELL_FLAGS_UNDERLINE, job->date_text);
+			report_end_line(job->report);
+		}
 
-			total = 0;
+		total = 0;
 
-			for (acc_group = 0; acc_group < groups; acc_group++) {
-				entries = account_get_list_length(file, sequence[acc_group]);
+		for (acc_group = 0; acc_group < groups; acc_group++) {
+			entries = account_get_list_length(job->file, sequence[acc_group]);
 
-				for (group_line = 0; group_line < entries; group_line++) {
-					if ((acc = account_get_list_entry_account(file, sequence[acc_group], group_line)) != NULL_ACCOUNT) {
-						amount = analysis_data_get_total(scratch, acc);
+			for (group_line = 0; group_line < entries; group_line++) {
+				if ((acc = account_get_list_entry_account(job->file, sequence[acc_group], group_line)) != NULL_ACCOUNT) {
+					amount = analysis_data_get_total(job->scratch, acc);
 
-						if (amount != 0 && analysis_data_test_account(scratch, acc, ANALYSIS_DATA_INCLUDE)) {
-							total += amount;
+					if (amount != 0 && analysis_data_test_account(job->scratch, acc, ANALYSIS_DATA_INCLUDE)) {
+						total += amount;
 
-							stringbuild_reset();
-							stringbuild_add_printf("\\i%s\\t\\d\\r", account_get_name(file, acc));
-							stringbuild_add_currency(amount, TRUE);
-							stringbuild_report_line(report, 2);
-						}
+						report_begin_line(job->report, 2, REPORT_LINE_FLAGS_NONE);
+						report_add_text_cell(job->report, 0, REPORT_CELL_FLAGS_INDENT, account_get_name(job->file, acc));
+						report_add_currency_cell(job->report, 1, REPORT_CELL_FLAGS_RIGHT, amount, TRUE);
+						report_end_line(job->report);
 					}
 				}
 			}
-			stringbuild_reset();
-			stringbuild_add_string("\\i\\b");
-			stringbuild_add_message("BRTotal");
-			stringbuild_add_string("\\t\\d\\r\\b");
-			stringbuild_add_currency(total, TRUE);
-			stringbuild_report_line(report, 2);
 		}
+		report_begin_line(job->report, 2, REPORT_LINE_FLAGS_NONE);
+		report_add_message_cell(job->report, 0, REPORT_CELL_FLAGS_INDENT | REPORT_CELL_FLAGS_BOLD, "BRTotal", NULL, NULL, NULL, NULL);
+		report_add_currency_cell(job->report, 1, REPORT_CELL_FLAGS_RIGHT | REPORT_CELL_FLAGS_BOLD, total, TRUE);
+		report_end_line(job->report);
 	}
 }
 
 
+/**
+ * Estimate how far through a balance report the generator has got, from the
+ * days covered by the time groups which are complete.
+ *
+ * \param *job			The report generator state.
+ * \return			The percentage of the report completed.
+ */
+
+static int analysis_balance_get_progress(struct analysis_balance_job *job)
+{
+	if (job->total_days <= 0 || job->next_end == NULL_DATE)
+		return 0;
+
+	return 100 * date_count_days(job->start_date, job->next_end) / job->total_days;
+}
+
+
+/**
+ * Register the date ranges that a balance report will need to take from a
+ * shared transaction scan, by working through its periods in the same way
+ * as the report itself.
+ *
+ * \param *parent		The parent analysis instance.
+ * \param *template		The template data to use for the report.
+ * \param *scan			The scan to register the ranges with.
+ */
+
+static void analysis_balance_prepare_scan(struct analysis_block *parent, void *template, struct analysis_scan_block *scan)
+{
+	struct analysis_balance_report		*settings = template;
+	struct analysis_period_block		periods;
+	char					date_text[ANALYSIS_PERIOD_NAME_LEN];
+	date_t					start_date, end_date, next_start, next_end;
+
+	if (parent == NULL || settings == NULL || scan == NULL)
+		return;
+
+	analysis_find_date_range(parent, &start_date, &end_date, settings->date_from, settings->date_to, settings->budget, NULL);
+
+	analysis_period_initialise(&periods, start_date, end_date, settings->group, settings->period, settings->period_unit, settings->lock);
+
+	while (analysis_period_get_next_dates(&periods, &next_start, &next_end, date_text, sizeof(date_text)))
+		analysis_scan_add_range(scan, NULL_DATE, next_end);
+}
+
+
 /**
  * Remove any references to a report template.
  * 
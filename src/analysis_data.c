@@ -58,6 +58,8 @@
 #include "analysis_data.h"
 
 #include "account.h"
+#include "analysis_scan.h"
+#include "archive.h"
 //#include "account_menu.h"
 //#include "analysis_balance.h"
 //#include "analysis_cashflow.h"
@@ -95,11 +97,17 @@ struct analysis_data {
  */
 
 struct analysis_data_block {
-	struct file_block	*file;		/**< The file to which the data applies.	*/
-	size_t			count;		/**< The number of entries in the data array.	*/
-	struct analysis_data	*data;		/**< Pointer to the data array.			*/
+	struct file_block		*file;		/**< The file to which the data applies.		*/
+	size_t				count;		/**< The number of entries in the data array.		*/
+	struct analysis_data		*data;		/**< Pointer to the data array.				*/
+	struct analysis_scan_block	*scan;		/**< A shared scan to take totals from, or NULL.	*/
 };
 
+/* Static Function Prototypes. */
+
+static int analysis_data_add_live_balances(struct analysis_data_block *block, date_t start_date, date_t end_date);
+static int analysis_data_add_archived_balances(struct analysis_data_block *block, date_t start_date, date_t end_date, osbool opening);
+
 
 /**
  * Allocate a new analysis scratch data set.
@@ -122,6 +130,7 @@ struct analysis_data_block *analysis_data_claim(struct file_block *file)
 	new->file = file;
 	new->count = account_get_count(file);
 	new->data = NULL;
+	new->scan = NULL;
 
 	if (!flexutils_allocate((void **) &(new->data), sizeof(struct analysis_data), new->count)) {
 		heap_free(new);
@@ -153,6 +162,24 @@ void analysis_data_free(struct analysis_data_block *block)
 }
 
 
+/**
+ * Attach a shared scan to an analysis scratch data set, from which account
+ * totals can be taken instead of scanning the transactions. The caller
+ * remains responsible for the scan, which must outlive the data set.
+ *
+ * \param *block		The scratch data block to update.
+ * \param *scan			The scan to attach, or NULL to detach.
+ */
+
+void analysis_data_set_scan(struct analysis_data_block *block, struct analysis_scan_block *scan)
+{
+	if (block == NULL)
+		return;
+
+	block->scan = scan;
+}
+
+
 /**
  * Clear all the account report flags in an analysis scratch data set,
  * to allow them to be re-set for a new report.
@@ -361,7 +388,8 @@ void analysis_data_initialise_balances(struct analysis_data_block *block)
 
 
 /**
- * Calculate the account balances on a given date.
+ * Calculate the account balances on a given date, including any
+ * transactions which have been purged into the file's archive.
  *
  * \param *block		The scratch data instance to process.
  * \param start_date		The first date to include in the balances,
@@ -376,10 +404,8 @@ void analysis_data_initialise_balances(struct analysis_data_block *block)
 
 int analysis_data_calculate_balances(struct analysis_data_block *block, date_t start_date, date_t end_date, osbool opening)
 {
-	int		transaction_count, transactions_found = 0;
-	date_t		date;
+	int		transactions_found;
 	acct_t		account;
-	tran_t		transaction;
 
 	if (block == NULL || block->file == NULL || block->data == NULL)
 		return 0;
@@ -392,6 +418,66 @@ int analysis_data_calculate_balances(struct analysis_data_block *block, date_t s
 	for (account = 0; account < block->count; account++)
 		block->data[account].report_total = (opening == TRUE) ? account_get_opening_balance(block->file, account) : 0;
 
+	transactions_found = analysis_data_add_live_balances(block, start_date, end_date);
+	transactions_found += analysis_data_add_archived_balances(block, start_date, end_date, opening);
+
+	return transactions_found;
+}
+
+
+/**
+ * Add the transactions in a file which fall between two dates to the
+ * totals in a scratch data instance.
+ *
+ * \param *block		The scratch data instance to process.
+ * \param start_date		The first date to include in the balances,
+ *				or NULL_DATE.
+ * \param end_date		The last date to include in the balances,
+ *				or NULL_DATE.
+ * \return			The number of transactions added.
+ */
+
+static int analysis_data_add_live_balances(struct analysis_data_block *block, date_t start_date, date_t end_date)
+{
+	int		transaction_count, transactions_found = 0, range;
+	date_t		date;
+	acct_t		account;
+	tran_t		transaction;
+	amt_t		*balances;
+
+	/* If a shared scan has already totalled the range, use its results. */
+
+	if (analysis_scan_find_range(block->scan, start_date, end_date, &range)) {
+		for (account = 0; account < block->count; account++)
+			block->data[account].report_total += analysis_scan_get_total(block->scan, range, account);
+
+		return analysis_scan_get_count(block->scan, range);
+	}
+
+	/* Balances from the start of the file can be picked up from the
+	 * nearest balance checkpoint, leaving only the recent history to add.
+	 */
+
+	if (start_date == NULL_DATE && block->count > 0) {
+		balances = heap_alloc(sizeof(amt_t) * block->count);
+
+		if (balances != NULL) {
+			transactions_found = transact_get_balances(block->file, end_date, balances, block->count);
+
+			if (transactions_found >= 0) {
+				for (account = 0; account < block->count; account++)
+					block->data[account].report_total += balances[account];
+			}
+
+			heap_free(balances);
+
+			if (transactions_found >= 0)
+				return transactions_found;
+
+			transactions_found = 0;
+		}
+	}
+
 	/* Scan through the transactions, adding the values up for those occurring before the end of the current
 	 * period and outputting them to the screen.
 	 */
@@ -412,6 +498,61 @@ int analysis_data_calculate_balances(struct analysis_data_block *block, date_t s
 }
 
 
+/**
+ * Add the archived transactions belonging to a file which fall between two
+ * dates to the totals in a scratch data instance. Purging has already
+ * folded the archived transactions into the opening balances of the full
+ * accounts, so if these are included, the whole archive is taken back out
+ * of them first.
+ *
+ * \param *block		The scratch data instance to process.
+ * \param start_date		The first date to include in the balances,
+ *				or NULL_DATE.
+ * \param end_date		The last date to include in the balances,
+ *				or NULL_DATE.
+ * \param opening		TRUE if the totals include opening balances.
+ * \return			The number of archived transactions added.
+ */
+
+static int analysis_data_add_archived_balances(struct analysis_data_block *block, date_t start_date, date_t end_date, osbool opening)
+{
+	int		transactions_found;
+	acct_t		account;
+	amt_t		*totals;
+
+	if (block->count == 0)
+		return 0;
+
+	totals = heap_alloc(sizeof(amt_t) * block->count);
+	if (totals == NULL)
+		return 0;
+
+	for (account = 0; account < block->count; account++)
+		totals[account] = 0;
+
+	transactions_found = archive_get_account_totals(block->file, start_date, end_date, totals, block->count);
+
+	for (account = 0; account < block->count; account++)
+		block->data[account].report_total += totals[account];
+
+	if (opening == TRUE) {
+		for (account = 0; account < block->count; account++)
+			totals[account] = 0;
+
+		archive_get_account_totals(block->file, NULL_DATE, NULL_DATE, totals, block->count);
+
+		for (account = 0; account < block->count; account++) {
+			if (account_get_type(block->file, account) & ACCOUNT_FULL)
+				block->data[account].report_total -= totals[account];
+		}
+	}
+
+	heap_free(totals);
+
+	return transactions_found;
+}
+
+
 /**
  * Add a transaction's details to an analysis scratch space.
  *
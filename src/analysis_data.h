@@ -35,6 +35,7 @@
 #include "account.h"
 #include "currency.h"
 #include "date.h"
+#include "analysis_scan.h"
 
 
 /**
@@ -74,6 +75,18 @@ struct analysis_data_block *analysis_data_claim(struct file_block *file);
 void analysis_data_free(struct analysis_data_block *block);
 
 
+/**
+ * Attach a shared scan to an analysis scratch data set, from which account
+ * totals can be taken instead of scanning the transactions. The caller
+ * remains responsible for the scan, which must outlive the data set.
+ *
+ * \param *block		The scratch data block to update.
+ * \param *scan			The scan to attach, or NULL to detach.
+ */
+
+void analysis_data_set_scan(struct analysis_data_block *block, struct analysis_scan_block *scan);
+
+
 /**
  * Clear all the account report flags in an analysis scratch data set,
  * to allow them to be re-set for a new report.
@@ -164,7 +177,8 @@ void analysis_data_initialise_balances(struct analysis_data_block *block);
 
 
 /**
- * Calculate the account balances on a given date.
+ * Calculate the account balances on a given date, including any
+ * transactions which have been purged into the file's archive.
  *
  * \param *block		The scratch data instance to process.
  * \param start_date		The first date to include in the balances,
@@ -45,49 +45,12 @@
 
 #include "date.h"
 
-/* Date period management. */
 
 /**
- * The start date of the current reporting period.
- */
-
-static date_t			analysis_period_start;
-
-/**
- * The end date of the current reporting period.
- */
-
-static date_t			analysis_period_end;
-
-/**
- * The length of the current reporting period, in the given units.
- */
-
-static int			analysis_period_length;
-
-/**
- * The units being used for the length of the current reporting period.
- */
-
-static enum date_period		analysis_period_unit;
-
-/**
- * True to apply calendar lock to the reporting period.
- */
-
-static osbool			analysis_period_lock;
-
-/**
- * True if this is the first period in a locked iteration.
- */
-
-static osbool			analysis_period_first = TRUE;
-
-
-/**
- * Initialise the date period iteration.  Set the state machine so that
- * analysis_get_next_date_period() can be called to work through the report.
+ * Initialise a date period iterator.  Set the state machine so that
+ * analysis_period_get_next_dates() can be called to work through the report.
  *
+ * \param *instance		The iterator to initialise.
  * \param start			The start date for the report period.
  * \param end			The end date for the report period.
  * \param group			TRUE to group the entries; otherwise FALSE.
@@ -96,14 +59,17 @@ static osbool			analysis_period_first = TRUE;
  * \param lock			TRUE to apply calendar lock; otherwise FALSE.
  */
 
-void analysis_period_initialise(date_t start, date_t end, osbool group, int period, enum date_period unit, osbool lock)
+void analysis_period_initialise(struct analysis_period_block *instance, date_t start, date_t end, osbool group, int period, enum date_period unit, osbool lock)
 {
-	analysis_period_start = start;
-	analysis_period_end = end;
-	analysis_period_length = (group) ? period : 0;
-	analysis_period_unit = unit;
-	analysis_period_lock = lock && (unit == DATE_PERIOD_MONTHS || unit == DATE_PERIOD_YEARS);
-	analysis_period_first = analysis_period_lock;
+	if (instance == NULL)
+		return;
+
+	instance->start = start;
+	instance->end = end;
+	instance->length = (group) ? period : 0;
+	instance->unit = unit;
+	instance->lock = lock && (unit == DATE_PERIOD_MONTHS || unit == DATE_PERIOD_YEARS);
+	instance->first = instance->lock;
 }
 
 
@@ -111,6 +77,7 @@ void analysis_period_initialise(date_t start, date_t end, osbool group, int peri
  * Return the next date period from the sequence set up with
  * analysis_period_initialise(), for use by the report modules.
  *
+ * \param *instance		The iterator to take the period from.
  * \param *next_start		Return the next period's start date.
  * \param *next_end		Return the next period's end date.
  * \param *date_text		Pointer to a buffer to hold a textual name for the period.
@@ -118,14 +85,14 @@ void analysis_period_initialise(date_t start, date_t end, osbool group, int peri
  * \return			TRUE if a period was returned; FALSE if none left.
  */
 
-osbool analysis_period_get_next_dates(date_t *next_start, date_t *next_end, char *date_text, size_t date_len)
+osbool analysis_period_get_next_dates(struct analysis_period_block *instance, date_t *next_start, date_t *next_end, char *date_text, size_t date_len)
 {
 	char		b1[1024], b2[1024];
 
-	if (analysis_period_start > analysis_period_end)
+	if (instance == NULL || instance->start > instance->end)
 		return FALSE;
 
-	if (analysis_period_length > 0) {
+	if (instance->length > 0) {
 		/* If the report is to be grouped, find the next_end date which falls at the end of the period.
 		 *
 		 * If first_lock is set, the report is locked to the calendar and this is the first iteration.  Therefore,
@@ -137,10 +104,10 @@ osbool analysis_period_get_next_dates(date_t *next_start, date_t *next_end, char
 		 * 1 from it.  By this point, locked reports will be period aligned anyway, so this should work OK.
 		 */
 
-		if (analysis_period_first) {
-			*next_end = date_add_period(analysis_period_start, analysis_period_unit, analysis_period_length - 1);
+		if (instance->first) {
+			*next_end = date_add_period(instance->start, instance->unit, instance->length - 1);
 
-			switch (analysis_period_unit) {
+			switch (instance->unit) {
 			case DATE_PERIOD_MONTHS:
 				*next_end = (*next_end & 0xffffff00) | 0x001f; /* Maximise the days, so end of month. */
 				break;
@@ -150,55 +117,55 @@ osbool analysis_period_get_next_dates(date_t *next_start, date_t *next_end, char
 				break;
 
 			default:
-				*next_end = date_add_period(analysis_period_start, analysis_period_unit, analysis_period_length) - 1;
+				*next_end = date_add_period(instance->start, instance->unit, instance->length) - 1;
 				break;
 			}
 		} else {
-			*next_end = date_add_period(analysis_period_start, analysis_period_unit, analysis_period_length) - 1;
+			*next_end = date_add_period(instance->start, instance->unit, instance->length) - 1;
 		}
 
 		/* Pull back into range isf we fall off the end. */
 
-		if (*next_end > analysis_period_end)
-			*next_end = analysis_period_end;
+		if (*next_end > instance->end)
+			*next_end = instance->end;
 	} else {
 		/* If the report is not to be grouped, the next_end date is just the end of the report period. */
 
-		*next_end = analysis_period_end;
+		*next_end = instance->end;
 	}
 
 	/* Get the real start and end dates for the period. */
 
-	*next_start = date_find_valid_day(analysis_period_start, DATE_ADJUST_BACKWARD);
+	*next_start = date_find_valid_day(instance->start, DATE_ADJUST_BACKWARD);
 	*next_end = date_find_valid_day(*next_end, DATE_ADJUST_FORWARD);
 
-	if (analysis_period_length > 0) {
+	if (instance->length > 0) {
 		/* If the report is grouped, find the next start date by adding the period on to the current start date. */
 
-		analysis_period_start = date_add_period(analysis_period_start, analysis_period_unit, analysis_period_length);
+		instance->start = date_add_period(instance->start, instance->unit, instance->length);
 
-		if (analysis_period_first) {
+		if (instance->first) {
 			/* If the report is calendar locked, and this is the first iteration, reset the DAYS or DAYS+MONTHS
 			 * to one so that the start date will be locked on to the calendar from now on.
 			 */
 
-			switch (analysis_period_unit) {
+			switch (instance->unit) {
 			case DATE_PERIOD_MONTHS:
-				analysis_period_start = (analysis_period_start & 0xffffff00) | 0x0001; /* Set the days to one. */
+				instance->start = (instance->start & 0xffffff00) | 0x0001; /* Set the days to one. */
 				break;
 
 			case DATE_PERIOD_YEARS:
-				analysis_period_start = (analysis_period_start & 0xffff0000) | 0x0101; /* Set the days and months to one. */
+				instance->start = (instance->start & 0xffff0000) | 0x0101; /* Set the days and months to one. */
 				break;
 
 			default:
 				break;
 			}
 
-			analysis_period_first = FALSE;
+			instance->first = FALSE;
 		}
 	} else {
-		analysis_period_start = analysis_period_end+1;
+		instance->start = instance->end+1;
 	}
 
 	/* Generate a date period title for the report section.
@@ -209,8 +176,8 @@ osbool analysis_period_get_next_dates(date_t *next_start, date_t *next_end, char
 
 	*date_text = '\0';
 
-	if (analysis_period_lock) {
-		switch (analysis_period_unit) {
+	if (instance->lock) {
+		switch (instance->unit) {
 		case DATE_PERIOD_MONTHS:
 			date_convert_to_month_string(*next_start, b1, sizeof(b1));
 
@@ -34,9 +34,32 @@
 #include "date.h"
 
 /**
- * Initialise the date period iteration.  Set the state machine so that
- * analysis_get_next_date_period() can be called to work through the report.
+ * The space allocated for the textual name of a reporting period.
+ */
+
+#define ANALYSIS_PERIOD_NAME_LEN 1024
+
+/**
+ * A date period iterator. The contents are private to the analysis period
+ * module, but the structure is made public so that clients can hold an
+ * iterator on the stack for the duration of a report.
+ */
+
+struct analysis_period_block {
+	date_t			start;				/**< The start date of the current reporting period.			*/
+	date_t			end;				/**< The end date of the current reporting period.			*/
+	int			length;				/**< The length of the current reporting period, in the given units.	*/
+	enum date_period	unit;				/**< The units being used for the length of the reporting period.	*/
+	osbool			lock;				/**< TRUE to apply calendar lock to the reporting period.		*/
+	osbool			first;				/**< TRUE if this is the first period in a locked iteration.		*/
+};
+
+
+/**
+ * Initialise a date period iterator.  Set the state machine so that
+ * analysis_period_get_next_dates() can be called to work through the report.
  *
+ * \param *instance		The iterator to initialise.
  * \param start			The start date for the report period.
  * \param end			The end date for the report period.
  * \param group			TRUE to group the entries; otherwise FALSE.
@@ -45,13 +68,14 @@
  * \param lock			TRUE to apply calendar lock; otherwise FALSE.
  */
 
-void analysis_period_initialise(date_t start, date_t end, osbool group, int period, enum date_period unit, osbool lock);
+void analysis_period_initialise(struct analysis_period_block *instance, date_t start, date_t end, osbool group, int period, enum date_period unit, osbool lock);
 
 
 /**
  * Return the next date period from the sequence set up with
  * analysis_period_initialise(), for use by the report modules.
  *
+ * \param *instance		The iterator to take the period from.
  * \param *next_start		Return the next period's start date.
  * \param *next_end		Return the next period's end date.
  * \param *date_text		Pointer to a buffer to hold a textual name for the period.
@@ -59,6 +83,6 @@ void analysis_period_initialise(date_t start, date_t end, osbool group, int peri
  * \return			TRUE if a period was returned; FALSE if none left.
  */
 
-osbool analysis_period_get_next_dates(date_t *next_start, date_t *next_end, char *date_text, size_t date_len);
+osbool analysis_period_get_next_dates(struct analysis_period_block *instance, date_t *next_start, date_t *next_end, char *date_text, size_t date_len);
 
 #endif
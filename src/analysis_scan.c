@@ -0,0 +1,524 @@
+/* Copyright 2003-2017, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: analysis_scan.c
+ *
+ * Shared transaction scans for analysis reports.
+ *
+ * Reports which work from account totals over ranges of dates can share a
+ * single pass through the date-sorted transactions. Each client registers
+ * the ranges that it will need before the scan is used; the pass then
+ * records the running totals of every account at the start and end of
+ * each range, so that the totals over any of them can be found by taking
+ * the difference between two snapshots.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files */
+
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/heap.h"
+
+/* Application header files */
+
+#include "analysis_scan.h"
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+#include "file.h"
+#include "transact.h"
+
+
+/**
+ * The number of ranges to allocate space for at a time.
+ */
+
+#define ANALYSIS_SCAN_RANGE_ALLOCATION 32
+
+/**
+ * The maximum number of account totals that a scan will hold, to keep the
+ * memory used by a scan over a large number of short periods under control.
+ */
+
+#define ANALYSIS_SCAN_MAX_TOTALS 262144
+
+/**
+ * The state of a scan.
+ */
+
+enum analysis_scan_status {
+	ANALYSIS_SCAN_PENDING,							/**< The scan has not been run yet.				*/
+	ANALYSIS_SCAN_COMPLETE,							/**< The scan has been run successfully.			*/
+	ANALYSIS_SCAN_FAILED							/**< The scan could not be run, and can't be used.		*/
+};
+
+/**
+ * A point in the sorted transactions at which the running totals are
+ * recorded.
+ */
+
+struct analysis_scan_bound {
+	date_t				date;				/**< The date of the boundary.					*/
+	osbool				inclusive;			/**< TRUE if transactions on the date fall before the boundary.	*/
+	int				count;				/**< The number of transactions before the boundary.		*/
+};
+
+/**
+ * A range of dates registered by a client.
+ */
+
+struct analysis_scan_range {
+	date_t				start;				/**< The first date in the range, or NULL_DATE.			*/
+	date_t				end;				/**< The last date in the range, or NULL_DATE.			*/
+	int				first;				/**< The boundary at the start of the range.			*/
+	int				last;				/**< The boundary at the end of the range.			*/
+};
+
+/**
+ * An analysis scan instance.
+ */
+
+struct analysis_scan_block {
+	struct file_block		*file;				/**< The file to which the scan applies.			*/
+	int				references;			/**< The number of references held to the scan.			*/
+	enum analysis_scan_status	status;				/**< The state of the scan.					*/
+	unsigned			version;			/**< The file data version from which the scan was made.	*/
+	size_t				accounts;			/**< The number of accounts held at each boundary.		*/
+
+	struct analysis_scan_range	*ranges;			/**< The ranges registered by clients.				*/
+	size_t				range_count;			/**< The number of ranges registered.				*/
+	size_t				range_size;			/**< The number of ranges for which space is allocated.		*/
+
+	struct analysis_scan_bound	*bounds;			/**< The sorted boundaries, or NULL.				*/
+	size_t				bound_count;			/**< The number of boundaries.					*/
+	amt_t				*totals;			/**< The account totals at each boundary, or NULL.		*/
+};
+
+/* Static Function Prototypes. */
+
+static osbool analysis_scan_run(struct analysis_scan_block *scan);
+static int analysis_scan_find_bound(struct analysis_scan_block *scan, date_t date, osbool inclusive);
+static int analysis_scan_compare_bounds(const void *va, const void *vb);
+static void analysis_scan_free_data(struct analysis_scan_block *scan);
+
+
+/**
+ * Create a new shared scan for a file. The caller holds a reference to
+ * the scan, which must be released with analysis_scan_release().
+ *
+ * \param *file			The file to which the scan will relate.
+ * \return			Pointer to the new scan, or NULL.
+ */
+
+struct analysis_scan_block *analysis_scan_create(struct file_block *file)
+{
+	struct analysis_scan_block	*new;
+
+	if (file == NULL)
+		return NULL;
+
+	new = heap_alloc(sizeof(struct analysis_scan_block));
+	if (new == NULL)
+		return NULL;
+
+	new->file = file;
+	new->references = 1;
+	new->status = ANALYSIS_SCAN_PENDING;
+	new->version = 0;
+	new->accounts = 0;
+
+	new->ranges = NULL;
+	new->range_count = 0;
+	new->range_size = 0;
+
+	new->bounds = NULL;
+	new->bound_count = 0;
+	new->totals = NULL;
+
+	return new;
+}
+
+
+/**
+ * Claim an additional reference to a shared scan.
+ *
+ * \param *scan			The scan to claim.
+ * \return			The scan, or NULL.
+ */
+
+struct analysis_scan_block *analysis_scan_claim(struct analysis_scan_block *scan)
+{
+	if (scan != NULL)
+		scan->references++;
+
+	return scan;
+}
+
+
+/**
+ * Release a reference to a shared scan, freeing it if it was the last.
+ *
+ * \param *scan			The scan to release.
+ */
+
+void analysis_scan_release(struct analysis_scan_block *scan)
+{
+	if (scan == NULL || --scan->references > 0)
+		return;
+
+	analysis_scan_free_data(scan);
+
+	if (scan->ranges != NULL)
+		heap_free(scan->ranges);
+
+	heap_free(scan);
+}
+
+
+/**
+ * Register a range of dates whose account totals will be required from a
+ * shared scan. Ranges must be added before the scan is first used.
+ *
+ * \param *scan			The scan to update.
+ * \param start			The first date in the range, or NULL_DATE.
+ * \param end			The last date in the range, or NULL_DATE.
+ */
+
+void analysis_scan_add_range(struct analysis_scan_block *scan, date_t start, date_t end)
+{
+	struct analysis_scan_range	*extend;
+	size_t				i;
+
+	if (scan == NULL || scan->status != ANALYSIS_SCAN_PENDING)
+		return;
+
+	/* Reports over the same periods will register the same ranges. */
+
+	for (i = 0; i < scan->range_count; i++) {
+		if (scan->ranges[i].start == start && scan->ranges[i].end == end)
+			return;
+	}
+
+	if (scan->range_count >= scan->range_size) {
+		if (scan->ranges == NULL)
+			extend = heap_alloc(sizeof(struct analysis_scan_range) * ANALYSIS_SCAN_RANGE_ALLOCATION);
+		else
+			extend = heap_extend(scan->ranges, sizeof(struct analysis_scan_range) * (scan->range_size + ANALYSIS_SCAN_RANGE_ALLOCATION));
+
+		if (extend == NULL) {
+			scan->status = ANALYSIS_SCAN_FAILED;
+			return;
+		}
+
+		scan->ranges = extend;
+		scan->range_size += ANALYSIS_SCAN_RANGE_ALLOCATION;
+	}
+
+	scan->ranges[scan->range_count].start = start;
+	scan->ranges[scan->range_count].end = end;
+	scan->ranges[scan->range_count].first = -1;
+	scan->ranges[scan->range_count].last = -1;
+
+	scan->range_count++;
+}
+
+
+/**
+ * Find a range of dates in a shared scan, making the pass through the
+ * transactions if it has not been done already.
+ *
+ * \param *scan			The scan to search.
+ * \param start			The first date in the range, or NULL_DATE.
+ * \param end			The last date in the range, or NULL_DATE.
+ * \param *range		Pointer to a variable to take the range handle.
+ * \return			TRUE if the range is available; FALSE if
+ *				the transactions must be scanned directly.
+ */
+
+osbool analysis_scan_find_range(struct analysis_scan_block *scan, date_t start, date_t end, int *range)
+{
+	size_t	i;
+
+	if (scan == NULL || range == NULL)
+		return FALSE;
+
+	if (scan->status == ANALYSIS_SCAN_PENDING && !analysis_scan_run(scan))
+		scan->status = ANALYSIS_SCAN_FAILED;
+
+	if (scan->status != ANALYSIS_SCAN_COMPLETE)
+		return FALSE;
+
+	/* If the file has changed since the scan was made, the totals can't be trusted. */
+
+	if (scan->version != file_get_data_version(scan->file) || scan->accounts != account_get_count(scan->file))
+		return FALSE;
+
+	for (i = 0; i < scan->range_count; i++) {
+		if (scan->ranges[i].start == start && scan->ranges[i].end == end) {
+			*range = i;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+
+/**
+ * Return the total movement of an account over a range found with
+ * analysis_scan_find_range().
+ *
+ * \param *scan			The scan to query.
+ * \param range			The range handle to query.
+ * \param account		The account to return the total for.
+ * \return			The total for the account.
+ */
+
+amt_t analysis_scan_get_total(struct analysis_scan_block *scan, int range, acct_t account)
+{
+	struct analysis_scan_range	*details;
+
+	if (scan == NULL || scan->totals == NULL || range < 0 || range >= scan->range_count ||
+			account < 0 || account >= scan->accounts)
+		return 0;
+
+	details = scan->ranges + range;
+
+	return scan->totals[details->last * scan->accounts + account] - scan->totals[details->first * scan->accounts + account];
+}
+
+
+/**
+ * Return the number of transactions falling into a range found with
+ * analysis_scan_find_range().
+ *
+ * \param *scan			The scan to query.
+ * \param range			The range handle to query.
+ * \return			The number of transactions in the range.
+ */
+
+int analysis_scan_get_count(struct analysis_scan_block *scan, int range)
+{
+	struct analysis_scan_range	*details;
+
+	if (scan == NULL || scan->bounds == NULL || range < 0 || range >= scan->range_count)
+		return 0;
+
+	details = scan->ranges + range;
+
+	return scan->bounds[details->last].count - scan->bounds[details->first].count;
+}
+
+
+/**
+ * Make the single pass through the transactions in a file, recording the
+ * account totals at each of the boundaries required by the registered
+ * ranges.
+ *
+ * \param *scan			The scan to run.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool analysis_scan_run(struct analysis_scan_block *scan)
+{
+	size_t		i, bound, accounts;
+	tran_t		transaction, count;
+	date_t		date;
+	acct_t		from, to;
+	amt_t		amount, *running;
+
+	if (scan == NULL || scan->range_count == 0)
+		return FALSE;
+
+	/* Collect the boundaries at the start and end of each range. A
+	 * range starting at NULL_DATE starts before every transaction, and
+	 * one ending at NULL_DATE ends after every transaction.
+	 */
+
+	scan->bounds = heap_alloc(sizeof(struct analysis_scan_bound) * 2 * scan->range_count);
+	if (scan->bounds == NULL)
+		return FALSE;
+
+	for (i = 0; i < scan->range_count; i++) {
+		scan->bounds[2 * i].date = (scan->ranges[i].start == NULL_DATE) ? 0 : scan->ranges[i].start;
+		scan->bounds[2 * i].inclusive = FALSE;
+		scan->bounds[2 * i + 1].date = scan->ranges[i].end;
+		scan->bounds[2 * i + 1].inclusive = TRUE;
+	}
+
+	qsort(scan->bounds, 2 * scan->range_count, sizeof(struct analysis_scan_bound), analysis_scan_compare_bounds);
+
+	scan->bound_count = 0;
+
+	for (i = 0; i < 2 * scan->range_count; i++) {
+		if (scan->bound_count == 0 || analysis_scan_compare_bounds(scan->bounds + scan->bound_count - 1, scan->bounds + i) != 0)
+			scan->bounds[scan->bound_count++] = scan->bounds[i];
+	}
+
+	for (i = 0; i < scan->range_count; i++) {
+		scan->ranges[i].first = analysis_scan_find_bound(scan, (scan->ranges[i].start == NULL_DATE) ? 0 : scan->ranges[i].start, FALSE);
+		scan->ranges[i].last = analysis_scan_find_bound(scan, scan->ranges[i].end, TRUE);
+	}
+
+	/* Allocate space for the totals at each boundary. */
+
+	accounts = account_get_count(scan->file);
+
+	if (accounts == 0 || scan->bound_count * accounts > ANALYSIS_SCAN_MAX_TOTALS) {
+		analysis_scan_free_data(scan);
+		return FALSE;
+	}
+
+	scan->accounts = accounts;
+	scan->totals = heap_alloc(sizeof(amt_t) * scan->bound_count * accounts);
+	running = heap_alloc(sizeof(amt_t) * accounts);
+
+	if (scan->totals == NULL || running == NULL) {
+		if (running != NULL)
+			heap_free(running);
+		analysis_scan_free_data(scan);
+		return FALSE;
+	}
+
+	memset(running, 0, sizeof(amt_t) * accounts);
+
+	/* Pass through the transactions in date order, taking a copy of the
+	 * running totals as each boundary is passed.
+	 */
+
+	transact_sort_file_data(scan->file);
+	scan->version = file_get_data_version(scan->file);
+
+	count = transact_get_count(scan->file);
+	bound = 0;
+
+	for (transaction = 0; transaction < count; transaction++) {
+		date = transact_get_date(scan->file, transaction);
+
+		while (bound < scan->bound_count && (date > scan->bounds[bound].date ||
+				(date == scan->bounds[bound].date && !scan->bounds[bound].inclusive))) {
+			memcpy(scan->totals + bound * accounts, running, sizeof(amt_t) * accounts);
+			scan->bounds[bound++].count = transaction;
+		}
+
+		from = transact_get_from(scan->file, transaction);
+		to = transact_get_to(scan->file, transaction);
+		amount = transact_get_amount(scan->file, transaction);
+
+		if (from != NULL_ACCOUNT && from >= 0 && from < accounts)
+			running[from] -= amount;
+
+		if (to != NULL_ACCOUNT && to >= 0 && to < accounts)
+			running[to] += amount;
+	}
+
+	while (bound < scan->bound_count) {
+		memcpy(scan->totals + bound * accounts, running, sizeof(amt_t) * accounts);
+		scan->bounds[bound++].count = count;
+	}
+
+	heap_free(running);
+
+	scan->status = ANALYSIS_SCAN_COMPLETE;
+
+	return TRUE;
+}
+
+
+/**
+ * Find a boundary in the sorted list held by a scan.
+ *
+ * \param *scan			The scan to search.
+ * \param date			The date of the boundary.
+ * \param inclusive		TRUE to find an inclusive boundary; else FALSE.
+ * \return			The index of the boundary.
+ */
+
+static int analysis_scan_find_bound(struct analysis_scan_block *scan, date_t date, osbool inclusive)
+{
+	struct analysis_scan_bound	key, *found;
+
+	key.date = date;
+	key.inclusive = inclusive;
+
+	found = bsearch(&key, scan->bounds, scan->bound_count, sizeof(struct analysis_scan_bound), analysis_scan_compare_bounds);
+
+	return (found == NULL) ? 0 : found - scan->bounds;
+}
+
+
+/**
+ * Compare two scan boundaries for the benefit of qsort() and bsearch(),
+ * placing an exclusive boundary before an inclusive one on the same date.
+ *
+ * \param *va			The first boundary.
+ * \param *vb			The second boundary.
+ * \return			Comparison result.
+ */
+
+static int analysis_scan_compare_bounds(const void *va, const void *vb)
+{
+	const struct analysis_scan_bound *a = va;
+	const struct analysis_scan_bound *b = vb;
+
+	if (a->date != b->date)
+		return (a->date < b->date) ? -1 : 1;
+
+	if (a->inclusive != b->inclusive)
+		return (a->inclusive) ? 1 : -1;
+
+	return 0;
+}
+
+
+/**
+ * Free the boundary and total data held by a scan.
+ *
+ * \param *scan			The scan to free the data from.
+ */
+
+static void analysis_scan_free_data(struct analysis_scan_block *scan)
+{
+	if (scan == NULL)
+		return;
+
+	if (scan->bounds != NULL)
+		heap_free(scan->bounds);
+
+	if (scan->totals != NULL)
+		heap_free(scan->totals);
+
+	scan->bounds = NULL;
+	scan->bound_count = 0;
+	scan->totals = NULL;
+}
+
@@ -0,0 +1,129 @@
+/* Copyright 2003-2017, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: analysis_scan.h
+ *
+ * Shared transaction scans for analysis reports.
+ */
+
+#ifndef CASHBOOK_ANALYSIS_SCAN
+#define CASHBOOK_ANALYSIS_SCAN
+
+#include "oslib/types.h"
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+
+
+/**
+ * An analysis scan instance.
+ */
+
+struct analysis_scan_block;
+
+
+/**
+ * Create a new shared scan for a file. The caller holds a reference to
+ * the scan, which must be released with analysis_scan_release().
+ *
+ * \param *file			The file to which the scan will relate.
+ * \return			Pointer to the new scan, or NULL.
+ */
+
+struct analysis_scan_block *analysis_scan_create(struct file_block *file);
+
+
+/**
+ * Claim an additional reference to a shared scan.
+ *
+ * \param *scan			The scan to claim.
+ * \return			The scan, or NULL.
+ */
+
+struct analysis_scan_block *analysis_scan_claim(struct analysis_scan_block *scan);
+
+
+/**
+ * Release a reference to a shared scan, freeing it if it was the last.
+ *
+ * \param *scan			The scan to release.
+ */
+
+void analysis_scan_release(struct analysis_scan_block *scan);
+
+
+/**
+ * Register a range of dates whose account totals will be required from a
+ * shared scan. Ranges must be added before the scan is first used.
+ *
+ * \param *scan			The scan to update.
+ * \param start			The first date in the range, or NULL_DATE.
+ * \param end			The last date in the range, or NULL_DATE.
+ */
+
+void analysis_scan_add_range(struct analysis_scan_block *scan, date_t start, date_t end);
+
+
+/**
+ * Find a range of dates in a shared scan, making the pass through the
+ * transactions if it has not been done already.
+ *
+ * \param *scan			The scan to search.
+ * \param start			The first date in the range, or NULL_DATE.
+ * \param end			The last date in the range, or NULL_DATE.
+ * \param *range		Pointer to a variable to take the range handle.
+ * \return			TRUE if the range is available; FALSE if
+ *				the transactions must be scanned directly.
+ */
+
+osbool analysis_scan_find_range(struct analysis_scan_block *scan, date_t start, date_t end, int *range);
+
+
+/**
+ * Return the total movement of an account over a range found with
+ * analysis_scan_find_range().
+ *
+ * \param *scan			The scan to query.
+ * \param range			The range handle to query.
+ * \param account		The account to return the total for.
+ * \return			The total for the account.
+ */
+
+amt_t analysis_scan_get_total(struct analysis_scan_block *scan, int range, acct_t account);
+
+
+/**
+ * Return the number of transactions falling into a range found with
+ * analysis_scan_find_range().
+ *
+ * \param *scan			The scan to query.
+ * \param range			The range handle to query.
+ * \return			The number of transactions in the range.
+ */
+
+int analysis_scan_get_count(struct analysis_scan_block *scan, int range);
+
+#endif
+
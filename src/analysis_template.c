@@ -59,6 +59,18 @@
 
 #define ANALYSIS_TEMPLATE_HEX_BUFFER_LEN 32
 
+/**
+ * The FNV-1a offset basis, used when hashing template settings.
+ */
+
+#define ANALYSIS_TEMPLATE_HASH_BASIS 2166136261u
+
+/**
+ * The FNV-1a prime, used when hashing template settings.
+ */
+
+#define ANALYSIS_TEMPLATE_HASH_PRIME 16777619u
+
 /**
  * Saved Report.
  */
@@ -425,6 +437,65 @@ char *analysis_template_get_name(struct analysis_report *template, char *buffer,
 }
 
 
+/**
+ * Test whether two analysis templates have the same name, type and
+ * settings, so that they would produce identical reports.
+ *
+ * \param *first		Pointer to the first template to compare.
+ * \param *second		Pointer to the second template to compare.
+ * \return			TRUE if the templates match; else FALSE.
+ */
+
+osbool analysis_template_compare(struct analysis_report *first, struct analysis_report *second)
+{
+	if (first == NULL || second == NULL)
+		return FALSE;
+
+	if (first->type != second->type || strcmp(first->name, second->name) != 0)
+		return FALSE;
+
+	return (memcmp(analysis_template_data_from_address(first), analysis_template_data_from_address(second),
+			analysis_template_block_size) == 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * Calculate a hash of the name, type and settings of an analysis template,
+ * along with an optional report title, for use as a cache key.
+ *
+ * \param *template		Pointer to the template to hash.
+ * \param *title		Pointer to a title to include, or NULL.
+ * \return			The calculated hash value.
+ */
+
+unsigned analysis_template_get_hash(struct analysis_report *template, char *title)
+{
+	unsigned	hash = ANALYSIS_TEMPLATE_HASH_BASIS;
+	byte		*data;
+	size_t		i;
+
+	if (template == NULL)
+		return hash;
+
+	hash = (hash ^ (unsigned) template->type) * ANALYSIS_TEMPLATE_HASH_PRIME;
+
+	for (i = 0; template->name[i] != '\0'; i++)
+		hash = (hash ^ (byte) template->name[i]) * ANALYSIS_TEMPLATE_HASH_PRIME;
+
+	data = analysis_template_data_from_address(template);
+
+	for (i = 0; i < analysis_template_block_size; i++)
+		hash = (hash ^ data[i]) * ANALYSIS_TEMPLATE_HASH_PRIME;
+
+	if (title != NULL) {
+		for (i = 0; title[i] != '\0'; i++)
+			hash = (hash ^ (byte) title[i]) * ANALYSIS_TEMPLATE_HASH_PRIME;
+	}
+
+	return hash;
+}
+
+
 /**
  * Find a saved template ID based on its name.
  *
@@ -655,6 +726,12 @@ struct analysis_report *analysis_template_create_new(struct analysis_template_bl
 	if (new == NULL)
 		return NULL;
 
+	/* Clear the block, so that any unused space in the settings will
+	 * compare as equal in analysis_template_compare().
+	 */
+
+	memset(new, 0, analysis_template_full_block_size);
+
 	new->instance = parent;
 	new->type = type;
 	if (name != NULL)
@@ -200,6 +200,30 @@ void *analysis_template_get_data(struct analysis_report *template);
 char *analysis_template_get_name(struct analysis_report *template, char *buffer, size_t length);
 
 
+/**
+ * Test whether two analysis templates have the same name, type and
+ * settings, so that they would produce identical reports.
+ *
+ * \param *first		Pointer to the first template to compare.
+ * \param *second		Pointer to the second template to compare.
+ * \return			TRUE if the templates match; else FALSE.
+ */
+
+osbool analysis_template_compare(struct analysis_report *first, struct analysis_report *second);
+
+
+/**
+ * Calculate a hash of the name, type and settings of an analysis template,
+ * along with an optional report title, for use as a cache key.
+ *
+ * \param *template		Pointer to the template to hash.
+ * \param *title		Pointer to a title to include, or NULL.
+ * \return			The calculated hash value.
+ */
+
+unsigned analysis_template_get_hash(struct analysis_report *template, char *title);
+
+
 /**
  * Find a saved template ID based on its name.
  *
@@ -100,6 +100,18 @@ static int					analysis_template_menu_entry_count = 0;
 
 static char					analysis_template_menu_title[ANALYSIS_TEMPLATE_MENU_TITLE_LEN];
 
+/**
+ * The index of the Run All entry in the menu, or -1 if there isn't one.
+ */
+
+static int					analysis_template_menu_run_all_entry = -1;
+
+/**
+ * Memory to hold the indirected Run All entry text.
+ */
+
+static char					analysis_template_menu_run_all[ANALYSIS_TEMPLATE_MENU_TITLE_LEN];
+
 /* Static Function Prototypes*/
 
 static int		analysis_template_menu_compare_entries(const void *va, const void *vb);
@@ -136,8 +148,12 @@ wimp_menu *analysis_template_menu_build(struct file_block *file, osbool standalo
 
 	analysis_template_menu_entry_count = analysis_template_get_count(templates);
 
+	/* When the menu is part of the main menu, an extra entry is added
+	 * at the foot to run all of the templates as a batch.
+	 */
+
 	if (analysis_template_menu_entry_count > 0) {
-		analysis_template_menu = heap_alloc(28 + 24 * analysis_template_menu_entry_count);
+		analysis_template_menu = heap_alloc(28 + 24 * (analysis_template_menu_entry_count + ((standalone) ? 0 : 1)));
 		analysis_template_menu_entry_link = heap_alloc(analysis_template_menu_entry_count * sizeof(struct analysis_template_menu_link));
 	}
 
@@ -195,6 +211,26 @@ wimp_menu *analysis_template_menu_build(struct file_block *file, osbool standalo
 		#endif
 	}
 
+	if (!standalone) {
+		analysis_template_menu->entries[line - 1].menu_flags |= wimp_MENU_SEPARATE;
+
+		msgs_lookup("RepListRunAll", analysis_template_menu_run_all, ANALYSIS_TEMPLATE_MENU_TITLE_LEN);
+
+		analysis_template_menu->entries[line].menu_flags = 0;
+		analysis_template_menu->entries[line].sub_menu = (wimp_menu *) -1;
+		analysis_template_menu->entries[line].icon_flags = wimp_ICON_TEXT | wimp_ICON_FILLED | wimp_ICON_INDIRECTED |
+				wimp_COLOUR_BLACK << wimp_ICON_FG_COLOUR_SHIFT |
+				wimp_COLOUR_WHITE << wimp_ICON_BG_COLOUR_SHIFT;
+		analysis_template_menu->entries[line].data.indirected_text.text = analysis_template_menu_run_all;
+		analysis_template_menu->entries[line].data.indirected_text.validation = NULL;
+		analysis_template_menu->entries[line].data.indirected_text.size = ANALYSIS_TEMPLATE_MENU_TITLE_LEN;
+
+		if (strlen(analysis_template_menu_run_all) > width)
+			width = strlen(analysis_template_menu_run_all);
+
+		analysis_template_menu_run_all_entry = line++;
+	}
+
 	analysis_template_menu->entries[line - 1].menu_flags |= wimp_MENU_LAST;
 
 	msgs_lookup((standalone) ? "RepListMenuT2" : "RepListMenuT1", analysis_template_menu_title, ANALYSIS_TEMPLATE_MENU_TITLE_LEN);
@@ -257,6 +293,19 @@ template_t analysis_template_menu_decode(int selection)
 	return analysis_template_menu_entry_link[selection].template;
 }
 
+
+/**
+ * Test whether an index into the menu identifies the Run All entry.
+ *
+ * \param selection		The selection index to test.
+ * \return			TRUE if the entry is Run All; else FALSE.
+ */
+
+osbool analysis_template_menu_decode_run_all(int selection)
+{
+	return (analysis_template_menu_run_all_entry != -1 && selection == analysis_template_menu_run_all_entry) ? TRUE : FALSE;
+}
+
 /**
  * Destroy any Template List menu which is currently open.
  */
@@ -272,5 +321,6 @@ void analysis_template_menu_destroy(void)
 	analysis_template_menu = NULL;
 	analysis_template_menu_entry_link = NULL;
 	analysis_template_menu_entry_count = 0;
+	analysis_template_menu_run_all_entry = -1;
 	*analysis_template_menu_title = '\0';
 }
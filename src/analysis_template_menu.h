@@ -64,6 +64,16 @@ osbool analysis_template_menu_contains_entries(void);
 template_t analysis_template_menu_decode(int selection);
 
 
+/**
+ * Test whether an index into the menu identifies the Run All entry.
+ *
+ * \param selection		The selection index to test.
+ * \return			TRUE if the entry is Run All; else FALSE.
+ */
+
+osbool analysis_template_menu_decode_run_all(int selection);
+
+
 /**
  * Destroy any Template List menu which is currently open.
  */
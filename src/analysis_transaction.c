@@ -33,6 +33,7 @@
 
 /* OSLib header files */
 
+#include "oslib/os.h"
 #include "oslib/wimp.h"
 
 /* SF-Lib header files. */
@@ -95,6 +96,13 @@
 #define ANALYSIS_TRANS_OPACCSUMMARY 38
 #define ANALYSIS_TRANS_OPEMPTY 41
 
+/**
+ * The number of transactions to scan between checks of the time when
+ * generating a report in the background.
+ */
+
+#define ANALYSIS_TRANS_CHECK_INTERVAL 64
+
 
 /**
  * Transaction Report Template structure.
@@ -144,6 +152,38 @@ struct analysis_transaction_block {
 };
 
 
+/**
+ * The state of a Transaction Report which is being generated.
+ */
+
+struct analysis_transaction_job {
+	struct file_block			*file;				/**< The file being reported on.				*/
+	struct analysis_transaction_report	*settings;			/**< The settings for the report.				*/
+	struct report				*report;			/**< The report being written to.				*/
+	struct analysis_data_block		*scratch;			/**< The scratch space used to build the report.		*/
+
+	amt_t					min_amount;			/**< The minimum amount to include, or NULL_CURRENCY.		*/
+	amt_t					max_amount;			/**< The maximum amount to include, or NULL_CURRENCY.		*/
+	char					*match_ref;			/**< The reference to match, or NULL.				*/
+	char					*match_desc;			/**< The description to match, or NULL.				*/
+
+	date_t					start_date;			/**< The start date of the report.				*/
+	int					total_days;			/**< The number of days covered by the report.			*/
+
+	struct analysis_period_block		periods;			/**< The report period iterator.				*/
+	osbool					in_period;			/**< TRUE if a period is being scanned; else FALSE.		*/
+	date_t					next_start;			/**< The start date of the current period.			*/
+	date_t					next_end;			/**< The end date of the current period.			*/
+	char					date_text[ANALYSIS_PERIOD_NAME_LEN];	/**< The name of the current period.				*/
+
+	tran_t					transaction;			/**< The next transaction to scan in the current period.	*/
+	int					found;				/**< The number of transactions found in the current period.	*/
+
+	struct stringbuild_block		builder;			/**< The string builder used to assemble lines.			*/
+	char					line[ANALYSIS_MAX_LINE_LEN];	/**< The buffer used by the string builder.			*/
+};
+
+
 /**
  * The dialogue instance used for this report.
  */
@@ -159,6 +199,12 @@ static void analysis_transaction_rename_template(struct analysis_block *parent,
 static void analysis_transaction_fill_window(struct analysis_block *parent, wimp_w window, void *block);
 static void analysis_transaction_process_window(struct analysis_block *parent, wimp_w window, void *block);
 static void analysis_transaction_generate(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title);
+static void *analysis_transaction_start(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title);
+static osbool analysis_transaction_step(void *state, os_t deadline, int *progress);
+static void analysis_transaction_end(void *state);
+static void analysis_transaction_scan(struct analysis_transaction_job *job, tran_t transaction);
+static void analysis_transaction_summarise(struct analysis_transaction_job *job);
+static int analysis_transaction_get_progress(struct analysis_transaction_job *job);
 static void analysis_transaction_remove_template(struct analysis_block *parent, template_t template);
 static void analysis_transaction_remove_account(void *report, acct_t account);
 static void analysis_transaction_copy_template(void *to, void *from);
@@ -180,7 +226,11 @@ static struct analysis_report_details analysis_transaction_details = {
 	analysis_transaction_copy_template,
 	analysis_transaction_rename_template,
 	analysis_transaction_remove_account,
-	analysis_transaction_remove_template
+	analysis_transaction_remove_template,
+	analysis_transaction_start,
+	analysis_transaction_step,
+	analysis_transaction_end,
+	NULL
 };
 
 /* The Transaction Report Dialogue Icon Details. */
@@ -527,7 +577,7 @@ static void analysis_transaction_process_window(struct analysis_block *parent, w
 
 
 /**
- * Generate a transaction report.
+ * Generate a transaction report in one go.
  *
  * \param *parent		The parent analysis instance.
  * \param *template		The template data to use for the report.
@@ -537,23 +587,59 @@ static void analysis_transaction_process_window(struct analysis_block *parent, w
  */
 
 static void analysis_transaction_generate(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title)
+{
+	void	*state;
+
+	state = analysis_transaction_start(parent, template, report, scratch, title);
+	if (state == NULL)
+		return;
+
+	while (!analysis_transaction_step(state, os_read_monotonic_time() + 100, NULL));
+
+	analysis_transaction_end(state);
+}
+
+
+/**
+ * Start generating a transaction report, writing the heading and setting
+ * up the state required for analysis_transaction_step() to work through
+ * the report periods.
+ *
+ * \param *parent		The parent analysis instance.
+ * \param *template		The template data to use for the report.
+ * \param *report		The report to write to.
+ * \param *scratch		The scratch space to use to build the report.
+ * \param *title		Pointer to the report title.
+ * \return			The report generator state, or NULL on failure.
+ */
+
+static void *analysis_transaction_start(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title)
 {
 	struct analysis_transaction_report	*settings = template;
+	struct analysis_transaction_job		*job;
 	struct file_block			*file;
-	int					found, total, total_days, period_days, period_limit, entries, account;
-	date_t					start_date, end_date, next_start, next_end, date;
-	tran_t					i;
-	acct_t					from, to;
-	amt_t					min_amount, max_amount, amount;
-	char					date_text[1024];
-	char					*match_ref, *match_desc;
+	date_t					end_date;
 
 	if (parent == NULL || report == NULL || settings == NULL || scratch == NULL || title == NULL)
-		return;
+		return NULL;
 
 	file = analysis_get_file(parent);
 	if (file == NULL)
-		return;
+		return NULL;
+
+	job = heap_alloc(sizeof(struct analysis_transaction_job));
+	if (job == NULL)
+		return NULL;
+
+	if (!stringbuild_initialise(&(job->builder), job->line, ANALYSIS_MAX_LINE_LEN)) {
+		heap_free(job);
+		return NULL;
+	}
+
+	job->file = file;
+	job->settings = settings;
+	job->report = report;
+	job->scratch = scratch;
 
 	/* Read the include list. */
 
@@ -567,11 +653,11 @@ static void analysis_transaction_generate(struct analysis_block *parent, void *t
 				settings->to, settings->to_count);
 	}
 
-	min_amount = settings->amount_min;
-	max_amount = settings->amount_max;
+	job->min_amount = settings->amount_min;
+	job->max_amount = settings->amount_max;
 
-	match_ref = (*(settings->ref) == '\0') ? NULL : settings->ref;
-	match_desc = (*(settings->desc) == '\0') ? NULL : settings->desc;
+	job->match_ref = (*(settings->ref) == '\0') ? NULL : settings->ref;
+	job->match_desc = (*(settings->desc) == '\0') ? NULL : settings->desc;
 
 	/* Output report heading */
 
@@ -579,234 +665,366 @@ static void analysis_transaction_generate(struct analysis_block *parent, void *t
 
 	/* Read the date settings and output their details. */
 
-	analysis_find_date_range(parent, &start_date, &end_date, settings->date_from, settings->date_to, settings->budget, report);
+	analysis_find_date_range(parent, &(job->start_date), &end_date, settings->date_from, settings->date_to, settings->budget, report);
 
-	total_days = date_count_days(start_date, end_date);
+	job->total_days = date_count_days(job->start_date, end_date);
 
 	/* Initialise the heading remainder values for the report. */
 
 	analysis_data_initialise_balances(scratch);
 
-	/* Process the report time groups. */
+	/* Set up the report time groups. */
+
+	analysis_period_initialise(&(job->periods), job->start_date, end_date, settings->group, settings->period, settings->period_unit, settings->lock);
+
+	job->in_period = FALSE;
+
+	return job;
+}
+
+
+/**
+ * Continue generating a transaction report, until either it is complete
+ * or the deadline has passed.
+ *
+ * \param *state		The report generator state.
+ * \param deadline		The time at which to stop and return.
+ * \param *progress		Pointer to a variable to take the percentage
+ *				complete, or NULL.
+ * \return			TRUE if the report is complete; else FALSE.
+ */
+
+static osbool analysis_transaction_step(void *state, os_t deadline, int *progress)
+{
+	struct analysis_transaction_job	*job = state;
+	tran_t				count;
+
+	if (job == NULL)
+		return TRUE;
+
+	while (TRUE) {
+		/* Start the next report time group, if there is one. */
 
-	analysis_period_initialise(start_date, end_date, settings->group, settings->period, settings->period_unit, settings->lock);
+		if (!job->in_period) {
+			if (!analysis_period_get_next_dates(&(job->periods), &(job->next_start), &(job->next_end), job->date_text, sizeof(job->date_text)))
+				return TRUE;
 
-	while (analysis_period_get_next_dates(&next_start, &next_end, date_text, sizeof(date_text))) {
-		analysis_data_zero_totals(scratch);
+			analysis_data_zero_totals(job->scratch);
+
+			job->in_period = TRUE;
+			job->transaction = 0;
+			job->found = 0;
+		}
 
 		/* Scan through the transactions, adding the values up for those in range and outputting them to the screen. */
 
-		found = 0;
-
-		for (i = 0; i < transact_get_count(file); i++) {
-			date = transact_get_date(file, i);
-			from = transact_get_from(file, i);
-			to = transact_get_to(file, i);
-			amount = transact_get_amount(file, i);
-		
-			if ((next_start == NULL_DATE || date >= next_start) &&
-					(next_end == NULL_DATE || date <= next_end) &&
-					(analysis_data_test_account(scratch, from, ANALYSIS_DATA_FROM) ||
-							analysis_data_test_account(scratch, to, ANALYSIS_DATA_TO)) &&
-					((min_amount == NULL_CURRENCY) || (amount >= min_amount)) &&
-					((max_amount == NULL_CURRENCY) || (amount <= max_amount)) &&
-					((match_ref == NULL) || string_wildcard_compare(match_ref, transact_get_reference(file, i, NULL, 0), TRUE)) &&
-					((match_desc == NULL) || string_wildcard_compare(match_desc, transact_get_description(file, i, NULL, 0), TRUE))) {
-				if (found == 0) {
-					report_write_line(report, 0, "");
-
-					if (settings->group == TRUE) {
-						stringbuild_reset();
-						stringbuild_add_printf("\\u%s", date_text);
-						stringbuild_report_line(report, 0);
-					}
+		count = transact_get_count(job->file);
 
-					if (settings->output_trans) {
-						stringbuild_reset();
-						stringbuild_add_message("TRHeadings");
-						stringbuild_report_line(report, 1);
-					}
-				}
+		while (job->transaction < count) {
+			analysis_transaction_scan(job, job->transaction++);
 
-				found++;
-
-				/* Update the totals and output the transaction to the report file. */
-
-				analysis_data_add_transaction(scratch, i);
-
-				if (settings->output_trans) {
-					stringbuild_reset();
-					stringbuild_add_printf("\\k\\v\\d\\r%d\\t\\v\\c",
-							transact_get_transaction_number(i));
-					stringbuild_add_date(date);
-					stringbuild_add_printf("\\t\\v%s\\t\\v%s\\t\\v%s\\t\\v\\d\\r",
-							account_get_name(file, from),
-							account_get_name(file, to),
-							transact_get_reference(file, i, NULL, 0));
-					stringbuild_add_currency(amount, TRUE);
-					stringbuild_add_printf("\\t\\v%s",
-							transact_get_description(file, i, NULL, 0));
-					stringbuild_report_line(report, 1);
-				}
+			if ((job->transaction % ANALYSIS_TRANS_CHECK_INTERVAL) == 0 && (int) (os_read_monotonic_time() - deadline) >= 0) {
+				if (progress != NULL)
+					*progress = analysis_transaction_get_progress(job);
+
+				return FALSE;
 			}
 		}
 
-		/* Print the account summaries. */
+		/* Print the summaries and complete the time group. */
+
+		analysis_transaction_summarise(job);
+
+		job->in_period = FALSE;
+
+		if ((int) (os_read_monotonic_time() - deadline) >= 0) {
+			if (progress != NULL)
+				*progress = analysis_transaction_get_progress(job);
+
+			return FALSE;
+		}
+	}
+}
+
 
-		if (settings->output_accsummary && found > 0) {
-			/* Summarise the accounts. */
+/**
+ * Free the state of a transaction report generator.
+ *
+ * \param *state		The report generator state.
+ */
 
-			total = 0;
+static void analysis_transaction_end(void *state)
+{
+	struct analysis_transaction_job	*job = state;
 
-			/* Only output blank line if there are transactions above. */
+	if (job == NULL)
+		return;
 
-			if (settings->output_trans)
-				report_write_line(report, 0, "");
+	stringbuild_cancel(&(job->builder));
+	heap_free(job);
+}
 
-			stringbuild_reset();
-			stringbuild_add_string("\\i");
-			stringbuild_add_message("TRAccounts");
-			stringbuild_report_line(report, 2);
 
-			entries = account_get_list_length(file, ACCOUNT_FULL);
+/**
+ * Test a transaction against the report settings and, if it falls within
+ * the current time group, add it to the totals and the report.
+ *
+ * \param *job			The report generator state.
+ * \param transaction		The transaction to process.
+ */
 
-			for (i = 0; i < entries; i++) {
-				if ((account = account_get_list_entry_account(file, ACCOUNT_FULL, i)) != NULL_ACCOUNT) {
-					amount = analysis_data_get_total(scratch, account);
+static void analysis_transaction_scan(struct analysis_transaction_job *job, tran_t transaction)
+{
+	struct file_block			*file = job->file;
+	struct analysis_transaction_report	*settings = job->settings;
+	struct report				*report = job->report;
+	date_t					date;
+	acct_t					from, to;
+	amt_t					amount;
+	char					number[TRANSACT_ROW_FIELD_LEN];
+
+	date = transact_get_date(file, transaction);
+	from = transact_get_from(file, transaction);
+	to = transact_get_to(file, transaction);
+	amount = transact_get_amount(file, transaction);
+
+	if (!((job->next_start == NULL_DATE || date >= job->next_start) &&
+			(job->next_end == NULL_DATE || date <= job->next_end) &&
+			(analysis_data_test_account(job->scratch, from, ANALYSIS_DATA_FROM) ||
+					analysis_data_test_account(job->scratch, to, ANALYSIS_DATA_TO)) &&
+			((job->min_amount == NULL_CURRENCY) || (amount >= job->min_amount)) &&
+			((job->max_amount == NULL_CURRENCY) || (amount <= job->max_amount)) &&
+			((job->match_ref == NULL) || string_wildcard_compare(job->match_ref, transact_get_reference(file, transaction, NULL, 0), TRUE)) &&
+			((job->match_desc == NULL) || string_wildcard_compare(job->match_desc, transact_get_description(file, transaction, NULL, 0), TRUE))))
+		return;
 
-					if ((amount != 0) || settings->output_empty) {
-						total += amount;
+	if (job->found == 0) {
+		report_write_line(report, 0, "");
 
-						stringbuild_reset();
-						stringbuild_add_printf("\\k\\i%s\\t\\d\\r", account_get_name(file, account));
-						stringbuild_add_currency(amount, TRUE);
-						stringbuild_report_line(report, 2);
-					}
-				}
-			}
+		if (settings->group == TRUE) {
+			report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+			report_add_text_cell(report, 0, REPORT_CELL_FLAGS_UNDERLINE, job->date_text);
+			report_end_line(report);
+		}
 
-			stringbuild_reset();
-			stringbuild_add_string("\\i\\k\\b");
-			stringbuild_add_message("TRTotal");
-			stringbuild_add_string("\\t\\d\\r\\b");
-			stringbuild_add_currency(total, TRUE);
-			stringbuild_report_line(report, 2);
+		if (settings->output_trans) {
+			stringbuild_reset(&(job->builder));
+			stringbuild_add_message(&(job->builder), "TRHeadings");
+			stringbuild_report_line(&(job->builder), report, 1);
 		}
+	}
 
-		/* Print the transaction summaries. */
+	job->found++;
 
-		if (settings->output_summary && found > 0) {
-			/* Summarise the outgoings. */
+	/* Update the totals and output the transaction to the report file. */
 
-			total = 0;
+	analysis_data_add_transaction(job->scratch, transaction);
 
-			/* Only output blank line if there is something above. */
+	if (settings->output_trans) {
+		string_printf(number, TRANSACT_ROW_FIELD_LEN, "%d", transact_get_transaction_number(transaction));
 
-			if (settings->output_trans || settings->output_accsummary)
-				report_write_line(report, 0, "");
+		report_begin_line(report, 1, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+		report_add_text_cell(report, 0, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_NUMERIC | REPORT_CELL_FLAGS_RIGHT, number);
+		report_add_date_cell(report, 1, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_CENTRE, date);
+		report_add_text_cell(report, 2, REPORT_CELL_FLAGS_RULE_AFTER, account_get_name(file, from));
+		report_add_text_cell(report, 3, REPORT_CELL_FLAGS_RULE_AFTER, account_get_name(file, to));
+		report_add_text_cell(report, 4, REPORT_CELL_FLAGS_RULE_AFTER, transact_get_reference(file, transaction, NULL, 0));
+		report_add_currency_cell(report, 5, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_RIGHT, amount, TRUE);
+		report_add_text_cell(report, 6, REPORT_CELL_FLAGS_RULE_AFTER, transact_get_description(file, transaction, NULL, 0));
+		report_end_line(report);
+	}
+}
 
-			stringbuild_reset();
-			stringbuild_add_string("\\i");
-			stringbuild_add_message("TROutgoings");
-			if (settings->budget)
-				stringbuild_add_message("TRSummExtra");
-			stringbuild_report_line(report, 2);
 
-			entries = account_get_list_length(file, ACCOUNT_OUT);
+/**
+ * Output the account and transaction summaries for the current time group
+ * of a transaction report, if any transactions were found in it.
+ *
+ * \param *job			The report generator state.
+ */
 
-			for (i = 0; i < entries; i++) {
-				if ((account = account_get_list_entry_account(file, ACCOUNT_OUT, i)) != NULL_ACCOUNT) {
-					amount = analysis_data_get_total(scratch, account);
+static void analysis_transaction_summarise(struct analysis_transaction_job *job)
+{
+	struct file_block			*file = job->file;
+	struct analysis_transaction_report	*settings = job->settings;
+	struct report				*report = job->report;
+	struct analysis_data_block		*scratch = job->scratch;
+	int					total, period_days, period_limit, entries, account, i;
+	amt_t					amount;
 
-					if ((amount != 0) || settings->output_empty) {
-						total += amount;
+	/* Print the account summaries. */
 
-						stringbuild_reset();
-						stringbuild_add_printf("\\i\\k%s\\t\\d\\r", account_get_name(file, account));
-						stringbuild_add_currency(amount, TRUE);
+	if (settings->output_accsummary && job->found > 0) {
+		/* Summarise the accounts. */
 
-						if (settings->budget) {
-							period_days = date_count_days(next_start, next_end);
-							period_limit = account_get_budget_amount(file, account) * period_days / total_days;
+		total = 0;
 
-							stringbuild_add_string("\\t\\d\\r");
-							stringbuild_add_currency(period_limit, TRUE);
+		/* Only output blank line if there are transactions above. */
 
-							stringbuild_add_string("\\t\\d\\r");
-							stringbuild_add_currency(period_limit - amount, TRUE);
+		if (settings->output_trans)
+			report_write_line(report, 0, "");
 
-							stringbuild_add_string("\\t\\d\\r");
-							stringbuild_add_currency(analysis_data_update_balance(scratch, amount), TRUE);
-						}
+		stringbuild_reset(&(job->builder));
+		stringbuild_add_string(&(job->builder), "\\i");
+		stringbuild_add_message(&(job->builder), "TRAccounts");
+		stringbuild_report_line(&(job->builder), report, 2);
 
-						stringbuild_report_line(report, 2);
-					}
+		entries = account_get_list_length(file, ACCOUNT_FULL);
+
+		for (i = 0; i < entries; i++) {
+			if ((account = account_get_list_entry_account(file, ACCOUNT_FULL, i)) != NULL_ACCOUNT) {
+				amount = analysis_data_get_total(scratch, account);
+
+				if ((amount != 0) || settings->output_empty) {
+					total += amount;
+
+					report_begin_line(report, 2, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+					report_add_text_cell(report, 0, REPORT_CELL_FLAGS_INDENT, account_get_name(file, account));
+					report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT, amount, TRUE);
+					report_end_line(report);
 				}
 			}
+		}
+
+		report_begin_line(report, 2, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT | REPORT_CELL_FLAGS_BOLD, "TRTotal", NULL, NULL, NULL, NULL);
+		report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT | REPORT_CELL_FLAGS_BOLD, total, TRUE);
+		report_end_line(report);
+	}
 
-			stringbuild_reset();
-			stringbuild_add_string("\\i\\k\\b");
-			stringbuild_add_message("TRTotal");
-			stringbuild_add_string("\\t\\d\\r\\b");
-			stringbuild_add_currency(total, TRUE);
-			stringbuild_report_line(report, 2);
+	/* Print the transaction summaries. */
 
-			/* Summarise the incomings. */
+	if (settings->output_summary && job->found > 0) {
+		/* Summarise the outgoings. */
 
-			total = 0;
+		total = 0;
 
+		/* Only output blank line if there is something above. */
+
+		if (settings->output_trans || settings->output_accsummary)
 			report_write_line(report, 0, "");
 
-			stringbuild_reset();
-			stringbuild_add_string("\\i");
-			stringbuild_add_message("TRIncomings");
-			if (settings->budget)
-				stringbuild_add_message("TRSummExtra");
-			stringbuild_report_line(report, 2);
+		stringbuild_reset(&(job->builder));
+		stringbuild_add_string(&(job->builder), "\\i");
+		stringbuild_add_message(&(job->builder), "TROutgoings");
+		if (settings->budget)
+			stringbuild_add_message(&(job->builder), "TRSummExtra");
+		stringbuild_report_line(&(job->builder), report, 2);
+
+		entries = account_get_list_length(file, ACCOUNT_OUT);
+
+		for (i = 0; i < entries; i++) {
+			if ((account = account_get_list_entry_account(file, ACCOUNT_OUT, i)) != NULL_ACCOUNT) {
+				amount = analysis_data_get_total(scratch, account);
 
-			entries = account_get_list_length(file, ACCOUNT_IN);
+				if ((amount != 0) || settings->output_empty) {
+					total += amount;
 
-			for (i = 0; i < entries; i++) {
-				if ((account = account_get_list_entry_account(file, ACCOUNT_IN, i)) != NULL_ACCOUNT) {
-					amount = analysis_data_get_total(scratch, account);
+					report_begin_line(report, 2, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+					report_add_text_cell(report, 0, REPORT_CELL_FLAGS_INDENT, account_get_name(file, account));
+					report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT, amount, TRUE);
 
-					if ((amount != 0) || settings->output_empty) {
-						total += amount;
+					if (settings->budget) {
+						period_days = date_count_days(job->next_start, job->next_end);
+						period_limit = account_get_budget_amount(file, account) * period_days / job->total_days;
+
+						report_add_currency_cell(report, 2, REPORT_CELL_FLAGS_RIGHT, period_limit, TRUE);
+						report_add_currency_cell(report, 3, REPORT_CELL_FLAGS_RIGHT, period_limit - amount, TRUE);
+						report_add_currency_cell(report, 4, REPORT_CELL_FLAGS_RIGHT, analysis_data_update_balance(scratch, amount), TRUE);
+					}
+
+					report_end_line(report);
+				}
+			}
+		}
 
-						stringbuild_reset();
-						stringbuild_add_printf("\\i\\k%s\\t\\d\\r", account_get_name(file, account));
-						stringbuild_add_currency(-amount, TRUE);
+		report_begin_line(report, 2, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT | REPORT_CELL_FLAGS_BOLD, "TRTotal", NULL, NULL, NULL, NULL);
+		report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT | REPORT_CELL_FLAGS_BOLD, total, TRUE);
+		report_end_line(report);
 
-						if (settings->budget) {
-							period_days = date_count_days(next_start, next_end);
-							period_limit = account_get_budget_amount(file, account) * period_days / total_days;
+		/* Summarise the incomings. */
 
-							stringbuild_add_string("\\t\\d\\r");
-							stringbuild_add_currency(period_limit, TRUE);
+		total = 0;
 
-							stringbuild_add_string("\\t\\d\\r");
-							stringbuild_add_currency(period_limit - amount, TRUE);
+		report_write_line(report, 0, "");
 
-							stringbuild_add_string("\\t\\d\\r");
-							stringbuild_add_currency(analysis_data_update_balance(scratch, amount), TRUE);
-						}
+		stringbuild_reset(&(job->builder));
+		stringbuild_add_string(&(job->builder), "\\i");
+		stringbuild_add_message(&(job->builder), "TRIncomings");
+		if (settings->budget)
+			stringbuild_add_message(&(job->builder), "TRSummExtra");
+		stringbuild_report_line(&(job->builder), report, 2);
 
-						stringbuild_report_line(report, 2);
+		entries = account_get_list_length(file, ACCOUNT_IN);
+
+		for (i = 0; i < entries; i++) {
+			if ((account = account_get_list_entry_account(file, ACCOUNT_IN, i)) != NULL_ACCOUNT) {
+				amount = analysis_data_get_total(scratch, account);
+
+				if ((amount != 0) || settings->output_empty) {
+					total += amount;
+
+					report_begin_line(report, 2, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+					report_add_text_cell(report, 0, REPORT_CELL_FLAGS_INDENT, account_get_name(file, account));
+					report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT, -amount, TRUE);
+
+					if (settings->budget) {
+						period_days = date_count_days(job->next_start, job->next_end);
+						period_limit = account_get_budget_amount(file, account) * period_days / job->total_days;
+
+						report_add_currency_cell(report, 2, REPORT_CELL_FLAGS_RIGHT, period_limit, TRUE);
+						report_add_currency_cell(report, 3, REPORT_CELL_FLAGS_RIGHT, period_limit - amount, TRUE);
+						report_add_currency_cell(report, 4, REPORT_CELL_FLAGS_RIGHT, analysis_data_update_balance(scratch, amount), TRUE);
 					}
+
+					report_end_line(report);
 				}
 			}
-
-			stringbuild_reset();
-			stringbuild_add_string("\\i\\k\\b");
-			stringbuild_add_message("TRTotal");
-			stringbuild_add_string("\\t\\d\\r\\b");
-			stringbuild_add_currency(-total, TRUE);
-			stringbuild_report_line(report, 2);
 		}
+
+		report_begin_line(report, 2, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT | REPORT_CELL_FLAGS_BOLD, "TRTotal", NULL, NULL, NULL, NULL);
+		report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT | REPORT_CELL_FLAGS_BOLD, -total, TRUE);
+		report_end_line(report);
 	}
 }
 
 
+/**
+ * Estimate how far through a transaction report the generator has got.
+ *
+ * \param *job			The report generator state.
+ * \return			The percentage of the report completed.
+ */
+
+static int analysis_transaction_get_progress(struct analysis_transaction_job *job)
+{
+	int	count, days_before, period_days;
+
+	count = transact_get_count(job->file);
+
+	if (count <= 0)
+		return 0;
+
+	/* If the report isn't broken into dated periods, base the progress
+	 * on the transactions scanned so far.
+	 */
+
+	if (job->total_days <= 0 || job->next_start == NULL_DATE || job->next_end == NULL_DATE)
+		return 100 * job->transaction / count;
+
+	/* Otherwise, the progress is the days covered by the complete periods,
+	 * plus the share of the current period that has been scanned.
+	 */
+
+	days_before = date_count_days(job->start_date, job->next_start) - 1;
+	period_days = date_count_days(job->next_start, job->next_end);
+
+	return (100 * days_before / job->total_days) + ((100 * period_days / job->total_days) * job->transaction / count);
+}
+
+
 /**
  * Remove any references to a report template.
  * 
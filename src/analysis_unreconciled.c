@@ -33,6 +33,7 @@
 
 /* OSLib header files */
 
+#include "oslib/os.h"
 #include "oslib/wimp.h"
 
 /* SF-Lib header files. */
@@ -41,6 +42,7 @@
 #include "sflib/heap.h"
 #include "sflib/icons.h"
 #include "sflib/msgs.h"
+#include "sflib/string.h"
 
 /* Application header files */
 
@@ -89,6 +91,19 @@
 #define ANALYSIS_UNREC_TOSPEC 26
 #define ANALYSIS_UNREC_TOSPECPOPUP 27
 
+/**
+ * The number of transactions to scan between checks of the time when
+ * generating a report in the background.
+ */
+
+#define ANALYSIS_UNREC_CHECK_INTERVAL 64
+
+/**
+ * The number of account types which are grouped over in the report.
+ */
+
+#define ANALYSIS_UNREC_ACCOUNT_GROUPS 3
+
 
 /**
  * Unreconciled Report Template structure.
@@ -128,6 +143,50 @@ struct analysis_unreconciled_block {
 	struct analysis_unreconciled_report	saved;
 };
 
+/**
+ * The state of an Unreconciled Report which is being generated.
+ */
+
+struct analysis_unreconciled_job {
+	struct file_block			*file;				/**< The file being reported on.				*/
+	struct analysis_unreconciled_report	*settings;			/**< The settings for the report.				*/
+	struct report				*report;			/**< The report being written to.				*/
+	struct analysis_data_block		*scratch;			/**< The scratch space used to build the report.		*/
+
+	char					rec_char[REC_FIELD_LEN];	/**< The character used to show reconciled accounts.		*/
+
+	date_t					start_date;			/**< The start date of the report.				*/
+	date_t					end_date;			/**< The end date of the report.				*/
+	int					total_days;			/**< The number of days covered by the report.			*/
+
+	osbool					by_account;			/**< TRUE if the report is grouped by account; else FALSE.	*/
+
+	int					acc_group;			/**< The account type of the current account group.		*/
+	int					group_line;			/**< The next line to use in the account type's list.		*/
+	acct_t					account;			/**< The account of the current account group.			*/
+
+	struct analysis_period_block		periods;			/**< The report period iterator.				*/
+	date_t					next_start;			/**< The start date of the current period.			*/
+	date_t					next_end;			/**< The end date of the current period.			*/
+	char					date_text[ANALYSIS_PERIOD_NAME_LEN];	/**< The name of the current period.				*/
+
+	osbool					in_group;			/**< TRUE if a group is being scanned; else FALSE.		*/
+	tran_t					transaction;			/**< The next transaction to scan in the current group.		*/
+	int					found;				/**< The number of transactions found in the current group.	*/
+	amt_t					total_in;			/**< The total into the current group's account.		*/
+	amt_t					total_out;			/**< The total out of the current group's account.		*/
+
+	struct stringbuild_block		builder;			/**< The string builder used to assemble lines.			*/
+	char					line[ANALYSIS_MAX_LINE_LEN];	/**< The buffer used by the string builder.			*/
+};
+
+
+/**
+ * The account types which are grouped over, in the order that they appear
+ * in the report.
+ */
+
+static int analysis_unreconciled_account_groups[ANALYSIS_UNREC_ACCOUNT_GROUPS] = {ACCOUNT_FULL, ACCOUNT_IN, ACCOUNT_OUT};
 
 /**
  * The dialogue instance used for this report.
@@ -144,6 +203,14 @@ static void analysis_unreconciled_rename_template(struct analysis_block *parent,
 static void analysis_unreconciled_fill_window(struct analysis_block *parent, wimp_w window, void *block);
 static void analysis_unreconciled_process_window(struct analysis_block *parent, wimp_w window, void *block);
 static void analysis_unreconciled_generate(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title);
+static void *analysis_unreconciled_start(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title);
+static osbool analysis_unreconciled_step(void *state, os_t deadline, int *progress);
+static void analysis_unreconciled_end(void *state);
+static osbool analysis_unreconciled_next_group(struct analysis_unreconciled_job *job);
+static void analysis_unreconciled_scan(struct analysis_unreconciled_job *job, tran_t transaction);
+static void analysis_unreconciled_write_totals(struct analysis_unreconciled_job *job);
+static int analysis_unreconciled_get_progress(struct analysis_unreconciled_job *job);
+static void analysis_unreconciled_write_transaction(struct report *report, struct file_block *file, tran_t transaction, char *rec_char);
 static void analysis_unreconciled_remove_template(struct analysis_block *parent, template_t template);
 static void analysis_unreconciled_remove_account(void *report, acct_t account);
 static void analysis_unreconciled_copy_template(void *to, void *from);
@@ -165,7 +232,11 @@ static struct analysis_report_details analysis_unreconciled_details = {
 	analysis_unreconciled_copy_template,
 	analysis_unreconciled_rename_template,
 	analysis_unreconciled_remove_account,
-	analysis_unreconciled_remove_template
+	analysis_unreconciled_remove_template,
+	analysis_unreconciled_start,
+	analysis_unreconciled_step,
+	analysis_unreconciled_end,
+	NULL
 };
 
 /* The Unreconciled Report Dialogue Icon Details. */
@@ -484,7 +555,7 @@ static void analysis_unreconciled_process_window(struct analysis_block *parent,
 
 
 /**
- * Generate an unreconciled transaction report.
+ * Generate an unreconciled transaction report in one go.
  *
  * \param *parent		The parent analysis instance.
  * \param *template		The template data to use for the report.
@@ -494,25 +565,58 @@ static void analysis_unreconciled_process_window(struct analysis_block *parent,
  */
 
 static void analysis_unreconciled_generate(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title)
+{
+	void	*state;
+
+	state = analysis_unreconciled_start(parent, template, report, scratch, title);
+	if (state == NULL)
+		return;
+
+	while (!analysis_unreconciled_step(state, os_read_monotonic_time() + 100, NULL));
+
+	analysis_unreconciled_end(state);
+}
+
+
+/**
+ * Start generating an unreconciled transaction report, writing the heading
+ * and setting up the state required for analysis_unreconciled_step() to
+ * work through the report groups.
+ *
+ * \param *parent		The parent analysis instance.
+ * \param *template		The template data to use for the report.
+ * \param *report		The report to write to.
+ * \param *scratch		The scratch space to use to build the report.
+ * \param *title		Pointer to the report title.
+ * \return			The report generator state, or NULL on failure.
+ */
+
+static void *analysis_unreconciled_start(struct analysis_block *parent, void *template, struct report *report, struct analysis_data_block *scratch, char *title)
 {
 	struct analysis_unreconciled_report	*settings = template;
+	struct analysis_unreconciled_job	*job;
 	struct file_block			*file;
 
-	int			acc, found, entries;
-	char			date_text[1024], rec_char[REC_FIELD_LEN];
-	date_t			start_date, end_date, next_start, next_end, date;
-	tran_t			i;
-	acct_t			from, to;
-	enum transact_flags	flags;
-	amt_t			amount, total_in, total_out;
-	int			acc_group, group_line, groups = 3, sequence[]={ACCOUNT_FULL,ACCOUNT_IN,ACCOUNT_OUT};
-
 	if (parent == NULL || report == NULL || settings == NULL || scratch == NULL || title == NULL)
-		return;
+		return NULL;
 
 	file = analysis_get_file(parent);
 	if (file == NULL)
-		return;
+		return NULL;
+
+	job = heap_alloc(sizeof(struct analysis_unreconciled_job));
+	if (job == NULL)
+		return NULL;
+
+	if (!stringbuild_initialise(&(job->builder), job->line, ANALYSIS_MAX_LINE_LEN)) {
+		heap_free(job);
+		return NULL;
+	}
+
+	job->file = file;
+	job->settings = settings;
+	job->report = report;
+	job->scratch = scratch;
 
 	/* Read the include list. */
 
@@ -526,7 +630,7 @@ static void analysis_unreconciled_generate(struct analysis_block *parent, void *
 
 	/* Start to output the report details. */
 
-	msgs_lookup("RecChar", rec_char, REC_FIELD_LEN);
+	msgs_lookup("RecChar", job->rec_char, REC_FIELD_LEN);
 
 	/* Output report heading */
 
@@ -534,177 +638,329 @@ static void analysis_unreconciled_generate(struct analysis_block *parent, void *
 
 	/* Read the date settings and output their details. */
 
-	analysis_find_date_range(parent, &start_date, &end_date, settings->date_from, settings->date_to, settings->budget, report);
-
-	/* Run the report itself. */
-
-	if (settings->group && settings->period_unit == DATE_PERIOD_NONE) {
-		/* We are doing a grouped-by-account report.
-		 *
-		 * Step through the accounts in account list order, and run through all the transactions each time.  A
-		 * transaction is added if it is unreconciled in the account concerned; transactions unreconciled in two
-		 * accounts may therefore appear twice in the list.
-		 */
-
-		for (acc_group = 0; acc_group < groups; acc_group++) {
-			entries = account_get_list_length(file, sequence[acc_group]);
-
-			for (group_line = 0; group_line < entries; group_line++) {
-				if ((acc = account_get_list_entry_account(file, sequence[acc_group], group_line)) != NULL_ACCOUNT) {
-					found = 0;
-					total_in = 0;
-					total_out = 0;
-
-					for (i = 0; i < transact_get_count(file); i++) {
-						date = transact_get_date(file, i);
-						from = transact_get_from(file, i);
-						to = transact_get_to(file, i);
-						flags = transact_get_flags(file, i);
-						amount = transact_get_amount(file, i);
-
-						if ((start_date == NULL_DATE || date >= start_date) &&
-								(end_date == NULL_DATE || date <= end_date) &&
-								(((from == acc) && analysis_data_test_account(scratch, acc, ANALYSIS_DATA_FROM) &&
-								(flags & TRANS_REC_FROM) == 0) ||
-								((to == acc) && analysis_data_test_account(scratch, acc, ANALYSIS_DATA_TO) &&
-								(flags & TRANS_REC_TO) == 0))) {
-							if (found == 0) {
-								report_write_line(report, 0, "");
-
-								if (settings->group == TRUE) {
-									stringbuild_reset();
-									stringbuild_add_printf("\\u%s", account_get_name(file, acc));
-									stringbuild_report_line(report, 0);
-								}
-
-								stringbuild_reset();
-								stringbuild_add_message("URHeadings");
-								stringbuild_report_line(report, 1);
-							}
-
-							found++;
-
-							if (from == acc)
-								total_out -= amount;
-							else if (to == acc)
-								total_in += amount;
-
-							/* Output the transaction to the report. */
-
-							stringbuild_reset();
-
-							stringbuild_add_printf("\\k\\v\\d\\r%d\\t\\v\\c",
-									transact_get_transaction_number(i));
-							stringbuild_add_date(date);
-							stringbuild_add_string("\\t");
-							if (flags & TRANS_REC_FROM)
-								stringbuild_add_string(rec_char);
-							stringbuild_add_printf("\\t\\v%s\\t",
-									account_get_name(file, from));
-							if (flags & TRANS_REC_TO)
-								stringbuild_add_string(rec_char);
-							stringbuild_add_printf("\\t\\v%s\\t\\v%s\\t\\v\\d\\r",
-								account_get_name(file, to),
-								transact_get_reference(file, i, NULL, 0));
-							stringbuild_add_currency(amount, TRUE);
-							stringbuild_add_printf("\\t\\v%s",
-									transact_get_description(file, i, NULL, 0));
-
-							stringbuild_report_line(report, 1);
-						}
-					}
-
-					if (found != 0) {
-						report_write_line(report, 2, "");
-
-						stringbuild_reset();
-						stringbuild_add_string("\\i");
-						stringbuild_add_message("URTotalIn");
-						stringbuild_add_string("\\t\\d\\r");
-						stringbuild_add_currency(total_in, TRUE);
-						stringbuild_report_line(report, 2);
-
-						stringbuild_reset();
-						stringbuild_add_string("\\i");
-						stringbuild_add_message("URTotalOut");
-						stringbuild_add_string("\\t\\d\\r");
-						stringbuild_add_currency(total_out, TRUE);
-						stringbuild_report_line(report, 2);
-
-						stringbuild_reset();
-						stringbuild_add_string("\\i");
-						stringbuild_add_message("URTotal");
-						stringbuild_add_string("\\t\\d\\r");
-						stringbuild_add_currency(total_in + total_out, TRUE);
-						stringbuild_report_line(report, 2);
-					}
-				}
+	analysis_find_date_range(parent, &(job->start_date), &(job->end_date), settings->date_from, settings->date_to, settings->budget, report);
+
+	job->total_days = date_count_days(job->start_date, job->end_date);
+
+	/* The report is either grouped by account, in which case the
+	 * transactions are scanned once for each account in account list
+	 * order, or grouped by date (or not at all), in which case they are
+	 * scanned once for each date period. A transaction unreconciled in
+	 * two accounts may therefore appear twice in an account grouped list.
+	 */
+
+	job->by_account = (settings->group && settings->period_unit == DATE_PERIOD_NONE) ? TRUE : FALSE;
+
+	job->acc_group = 0;
+	job->group_line = 0;
+	job->account = NULL_ACCOUNT;
+
+	if (!job->by_account)
+		analysis_period_initialise(&(job->periods), job->start_date, job->end_date, settings->group, settings->period, settings->period_unit, settings->lock);
+
+	job->next_start = NULL_DATE;
+	job->next_end = NULL_DATE;
+
+	job->in_group = FALSE;
+
+	return job;
+}
+
+
+/**
+ * Continue generating an unreconciled transaction report, until either it
+ * is complete or the deadline has passed.
+ *
+ * \param *state		The report generator state.
+ * \param deadline		The time at which to stop and return.
+ * \param *progress		Pointer to a variable to take the percentage
+ *				complete, or NULL.
+ * \return			TRUE if the report is complete; else FALSE.
+ */
+
+static osbool analysis_unreconciled_step(void *state, os_t deadline, int *progress)
+{
+	struct analysis_unreconciled_job	*job = state;
+	tran_t					count;
+
+	if (job == NULL)
+		return TRUE;
+
+	while (TRUE) {
+		/* Start the next report group, if there is one. */
+
+		if (!job->in_group) {
+			if (!analysis_unreconciled_next_group(job))
+				return TRUE;
+
+			job->in_group = TRUE;
+			job->transaction = 0;
+			job->found = 0;
+			job->total_in = 0;
+			job->total_out = 0;
+		}
+
+		/* Scan through the transactions, outputting those in the group. */
+
+		count = transact_get_count(job->file);
+
+		while (job->transaction < count) {
+			analysis_unreconciled_scan(job, job->transaction++);
+
+			if ((job->transaction % ANALYSIS_UNREC_CHECK_INTERVAL) == 0 && (int) (os_read_monotonic_time() - deadline) >= 0) {
+				if (progress != NULL)
+					*progress = analysis_unreconciled_get_progress(job);
+
+				return FALSE;
 			}
 		}
+
+		/* Print the totals and complete the group. */
+
+		if (job->by_account && job->found != 0)
+			analysis_unreconciled_write_totals(job);
+
+		job->in_group = FALSE;
+
+		if ((int) (os_read_monotonic_time() - deadline) >= 0) {
+			if (progress != NULL)
+				*progress = analysis_unreconciled_get_progress(job);
+
+			return FALSE;
+		}
+	}
+}
+
+
+/**
+ * Free the state of an unreconciled transaction report generator.
+ *
+ * \param *state		The report generator state.
+ */
+
+static void analysis_unreconciled_end(void *state)
+{
+	struct analysis_unreconciled_job	*job = state;
+
+	if (job == NULL)
+		return;
+
+	stringbuild_cancel(&(job->builder));
+	heap_free(job);
+}
+
+
+/**
+ * Move an unreconciled transaction report on to its next group: either
+ * the next account in account list order, or the next date period.
+ *
+ * \param *job			The report generator state.
+ * \return			TRUE if there is another group; FALSE if the
+ *				report is complete.
+ */
+
+static osbool analysis_unreconciled_next_group(struct analysis_unreconciled_job *job)
+{
+	int	entries;
+
+	if (!job->by_account)
+		return analysis_period_get_next_dates(&(job->periods), &(job->next_start), &(job->next_end), job->date_text, sizeof(job->date_text));
+
+	while (job->acc_group < ANALYSIS_UNREC_ACCOUNT_GROUPS) {
+		entries = account_get_list_length(job->file, analysis_unreconciled_account_groups[job->acc_group]);
+
+		while (job->group_line < entries) {
+			job->account = account_get_list_entry_account(job->file, analysis_unreconciled_account_groups[job->acc_group], job->group_line++);
+
+			if (job->account != NULL_ACCOUNT)
+				return TRUE;
+		}
+
+		job->acc_group++;
+		job->group_line = 0;
+	}
+
+	return FALSE;
+}
+
+
+/**
+ * Test a transaction against the report settings and, if it belongs in
+ * the current group, add it to the totals and the report.
+ *
+ * \param *job			The report generator state.
+ * \param transaction		The transaction to process.
+ */
+
+static void analysis_unreconciled_scan(struct analysis_unreconciled_job *job, tran_t transaction)
+{
+	struct file_block	*file = job->file;
+	struct report		*report = job->report;
+	struct analysis_data_block *scratch = job->scratch;
+	date_t			date;
+	acct_t			from, to, acc = job->account;
+	enum transact_flags	flags;
+	amt_t			amount;
+	osbool			include;
+
+	date = transact_get_date(file, transaction);
+	from = transact_get_from(file, transaction);
+	to = transact_get_to(file, transaction);
+	flags = transact_get_flags(file, transaction);
+	amount = transact_get_amount(file, transaction);
+
+	if (job->by_account) {
+		include = ((job->start_date == NULL_DATE || date >= job->start_date) &&
+				(job->end_date == NULL_DATE || date <= job->end_date) &&
+				(((from == acc) && analysis_data_test_account(scratch, acc, ANALYSIS_DATA_FROM) &&
+				(flags & TRANS_REC_FROM) == 0) ||
+				((to == acc) && analysis_data_test_account(scratch, acc, ANALYSIS_DATA_TO) &&
+				(flags & TRANS_REC_TO) == 0))) ? TRUE : FALSE;
 	} else {
-		/* We are either doing a grouped-by-date report, or not grouping at all.
-		 *
-		 * For each date period, run through the transactions and output any which fall within it.
-		 */
-
-		analysis_period_initialise(start_date, end_date, settings->group, settings->period, settings->period_unit, settings->lock);
-
-		while (analysis_period_get_next_dates(&next_start, &next_end, date_text, sizeof(date_text))) {
-			found = 0;
-
-			for (i = 0; i < transact_get_count(file); i++) {
-				date = transact_get_date(file, i);
-				from = transact_get_from(file, i);
-				to = transact_get_to(file, i);
-				flags = transact_get_flags(file, i);
-				amount = transact_get_amount(file, i);
-
-				if ((next_start == NULL_DATE || date >= next_start) &&
-						(next_end == NULL_DATE || date <= next_end) &&
-						((((flags & TRANS_REC_FROM) == 0) && analysis_data_test_account(scratch, from, ANALYSIS_DATA_FROM)) ||
-						(((flags & TRANS_REC_TO) == 0) && analysis_data_test_account(scratch, to, ANALYSIS_DATA_TO)))) {
-					if (found == 0) {
-						report_write_line(report, 0, "");
-
-						if (settings->group == TRUE) {
-							stringbuild_reset();
-							stringbuild_add_printf("\\u%s", date_text);
-							stringbuild_report_line(report, 0);
-						}
-
-						stringbuild_reset();
-						stringbuild_add_message("URHeadings");
-						stringbuild_report_line(report, 1);
-					}
-
-					found++;
-
-					/* Output the transaction to the report. */
-
-					stringbuild_reset();
-
-					stringbuild_add_printf("\\k\\v\\d\\r%d\\t\\v\\c",
-							transact_get_transaction_number(i));
-					stringbuild_add_date(date);
-					stringbuild_add_string("\\t");
-					if (flags & TRANS_REC_FROM)
-						stringbuild_add_string(rec_char);
-					stringbuild_add_printf("\\t\\v%s\\t",
-							account_get_name(file, from));
-					if (flags & TRANS_REC_TO)
-						stringbuild_add_string(rec_char);
-					stringbuild_add_printf("\\t\\v%s\\t\\v%s\\t\\v\\d\\r",
-						account_get_name(file, to),
-						transact_get_reference(file, i, NULL, 0));
-					stringbuild_add_currency(amount, TRUE);
-					stringbuild_add_printf("\\t\\v%s",
-							transact_get_description(file, i, NULL, 0));
-
-					stringbuild_report_line(report, 1);
-				}
-			}
+		include = ((job->next_start == NULL_DATE || date >= job->next_start) &&
+				(job->next_end == NULL_DATE || date <= job->next_end) &&
+				((((flags & TRANS_REC_FROM) == 0) && analysis_data_test_account(scratch, from, ANALYSIS_DATA_FROM)) ||
+				(((flags & TRANS_REC_TO) == 0) && analysis_data_test_account(scratch, to, ANALYSIS_DATA_TO)))) ? TRUE : FALSE;
+	}
+
+	if (!include)
+		return;
+
+	if (job->found == 0) {
+		report_write_line(report, 0, "");
+
+		if (job->settings->group == TRUE) {
+			report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+			report_add_text_cell(report, 0, REPORT_CELL_FLAGS_UNDERLINE, (job->by_account) ? account_get_name(file, acc) : job->date_text);
+			report_end_line(report);
 		}
+
+		stringbuild_reset(&(job->builder));
+		stringbuild_add_message(&(job->builder), "URHeadings");
+		stringbuild_report_line(&(job->builder), report, 1);
 	}
+
+	job->found++;
+
+	if (job->by_account) {
+		if (from == acc)
+			job->total_out -= amount;
+		else if (to == acc)
+			job->total_in += amount;
+	}
+
+	/* Output the transaction to the report. */
+
+	analysis_unreconciled_write_transaction(report, file, transaction, job->rec_char);
+}
+
+
+/**
+ * Write the totals for the current account group to an unreconciled
+ * transaction report.
+ *
+ * \param *job			The report generator state.
+ */
+
+static void analysis_unreconciled_write_totals(struct analysis_unreconciled_job *job)
+{
+	struct report	*report = job->report;
+
+	report_write_line(report, 2, "");
+
+	report_begin_line(report, 2, REPORT_LINE_FLAGS_NONE);
+	report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, "URTotalIn", NULL, NULL, NULL, NULL);
+	report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT, job->total_in, TRUE);
+	report_end_line(report);
+
+	report_begin_line(report, 2, REPORT_LINE_FLAGS_NONE);
+	report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, "URTotalOut", NULL, NULL, NULL, NULL);
+	report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT, job->total_out, TRUE);
+	report_end_line(report);
+
+	report_begin_line(report, 2, REPORT_LINE_FLAGS_NONE);
+	report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, "URTotal", NULL, NULL, NULL, NULL);
+	report_add_currency_cell(report, 1, REPORT_CELL_FLAGS_RIGHT, job->total_in + job->total_out, TRUE);
+	report_end_line(report);
+}
+
+
+/**
+ * Estimate how far through an unreconciled transaction report the
+ * generator has got.
+ *
+ * \param *job			The report generator state.
+ * \return			The percentage of the report completed.
+ */
+
+static int analysis_unreconciled_get_progress(struct analysis_unreconciled_job *job)
+{
+	int	count, entries, days_before, period_days;
+
+	count = transact_get_count(job->file);
+
+	if (count <= 0)
+		return 0;
+
+	/* Account grouped reports progress through the account lists, with
+	 * each account type taking an equal share.
+	 */
+
+	if (job->by_account) {
+		if (job->acc_group >= ANALYSIS_UNREC_ACCOUNT_GROUPS)
+			return 100;
+
+		entries = account_get_list_length(job->file, analysis_unreconciled_account_groups[job->acc_group]);
+
+		if (entries <= 0)
+			return 100 * job->acc_group / ANALYSIS_UNREC_ACCOUNT_GROUPS;
+
+		return (100 * job->acc_group + 100 * job->group_line / entries) / ANALYSIS_UNREC_ACCOUNT_GROUPS;
+	}
+
+	/* Otherwise, the progress is the days covered by the complete periods,
+	 * plus the share of the current period that has been scanned.
+	 */
+
+	if (job->total_days <= 0 || job->next_start == NULL_DATE || job->next_end == NULL_DATE)
+		return 100 * job->transaction / count;
+
+	days_before = date_count_days(job->start_date, job->next_start) - 1;
+	period_days = date_count_days(job->next_start, job->next_end);
+
+	return (100 * days_before / job->total_days) + ((100 * period_days / job->total_days) * job->transaction / count);
+}
+
+
+/**
+ * Write a transaction to an unreconciled transaction report.
+ *
+ * \param *report		The report to write to.
+ * \param *file			The file containing the transaction.
+ * \param transaction		The transaction to be written.
+ * \param *rec_char		The character used to show reconciled accounts.
+ */
+
+static void analysis_unreconciled_write_transaction(struct report *report, struct file_block *file, tran_t transaction, char *rec_char)
+{
+	enum transact_flags	flags;
+	char			number[TRANSACT_ROW_FIELD_LEN];
+
+	flags = transact_get_flags(file, transaction);
+
+	string_printf(number, TRANSACT_ROW_FIELD_LEN, "%d", transact_get_transaction_number(transaction));
+
+	report_begin_line(report, 1, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+	report_add_text_cell(report, 0, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_NUMERIC | REPORT_CELL_FLAGS_RIGHT, number);
+	report_add_date_cell(report, 1, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_CENTRE, transact_get_date(file, transaction));
+	report_add_text_cell(report, 2, REPORT_CELL_FLAGS_NONE, (flags & TRANS_REC_FROM) ? rec_char : NULL);
+	report_add_text_cell(report, 3, REPORT_CELL_FLAGS_RULE_AFTER, account_get_name(file, transact_get_from(file, transaction)));
+	report_add_text_cell(report, 4, REPORT_CELL_FLAGS_NONE, (flags & TRANS_REC_TO) ? rec_char : NULL);
+	report_add_text_cell(report, 5, REPORT_CELL_FLAGS_RULE_AFTER, account_get_name(file, transact_get_to(file, transaction)));
+	report_add_text_cell(report, 6, REPORT_CELL_FLAGS_RULE_AFTER, transact_get_reference(file, transaction, NULL, 0));
+	report_add_currency_cell(report, 7, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_RIGHT, transact_get_amount(file, transaction), TRUE);
+	report_add_text_cell(report, 8, REPORT_CELL_FLAGS_RULE_AFTER, transact_get_description(file, transaction, NULL, 0));
+	report_end_line(report);
 }
 
 
@@ -0,0 +1,1821 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: archive.c
+ *
+ * Transaction archive segment implementation.
+ *
+ * When transactions are purged from a file, they can be written to a
+ * sealed archive segment instead of being thrown away. Segments are plain
+ * text in the style of CashBook files, but the transactions are stored
+ * compactly: only the first transaction in each run of ARCHIVE_INDEX_STEP
+ * carries its full date, with the rest holding the difference from the
+ * one before. Transactions without a date have no place in this sequence,
+ * so they are held back and written to an undated section of their own
+ * once the dated transactions are complete. The segment ends with a
+ * summary for each account involved, a date index giving the position of
+ * each full date in the file, and a seal which covers everything before it.
+ *
+ * A new segment is written to a scrap file, since the purged file has not
+ * been saved yet. It is moved in next to the file when the file is saved,
+ * and the file then records where its segments are; if the file is closed
+ * without being saved, the segment is thrown away with it.
+ */
+
+/* ANSI C header files */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files */
+
+#include "oslib/fileswitch.h"
+#include "oslib/osfile.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/config.h"
+#include "sflib/debug.h"
+#include "sflib/errors.h"
+#include "sflib/heap.h"
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "global.h"
+#include "archive.h"
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+#include "file.h"
+#include "filing.h"
+#include "transact.h"
+
+/**
+ * The archive segment format version, multiplied by 100.
+ */
+
+#define ARCHIVE_FORMAT 100
+
+/**
+ * The number of transactions between full dates and index entries.
+ */
+
+#define ARCHIVE_INDEX_STEP 64
+
+/**
+ * The number of index entries to allocate space for at a time.
+ */
+
+#define ARCHIVE_INDEX_ALLOCATION 32
+
+/**
+ * The highest segment number which will be tried next to a file.
+ */
+
+#define ARCHIVE_MAX_SEGMENTS 99
+
+/**
+ * The modulus used by the Adler-32 checksum which seals the segments.
+ */
+
+#define ARCHIVE_SEAL_MODULUS 65521
+
+/**
+ * The size of the buffer used when copying segments.
+ */
+
+#define ARCHIVE_COPY_BUFFER_LEN 1024
+
+/**
+ * The sections of an archive segment.
+ */
+
+enum archive_section {
+	ARCHIVE_SECTION_HEADER,							/**< The segment header, before any sections.		*/
+	ARCHIVE_SECTION_TRANSACTIONS,						/**< The transactions.					*/
+	ARCHIVE_SECTION_UNDATED,						/**< The undated transactions.				*/
+	ARCHIVE_SECTION_SEGMENT,						/**< The segment details.				*/
+	ARCHIVE_SECTION_ACCOUNTS,						/**< The account summaries.				*/
+	ARCHIVE_SECTION_INDEX,							/**< The date index.					*/
+	ARCHIVE_SECTION_UNKNOWN							/**< A section which isn't understood.			*/
+};
+
+/**
+ * A summary of an account's transactions in an archive segment.
+ */
+
+struct archive_account {
+	int			account;				/**< The segment account number.			*/
+	char			ident[ACCOUNT_IDENT_LEN];		/**< The ident of the account.				*/
+	char			name[ACCOUNT_NAME_LEN];			/**< The name of the account.				*/
+	int			count;					/**< The number of transactions using the account.	*/
+	amt_t			in;					/**< The total transferred into the account.		*/
+	amt_t			out;					/**< The total transferred out of the account.		*/
+	acct_t			match;					/**< The matching account in the file, or NULL_ACCOUNT.	*/
+};
+
+/**
+ * An entry in the date index of an archive segment.
+ */
+
+struct archive_index {
+	date_t			date;					/**< The full date stored at the indexed line.		*/
+	int			entry;					/**< The number of the transaction at the line.		*/
+	long			offset;					/**< The position of the line in the segment file.	*/
+};
+
+/**
+ * The seal being calculated over an archive segment.
+ */
+
+struct archive_seal {
+	unsigned		low;					/**< The low half of the Adler-32 checksum.		*/
+	unsigned		high;					/**< The high half of the Adler-32 checksum.		*/
+};
+
+/**
+ * An archive segment belonging to a file.
+ */
+
+struct archive_segment_file {
+	char			filename[FILE_MAX_FILENAME];		/**< The filename of the segment.			*/
+	osbool			pending;				/**< TRUE if the segment is waiting for a save.		*/
+	struct archive_segment	*segment;				/**< The segment's details once checked, or NULL.	*/
+};
+
+/**
+ * A file's transaction archive instance.
+ */
+
+struct archive_block {
+	struct file_block	*file;					/**< The file to which the instance belongs.		*/
+
+	struct archive_segment_file *segments;				/**< The segments belonging to the file.		*/
+	int			segment_count;				/**< The number of segments belonging to the file.	*/
+};
+
+/**
+ * An archive segment writer instance.
+ */
+
+struct archive_writer {
+	struct file_block	*file;					/**< The file being archived from.			*/
+	FILE			*handle;				/**< The handle of the segment being written.		*/
+	char			filename[FILE_MAX_FILENAME];		/**< The filename of the segment being written.	*/
+	osbool			failed;					/**< TRUE if an error has occurred while writing.	*/
+
+	struct archive_seal	seal;					/**< The seal being calculated over the segment.	*/
+
+	struct archive_account	*accounts;				/**< The summaries for each account in the file.	*/
+	int			account_count;				/**< The number of accounts in the file.		*/
+
+	struct archive_index	*index;					/**< The date index being built.			*/
+	int			index_count;				/**< The number of entries in the index.		*/
+	int			index_size;				/**< The number of index entries space is allocated for. */
+
+	struct archive_transaction *undated;				/**< The undated transactions, held back until the end.	*/
+	int			undated_count;				/**< The number of undated transactions held.		*/
+	int			undated_size;				/**< The number of undated transactions space is allocated for. */
+
+	int			entries;				/**< The number of dated transactions written.		*/
+	date_t			start;					/**< The earliest transaction date written.		*/
+	date_t			end;					/**< The latest transaction date written.		*/
+	date_t			previous;				/**< The date of the last transaction written.		*/
+	osbool			sorted;					/**< TRUE if the transactions are in date order.	*/
+};
+
+/**
+ * An open archive segment.
+ */
+
+struct archive_segment {
+	FILE			*handle;				/**< The handle of the segment file.			*/
+
+	struct archive_account	*accounts;				/**< The account summaries, in account order.		*/
+	int			account_count;				/**< The number of account summaries.			*/
+
+	struct archive_index	*index;					/**< The date index.					*/
+	int			index_count;				/**< The number of entries in the index.		*/
+
+	int			entries;				/**< The number of dated transactions in the segment.	*/
+	int			undated;				/**< The number of undated transactions in the segment. */
+	long			undated_offset;				/**< The position of the undated transactions in the file. */
+	date_t			start;					/**< The earliest transaction date in the segment.	*/
+	date_t			end;					/**< The latest transaction date in the segment.	*/
+	osbool			sorted;					/**< TRUE if the transactions are in date order.	*/
+};
+
+/**
+ * The account totals being built up from an archive.
+ */
+
+struct archive_totals {
+	amt_t			*totals;				/**< The totals, indexed by file account.		*/
+	acct_t			count;					/**< The number of entries in the totals array.	*/
+};
+
+/* Static Function Prototypes. */
+
+static struct archive_segment *archive_open_segment(char *filename);
+static void archive_close_segment(struct archive_segment *segment);
+static struct archive_segment *archive_claim_segment(struct archive_segment_file *file);
+static void archive_release_segment(struct archive_segment *segment);
+static int archive_get_entry_count(struct archive_segment *segment);
+static int archive_read_segment(struct archive_segment *segment, date_t from, date_t to,
+		osbool (*callback)(struct archive_segment *segment, struct archive_transaction *transaction, void *data), void *data, osbool *stopped);
+static int archive_read_entries(struct archive_segment *segment, long offset, int remaining, date_t from, date_t to,
+		osbool (*callback)(struct archive_segment *segment, struct archive_transaction *transaction, void *data), void *data, osbool *stopped);
+static osbool archive_hold_undated_transaction(struct archive_writer *writer, enum transact_flags flags, acct_t from, acct_t to,
+		amt_t amount, char *reference, char *description);
+static void archive_match_accounts(struct file_block *file, struct archive_segment *segment);
+static osbool archive_total_transaction(struct archive_segment *segment, struct archive_transaction *transaction, void *data);
+static void archive_add_to_total(struct archive_segment *segment, int account, amt_t amount, struct archive_totals *totals);
+static osbool archive_add_segment_file(struct archive_block *instance, char *filename, osbool pending);
+static void archive_destroy_writer(struct archive_writer *writer, osbool keep);
+static osbool archive_find_filename(char *base, char *filename, size_t length);
+static osbool archive_copy_file(char *source, char *destination);
+static void archive_write_line(struct archive_writer *writer, char *line);
+static osbool archive_add_index_entry(struct archive_index **index, int *count, int *size, date_t date, int entry, long offset);
+static osbool archive_read_line(FILE *handle, char *line, size_t length);
+static char *archive_split_line(char *line);
+static unsigned archive_next_field(char **field);
+static struct archive_account *archive_find_account(struct archive_segment *segment, int account);
+static void archive_reset_seal(struct archive_seal *seal);
+static void archive_update_seal(struct archive_seal *seal, char *line);
+static unsigned archive_get_seal(struct archive_seal *seal);
+
+
+/**
+ * Create a new transaction archive instance.
+ *
+ * \param *file			The file to attach the instance to.
+ * \return			The instance handle, or NULL on failure.
+ */
+
+struct archive_block *archive_create_instance(struct file_block *file)
+{
+	struct archive_block	*new;
+
+	new = heap_alloc(sizeof(struct archive_block));
+	if (new == NULL)
+		return NULL;
+
+	new->file = file;
+
+	new->segments = NULL;
+	new->segment_count = 0;
+
+	return new;
+}
+
+
+/**
+ * Delete a transaction archive instance. Any segments which are still
+ * waiting for the file to be saved are removed.
+ *
+ * \param *instance		The instance to be deleted.
+ */
+
+void archive_delete_instance(struct archive_block *instance)
+{
+	int	segment;
+
+	if (instance == NULL)
+		return;
+
+	for (segment = 0; segment < instance->segment_count; segment++) {
+		archive_close_segment(instance->segments[segment].segment);
+
+		if (instance->segments[segment].pending)
+			remove(instance->segments[segment].filename);
+	}
+
+	if (instance->segments != NULL)
+		heap_free(instance->segments);
+
+	heap_free(instance);
+}
+
+
+/**
+ * Start a new archive segment for a file. The segment is written to a
+ * scrap file, and is only placed next to the file when it is saved.
+ *
+ * \param *file			The file to archive transactions from.
+ * \param cutoff		The date before which transactions are archived,
+ *				or NULL_DATE if there is no cutoff.
+ * \return			The new writer handle, or NULL on failure.
+ */
+
+struct archive_writer *archive_begin_segment(struct file_block *file, date_t cutoff)
+{
+	struct archive_writer	*new;
+	char			line[FILING_MAX_FILE_LINE_LEN];
+	acct_t			account;
+
+	if (file == NULL || file->archive == NULL)
+		return NULL;
+
+	new = heap_alloc(sizeof(struct archive_writer));
+	if (new == NULL) {
+		error_msgs_report_error("NoMemArchive");
+		return NULL;
+	}
+
+	new->file = file;
+	new->handle = NULL;
+	new->failed = FALSE;
+
+	new->account_count = account_get_count(file);
+	new->accounts = NULL;
+
+	new->index = NULL;
+	new->index_count = 0;
+	new->index_size = 0;
+
+	new->undated = NULL;
+	new->undated_count = 0;
+	new->undated_size = 0;
+
+	new->entries = 0;
+	new->start = NULL_DATE;
+	new->end = NULL_DATE;
+	new->previous = NULL_DATE;
+	new->sorted = TRUE;
+
+	*(new->filename) = '\0';
+
+	if (new->account_count > 0) {
+		new->accounts = heap_alloc(sizeof(struct archive_account) * new->account_count);
+		if (new->accounts == NULL) {
+			archive_destroy_writer(new, FALSE);
+			error_msgs_report_error("NoMemArchive");
+			return NULL;
+		}
+	}
+
+	for (account = 0; account < new->account_count; account++) {
+		new->accounts[account].account = account;
+		new->accounts[account].count = 0;
+		new->accounts[account].in = 0;
+		new->accounts[account].out = 0;
+	}
+
+	/* The segment goes into a scrap file until the file is saved. */
+
+	if (tmpnam(new->filename) == NULL)
+		*(new->filename) = '\0';
+	else
+		new->handle = fopen(new->filename, "w");
+
+	if (new->handle == NULL) {
+		archive_destroy_writer(new, FALSE);
+		error_msgs_report_error("ArchiveFail");
+		return NULL;
+	}
+
+	#ifdef DEBUG
+	debug_printf("Creating archive segment '%s'", new->filename);
+	#endif
+
+	archive_reset_seal(&(new->seal));
+
+	archive_write_line(new, "# CashBook archive segment");
+	archive_write_line(new, "# Written by CashBook");
+	archive_write_line(new, "");
+
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "Format: %1.2f", ((double) ARCHIVE_FORMAT) / 100.0);
+	archive_write_line(new, line);
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "Book: %s", file_get_leafname(file, NULL, 0));
+	archive_write_line(new, line);
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "Cutoff: %x", cutoff);
+	archive_write_line(new, line);
+
+	archive_write_line(new, "");
+	archive_write_line(new, "[Transactions]");
+
+	return new;
+}
+
+
+/**
+ * Add a transaction to an archive segment which is being written.
+ *
+ * \param *writer		The archive segment writer to add to.
+ * \param date			The date of the transaction.
+ * \param from			The account transferred from.
+ * \param to			The account transferred to.
+ * \param flags			The transaction's flags.
+ * \param amount		The amount transferred.
+ * \param *reference		The transaction reference.
+ * \param *description		The transaction description.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool archive_add_transaction(struct archive_writer *writer, date_t date, acct_t from, acct_t to, enum transact_flags flags,
+		amt_t amount, char *reference, char *description)
+{
+	char	line[FILING_MAX_FILE_LINE_LEN];
+
+	if (writer == NULL || writer->handle == NULL || writer->failed)
+		return FALSE;
+
+	/* Update the account summaries. */
+
+	if (from >= 0 && from < writer->account_count) {
+		writer->accounts[from].count++;
+		writer->accounts[from].out += amount;
+	}
+
+	if (to >= 0 && to < writer->account_count) {
+		writer->accounts[to].count++;
+		writer->accounts[to].in += amount;
+	}
+
+	/* Undated transactions can't take part in the date sequence, so they
+	 * are kept to one side until the segment is completed.
+	 */
+
+	if (date == NULL_DATE)
+		return archive_hold_undated_transaction(writer, flags, from, to, amount, reference, description);
+
+	/* Every so often, write a full date and index the position of the
+	 * line; otherwise, just write the difference from the previous date.
+	 */
+
+	if (writer->entries % ARCHIVE_INDEX_STEP == 0) {
+		if (!archive_add_index_entry(&(writer->index), &(writer->index_count), &(writer->index_size),
+				date, writer->entries, ftell(writer->handle))) {
+			writer->failed = TRUE;
+			return FALSE;
+		}
+
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "@: %x,%x,%x,%x,%x", date, flags, from, to, amount);
+	} else {
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "+: %x,%x,%x,%x,%x", date - writer->previous, flags, from, to, amount);
+	}
+
+	archive_write_line(writer, line);
+
+	if (reference != NULL && *reference != '\0') {
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "Ref: %s", reference);
+		archive_write_line(writer, line);
+	}
+
+	if (description != NULL && *description != '\0') {
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "Desc: %s", description);
+		archive_write_line(writer, line);
+	}
+
+	/* Update the segment details. */
+
+	if (writer->previous != NULL_DATE && date < writer->previous)
+		writer->sorted = FALSE;
+
+	if (writer->start == NULL_DATE || date < writer->start)
+		writer->start = date;
+
+	if (writer->end == NULL_DATE || date > writer->end)
+		writer->end = date;
+
+	writer->previous = date;
+	writer->entries++;
+
+	return !writer->failed;
+}
+
+
+/**
+ * Complete an archive segment, sealing it and reading it back to check
+ * that it is intact. If all is well, the segment is held against the file
+ * until it is next saved; if not, it is removed again. Either way, the
+ * writer is freed.
+ *
+ * \param *writer		The archive segment writer to complete.
+ * \return			TRUE if the segment was sealed; else FALSE.
+ */
+
+osbool archive_end_segment(struct archive_writer *writer)
+{
+	struct archive_segment	*segment;
+	struct archive_transaction *transaction;
+	char			line[FILING_MAX_FILE_LINE_LEN];
+	acct_t			account;
+	int			entry;
+	osbool			intact;
+
+	if (writer == NULL)
+		return FALSE;
+
+	if (writer->handle == NULL || writer->failed) {
+		archive_destroy_writer(writer, FALSE);
+		error_msgs_report_error("ArchiveFail");
+		return FALSE;
+	}
+
+	/* Write out the undated transactions which were held back. */
+
+	if (writer->undated_count > 0) {
+		archive_write_line(writer, "");
+		archive_write_line(writer, "[Undated]");
+
+		for (entry = 0; entry < writer->undated_count; entry++) {
+			transaction = writer->undated + entry;
+
+			string_printf(line, FILING_MAX_FILE_LINE_LEN, "?: %x,%x,%x,%x", transaction->flags,
+					transaction->from, transaction->to, transaction->amount);
+			archive_write_line(writer, line);
+
+			if (*(transaction->reference) != '\0') {
+				string_printf(line, FILING_MAX_FILE_LINE_LEN, "Ref: %s", transaction->reference);
+				archive_write_line(writer, line);
+			}
+
+			if (*(transaction->description) != '\0') {
+				string_printf(line, FILING_MAX_FILE_LINE_LEN, "Desc: %s", transaction->description);
+				archive_write_line(writer, line);
+			}
+		}
+	}
+
+	/* Write the segment details. */
+
+	archive_write_line(writer, "");
+	archive_write_line(writer, "[Segment]");
+
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "Start: %x", writer->start);
+	archive_write_line(writer, line);
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "End: %x", writer->end);
+	archive_write_line(writer, line);
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "Entries: %x", writer->entries);
+	archive_write_line(writer, line);
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "Undated: %x", writer->undated_count);
+	archive_write_line(writer, line);
+	string_printf(line, FILING_MAX_FILE_LINE_LEN, "Sorted: %s", (writer->sorted) ? config_return_opt_string(TRUE) : config_return_opt_string(FALSE));
+	archive_write_line(writer, line);
+
+	/* Write the summaries of the accounts which were used. */
+
+	archive_write_line(writer, "");
+	archive_write_line(writer, "[Accounts]");
+
+	for (account = 0; account < writer->account_count; account++) {
+		if (writer->accounts[account].count == 0)
+			continue;
+
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "@: %x,%x,%x,%x", account, writer->accounts[account].count,
+				writer->accounts[account].in, writer->accounts[account].out);
+		archive_write_line(writer, line);
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "Ident: %s", account_get_ident(writer->file, account));
+		archive_write_line(writer, line);
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "Name: %s", account_get_name(writer->file, account));
+		archive_write_line(writer, line);
+	}
+
+	/* Write the date index. */
+
+	archive_write_line(writer, "");
+	archive_write_line(writer, "[Index]");
+
+	for (entry = 0; entry < writer->index_count; entry++) {
+		string_printf(line, FILING_MAX_FILE_LINE_LEN, "@: %x,%x,%lx", writer->index[entry].date,
+				writer->index[entry].entry, writer->index[entry].offset);
+		archive_write_line(writer, line);
+	}
+
+	/* Seal the segment. */
+
+	archive_write_line(writer, "");
+	fprintf(writer->handle, "Seal: %x\n", archive_get_seal(&(writer->seal)));
+
+	if (ferror(writer->handle))
+		writer->failed = TRUE;
+
+	if (fclose(writer->handle) != 0)
+		writer->failed = TRUE;
+
+	writer->handle = NULL;
+
+	/* Read the segment back, to make sure that it is intact, and then
+	 * hold it against the file until the file is saved.
+	 */
+
+	intact = FALSE;
+
+	if (!writer->failed) {
+		segment = archive_open_segment(writer->filename);
+		intact = (segment != NULL && archive_get_entry_count(segment) == writer->entries + writer->undated_count) ? TRUE : FALSE;
+		archive_close_segment(segment);
+	}
+
+	if (!intact || !archive_add_segment_file(writer->file->archive, writer->filename, TRUE)) {
+		archive_destroy_writer(writer, FALSE);
+		error_msgs_report_error("ArchiveFail");
+		return FALSE;
+	}
+
+	#ifdef DEBUG
+	debug_printf("Sealed archive segment with %d entries and %d undated", writer->entries, writer->undated_count);
+	#endif
+
+	archive_destroy_writer(writer, TRUE);
+
+	return TRUE;
+}
+
+
+/**
+ * Place any archive segments which are waiting for a file to be saved
+ * next to the file's new location on disc. This must be done before the
+ * file itself is written, so that the file can record the segments.
+ *
+ * \param *file			The file being saved.
+ * \param *filename		The filename that the file is being saved to.
+ * \return			TRUE if successful; FALSE if the segments could
+ *				not be saved, in which case the file shouldn't be.
+ */
+
+osbool archive_save_segments(struct file_block *file, char *filename)
+{
+	struct archive_segment_file	*segment;
+	struct archive_segment		*check;
+	char				destination[FILE_MAX_FILENAME];
+	int				i;
+	osbool				intact;
+
+	if (file == NULL || file->archive == NULL || filename == NULL)
+		return FALSE;
+
+	for (i = 0; i < file->archive->segment_count; i++) {
+		segment = file->archive->segments + i;
+
+		if (!segment->pending)
+			continue;
+
+		if (!archive_find_filename(filename, destination, FILE_MAX_FILENAME))
+			return FALSE;
+
+		/* Copy the segment into place, and check that the copy is intact
+		 * before letting go of the scrap file.
+		 */
+
+		if (!archive_copy_file(segment->filename, destination))
+			return FALSE;
+
+		check = archive_open_segment(destination);
+		intact = (check != NULL) ? TRUE : FALSE;
+		archive_close_segment(check);
+
+		if (!intact) {
+			remove(destination);
+			return FALSE;
+		}
+
+		osfile_set_type(destination, (bits) osfile_TYPE_TEXT);
+
+		remove(segment->filename);
+
+		string_copy(segment->filename, destination, FILE_MAX_FILENAME);
+		segment->pending = FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Save the details of a file's archive segments to a CashBook file.
+ *
+ * \param *file			The file to write.
+ * \param *out			The file handle to write to.
+ */
+
+void archive_write_file(struct file_block *file, FILE *out)
+{
+	int	segment;
+	osbool	header = FALSE;
+
+	if (file == NULL || file->archive == NULL)
+		return;
+
+	/* Segments which are still pending haven't been placed next to the
+	 * file, so there's nothing to record for them.
+	 */
+
+	for (segment = 0; segment < file->archive->segment_count; segment++) {
+		if (file->archive->segments[segment].pending)
+			continue;
+
+		if (!header) {
+			fprintf(out, "\n[Archive]\n");
+			header = TRUE;
+		}
+
+		config_write_token_pair(out, "Segment", file->archive->segments[segment].filename);
+	}
+}
+
+
+/**
+ * Read the details of a file's archive segments from a CashBook file.
+ *
+ * \param *file			The file to read in to.
+ * \param *in			The filing handle to read in from.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool archive_read_file(struct file_block *file, struct filing_block *in)
+{
+	char	filename[FILE_MAX_FILENAME];
+
+	if (file == NULL || file->archive == NULL)
+		return FALSE;
+
+#ifdef DEBUG
+	debug_printf("\\GLoading Archive Segments.");
+#endif
+
+	do {
+		if (filing_test_token(in, "Segment")) {
+			filing_get_text_value(in, filename, FILE_MAX_FILENAME);
+
+			if (!archive_add_segment_file(file->archive, filename, FALSE)) {
+				filing_set_status(in, FILING_STATUS_MEMORY);
+				return FALSE;
+			}
+		} else {
+			filing_set_status(in, FILING_STATUS_UNEXPECTED);
+		}
+	} while (filing_get_next_token(in));
+
+	return TRUE;
+}
+
+
+/**
+ * Read the archived transactions belonging to a file which fall between two
+ * dates, passing each in turn to a callback function. The date index of each
+ * segment is used to skip straight to the first transaction of interest.
+ * Undated transactions are only included if there is no last date.
+ * Segments which are missing, or whose seal is broken, are skipped.
+ *
+ * \param *file			The file whose archive is to be read.
+ * \param from			The first date to read, or NULL_DATE for the
+ *				start of the archive.
+ * \param to			The last date to read, or NULL_DATE for the
+ *				end of the archive.
+ * \param *callback		The function to call for each transaction; it
+ *				should return FALSE to stop reading.
+ * \param *data			Client data to pass to the callback function.
+ * \return			The number of transactions passed to the
+ *				callback.
+ */
+
+int archive_read_transactions(struct file_block *file, date_t from, date_t to,
+		osbool (*callback)(struct archive_segment *segment, struct archive_transaction *transaction, void *data), void *data)
+{
+	struct archive_segment	*segment;
+	int			i, read, count = 0;
+	osbool			stopped = FALSE;
+
+	if (file == NULL || file->archive == NULL || callback == NULL)
+		return 0;
+
+	for (i = 0; !stopped && i < file->archive->segment_count; i++) {
+		segment = archive_claim_segment(file->archive->segments + i);
+		if (segment == NULL)
+			continue;
+
+		read = archive_read_segment(segment, from, to, callback, data, &stopped);
+		if (read > 0)
+			count += read;
+
+		archive_release_segment(segment);
+	}
+
+	return count;
+}
+
+
+/**
+ * Add up the archived transactions belonging to a file which fall between
+ * two dates, adding the net amount transferred into each of the file's
+ * accounts to a set of totals. Segments which lie wholly within the dates
+ * are taken from their account summaries, while the date index is used to
+ * read just the parts of any others which are required. Accounts are
+ * matched to those in the file by their idents.
+ *
+ * \param *file			The file whose archive is to be read.
+ * \param from			The first date to include, or NULL_DATE for the
+ *				start of the archive.
+ * \param to			The last date to include, or NULL_DATE for the
+ *				end of the archive.
+ * \param *totals		The totals to add to, indexed by account.
+ * \param count			The number of entries in the totals array.
+ * \return			The number of archived transactions included.
+ */
+
+int archive_get_account_totals(struct file_block *file, date_t from, date_t to, amt_t *totals, acct_t count)
+{
+	struct archive_segment	*segment;
+	struct archive_totals	data;
+	int			i, account, read, found = 0;
+	osbool			stopped;
+
+	if (file == NULL || file->archive == NULL || totals == NULL)
+		return 0;
+
+	data.totals = totals;
+	data.count = count;
+
+	for (i = 0; i < file->archive->segment_count; i++) {
+		segment = archive_claim_segment(file->archive->segments + i);
+		if (segment == NULL)
+			continue;
+
+		archive_match_accounts(file, segment);
+
+		/* Undated transactions fall after any last date, so a segment
+		 * holding them is only wholly inside an open-ended range.
+		 */
+
+		if ((from == NULL_DATE || segment->entries == 0 || from <= segment->start) &&
+				(to == NULL_DATE || ((segment->entries == 0 || to >= segment->end) && segment->undated == 0))) {
+			for (account = 0; account < segment->account_count; account++) {
+				archive_add_to_total(segment, segment->accounts[account].account, -segment->accounts[account].out, &data);
+				archive_add_to_total(segment, segment->accounts[account].account, segment->accounts[account].in, &data);
+			}
+
+			found += segment->entries + segment->undated;
+		} else {
+			read = archive_read_segment(segment, from, to, archive_total_transaction, &data, &stopped);
+			if (read > 0)
+				found += read;
+		}
+
+		archive_release_segment(segment);
+	}
+
+	return found;
+}
+
+
+/**
+ * Return the ident of one of the accounts in an archive segment.
+ *
+ * \param *segment		The segment to interrogate.
+ * \param account		The segment account to look up.
+ * \return			Pointer to the account ident, or "".
+ */
+
+char *archive_get_account_ident(struct archive_segment *segment, int account)
+{
+	struct archive_account	*summary;
+
+	summary = archive_find_account(segment, account);
+
+	return (summary != NULL) ? summary->ident : "";
+}
+
+
+/**
+ * Return the name of one of the accounts in an archive segment.
+ *
+ * \param *segment		The segment to interrogate.
+ * \param account		The segment account to look up.
+ * \return			Pointer to the account name, or "".
+ */
+
+char *archive_get_account_name(struct archive_segment *segment, int account)
+{
+	struct archive_account	*summary;
+
+	summary = archive_find_account(segment, account);
+
+	return (summary != NULL) ? summary->name : "";
+}
+
+
+/**
+ * Open an archive segment for reading, checking its seal and loading its
+ * account summaries and date index.
+ *
+ * \param *filename		The filename of the segment to open.
+ * \return			The segment handle, or NULL on failure.
+ */
+
+static struct archive_segment *archive_open_segment(char *filename)
+{
+	struct archive_segment	*new;
+	struct archive_account	*accounts;
+	struct archive_seal	seal;
+	enum archive_section	section = ARCHIVE_SECTION_HEADER;
+	char			line[FILING_MAX_FILE_LINE_LEN], *value, *field;
+	int			entries = 0, undated = 0, index_size = 0, account_size = 0;
+	osbool			sealed = FALSE, success = TRUE;
+	unsigned		expected;
+
+	if (filename == NULL)
+		return NULL;
+
+	new = heap_alloc(sizeof(struct archive_segment));
+	if (new == NULL)
+		return NULL;
+
+	new->accounts = NULL;
+	new->account_count = 0;
+	new->index = NULL;
+	new->index_count = 0;
+	new->entries = 0;
+	new->undated = 0;
+	new->undated_offset = 0;
+	new->start = NULL_DATE;
+	new->end = NULL_DATE;
+	new->sorted = FALSE;
+
+	new->handle = fopen(filename, "r");
+	if (new->handle == NULL) {
+		archive_close_segment(new);
+		return NULL;
+	}
+
+	archive_reset_seal(&seal);
+
+	/* Read through the whole segment, checking the seal as we go and
+	 * picking up the details needed to find our way around it later.
+	 */
+
+	while (success && !sealed && archive_read_line(new->handle, line, FILING_MAX_FILE_LINE_LEN)) {
+		value = archive_split_line(line);
+
+		if (strcmp(line, "Seal") == 0 && value != NULL) {
+			expected = (unsigned) strtoul(value, NULL, 16);
+			sealed = (expected == archive_get_seal(&seal)) ? TRUE : FALSE;
+			success = sealed;
+			break;
+		}
+
+		/* The line has been split in two, so put it back together for
+		 * the seal.
+		 */
+
+		if (value != NULL)
+			*(value - 2) = ':';
+
+		archive_update_seal(&seal, line);
+
+		if (value != NULL)
+			*(value - 2) = '\0';
+
+		if (*line == '[') {
+			if (strcmp(line, "[Transactions]") == 0) {
+				section = ARCHIVE_SECTION_TRANSACTIONS;
+			} else if (strcmp(line, "[Undated]") == 0) {
+				section = ARCHIVE_SECTION_UNDATED;
+				new->undated_offset = ftell(new->handle);
+			} else if (strcmp(line, "[Segment]") == 0) {
+				section = ARCHIVE_SECTION_SEGMENT;
+			} else if (strcmp(line, "[Accounts]") == 0) {
+				section = ARCHIVE_SECTION_ACCOUNTS;
+			} else if (strcmp(line, "[Index]") == 0) {
+				section = ARCHIVE_SECTION_INDEX;
+			} else {
+				section = ARCHIVE_SECTION_UNKNOWN;
+			}
+
+			continue;
+		}
+
+		if (value == NULL)
+			continue;
+
+		field = value;
+
+		switch (section) {
+		case ARCHIVE_SECTION_HEADER:
+			if (strcmp(line, "Format") == 0 && (int) (atof(value) * 100.0 + 0.5) > ARCHIVE_FORMAT)
+				success = FALSE;
+			break;
+
+		case ARCHIVE_SECTION_TRANSACTIONS:
+			if (strcmp(line, "@") == 0 || strcmp(line, "+") == 0)
+				entries++;
+			break;
+
+		case ARCHIVE_SECTION_UNDATED:
+			if (strcmp(line, "?") == 0)
+				undated++;
+			break;
+
+		case ARCHIVE_SECTION_SEGMENT:
+			if (strcmp(line, "Start") == 0)
+				new->start = (date_t) strtoul(value, NULL, 16);
+			else if (strcmp(line, "End") == 0)
+				new->end = (date_t) strtoul(value, NULL, 16);
+			else if (strcmp(line, "Entries") == 0)
+				new->entries = (int) strtoul(value, NULL, 16);
+			else if (strcmp(line, "Undated") == 0)
+				new->undated = (int) strtoul(value, NULL, 16);
+			else if (strcmp(line, "Sorted") == 0)
+				new->sorted = config_read_opt_string(value);
+			break;
+
+		case ARCHIVE_SECTION_ACCOUNTS:
+			if (strcmp(line, "@") == 0) {
+				if (new->account_count >= account_size) {
+					account_size += ARCHIVE_INDEX_ALLOCATION;
+
+					if (new->accounts == NULL)
+						accounts = heap_alloc(sizeof(struct archive_account) * account_size);
+					else
+						accounts = heap_extend(new->accounts, sizeof(struct archive_account) * account_size);
+
+					if (accounts == NULL) {
+						success = FALSE;
+						break;
+					}
+
+					new->accounts = accounts;
+				}
+
+				accounts = new->accounts + new->account_count++;
+
+				accounts->account = (int) archive_next_field(&field);
+				accounts->count = (int) archive_next_field(&field);
+				accounts->in = (amt_t) archive_next_field(&field);
+				accounts->out = (amt_t) archive_next_field(&field);
+				accounts->match = NULL_ACCOUNT;
+				*(accounts->ident) = '\0';
+				*(accounts->name) = '\0';
+			} else if (new->account_count > 0 && strcmp(line, "Ident") == 0) {
+				string_copy(new->accounts[new->account_count - 1].ident, value, ACCOUNT_IDENT_LEN);
+			} else if (new->account_count > 0 && strcmp(line, "Name") == 0) {
+				string_copy(new->accounts[new->account_count - 1].name, value, ACCOUNT_NAME_LEN);
+			}
+			break;
+
+		case ARCHIVE_SECTION_INDEX:
+			if (strcmp(line, "@") == 0) {
+				date_t	date = (date_t) archive_next_field(&field);
+				int	entry = (int) archive_next_field(&field);
+				long	offset = (long) archive_next_field(&field);
+
+				success = archive_add_index_entry(&(new->index), &(new->index_count), &index_size, date, entry, offset);
+			}
+			break;
+
+		case ARCHIVE_SECTION_UNKNOWN:
+			break;
+		}
+	}
+
+	/* The segment is only usable if the seal was found and matched, and
+	 * the transactions are all present.
+	 */
+
+	if (!success || !sealed || entries != new->entries || undated != new->undated) {
+		#ifdef DEBUG
+		debug_printf("Archive segment '%s' failed its checks", filename);
+		#endif
+
+		archive_close_segment(new);
+		return NULL;
+	}
+
+	return new;
+}
+
+
+/**
+ * Close an archive segment which was opened for reading.
+ *
+ * \param *segment		The segment to close.
+ */
+
+static void archive_close_segment(struct archive_segment *segment)
+{
+	if (segment == NULL)
+		return;
+
+	if (segment->handle != NULL)
+		fclose(segment->handle);
+
+	if (segment->accounts != NULL)
+		heap_free(segment->accounts);
+
+	if (segment->index != NULL)
+		heap_free(segment->index);
+
+	heap_free(segment);
+}
+
+
+/**
+ * Claim one of a file's archive segments for reading. The segment is
+ * checked the first time that it is claimed, and its details are then
+ * kept so that later claims need only reopen the file.
+ *
+ * \param *file			The segment file to claim.
+ * \return			The segment handle, or NULL on failure.
+ */
+
+static struct archive_segment *archive_claim_segment(struct archive_segment_file *file)
+{
+	if (file->segment == NULL) {
+		file->segment = archive_open_segment(file->filename);
+		return file->segment;
+	}
+
+	if (file->segment->handle == NULL)
+		file->segment->handle = fopen(file->filename, "r");
+
+	return (file->segment->handle != NULL) ? file->segment : NULL;
+}
+
+
+/**
+ * Release an archive segment which was claimed for reading, closing its
+ * file but keeping its details.
+ *
+ * \param *segment		The segment to release.
+ */
+
+static void archive_release_segment(struct archive_segment *segment)
+{
+	if (segment == NULL || segment->handle == NULL)
+		return;
+
+	fclose(segment->handle);
+	segment->handle = NULL;
+}
+
+
+/**
+ * Return the number of transactions held in an archive segment.
+ *
+ * \param *segment		The segment to interrogate.
+ * \return			The number of transactions in the segment.
+ */
+
+static int archive_get_entry_count(struct archive_segment *segment)
+{
+	return (segment != NULL) ? segment->entries + segment->undated : 0;
+}
+
+
+/**
+ * Read the transactions in an archive segment which fall between two dates,
+ * passing each in turn to a callback function. The segment's date index is
+ * used to skip straight to the first transaction of interest. Undated
+ * transactions sort after all of the dated ones, so they are only included
+ * if there is no last date.
+ *
+ * \param *segment		The segment to read from.
+ * \param from			The first date to read, or NULL_DATE for the
+ *				start of the segment.
+ * \param to			The last date to read, or NULL_DATE for the
+ *				end of the segment.
+ * \param *callback		The function to call for each transaction; it
+ *				should return FALSE to stop reading.
+ * \param *data			Client data to pass to the callback function.
+ * \param *stopped		Pointer to a variable to be set to TRUE if the
+ *				callback asked for reading to stop.
+ * \return			The number of transactions passed to the
+ *				callback, or -1 on failure.
+ */
+
+static int archive_read_segment(struct archive_segment *segment, date_t from, date_t to,
+		osbool (*callback)(struct archive_segment *segment, struct archive_transaction *transaction, void *data), void *data, osbool *stopped)
+{
+	int	low, high, middle, count = 0, read;
+
+	*stopped = FALSE;
+
+	if (segment == NULL || callback == NULL)
+		return -1;
+
+	if (from == NULL_DATE)
+		from = 0;
+
+	if (segment->entries > 0 && segment->index_count > 0 && from <= segment->end && to >= segment->start) {
+
+		/* If the transactions are in date order, find the last index
+		 * entry which falls before the first date required; otherwise,
+		 * all of the transactions must be checked.
+		 */
+
+		low = 0;
+
+		if (segment->sorted) {
+			high = segment->index_count - 1;
+
+			while (low < high) {
+				middle = (low + high + 1) / 2;
+
+				if (segment->index[middle].date < from)
+					low = middle;
+				else
+					high = middle - 1;
+			}
+		}
+
+		count = archive_read_entries(segment, segment->index[low].offset, segment->entries - segment->index[low].entry,
+				from, to, callback, data, stopped);
+		if (count < 0)
+			return -1;
+	}
+
+	if (!*stopped && segment->undated > 0 && to == NULL_DATE) {
+		read = archive_read_entries(segment, segment->undated_offset, segment->undated, from, to, callback, data, stopped);
+		if (read < 0)
+			return -1;
+
+		count += read;
+	}
+
+	return count;
+}
+
+
+/**
+ * Read a run of transactions from an archive segment, passing those which
+ * fall between two dates to a callback function.
+ *
+ * \param *segment		The segment to read from.
+ * \param offset		The position of the first transaction's line.
+ * \param remaining		The number of transactions left in the run.
+ * \param from			The first date to read.
+ * \param to			The last date to read, or NULL_DATE for the
+ *				end of the segment.
+ * \param *callback		The function to call for each transaction; it
+ *				should return FALSE to stop reading.
+ * \param *data			Client data to pass to the callback function.
+ * \param *stopped		Pointer to a variable to be set to TRUE if the
+ *				callback asked for reading to stop.
+ * \return			The number of transactions passed to the
+ *				callback, or -1 on failure.
+ */
+
+static int archive_read_entries(struct archive_segment *segment, long offset, int remaining, date_t from, date_t to,
+		osbool (*callback)(struct archive_segment *segment, struct archive_transaction *transaction, void *data), void *data, osbool *stopped)
+{
+	struct archive_transaction	transaction;
+	char				line[FILING_MAX_FILE_LINE_LEN], *value, *field;
+	int				count = 0;
+	osbool				pending = FALSE, more = TRUE, done = FALSE, entry;
+	date_t				date = NULL_DATE;
+
+	if (fseek(segment->handle, offset, SEEK_SET) != 0)
+		return -1;
+
+	/* Read the transactions, passing each one on once all of its lines
+	 * have been seen.
+	 */
+
+	while (!done) {
+		more = (remaining > 0 || pending) && archive_read_line(segment->handle, line, FILING_MAX_FILE_LINE_LEN);
+		value = (more) ? archive_split_line(line) : NULL;
+		entry = (more && (strcmp(line, "@") == 0 || strcmp(line, "+") == 0 || strcmp(line, "?") == 0)) ? TRUE : FALSE;
+
+		if (pending && (!more || value == NULL || entry)) {
+			pending = FALSE;
+
+			if (segment->sorted && transaction.date > to) {
+				done = TRUE;
+				break;
+			}
+
+			if (transaction.date >= from && transaction.date <= to) {
+				count++;
+
+				if (!callback(segment, &transaction, data)) {
+					*stopped = TRUE;
+					done = TRUE;
+					break;
+				}
+			}
+		}
+
+		if (!more || value == NULL) {
+			done = TRUE;
+			break;
+		}
+
+		field = value;
+
+		if (entry) {
+			if (strcmp(line, "@") == 0)
+				date = (date_t) archive_next_field(&field);
+			else if (strcmp(line, "+") == 0)
+				date += (date_t) archive_next_field(&field);
+
+			transaction.date = (strcmp(line, "?") == 0) ? NULL_DATE : date;
+			transaction.flags = (enum transact_flags) archive_next_field(&field);
+			transaction.from = (int) archive_next_field(&field);
+			transaction.to = (int) archive_next_field(&field);
+			transaction.amount = (amt_t) archive_next_field(&field);
+			*(transaction.reference) = '\0';
+			*(transaction.description) = '\0';
+
+			pending = TRUE;
+			remaining--;
+		} else if (pending && strcmp(line, "Ref") == 0) {
+			string_copy(transaction.reference, value, TRANSACT_REF_FIELD_LEN);
+		} else if (pending && strcmp(line, "Desc") == 0) {
+			string_copy(transaction.description, value, TRANSACT_DESCRIPT_FIELD_LEN);
+		}
+	}
+
+	return count;
+}
+
+
+/**
+ * Hold an undated transaction against an archive segment writer, ready to
+ * be written out when the segment is completed.
+ *
+ * \param *writer		The archive segment writer to add to.
+ * \param flags			The transaction's flags.
+ * \param from			The account transferred from.
+ * \param to			The account transferred to.
+ * \param amount		The amount transferred.
+ * \param *reference		The transaction reference.
+ * \param *description		The transaction description.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool archive_hold_undated_transaction(struct archive_writer *writer, enum transact_flags flags, acct_t from, acct_t to,
+		amt_t amount, char *reference, char *description)
+{
+	struct archive_transaction	*undated;
+
+	if (writer->undated_count >= writer->undated_size) {
+		if (writer->undated == NULL)
+			undated = heap_alloc(sizeof(struct archive_transaction) * (writer->undated_size + ARCHIVE_INDEX_ALLOCATION));
+		else
+			undated = heap_extend(writer->undated, sizeof(struct archive_transaction) * (writer->undated_size + ARCHIVE_INDEX_ALLOCATION));
+
+		if (undated == NULL) {
+			writer->failed = TRUE;
+			return FALSE;
+		}
+
+		writer->undated = undated;
+		writer->undated_size += ARCHIVE_INDEX_ALLOCATION;
+	}
+
+	undated = writer->undated + writer->undated_count++;
+
+	undated->date = NULL_DATE;
+	undated->flags = flags;
+	undated->from = from;
+	undated->to = to;
+	undated->amount = amount;
+	string_copy(undated->reference, (reference != NULL) ? reference : "", TRANSACT_REF_FIELD_LEN);
+	string_copy(undated->description, (description != NULL) ? description : "", TRANSACT_DESCRIPT_FIELD_LEN);
+
+	return TRUE;
+}
+
+
+/**
+ * Match the accounts in an archive segment's summaries to the accounts in
+ * a file, using their idents.
+ *
+ * \param *file			The file to match the accounts in.
+ * \param *segment		The segment whose accounts are to be matched.
+ */
+
+static void archive_match_accounts(struct file_block *file, struct archive_segment *segment)
+{
+	int	account;
+
+	for (account = 0; account < segment->account_count; account++)
+		segment->accounts[account].match = account_find_by_ident(file, segment->accounts[account].ident,
+				ACCOUNT_FULL | ACCOUNT_IN | ACCOUNT_OUT);
+}
+
+
+/**
+ * Callback for archive_read_segment() when totalling accounts, which adds
+ * a transaction to the account totals.
+ *
+ * \param *segment		The segment holding the transaction.
+ * \param *transaction		The transaction to add.
+ * \param *data			The account totals being built up.
+ * \return			TRUE to continue reading.
+ */
+
+static osbool archive_total_transaction(struct archive_segment *segment, struct archive_transaction *transaction, void *data)
+{
+	archive_add_to_total(segment, transaction->from, -transaction->amount, data);
+	archive_add_to_total(segment, transaction->to, transaction->amount, data);
+
+	return TRUE;
+}
+
+
+/**
+ * Add an amount to the total for the file account which matches one of
+ * the accounts in an archive segment.
+ *
+ * \param *segment		The segment holding the account.
+ * \param account		The segment account number.
+ * \param amount		The amount to add.
+ * \param *totals		The account totals being built up.
+ */
+
+static void archive_add_to_total(struct archive_segment *segment, int account, amt_t amount, struct archive_totals *totals)
+{
+	struct archive_account	*summary;
+
+	summary = archive_find_account(segment, account);
+
+	if (summary != NULL && summary->match != NULL_ACCOUNT && summary->match >= 0 && summary->match < totals->count)
+		totals->totals[summary->match] += amount;
+}
+
+
+/**
+ * Add a segment to the list of those belonging to a file.
+ *
+ * \param *instance		The archive instance to add the segment to.
+ * \param *filename		The filename of the segment.
+ * \param pending		TRUE if the segment is waiting for the file
+ *				to be saved; FALSE if it is already in place.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool archive_add_segment_file(struct archive_block *instance, char *filename, osbool pending)
+{
+	struct archive_segment_file	*segments;
+
+	if (instance == NULL || filename == NULL)
+		return FALSE;
+
+	if (instance->segments == NULL)
+		segments = heap_alloc(sizeof(struct archive_segment_file) * (instance->segment_count + 1));
+	else
+		segments = heap_extend(instance->segments, sizeof(struct archive_segment_file) * (instance->segment_count + 1));
+
+	if (segments == NULL)
+		return FALSE;
+
+	instance->segments = segments;
+
+	string_copy(instance->segments[instance->segment_count].filename, filename, FILE_MAX_FILENAME);
+	instance->segments[instance->segment_count].pending = pending;
+	instance->segments[instance->segment_count].segment = NULL;
+
+	instance->segment_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Free an archive segment writer instance.
+ *
+ * \param *writer		The writer to be freed.
+ * \param keep			TRUE to keep the segment file; FALSE to
+ *				remove it.
+ */
+
+static void archive_destroy_writer(struct archive_writer *writer, osbool keep)
+{
+	if (writer == NULL)
+		return;
+
+	if (writer->handle != NULL)
+		fclose(writer->handle);
+
+	if (!keep && *(writer->filename) != '\0')
+		remove(writer->filename);
+
+	if (writer->accounts != NULL)
+		heap_free(writer->accounts);
+
+	if (writer->index != NULL)
+		heap_free(writer->index);
+
+	if (writer->undated != NULL)
+		heap_free(writer->undated);
+
+	heap_free(writer);
+}
+
+
+/**
+ * Find a free filename for a new archive segment next to a file, by adding
+ * a segment number to the file's own filename.
+ *
+ * \param *base			The filename of the file.
+ * \param *filename		Pointer to a buffer to take the filename.
+ * \param length		The length of the supplied buffer.
+ * \return			TRUE if a filename was found; else FALSE.
+ */
+
+static osbool archive_find_filename(char *base, char *filename, size_t length)
+{
+	int	segment;
+
+	if (base == NULL || *base == '\0' || filename == NULL)
+		return FALSE;
+
+	for (segment = 1; segment <= ARCHIVE_MAX_SEGMENTS; segment++) {
+		string_printf(filename, length, "%s_A%d", base, segment);
+
+		if (osfile_read_stamped(filename, NULL, NULL, NULL, NULL, NULL) == fileswitch_NOT_FOUND)
+			return TRUE;
+	}
+
+	*filename = '\0';
+
+	return FALSE;
+}
+
+
+/**
+ * Copy a file.
+ *
+ * \param *source		The filename of the file to copy.
+ * \param *destination		The filename to copy the file to.
+ * \return			TRUE if successful; else FALSE.
+ */
+
+static osbool archive_copy_file(char *source, char *destination)
+{
+	FILE	*in, *out;
+	char	buffer[ARCHIVE_COPY_BUFFER_LEN];
+	size_t	length;
+	osbool	success = TRUE;
+
+	in = fopen(source, "rb");
+	if (in == NULL)
+		return FALSE;
+
+	out = fopen(destination, "wb");
+	if (out == NULL) {
+		fclose(in);
+		return FALSE;
+	}
+
+	while (success && (length = fread(buffer, 1, ARCHIVE_COPY_BUFFER_LEN, in)) > 0) {
+		if (fwrite(buffer, 1, length, out) != length)
+			success = FALSE;
+	}
+
+	if (ferror(in))
+		success = FALSE;
+
+	fclose(in);
+
+	if (fclose(out) != 0)
+		success = FALSE;
+
+	if (!success)
+		remove(destination);
+
+	return success;
+}
+
+
+/**
+ * Write a line to an archive segment, adding it to the segment's seal.
+ *
+ * \param *writer		The archive segment writer to write to.
+ * \param *line			The line to write, without a line ending.
+ */
+
+static void archive_write_line(struct archive_writer *writer, char *line)
+{
+	if (writer == NULL || writer->handle == NULL || line == NULL)
+		return;
+
+	archive_update_seal(&(writer->seal), line);
+
+	if (fprintf(writer->handle, "%s\n", line) < 0)
+		writer->failed = TRUE;
+}
+
+
+/**
+ * Add an entry to the end of an archive segment's date index.
+ *
+ * \param **index		Pointer to the index array pointer.
+ * \param *count		Pointer to the number of entries in the index.
+ * \param *size			Pointer to the number of entries allocated.
+ * \param date			The date of the indexed transaction.
+ * \param entry			The number of the indexed transaction.
+ * \param offset		The position of the indexed line in the file.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool archive_add_index_entry(struct archive_index **index, int *count, int *size, date_t date, int entry, long offset)
+{
+	struct archive_index	*extended;
+
+	if (offset < 0)
+		return FALSE;
+
+	if (*count >= *size) {
+		if (*index == NULL)
+			extended = heap_alloc(sizeof(struct archive_index) * (*size + ARCHIVE_INDEX_ALLOCATION));
+		else
+			extended = heap_extend(*index, sizeof(struct archive_index) * (*size + ARCHIVE_INDEX_ALLOCATION));
+
+		if (extended == NULL)
+			return FALSE;
+
+		*index = extended;
+		*size += ARCHIVE_INDEX_ALLOCATION;
+	}
+
+	(*index)[*count].date = date;
+	(*index)[*count].entry = entry;
+	(*index)[*count].offset = offset;
+
+	(*count)++;
+
+	return TRUE;
+}
+
+
+/**
+ * Read a line from an archive segment, removing the line ending.
+ *
+ * \param *handle		The handle of the file to read from.
+ * \param *line			Pointer to a buffer to take the line.
+ * \param length		The length of the supplied buffer.
+ * \return			TRUE if a line was read; FALSE at the end of
+ *				the file.
+ */
+
+static osbool archive_read_line(FILE *handle, char *line, size_t length)
+{
+	size_t	end;
+
+	if (fgets(line, length, handle) == NULL)
+		return FALSE;
+
+	end = strlen(line);
+
+	while (end > 0 && (line[end - 1] == '\n' || line[end - 1] == '\r'))
+		line[--end] = '\0';
+
+	return TRUE;
+}
+
+
+/**
+ * Split an archive segment line in the form "Token: Value" into its token
+ * and value, by terminating the token in place.
+ *
+ * \param *line			The line to be split.
+ * \return			Pointer to the value, or NULL if the line does
+ *				not contain one.
+ */
+
+static char *archive_split_line(char *line)
+{
+	char	*value;
+
+	value = strstr(line, ": ");
+	if (value == NULL || *line == '#' || *line == '[')
+		return NULL;
+
+	*value = '\0';
+
+	return value + 2;
+}
+
+
+/**
+ * Read the next hexadecimal field from a comma-separated list, and step on
+ * to the field which follows it.
+ *
+ * \param **field		Pointer to a pointer to the field to read.
+ * \return			The value of the field, or 0 if none remain.
+ */
+
+static unsigned archive_next_field(char **field)
+{
+	unsigned	value;
+	char		*end;
+
+	if (field == NULL || *field == NULL || **field == '\0')
+		return 0;
+
+	value = (unsigned) strtoul(*field, &end, 16);
+
+	*field = (*end == ',') ? end + 1 : end;
+
+	return value;
+}
+
+
+/**
+ * Find the summary for an account in an archive segment, by the segment's
+ * account number.
+ *
+ * \param *segment		The segment to search.
+ * \param account		The segment account number to find.
+ * \return			Pointer to the account's summary, or NULL.
+ */
+
+static struct archive_account *archive_find_account(struct archive_segment *segment, int account)
+{
+	int	low, high, middle;
+
+	if (segment == NULL || segment->accounts == NULL)
+		return NULL;
+
+	/* The summaries are written in account order. */
+
+	low = 0;
+	high = segment->account_count - 1;
+
+	while (low <= high) {
+		middle = (low + high) / 2;
+
+		if (segment->accounts[middle].account == account)
+			return segment->accounts + middle;
+		else if (segment->accounts[middle].account < account)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Reset an archive segment seal, ready to start a new segment.
+ *
+ * \param *seal			The seal to reset.
+ */
+
+static void archive_reset_seal(struct archive_seal *seal)
+{
+	seal->low = 1;
+	seal->high = 0;
+}
+
+
+/**
+ * Add a line, and the line ending which follows it, to an archive segment
+ * seal.
+ *
+ * \param *seal			The seal to update.
+ * \param *line			The line to add.
+ */
+
+static void archive_update_seal(struct archive_seal *seal, char *line)
+{
+	do {
+		seal->low = (seal->low + (unsigned char) ((*line != '\0') ? *line : '\n')) % ARCHIVE_SEAL_MODULUS;
+		seal->high = (seal->high + seal->low) % ARCHIVE_SEAL_MODULUS;
+	} while (*line++ != '\0');
+}
+
+
+/**
+ * Return the value of an archive segment seal.
+ *
+ * \param *seal			The seal to read.
+ * \return			The value of the seal.
+ */
+
+static unsigned archive_get_seal(struct archive_seal *seal)
+{
+	return (seal->high << 16) | seal->low;
+}
+
+
@@ -0,0 +1,242 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: archive.h
+ *
+ * Transaction archive segment interface.
+ */
+
+#ifndef CASHBOOK_ARCHIVE
+#define CASHBOOK_ARCHIVE
+
+#include <stdio.h>
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+#include "filing.h"
+#include "transact.h"
+
+/**
+ * A file's transaction archive instance handle.
+ */
+
+struct archive_block;
+
+/**
+ * An archive segment writer instance handle.
+ */
+
+struct archive_writer;
+
+/**
+ * An open archive segment handle.
+ */
+
+struct archive_segment;
+
+/**
+ * A transaction read back from an archive segment. The accounts are the
+ * segment's own account numbers, which can be looked up with
+ * archive_get_account_ident() and archive_get_account_name().
+ */
+
+struct archive_transaction {
+	date_t			date;						/**< The date of the transaction.			*/
+	enum transact_flags	flags;						/**< The transaction's flags.				*/
+	int			from;						/**< The segment account transferred from.		*/
+	int			to;						/**< The segment account transferred to.		*/
+	amt_t			amount;						/**< The amount transferred.				*/
+	char			reference[TRANSACT_REF_FIELD_LEN];		/**< The transaction reference.			*/
+	char			description[TRANSACT_DESCRIPT_FIELD_LEN];	/**< The transaction description.			*/
+};
+
+
+/**
+ * Create a new transaction archive instance.
+ *
+ * \param *file			The file to attach the instance to.
+ * \return			The instance handle, or NULL on failure.
+ */
+
+struct archive_block *archive_create_instance(struct file_block *file);
+
+
+/**
+ * Delete a transaction archive instance. Any segments which are still
+ * waiting for the file to be saved are removed.
+ *
+ * \param *instance		The instance to be deleted.
+ */
+
+void archive_delete_instance(struct archive_block *instance);
+
+
+/**
+ * Start a new archive segment for a file. The segment is written to a
+ * scrap file, and is only placed next to the file when it is saved.
+ *
+ * \param *file			The file to archive transactions from.
+ * \param cutoff		The date before which transactions are archived,
+ *				or NULL_DATE if there is no cutoff.
+ * \return			The new writer handle, or NULL on failure.
+ */
+
+struct archive_writer *archive_begin_segment(struct file_block *file, date_t cutoff);
+
+
+/**
+ * Add a transaction to an archive segment which is being written.
+ *
+ * \param *writer		The archive segment writer to add to.
+ * \param date			The date of the transaction.
+ * \param from			The account transferred from.
+ * \param to			The account transferred to.
+ * \param flags			The transaction's flags.
+ * \param amount		The amount transferred.
+ * \param *reference		The transaction reference.
+ * \param *description		The transaction description.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool archive_add_transaction(struct archive_writer *writer, date_t date, acct_t from, acct_t to, enum transact_flags flags,
+		amt_t amount, char *reference, char *description);
+
+
+/**
+ * Complete an archive segment, sealing it and reading it back to check
+ * that it is intact. If all is well, the segment is held against the file
+ * until it is next saved; if not, it is removed again. Either way, the
+ * writer is freed.
+ *
+ * \param *writer		The archive segment writer to complete.
+ * \return			TRUE if the segment was sealed; else FALSE.
+ */
+
+osbool archive_end_segment(struct archive_writer *writer);
+
+
+/**
+ * Place any archive segments which are waiting for a file to be saved
+ * next to the file's new location on disc. This must be done before the
+ * file itself is written, so that the file can record the segments.
+ *
+ * \param *file			The file being saved.
+ * \param *filename		The filename that the file is being saved to.
+ * \return			TRUE if successful; FALSE if the segments could
+ *				not be saved, in which case the file shouldn't be.
+ */
+
+osbool archive_save_segments(struct file_block *file, char *filename);
+
+
+/**
+ * Save the details of a file's archive segments to a CashBook file.
+ *
+ * \param *file			The file to write.
+ * \param *out			The file handle to write to.
+ */
+
+void archive_write_file(struct file_block *file, FILE *out);
+
+
+/**
+ * Read the details of a file's archive segments from a CashBook file.
+ *
+ * \param *file			The file to read in to.
+ * \param *in			The filing handle to read in from.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool archive_read_file(struct file_block *file, struct filing_block *in);
+
+
+/**
+ * Return the ident of one of the accounts in an archive segment.
+ *
+ * \param *segment		The segment to interrogate.
+ * \param account		The segment account to look up.
+ * \return			Pointer to the account ident, or "".
+ */
+
+char *archive_get_account_ident(struct archive_segment *segment, int account);
+
+
+/**
+ * Return the name of one of the accounts in an archive segment.
+ *
+ * \param *segment		The segment to interrogate.
+ * \param account		The segment account to look up.
+ * \return			Pointer to the account name, or "".
+ */
+
+char *archive_get_account_name(struct archive_segment *segment, int account);
+
+
+/**
+ * Read the archived transactions belonging to a file which fall between two
+ * dates, passing each in turn to a callback function. The date index of each
+ * segment is used to skip straight to the first transaction of interest.
+ * Undated transactions are only included if there is no last date.
+ * Segments which are missing, or whose seal is broken, are skipped.
+ *
+ * \param *file			The file whose archive is to be read.
+ * \param from			The first date to read, or NULL_DATE for the
+ *				start of the archive.
+ * \param to			The last date to read, or NULL_DATE for the
+ *				end of the archive.
+ * \param *callback		The function to call for each transaction; it
+ *				should return FALSE to stop reading.
+ * \param *data			Client data to pass to the callback function.
+ * \return			The number of transactions passed to the
+ *				callback.
+ */
+
+int archive_read_transactions(struct file_block *file, date_t from, date_t to,
+		osbool (*callback)(struct archive_segment *segment, struct archive_transaction *transaction, void *data), void *data);
+
+
+/**
+ * Add up the archived transactions belonging to a file which fall between
+ * two dates, adding the net amount transferred into each of the file's
+ * accounts to a set of totals. Segments which lie wholly within the dates
+ * are taken from their account summaries, while the date index is used to
+ * read just the parts of any others which are required. Accounts are
+ * matched to those in the file by their idents.
+ *
+ * \param *file			The file whose archive is to be read.
+ * \param from			The first date to include, or NULL_DATE for the
+ *				start of the archive.
+ * \param to			The last date to include, or NULL_DATE for the
+ *				end of the archive.
+ * \param *totals		The totals to add to, indexed by account.
+ * \param count			The number of entries in the totals array.
+ * \return			The number of archived transactions included.
+ */
+
+int archive_get_account_totals(struct file_block *file, date_t from, date_t to, amt_t *totals, acct_t count);
+
+#endif
+
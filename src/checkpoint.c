@@ -0,0 +1,493 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: checkpoint.c
+ *
+ * Periodic account balance checkpoints.
+ *
+ * A checkpoint records the total of the transactions into and out of every
+ * account in a file, up to the end of a given date, along with the number
+ * of transactions which that covers once the file is in date order. The
+ * checkpoints are placed on date boundaries, so the set of transactions
+ * before each one is not affected by sorting, and are spaced a number of
+ * transactions apart. Balances can then be found by starting from the
+ * nearest checkpoint and only walking the transactions since.
+ *
+ * Checkpoints are added as balances are requested, and discarded from the
+ * date of any transaction which is changed onwards.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files */
+
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/debug.h"
+#include "sflib/heap.h"
+
+/* Application header files */
+
+#include "global.h"
+#include "checkpoint.h"
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+#include "transact.h"
+
+/**
+ * The smallest number of transactions between checkpoints.
+ */
+
+#define CHECKPOINT_MIN_SPACING 256
+
+/**
+ * The number of checkpoints to allocate space for at a time.
+ */
+
+#define CHECKPOINT_ALLOCATION 16
+
+/**
+ * A single balance checkpoint.
+ */
+
+struct checkpoint_entry {
+	date_t			date;			/**< The last date covered by the checkpoint.			*/
+	tran_t			transaction;		/**< The number of transactions covered, in date order.		*/
+};
+
+/**
+ * A Balance Checkpoint instance.
+ */
+
+struct checkpoint_block {
+	struct file_block	*file;			/**< The file to which the instance belongs.			*/
+
+	struct checkpoint_entry	*entries;		/**< The checkpoints, in date order.				*/
+	amt_t			*balances;		/**< The account totals, account_count for each checkpoint.	*/
+	int			entry_count;		/**< The number of valid checkpoints.				*/
+	int			entry_size;		/**< The number of checkpoints space is allocated for.		*/
+
+	int			account_count;		/**< The number of accounts covered by each checkpoint.		*/
+	int			spacing;		/**< The number of transactions between checkpoints.		*/
+};
+
+/* Static Function Prototypes. */
+
+static void checkpoint_reset(struct checkpoint_block *instance, int accounts);
+static int checkpoint_find_entry(struct checkpoint_block *instance, date_t date);
+static osbool checkpoint_add_entry(struct checkpoint_block *instance, date_t date, tran_t transaction, amt_t *balances);
+static void checkpoint_add_transaction(struct file_block *file, tran_t transaction, amt_t *balances, int count);
+
+
+/**
+ * Create a new Balance Checkpoint instance.
+ *
+ * \param *file			The file to attach the instance to.
+ * \return			The instance handle, or NULL on failure.
+ */
+
+struct checkpoint_block *checkpoint_create_instance(struct file_block *file)
+{
+	struct checkpoint_block	*new;
+
+	new = heap_alloc(sizeof(struct checkpoint_block));
+	if (new == NULL)
+		return NULL;
+
+	new->file = file;
+
+	new->entries = NULL;
+	new->balances = NULL;
+	new->entry_count = 0;
+	new->entry_size = 0;
+
+	new->account_count = 0;
+	new->spacing = CHECKPOINT_MIN_SPACING;
+
+	return new;
+}
+
+
+/**
+ * Delete a Balance Checkpoint instance, and all of its data.
+ *
+ * \param *instance		The instance to be deleted.
+ */
+
+void checkpoint_delete_instance(struct checkpoint_block *instance)
+{
+	if (instance == NULL)
+		return;
+
+	checkpoint_reset(instance, 0);
+
+	heap_free(instance);
+}
+
+
+/**
+ * Discard any checkpoints which cover transactions on or after a given
+ * date, because a transaction on that date has been changed.
+ *
+ * \param *instance		The instance to update.
+ * \param date			The date of the changed transaction.
+ */
+
+void checkpoint_invalidate(struct checkpoint_block *instance, date_t date)
+{
+	int	entry;
+
+	if (instance == NULL || instance->entry_count == 0)
+		return;
+
+	/* Keep only the checkpoints which end before the date. A checkpoint
+	 * never covers NULL_DATE, so changes to undated transactions leave
+	 * everything in place.
+	 */
+
+	entry = checkpoint_find_entry(instance, date);
+
+	if (entry >= 0 && instance->entries[entry].date == date)
+		entry--;
+
+	instance->entry_count = entry + 1;
+}
+
+
+/**
+ * Discard all of the checkpoints held by an instance.
+ *
+ * \param *instance		The instance to update.
+ */
+
+void checkpoint_invalidate_all(struct checkpoint_block *instance)
+{
+	if (instance == NULL)
+		return;
+
+	instance->entry_count = 0;
+}
+
+
+/**
+ * Calculate the total of the transactions into and out of each account in
+ * a file, up to and including a given date. Opening balances are not
+ * included. The calculation starts from the nearest checkpoint, adding
+ * new checkpoints along the way if it runs past the last one.
+ *
+ * \param *instance		The instance to use.
+ * \param date			The last date to include, or NULL_DATE for all.
+ * \param *balances		Pointer to an array to take the totals.
+ * \param count			The number of entries in the array, which must
+ *				match the number of accounts in the file.
+ * \return			The number of transactions included in the
+ *				totals, or -1 on failure.
+ */
+
+int checkpoint_get_balances(struct checkpoint_block *instance, date_t date, amt_t *balances, int count)
+{
+	int	entry, transaction_count, since = 0;
+	tran_t	transaction;
+	date_t	current, previous = NULL_DATE;
+	osbool	extend;
+
+	if (instance == NULL || instance->file == NULL || balances == NULL || count != account_get_count(instance->file))
+		return -1;
+
+	/* If accounts have been added or removed, the checkpoints no longer
+	 * line up with them.
+	 */
+
+	if (count != instance->account_count)
+		checkpoint_reset(instance, count);
+
+	transact_sort_file_data(instance->file);
+
+	/* Start from the last checkpoint on or before the date, or from the
+	 * start of the file if there isn't one.
+	 */
+
+	entry = checkpoint_find_entry(instance, date);
+
+	if (entry >= 0) {
+		memcpy(balances, instance->balances + (entry * count), sizeof(amt_t) * count);
+		transaction = instance->entries[entry].transaction;
+	} else {
+		memset(balances, 0, sizeof(amt_t) * count);
+		transaction = 0;
+	}
+
+	/* If we're beyond the last checkpoint, add more as we go. */
+
+	extend = (entry == instance->entry_count - 1) ? TRUE : FALSE;
+
+	transaction_count = transact_get_count(instance->file);
+
+	for (; transaction < transaction_count; transaction++) {
+		current = transact_get_date(instance->file, transaction);
+
+		if (date != NULL_DATE && current > date)
+			break;
+
+		if (extend && since >= instance->spacing && current != previous) {
+			extend = checkpoint_add_entry(instance, previous, transaction, balances);
+			since = 0;
+		}
+
+		checkpoint_add_transaction(instance->file, transaction, balances, count);
+
+		previous = current;
+		since++;
+	}
+
+	return transaction;
+}
+
+
+/**
+ * Check all of the checkpoints held by an instance against the totals
+ * calculated afresh from the start of the file. If any disagree, all of
+ * the checkpoints are discarded.
+ *
+ * \param *instance		The instance to check.
+ * \return			TRUE if the checkpoints were consistent; else FALSE.
+ */
+
+osbool checkpoint_verify(struct checkpoint_block *instance)
+{
+	amt_t	*balances;
+	int	entry = 0, transaction_count, count;
+	tran_t	transaction;
+	osbool	consistent = TRUE;
+	date_t	date;
+
+	if (instance == NULL || instance->file == NULL || instance->entry_count == 0)
+		return TRUE;
+
+	count = account_get_count(instance->file);
+
+	if (count != instance->account_count) {
+		checkpoint_reset(instance, count);
+		return TRUE;
+	}
+
+	balances = heap_alloc(sizeof(amt_t) * count);
+	if (balances == NULL)
+		return TRUE;
+
+	memset(balances, 0, sizeof(amt_t) * count);
+
+	transact_sort_file_data(instance->file);
+
+	transaction_count = transact_get_count(instance->file);
+
+	/* Walk the whole file, checking that each checkpoint sits on a date
+	 * boundary at the end of its date, and that its totals match.
+	 */
+
+	for (transaction = 0; transaction <= transaction_count && entry < instance->entry_count; transaction++) {
+		while (entry < instance->entry_count && instance->entries[entry].transaction == transaction) {
+			date = instance->entries[entry].date;
+
+			if (transaction == 0 || transact_get_date(instance->file, transaction - 1) != date ||
+					(transaction < transaction_count && transact_get_date(instance->file, transaction) <= date) ||
+					memcmp(balances, instance->balances + (entry * count), sizeof(amt_t) * count) != 0) {
+				#ifdef DEBUG
+				debug_printf("\\RBalance checkpoint %d at transaction %d is inconsistent", entry, transaction);
+				#endif
+
+				consistent = FALSE;
+			}
+
+			entry++;
+		}
+
+		if (transaction < transaction_count)
+			checkpoint_add_transaction(instance->file, transaction, balances, count);
+	}
+
+	if (entry < instance->entry_count)
+		consistent = FALSE;
+
+	heap_free(balances);
+
+	if (!consistent)
+		checkpoint_invalidate_all(instance);
+
+	return consistent;
+}
+
+
+/**
+ * Discard all of the checkpoints held by an instance, and set it up for a
+ * given number of accounts.
+ *
+ * \param *instance		The instance to reset.
+ * \param accounts		The number of accounts to be covered.
+ */
+
+static void checkpoint_reset(struct checkpoint_block *instance, int accounts)
+{
+	if (instance == NULL)
+		return;
+
+	if (instance->entries != NULL)
+		heap_free(instance->entries);
+
+	if (instance->balances != NULL)
+		heap_free(instance->balances);
+
+	instance->entries = NULL;
+	instance->balances = NULL;
+	instance->entry_count = 0;
+	instance->entry_size = 0;
+
+	/* Copying the totals into a checkpoint costs about as much as walking
+	 * one transaction per account, so keep the checkpoints at least that
+	 * far apart.
+	 */
+
+	instance->account_count = accounts;
+	instance->spacing = (accounts > CHECKPOINT_MIN_SPACING) ? accounts : CHECKPOINT_MIN_SPACING;
+}
+
+
+/**
+ * Find the last checkpoint covering a date or earlier.
+ *
+ * \param *instance		The instance to search.
+ * \param date			The date to search for.
+ * \return			The index of the checkpoint, or -1 if none.
+ */
+
+static int checkpoint_find_entry(struct checkpoint_block *instance, date_t date)
+{
+	int	low, high, middle;
+
+	if (instance == NULL)
+		return -1;
+
+	low = 0;
+	high = instance->entry_count - 1;
+
+	while (low <= high) {
+		middle = (low + high) / 2;
+
+		if (instance->entries[middle].date <= date)
+			low = middle + 1;
+		else
+			high = middle - 1;
+	}
+
+	return high;
+}
+
+
+/**
+ * Add a new checkpoint to the end of an instance.
+ *
+ * \param *instance		The instance to add the checkpoint to.
+ * \param date			The last date covered by the checkpoint.
+ * \param transaction		The number of transactions covered.
+ * \param *balances		The account totals at the checkpoint.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool checkpoint_add_entry(struct checkpoint_block *instance, date_t date, tran_t transaction, amt_t *balances)
+{
+	struct checkpoint_entry	*entries;
+	amt_t			*totals;
+	int			size;
+
+	if (instance == NULL || instance->account_count <= 0 || date == NULL_DATE)
+		return FALSE;
+
+	if (instance->entry_count >= instance->entry_size) {
+		size = instance->entry_size + CHECKPOINT_ALLOCATION;
+
+		if (instance->entries == NULL)
+			entries = heap_alloc(sizeof(struct checkpoint_entry) * size);
+		else
+			entries = heap_extend(instance->entries, sizeof(struct checkpoint_entry) * size);
+
+		if (entries == NULL)
+			return FALSE;
+
+		instance->entries = entries;
+
+		if (instance->balances == NULL)
+			totals = heap_alloc(sizeof(amt_t) * instance->account_count * size);
+		else
+			totals = heap_extend(instance->balances, sizeof(amt_t) * instance->account_count * size);
+
+		if (totals == NULL)
+			return FALSE;
+
+		instance->balances = totals;
+		instance->entry_size = size;
+	}
+
+	instance->entries[instance->entry_count].date = date;
+	instance->entries[instance->entry_count].transaction = transaction;
+	memcpy(instance->balances + (instance->entry_count * instance->account_count), balances, sizeof(amt_t) * instance->account_count);
+
+	instance->entry_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Add a transaction's effect on the accounts to a set of totals.
+ *
+ * \param *file			The file containing the transaction.
+ * \param transaction		The transaction to add.
+ * \param *balances		The account totals to update.
+ * \param count			The number of accounts in the totals.
+ */
+
+static void checkpoint_add_transaction(struct file_block *file, tran_t transaction, amt_t *balances, int count)
+{
+	acct_t	from, to;
+	amt_t	amount;
+
+	from = transact_get_from(file, transaction);
+	to = transact_get_to(file, transaction);
+	amount = transact_get_amount(file, transaction);
+
+	if (from != NULL_ACCOUNT && from >= 0 && from < count)
+		balances[from] -= amount;
+
+	if (to != NULL_ACCOUNT && to >= 0 && to < count)
+		balances[to] += amount;
+}
+
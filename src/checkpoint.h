@@ -0,0 +1,115 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: checkpoint.h
+ *
+ * Periodic account balance checkpoints.
+ */
+
+#ifndef CASHBOOK_CHECKPOINT
+#define CASHBOOK_CHECKPOINT
+
+#include "oslib/types.h"
+
+#include "currency.h"
+#include "date.h"
+
+/**
+ * A Balance Checkpoint instance handle.
+ */
+
+struct checkpoint_block;
+
+
+/**
+ * Create a new Balance Checkpoint instance.
+ *
+ * \param *file			The file to attach the instance to.
+ * \return			The instance handle, or NULL on failure.
+ */
+
+struct checkpoint_block *checkpoint_create_instance(struct file_block *file);
+
+
+/**
+ * Delete a Balance Checkpoint instance, and all of its data.
+ *
+ * \param *instance		The instance to be deleted.
+ */
+
+void checkpoint_delete_instance(struct checkpoint_block *instance);
+
+
+/**
+ * Discard any checkpoints which cover transactions on or after a given
+ * date, because a transaction on that date has been changed.
+ *
+ * \param *instance		The instance to update.
+ * \param date			The date of the changed transaction.
+ */
+
+void checkpoint_invalidate(struct checkpoint_block *instance, date_t date);
+
+
+/**
+ * Discard all of the checkpoints held by an instance.
+ *
+ * \param *instance		The instance to update.
+ */
+
+void checkpoint_invalidate_all(struct checkpoint_block *instance);
+
+
+/**
+ * Calculate the total of the transactions into and out of each account in
+ * a file, up to and including a given date. Opening balances are not
+ * included. The calculation starts from the nearest checkpoint, adding
+ * new checkpoints along the way if it runs past the last one.
+ *
+ * \param *instance		The instance to use.
+ * \param date			The last date to include, or NULL_DATE for all.
+ * \param *balances		Pointer to an array to take the totals.
+ * \param count			The number of entries in the array, which must
+ *				match the number of accounts in the file.
+ * \return			The number of transactions included in the
+ *				totals, or -1 on failure.
+ */
+
+int checkpoint_get_balances(struct checkpoint_block *instance, date_t date, amt_t *balances, int count);
+
+
+/**
+ * Check all of the checkpoints held by an instance against the totals
+ * calculated afresh from the start of the file. If any disagree, all of
+ * the checkpoints are discarded.
+ *
+ * \param *instance		The instance to check.
+ * \return			TRUE if the checkpoints were consistent; else FALSE.
+ */
+
+osbool checkpoint_verify(struct checkpoint_block *instance);
+
+#endif
+
@@ -62,6 +62,7 @@
 #include "date.h"
 #include "file.h"
 #include "fontlist.h"
+#include "report.h"
 
 
 /* Pane numbers */
@@ -951,6 +952,10 @@ static void choices_read_window(void)
 	date_initialise();
 	currency_initialise();
 
+	/* Any cached reports were formatted with the old settings. */
+
+	file_process_all(report_flush_cache);
+
 	/* Redraw windows as required. */
 
 	file_process_all(file_redraw_windows);
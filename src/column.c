@@ -573,16 +573,17 @@ void columns_export_heading_names(struct column_block *instance, wimp_w window,
  *
  * \param *instance		The column instance to be processed.
  * \param window		The handle of the window holding the heading icons.
+ * \param *output		The stringbuild instance to write the names to.
  */
 
-void columns_print_heading_names(struct column_block *instance, wimp_w window)
+void columns_print_heading_names(struct column_block *instance, wimp_w window, struct stringbuild_block *output)
 {
 	wimp_icon_state		state;
 	int			column;
 	wimp_i			icon = wimp_ICON_WINDOW;
 	osbool			first = TRUE;
 
-	if (instance == NULL || window == NULL)
+	if (instance == NULL || window == NULL || output == NULL)
 		return;
 
 	/* Write out the column heading names, using the icon text. */
@@ -593,7 +594,7 @@ void columns_print_heading_names(struct column_block *instance, wimp_w window)
 		 */
 
 		if (instance->map[column].heading == icon && icon != wimp_ICON_WINDOW) {
-			stringbuild_add_string("\\t\\s");
+			stringbuild_add_string(output, "\\t\\s");
 			continue;
 		}
 
@@ -608,15 +609,15 @@ void columns_print_heading_names(struct column_block *instance, wimp_w window)
 		 */
 
 		if (first == TRUE)
-			stringbuild_add_string("\\k");
+			stringbuild_add_string(output, "\\k");
 		else
-			stringbuild_add_string("\\v\\t");
+			stringbuild_add_string(output, "\\v\\t");
 
 		first = FALSE;
 
 		/* Headings are Bold and Underlined. */
 
-		stringbuild_add_string("\\b\\o");
+		stringbuild_add_string(output, "\\b\\o");
 
 		/* If the icon is right-aligned, so is the heading. */
 
@@ -625,16 +626,16 @@ void columns_print_heading_names(struct column_block *instance, wimp_w window)
 		wimp_get_icon_state(&state);
 
 		if (state.icon.flags & wimp_ICON_RJUSTIFIED)
-			stringbuild_add_string("\\r");
+			stringbuild_add_string(output, "\\r");
 		else if (state.icon.flags & wimp_ICON_HCENTRED)
-			stringbuild_add_string("\\c");
+			stringbuild_add_string(output, "\\c");
 
 		/* Copy the icon text for the heading. */
 
-		stringbuild_add_icon(window, icon);
+		stringbuild_add_icon(output, window, icon);
 	}
 
-	stringbuild_add_string("\\v");
+	stringbuild_add_string(output, "\\v");
 }
 
 
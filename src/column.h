@@ -33,6 +33,7 @@
 #include <stddef.h>
 #include "filing.h"
 #include "sort.h"
+#include "stringbuild.h"
 
 #define COLUMN_SORT_SPRITE_LEN 12
 
@@ -244,9 +245,10 @@ void columns_export_heading_names(struct column_block *instance, wimp_w window,
  *
  * \param *instance		The column instance to be processed.
  * \param window		The handle of the window holding the heading icons.
+ * \param *output		The stringbuild instance to write the names to.
  */
 
-void columns_print_heading_names(struct column_block *instance, wimp_w window);
+void columns_print_heading_names(struct column_block *instance, wimp_w window, struct stringbuild_block *output);
 
 
 /**
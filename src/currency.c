@@ -29,14 +29,15 @@
 
 /* ANSI C header files */
 
+#include <ctype.h>
 #include <string.h>
 #include <stdlib.h>
-#include <math.h>
 
 /* Acorn C header files */
 
 /* OSLib header files */
 
+#include "oslib/os.h"
 #include "oslib/territory.h"
 
 /* SF-Lib header files. */
@@ -59,18 +60,72 @@
 #define CURRENCY_MAX_DIGITS 9
 
 /**
- * The maximum string length that can be converted into an amount value, which
- * sets the size of the working buffer.
+ * The maximum string length that can be converted into an amount value,
+ * including the leading zero which is implied before the digits.
  */
 
 #define CURRENCY_MAX_CONVERSION_LENGTH 256
 
 /**
- * The length of a format string generated by the conversion to a string
- * value.
+ * The size of the working buffer used to assemble the digits of a value
+ * when converting it into a string.
  */
 
-#define CURRENCY_FORMAT_LENGTH 20
+#define CURRENCY_DIGIT_BUFFER_LENGTH 20
+
+/**
+ * Powers of ten, for shifting values into and out of the decimal places.
+ */
+
+static const int currency_powers_of_ten[CURRENCY_MAX_DIGITS + 1] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+/**
+ * Pairs of digits for the values 00 to 99, allowing conversions to text to
+ * be done two digits at a time.
+ */
+
+static const char currency_digit_pairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+#ifdef DEBUG
+
+/**
+ * The size of the buffers used by currency_verify_conversions(), which
+ * must be large enough for the longest possible conversion.
+ */
+
+#define CURRENCY_VERIFY_BUFFER_LENGTH 24
+
+/**
+ * The number of times that the conversions checked by
+ * currency_verify_conversions() are repeated when timing them.
+ */
+
+#define CURRENCY_VERIFY_TIMING_PASSES 20
+
+/**
+ * The amounts checked by currency_verify_conversions(), covering zero, the
+ * boundaries of the digit pairs and the largest values that fit.
+ */
+
+static const amt_t currency_verify_amounts[] = {
+	0, 1, -1, 5, -5, 9, 10, -10, 99, -99, 100, -100, 101, 999, 1000, -1000,
+	12345, -12345, 100000, 654321, -654321, 1000000, 99999999, -99999999,
+	123456789, -123456789, 999999999, -999999999
+};
+
+#endif
 
 
 /**
@@ -83,6 +138,16 @@ static char	currency_decimal_point = '.';					/**< The symbol used to represent
 static osbool	currency_print_zeros = FALSE;					/**< Should zero values be converted to digits or a blank space?		*/
 static osbool	currency_bracket_negatives = FALSE;				/**< Should negative values be represented (1.23) instead of -1.23?		*/
 
+/**
+ * Static Function Prototypes
+ */
+
+static int	currency_parse_integer(char *string, size_t length);
+#ifdef DEBUG
+static void	currency_verify_conversions(void);
+static char	*currency_reference_convert_to_string(amt_t value, char *buffer, size_t length, osbool print_zeros);
+#endif
+
 
 /**
  * Initialise, or re-initialise, the currency module.
@@ -105,6 +170,17 @@ void currency_initialise(void)
 		currency_decimal_places = config_int_read("DecimalPlaces");
 		currency_bracket_negatives = config_opt_read("BracketNegatives");
 	}
+
+	/* An amt_t can't hold more decimal places than it has digits. */
+
+	if (currency_decimal_places < 0)
+		currency_decimal_places = 0;
+	else if (currency_decimal_places > CURRENCY_MAX_DIGITS)
+		currency_decimal_places = CURRENCY_MAX_DIGITS;
+
+#ifdef DEBUG
+	currency_verify_conversions();
+#endif
 }
 
 
@@ -130,10 +206,10 @@ char *currency_convert_to_string(amt_t value, char *buffer, size_t length)
  * Convert a currency amount into a string, placing the result into a
  * supplied buffer.
  *
- * \TODO -- +ve and -ve conversion strings could be created in _initialise()
- *          and referenced from here to save time on each conversion?
- *
- * \TODO -- Shouldn't the for() loop work on end and not i?
+ * The digits are generated directly into the buffer, two at a time, with the
+ * value being zero-padded to give at least one digit before the decimal
+ * point. If the buffer is too small to hold the result with its decimal
+ * point or brackets, an empty string is returned.
  *
  * \param value			The value to be converted.
  * \param *buffer		Pointer to a buffer to take the conversion.
@@ -146,8 +222,10 @@ char *currency_convert_to_string(amt_t value, char *buffer, size_t length)
 
 char *currency_flexible_convert_to_string(amt_t value, char *buffer, size_t length, osbool print_zeros)
 {
-	int	i, places, size;
-	char	*end, conversion[CURRENCY_FORMAT_LENGTH];
+	unsigned	magnitude, pair;
+	size_t		digits, size, whole;
+	osbool		negative, brackets;
+	char		*out, *ptr, *end, conversion[CURRENCY_DIGIT_BUFFER_LENGTH];
 
 	if (buffer == NULL || length <= 0)
 		return NULL;
@@ -161,65 +239,97 @@ char *currency_flexible_convert_to_string(amt_t value, char *buffer, size_t leng
 		return buffer;
 	}
 
-	/* Convert the integer value into a string. The calculated conversion
-	 * string forces a zero for each decimal place plus one extra, to
-	 * give us all the actual digits required to turn into a human-
-	 * readable number. eg. For 2 decimal places, 0 would become 000 so
-	 * that a decimal point can be inserted to give 0.00
-	 *
-	 * Negative numbers need an additional place in the format string,
-	 * as the - sign takes up one of the 'digits' in sprintf().
+	/* Convert the magnitude of the value into digits, working back from
+	 * the end of the conversion buffer two digits at a time.
 	 */
 
-	places = currency_decimal_places + 1;
-	string_printf(conversion, CURRENCY_FORMAT_LENGTH, "%%0%1dd", places + ((value < 0) ? 1 : 0));
+	negative = (value < 0) ? TRUE : FALSE;
+	magnitude = (negative) ? -((unsigned) value) : (unsigned) value;
 
-	/* Print the number to the buffer and find the end. */
+	end = conversion + CURRENCY_DIGIT_BUFFER_LENGTH;
+	ptr = end;
 
-	string_printf(buffer, length, conversion, value);
-	size = strlen(buffer);
-	end = buffer + size;
+	while (magnitude >= 100) {
+		pair = (magnitude % 100) * 2;
+		magnitude /= 100;
+		*(--ptr) = currency_digit_pairs[pair + 1];
+		*(--ptr) = currency_digit_pairs[pair];
+	}
+
+	if (magnitude >= 10) {
+		pair = magnitude * 2;
+		*(--ptr) = currency_digit_pairs[pair + 1];
+		*(--ptr) = currency_digit_pairs[pair];
+	} else {
+		*(--ptr) = '0' + magnitude;
+	}
 
-	/* If there is a decimal point, shuffle the higher digits up one to
-	 * make room and insert it.
+	/* Pad with zeros to give one digit for each decimal place plus one
+	 * extra, so that 0 becomes 000 at 2 decimal places and a decimal
+	 * point can be inserted to give 0.00.
 	 */
 
-	if (places > 1) {
-		/* If the string just fits the supplied buffer without a decimal
-		 * point, we can't add one so just return an empty string.
-		 */
+	while ((end - ptr) < currency_decimal_places + 1)
+		*(--ptr) = '0';
 
+	digits = end - ptr;
+
+	/* Work out how much of the result will fit into the buffer. If there
+	 * is a decimal point or bracket to add and the digits fill the
+	 * buffer, the result is left empty.
+	 */
+
+	size = digits + ((negative) ? 1 : 0);
+	if (size >= length)
+		size = length - 1;
+
+	if (currency_decimal_places > 0) {
 		if (size + 1 >= length) {
 			*buffer = '\0';
 			return buffer;
 		}
 
-		for (i = 1; i <= places; i++) {
-			*(end + 1) = *end;
-			end--;
-		}
+		size++;
+	}
 
-		*(++end) = currency_decimal_point;
+	brackets = (currency_bracket_negatives && negative && size > 0) ? TRUE : FALSE;
 
-		size++;
+	if (brackets && (size + 1 >= length)) {
+		*buffer = '\0';
+		return buffer;
 	}
 
-	/* If () is to be used for -ve numbers, replace the - */
+	/* Copy the sign and digits into the buffer, inserting the decimal
+	 * point if required.
+	 */
 
-	if (currency_bracket_negatives && *buffer == '-') {
-		/* If the string just fits the supplied buffer without a closing
-		 * bracket, we can't add one so just return an empty string.
-		 */
+	out = buffer;
 
-		if (size + 1 >= length) {
-			*buffer = '\0';
-			return buffer;
-		}
+	if (negative && size > 0) {
+		*out++ = (brackets) ? '(' : '-';
+		size--;
+	}
 
-		*buffer = '(';
-		strcat(buffer, ")");
+	if (currency_decimal_places > 0) {
+		whole = digits - currency_decimal_places;
+
+		while (whole-- > 0)
+			*out++ = *ptr++;
+
+		*out++ = currency_decimal_point;
+
+		while (ptr < end)
+			*out++ = *ptr++;
+	} else {
+		while (size-- > 0)
+			*out++ = *ptr++;
 	}
 
+	if (brackets)
+		*out++ = ')';
+
+	*out = '\0';
+
 	return buffer;
 }
 
@@ -228,6 +338,10 @@ char *currency_flexible_convert_to_string(amt_t value, char *buffer, size_t leng
  * Convert a string into a currency amount by brute force, based on the
  * configured settings, to ensure that accuracy is retained.
  *
+ * The string is scanned in place: the digits before the first '.' form the
+ * whole part, and those in the next group after it form the decimal part,
+ * truncated (without rounding) to the configured number of places.
+ *
  * \param *string		The string to be converted into a currency amount.
  * \return			The converted amount, or NULL_CURRENCY.
  */
@@ -235,8 +349,9 @@ char *currency_flexible_convert_to_string(amt_t value, char *buffer, size_t leng
 amt_t currency_convert_from_string(char *string)
 {
 	int	result, decimal;
+	size_t	length;
 	osbool	negative;
-	char	copy[CURRENCY_MAX_CONVERSION_LENGTH], *next;
+	char	*start, *end, *next;
 
 	if (string == NULL || *string == '\0')
 		return NULL_CURRENCY;
@@ -252,20 +367,20 @@ amt_t currency_convert_from_string(char *string)
 	else
 		negative = (*string == '-');
 
-	/* Take a copy of the string, with a leading zero so that values like
-	 * .01 work OK. If the value is negative, then start one character in
-	 * to skip the leading '-' or '('.
+	/* If the value is negative, then start one character in to skip the
+	 * leading '-' or '('. Find the end of the usable text, allowing for
+	 * an implied leading zero so that values like .01 work OK.
 	 */
 
-	string_printf(copy, CURRENCY_MAX_CONVERSION_LENGTH, "0%s", (negative) ? string + 1 : string);
+	start = (negative) ? string + 1 : string;
 
-	/* Get the part of the string before the decimal place. If there isn't
-	 * one, then return with an invalid amount.
-	 */
+	for (end = start; *end != '\0' && (end - start) < CURRENCY_MAX_CONVERSION_LENGTH - 2; end++);
 
-	next = strtok(copy, ".");
-	if (next == NULL)
-		return NULL_CURRENCY;
+	/* Find the part of the string before the decimal place. */
+
+	for (next = start; next < end && *next != '.'; next++);
+
+	length = next - start;
 
 	/* Take the value from before the DP and convert it to an integer.
 	 *
@@ -273,39 +388,52 @@ amt_t currency_convert_from_string(char *string)
 	 * the result is value * 10^decimal_places to shift the value up out
 	 * of the way of the decimal part. If it isn't, then we just set the
 	 * value to the maximum possible (10^decimal_places - 1).
-	 *
-	 * Note that we add 1 to the available digits, to cover leading 0 we
-	 * added when copying the value.
 	 */
 
-	if ((strlen(next) + currency_decimal_places) <= CURRENCY_MAX_DIGITS + 1)
-		result = atoi(next) * pow(10, currency_decimal_places);
-	else
-		result = (1 * pow(10, CURRENCY_MAX_DIGITS - currency_decimal_places) - 1) * pow(10, currency_decimal_places);
+	if ((length + currency_decimal_places) <= CURRENCY_MAX_DIGITS) {
+		result = 0;
+
+		while (start < next && isdigit(*start))
+			result = (result * 10) + (*start++ - '0');
+
+		result *= currency_powers_of_ten[currency_decimal_places];
+	} else {
+		result = (currency_powers_of_ten[CURRENCY_MAX_DIGITS - currency_decimal_places] - 1) *
+				currency_powers_of_ten[currency_decimal_places];
+	}
 
-	/* Now see if there were any digits after the DP.  If there were,
-	 * these are now processed.
+	/* Now see if there were any digits after the DP, skipping over any
+	 * repeated points. If there were, these are now processed.
 	 */
 
-	next = strtok(NULL, ".");
-	if (currency_decimal_places > 0 && next != NULL) {
+	while (next < end && *next == '.')
+		next++;
+
+	start = next;
+
+	while (next < end && *next != '.')
+		next++;
+
+	length = next - start;
+
+	if (currency_decimal_places > 0 && length > 0) {
 		/* If there were too many digits for the decimal part, truncate
 		 * to the required number and lose the precision. No rounding
 		 * is performed, so .119 would become .11 to 2dp. */
 
-		if (strlen(next) > currency_decimal_places)
-			next[currency_decimal_places] = '\0';
+		if (length > currency_decimal_places)
+			length = currency_decimal_places;
 
 		/* Convert the required digits into an int. */
 
-		decimal = atoi(next);
+		decimal = currency_parse_integer(start, length);
 
 		/* If there weren't enough digits, multiply by the required
 		 * power of 10 to shift the value into the correct place.
 		 */
 
-		if (strlen(next) < currency_decimal_places)
-			decimal *= pow (10, currency_decimal_places - strlen(next));
+		if (length < currency_decimal_places)
+			decimal *= currency_powers_of_ten[currency_decimal_places - length];
 
 		/* Add the decimal part on to the result. */
 
@@ -324,3 +452,175 @@ amt_t currency_convert_from_string(char *string)
 	return (amt_t) result;
 }
 
+
+/**
+ * Convert a fixed-length section of a string into an integer, following
+ * the same rules as atoi().
+ *
+ * \param *string		Pointer to the start of the text to convert.
+ * \param length		The number of characters to consider.
+ * \return			The converted value.
+ */
+
+static int currency_parse_integer(char *string, size_t length)
+{
+	char	*end = string + length;
+	int	result = 0;
+	osbool	negative = FALSE;
+
+	while (string < end && isspace(*string))
+		string++;
+
+	if (string < end && (*string == '-' || *string == '+'))
+		negative = (*string++ == '-');
+
+	while (string < end && isdigit(*string))
+		result = (result * 10) + (*string++ - '0');
+
+	return (negative) ? -result : result;
+}
+
+
+#ifdef DEBUG
+
+/**
+ * Check currency_flexible_convert_to_string() against a printf() based
+ * conversion for the amounts in currency_verify_amounts[], with every
+ * number of decimal places, both styles of negative value and every buffer
+ * length up to the longest result. Where negative values use a '-' and
+ * the decimal point is a '.', check that currency_convert_from_string()
+ * gives back the original amount from the full result. Any mismatches are written to the debug
+ * output, followed by the time taken by each conversion over
+ * CURRENCY_VERIFY_TIMING_PASSES passes.
+ */
+
+static void currency_verify_conversions(void)
+{
+	int	decimal_places, i, pass, failures = 0;
+	osbool	bracket_negatives, print_zeros;
+	amt_t	value, parsed;
+	size_t	length;
+	os_t	start, direct_time, printf_time;
+	char	direct[CURRENCY_VERIFY_BUFFER_LENGTH], reference[CURRENCY_VERIFY_BUFFER_LENGTH];
+
+	decimal_places = currency_decimal_places;
+	bracket_negatives = currency_bracket_negatives;
+
+	for (currency_decimal_places = 0; currency_decimal_places <= CURRENCY_MAX_DIGITS; currency_decimal_places++) {
+		for (currency_bracket_negatives = FALSE; currency_bracket_negatives <= TRUE; currency_bracket_negatives++) {
+			for (i = 0; i < sizeof(currency_verify_amounts) / sizeof(amt_t); i++) {
+				value = currency_verify_amounts[i];
+
+				for (print_zeros = FALSE; print_zeros <= TRUE; print_zeros++) {
+					for (length = 1; length <= CURRENCY_VERIFY_BUFFER_LENGTH; length++) {
+						currency_flexible_convert_to_string(value, direct, length, print_zeros);
+						currency_reference_convert_to_string(value, reference, length, print_zeros);
+
+						if (strcmp(direct, reference) != 0) {
+							debug_printf("\\RAmount %d at %d places (brackets %d, zeros %d, length %d) is '%s', not '%s'",
+									value, currency_decimal_places, currency_bracket_negatives, print_zeros, length, direct, reference);
+							failures++;
+						}
+					}
+				}
+
+				if (currency_bracket_negatives || currency_decimal_point != '.')
+					continue;
+
+				currency_flexible_convert_to_string(value, direct, CURRENCY_VERIFY_BUFFER_LENGTH, TRUE);
+				parsed = currency_convert_from_string(direct);
+
+				if (parsed != value) {
+					debug_printf("\\RAmount '%s' at %d places reads as %d, not %d", direct, currency_decimal_places, parsed, value);
+					failures++;
+				}
+			}
+		}
+	}
+
+	currency_decimal_places = decimal_places;
+	currency_bracket_negatives = bracket_negatives;
+
+	/* Time the two conversions over the same amounts with the active
+	 * settings.
+	 */
+
+	start = os_read_monotonic_time();
+
+	for (pass = 0; pass < CURRENCY_VERIFY_TIMING_PASSES; pass++) {
+		for (i = 0; i < sizeof(currency_verify_amounts) / sizeof(amt_t); i++)
+			currency_flexible_convert_to_string(currency_verify_amounts[i], direct, CURRENCY_VERIFY_BUFFER_LENGTH, TRUE);
+	}
+
+	direct_time = os_read_monotonic_time() - start;
+	start = os_read_monotonic_time();
+
+	for (pass = 0; pass < CURRENCY_VERIFY_TIMING_PASSES; pass++) {
+		for (i = 0; i < sizeof(currency_verify_amounts) / sizeof(amt_t); i++)
+			currency_reference_convert_to_string(currency_verify_amounts[i], reference, CURRENCY_VERIFY_BUFFER_LENGTH, TRUE);
+	}
+
+	printf_time = os_read_monotonic_time() - start;
+
+	debug_printf("Currency conversion checks complete, with %d failures; direct %dcs, printf %dcs", failures, direct_time, printf_time);
+}
+
+
+/**
+ * Convert a currency amount into a string using printf(), in the way that
+ * currency_flexible_convert_to_string() did before it generated the digits
+ * directly. This is used as a reference by currency_verify_conversions().
+ *
+ * \param value			The value to be converted.
+ * \param *buffer		Pointer to a buffer to take the conversion.
+ * \param length		The size of the supplied buffer, in bytes.
+ * \param print_zeros		TRUE to convert zero values as 0; FALSE to
+ *				return a blank string.
+ * \return			A pointer to the supplied buffer.
+ */
+
+static char *currency_reference_convert_to_string(amt_t value, char *buffer, size_t length, osbool print_zeros)
+{
+	int	i, places, size;
+	char	*end;
+
+	if (value == NULL_CURRENCY && !print_zeros) {
+		*buffer = '\0';
+		return buffer;
+	}
+
+	places = currency_decimal_places + 1;
+	string_printf(buffer, length, "%0*d", places + ((value < 0) ? 1 : 0), value);
+	size = strlen(buffer);
+	end = buffer + size;
+
+	if (places > 1) {
+		if (size + 1 >= length) {
+			*buffer = '\0';
+			return buffer;
+		}
+
+		for (i = 1; i <= places; i++) {
+			*(end + 1) = *end;
+			end--;
+		}
+
+		*(++end) = currency_decimal_point;
+
+		size++;
+	}
+
+	if (currency_bracket_negatives && *buffer == '-') {
+		if (size + 1 >= length) {
+			*buffer = '\0';
+			return buffer;
+		}
+
+		*buffer = '(';
+		strcat(buffer, ")");
+	}
+
+	return buffer;
+}
+
+#endif
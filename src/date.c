@@ -79,6 +79,13 @@
 
 #define DATE_CONVERT_BUFFER_LEN 64
 
+/**
+ * The size of the buffer used when converting a date into a string; large
+ * enough for the widest possible day, month and year values.
+ */
+
+#define DATE_FORMAT_BUFFER_LEN 16
+
 /**
  * The number of fields in a date (ie. day, month, year).
  */
@@ -181,6 +188,55 @@ static char			date_sep_in[DATE_SEP_LENGTH];			/**< A list of the characters usab
 
 static enum date_format		date_active_format;
 
+#ifdef DEBUG
+
+/**
+ * The number of occurrences to compare for each regular event checked by
+ * date_verify_occurrences().
+ */
+
+#define DATE_VERIFY_OCCURRENCES 24
+
+/**
+ * The number of times that the conversions checked by
+ * date_verify_conversions() are repeated when timing them.
+ */
+
+#define DATE_VERIFY_TIMING_PASSES 20
+
+/**
+ * A regular event to check with date_verify_occurrences().
+ */
+
+struct date_verify_event {
+	date_t			start;						/**< The raw date of the first occurrence.			*/
+	enum date_period	unit;						/**< The unit of the period between occurrences.		*/
+	int			period;						/**< The period between occurrences.				*/
+};
+
+/**
+ * The regular events checked by date_verify_occurrences(), covering the
+ * ends of long and short months, leap days and century years.
+ */
+
+static struct date_verify_event	date_verify_events[] = {
+	{date_combine_parts(31, 1, 2019),	DATE_PERIOD_MONTHS,	1},
+	{date_combine_parts(31, 1, 2020),	DATE_PERIOD_MONTHS,	1},
+	{date_combine_parts(30, 11, 2019),	DATE_PERIOD_MONTHS,	3},
+	{date_combine_parts(31, 8, 2023),	DATE_PERIOD_MONTHS,	6},
+	{date_combine_parts(29, 2, 2020),	DATE_PERIOD_MONTHS,	12},
+	{date_combine_parts(29, 2, 2020),	DATE_PERIOD_YEARS,	1},
+	{date_combine_parts(29, 2, 1996),	DATE_PERIOD_YEARS,	4},
+	{date_combine_parts(1, 3, 1896),	DATE_PERIOD_YEARS,	4},
+	{date_combine_parts(28, 2, 2020),	DATE_PERIOD_DAYS,	1},
+	{date_combine_parts(31, 12, 2019),	DATE_PERIOD_DAYS,	7},
+	{date_combine_parts(15, 3, 2021),	DATE_PERIOD_DAYS,	30},
+	{date_combine_parts(28, 2, 2099),	DATE_PERIOD_DAYS,	366},
+	{date_combine_parts(1, 6, 2022),	DATE_PERIOD_NONE,	0}
+};
+
+#endif
+
 /**
  * Static Function Protypes
  */
@@ -188,7 +244,17 @@ static enum date_format		date_active_format;
 static int			date_days_in_month(int month, int year);
 static int			date_months_in_year(int year);
 static enum date_os_day		date_day_of_week(date_t date);
+static date_t			date_step_period(date_t date, enum date_period unit, int period);
+static int			date_estimate_occurrences(date_t start, enum date_period unit, int period, date_t end);
+static int			date_get_day_number(int day, int month, int year);
+static date_t			date_from_day_number(int number);
 static osbool			date_is_string_numeric(char *string);
+static char			*date_write_field(char *buffer, int value, int width);
+#ifdef DEBUG
+static void			date_verify_occurrences(void);
+static void			date_verify_conversions(void);
+static char			*date_reference_convert_to_string(date_t date, char *buffer, size_t length);
+#endif
 
 
 /**
@@ -252,6 +318,11 @@ void date_initialise(void)
 	date_active_format = (enum date_format) config_int_read("DateFormat");
 	if (date_active_format < 0 || date_active_format >= DATE_FORMATS)
 		date_active_format = DATE_FORMAT_DMY;
+
+#ifdef DEBUG
+	date_verify_occurrences();
+	date_verify_conversions();
+#endif
 }
 
 
@@ -269,6 +340,8 @@ void date_initialise(void)
 char *date_convert_to_string(date_t date, char *buffer, size_t length)
 {
 	int	day, month, year;
+	size_t	size;
+	char	conversion[DATE_FORMAT_BUFFER_LEN], *end;
 
 	if (buffer == NULL || length <= 0)
 		return NULL;
@@ -280,24 +353,50 @@ char *date_convert_to_string(date_t date, char *buffer, size_t length)
 		return buffer;
 	}
 
-	/* split the date up and convert it to text. */
+	/* split the date up and convert it to text. This is done directly,
+	 * rather than via printf(), as it happens for every date on every
+	 * line of every window redraw.
+	 */
 
 	day = date_get_day_from_date(date);
 	month = date_get_month_from_date(date);
 	year = date_get_year_from_date(date);
 
+	end = conversion;
+
 	switch (date_active_format) {
 	case DATE_FORMAT_DMY:
-		string_printf(buffer, length, "%02d%c%02d%c%04d", day, date_sep_out, month, date_sep_out, year);
+		end = date_write_field(end, day, 2);
+		*end++ = date_sep_out;
+		end = date_write_field(end, month, 2);
+		*end++ = date_sep_out;
+		end = date_write_field(end, year, 4);
 		break;
 	case DATE_FORMAT_YMD:
-		string_printf(buffer, length, "%04d%c%02d%c%02d", year, date_sep_out, month, date_sep_out, day);
+		end = date_write_field(end, year, 4);
+		*end++ = date_sep_out;
+		end = date_write_field(end, month, 2);
+		*end++ = date_sep_out;
+		end = date_write_field(end, day, 2);
 		break;
 	case DATE_FORMAT_MDY:
-		string_printf(buffer, length, "%02d%c%02d%c%04d", month, date_sep_out, day, date_sep_out, year);
+		end = date_write_field(end, month, 2);
+		*end++ = date_sep_out;
+		end = date_write_field(end, day, 2);
+		*end++ = date_sep_out;
+		end = date_write_field(end, year, 4);
 		break;
 	}
 
+	/* Copy as much of the result as will fit into the supplied buffer. */
+
+	size = end - conversion;
+	if (size >= length)
+		size = length - 1;
+
+	memcpy(buffer, conversion, size);
+	buffer[size] = '\0';
+
 	return buffer;
 }
 
@@ -567,6 +666,47 @@ date_t date_add_period(date_t date, enum date_period unit, int period)
 	month = date_get_month_from_date(date);
 	year = date_get_year_from_date(date);
 
+	/* Unless the Territory Manager is supplying the calendar, the
+	 * Gregorian calendar allows months and days to be added directly.
+	 */
+
+	if (unit != DATE_PERIOD_YEARS && !config_opt_read("Territory_dates")) {
+		if (unit == DATE_PERIOD_DAYS)
+			return date_from_day_number(date_get_day_number(day, month, year) + period);
+
+		if (unit == DATE_PERIOD_MONTHS) {
+			month = (year * 12) + (month - 1) + period;
+			year = (month >= 0) ? month / 12 : -((11 - month) / 12);
+			month = month - (year * 12) + 1;
+
+			return date_combine_parts(day, month, year);
+		}
+	}
+
+	return date_step_period(date, unit, period);
+}
+
+
+/**
+ * Add or subtract a period from a date by stepping through the calendar
+ * one month or year at a time, using the calendar details supplied by
+ * date_days_in_month() and date_months_in_year().
+ *
+ * \param date			The date to add to or subtract from.
+ * \param unit			The unit of the supplied period.
+ * \param period		The period to add (when +ve) or subtract
+ *				(when -ve) to the date.
+ * \return			The modified date.
+ */
+
+static date_t date_step_period(date_t date, enum date_period unit, int period)
+{
+	int	day, month, year;
+
+	day = date_get_day_from_date(date);
+	month = date_get_month_from_date(date);
+	year = date_get_year_from_date(date);
+
 	switch (unit) {
 	case DATE_PERIOD_YEARS:
 
@@ -760,6 +900,284 @@ date_t date_find_working_day(date_t date, enum date_adjust direction)
 }
 
 
+/**
+ * Find the date of an occurrence of a regular event, such as a standing
+ * order, without stepping through all of the occurrences before it. The
+ * occurrences fall on the raw start date plus a whole number of periods,
+ * adjusted to valid working days in the same way as date_find_working_day().
+ *
+ * \param start			The raw date of the first occurrence.
+ * \param unit			The unit of the period between occurrences.
+ * \param period		The period between occurrences.
+ * \param occurrence		The occurrence to find, counting the first as 0.
+ * \param adjust		The direction to adjust the date, or none.
+ * \return			The adjusted date of the occurrence, or NULL_DATE.
+ */
+
+date_t date_find_occurrence(date_t start, enum date_period unit, int period, int occurrence, enum date_adjust adjust)
+{
+	if (start == NULL_DATE || occurrence < 0)
+		return NULL_DATE;
+
+	if (occurrence == 0)
+		return date_find_working_day(start, adjust);
+
+	if (unit == DATE_PERIOD_NONE || period <= 0)
+		return NULL_DATE;
+
+	return date_find_working_day(date_add_period(start, unit, occurrence * period), adjust);
+}
+
+
+/**
+ * Count the number of occurrences of a regular event, such as a standing
+ * order, which fall on or before a given date. Weekend adjustment is only
+ * applied to the occurrences around the end date, so the cost does not
+ * depend on the number of occurrences counted.
+ *
+ * \param start			The raw date of the first occurrence.
+ * \param unit			The unit of the period between occurrences.
+ * \param period		The period between occurrences.
+ * \param adjust		The direction to adjust the dates, or none.
+ * \param limit			The number of occurrences in the sequence.
+ * \param end			The date to count up to, inclusive, or NULL_DATE
+ *				to count all of the occurrences.
+ * \return			The number of occurrences on or before the date.
+ */
+
+int date_count_occurrences(date_t start, enum date_period unit, int period, enum date_adjust adjust, int limit, date_t end)
+{
+	int	count, middle, high;
+
+	if (start == NULL_DATE || limit <= 0)
+		return 0;
+
+	if (unit == DATE_PERIOD_NONE || period <= 0)
+		limit = 1;
+
+	if (end == NULL_DATE)
+		return limit;
+
+	/* The adjusted dates never decrease from one occurrence to the next.
+	 * If the calendar allows, estimate the count from the raw dates, then
+	 * correct it by looking at the adjusted dates around the boundary.
+	 */
+
+	count = date_estimate_occurrences(start, unit, period, end);
+
+	if (count >= 0) {
+		if (count > limit)
+			count = limit;
+
+		while (count > 0 && date_find_occurrence(start, unit, period, count - 1, adjust) > end)
+			count--;
+
+		while (count < limit && date_find_occurrence(start, unit, period, count, adjust) <= end)
+			count++;
+
+		return count;
+	}
+
+	/* Otherwise, fall back to a binary search over the adjusted dates. */
+
+	count = 0;
+	high = limit;
+
+	while (count < high) {
+		middle = count + (high - count) / 2;
+
+		if (date_find_occurrence(start, unit, period, middle, adjust) <= end)
+			count = middle + 1;
+		else
+			high = middle;
+	}
+
+	return count;
+}
+
+
+#ifdef DEBUG
+
+/**
+ * Check date_find_occurrence() and date_count_occurrences() against the
+ * results of stepping through each of the events in date_verify_events[]
+ * one period at a time, with each of the adjustment directions. Counts are
+ * checked with end dates on and just before each occurrence. Any mismatches
+ * are written to the debug output.
+ */
+
+static void date_verify_occurrences(void)
+{
+	struct date_verify_event	*event;
+	enum date_adjust		adjust;
+	date_t				raw, found, end, stepped[DATE_VERIFY_OCCURRENCES];
+	int				i, occurrence, occurrences, limit, expected, count, failures = 0;
+
+	for (i = 0; i < sizeof(date_verify_events) / sizeof(struct date_verify_event); i++) {
+		event = date_verify_events + i;
+		occurrences = (event->unit == DATE_PERIOD_NONE || event->period <= 0) ? 1 : DATE_VERIFY_OCCURRENCES;
+
+		for (adjust = DATE_ADJUST_NONE; adjust <= DATE_ADJUST_BACKWARD; adjust++) {
+			/* Step through the occurrences one period at a time. */
+
+			raw = event->start;
+
+			for (occurrence = 0; occurrence < occurrences; occurrence++) {
+				stepped[occurrence] = date_find_working_day(raw, adjust);
+				raw = date_step_period(raw, event->unit, event->period);
+
+				found = date_find_occurrence(event->start, event->unit, event->period, occurrence, adjust);
+				if (found != stepped[occurrence]) {
+					debug_printf("\\RDate occurrence %d of event %d (adjust %d) is 0x%x, not 0x%x", occurrence, i, adjust, found, stepped[occurrence]);
+					failures++;
+				}
+			}
+
+			/* Count the occurrences up to dates on and just before each
+			 * stepped occurrence, for the full sequence and a short one.
+			 */
+
+			for (occurrence = 0; occurrence < occurrences * 2; occurrence++) {
+				end = stepped[occurrence / 2];
+				if (occurrence % 2)
+					end = date_add_period(end, DATE_PERIOD_DAYS, -1);
+
+				for (limit = occurrences; limit > 0; limit = (limit > 5) ? 5 : 0) {
+					for (expected = 0, count = 0; count < limit; count++) {
+						if (stepped[count] <= end)
+							expected++;
+					}
+
+					count = date_count_occurrences(event->start, event->unit, event->period, adjust, limit, end);
+					if (count != expected) {
+						debug_printf("\\RDate count to 0x%x for event %d (adjust %d, limit %d) is %d, not %d", end, i, adjust, limit, count, expected);
+						failures++;
+					}
+				}
+			}
+		}
+	}
+
+	debug_printf("Date occurrence checks complete, with %d failures", failures);
+}
+
+
+/**
+ * Check date_convert_to_string() against a printf() based conversion for
+ * the dates in date_verify_events[] and the periods after them, in each of
+ * the date formats and with every buffer length up to the longest result.
+ * Any mismatches are written to the debug output, followed by the time
+ * taken by each conversion over DATE_VERIFY_TIMING_PASSES passes.
+ */
+
+static void date_verify_conversions(void)
+{
+	enum date_format	format, active_format;
+	date_t			date;
+	size_t			length;
+	os_t			start, direct_time, printf_time;
+	int			i, occurrence, pass, failures = 0;
+	char			direct[DATE_FORMAT_BUFFER_LEN], reference[DATE_FORMAT_BUFFER_LEN];
+
+	active_format = date_active_format;
+
+	for (format = 0; format < DATE_FORMATS; format++) {
+		date_active_format = format;
+
+		for (i = 0; i < sizeof(date_verify_events) / sizeof(struct date_verify_event); i++) {
+			date = date_verify_events[i].start;
+
+			for (occurrence = 0; occurrence < DATE_VERIFY_OCCURRENCES; occurrence++) {
+				for (length = 1; length <= DATE_FORMAT_BUFFER_LEN; length++) {
+					date_convert_to_string(date, direct, length);
+					date_reference_convert_to_string(date, reference, length);
+
+					if (strcmp(direct, reference) != 0) {
+						debug_printf("\\RDate 0x%x in format %d (length %d) is '%s', not '%s'", date, format, length, direct, reference);
+						failures++;
+					}
+				}
+
+				date = date_step_period(date, date_verify_events[i].unit, date_verify_events[i].period);
+			}
+		}
+	}
+
+	date_active_format = active_format;
+
+	/* Time the two conversions over the same dates in the active format. */
+
+	start = os_read_monotonic_time();
+
+	for (pass = 0; pass < DATE_VERIFY_TIMING_PASSES; pass++) {
+		for (i = 0; i < sizeof(date_verify_events) / sizeof(struct date_verify_event); i++) {
+			for (date = date_verify_events[i].start, occurrence = 0; occurrence < DATE_VERIFY_OCCURRENCES; occurrence++) {
+				date_convert_to_string(date, direct, DATE_FORMAT_BUFFER_LEN);
+				date = date_step_period(date, date_verify_events[i].unit, date_verify_events[i].period);
+			}
+		}
+	}
+
+	direct_time = os_read_monotonic_time() - start;
+	start = os_read_monotonic_time();
+
+	for (pass = 0; pass < DATE_VERIFY_TIMING_PASSES; pass++) {
+		for (i = 0; i < sizeof(date_verify_events) / sizeof(struct date_verify_event); i++) {
+			for (date = date_verify_events[i].start, occurrence = 0; occurrence < DATE_VERIFY_OCCURRENCES; occurrence++) {
+				date_reference_convert_to_string(date, reference, DATE_FORMAT_BUFFER_LEN);
+				date = date_step_period(date, date_verify_events[i].unit, date_verify_events[i].period);
+			}
+		}
+	}
+
+	printf_time = os_read_monotonic_time() - start;
+
+	debug_printf("Date conversion checks complete, with %d failures; direct %dcs, printf %dcs", failures, direct_time, printf_time);
+}
+
+
+/**
+ * Convert a date into a string using printf(), in the way that
+ * date_convert_to_string() did before it wrote the digits directly. This
+ * is used as a reference by date_verify_conversions().
+ *
+ * \param date			The date to convert.
+ * \param *buffer		Pointer to a buffer to take the conversion.
+ * \param length		The size of the supplied buffer, in bytes.
+ * \return			A pointer to the supplied buffer.
+ */
+
+static char *date_reference_convert_to_string(date_t date, char *buffer, size_t length)
+{
+	int	day, month, year;
+
+	if (date == NULL_DATE) {
+		*buffer = '\0';
+		return buffer;
+	}
+
+	day = date_get_day_from_date(date);
+	month = date_get_month_from_date(date);
+	year = date_get_year_from_date(date);
+
+	switch (date_active_format) {
+	case DATE_FORMAT_DMY:
+		string_printf(buffer, length, "%02d%c%02d%c%04d", day, date_sep_out, month, date_sep_out, year);
+		break;
+	case DATE_FORMAT_YMD:
+		string_printf(buffer, length, "%04d%c%02d%c%02d", year, date_sep_out, month, date_sep_out, day);
+		break;
+	case DATE_FORMAT_MDY:
+		string_printf(buffer, length, "%02d%c%02d%c%04d", month, date_sep_out, day, date_sep_out, year);
+		break;
+	}
+
+	return buffer;
+}
+
+#endif
+
+
 /**
  * Get the current system date.
  *
@@ -1045,6 +1463,117 @@ int date_count_days(date_t start, date_t end)
 }
 
 
+/**
+ * Estimate the number of occurrences of a regular event whose raw dates
+ * fall on or before an end date, using the Gregorian calendar. The estimate
+ * ignores any adjustment of the dates, so may be out by a few occurrences
+ * around the end date.
+ *
+ * \param start			The raw date of the first occurrence.
+ * \param unit			The unit of the period between occurrences.
+ * \param period		The period between occurrences.
+ * \param end			The date to count up to, inclusive.
+ * \return			The estimated count, or -1 if the calendar is
+ *				supplied by the Territory Manager.
+ */
+
+static int date_estimate_occurrences(date_t start, enum date_period unit, int period, date_t end)
+{
+	int	difference, start_day, end_day;
+
+	if (config_opt_read("Territory_dates"))
+		return -1;
+
+	if (unit == DATE_PERIOD_NONE || period <= 0)
+		return (start <= end) ? 1 : 0;
+
+	start_day = date_get_day_from_date(start);
+	end_day = date_get_day_from_date(end);
+
+	switch (unit) {
+	case DATE_PERIOD_DAYS:
+		difference = date_get_day_number(end_day, date_get_month_from_date(end), date_get_year_from_date(end)) -
+				date_get_day_number(start_day, date_get_month_from_date(start), date_get_year_from_date(start));
+		break;
+
+	case DATE_PERIOD_MONTHS:
+		difference = (date_get_year_from_date(end) * 12 + date_get_month_from_date(end)) -
+				(date_get_year_from_date(start) * 12 + date_get_month_from_date(start));
+
+		if (end_day < start_day)
+			difference--;
+		break;
+
+	case DATE_PERIOD_YEARS:
+		difference = date_get_year_from_date(end) - date_get_year_from_date(start);
+
+		if ((end & (DATE_FIELD_MONTH | DATE_FIELD_DAY)) < (start & (DATE_FIELD_MONTH | DATE_FIELD_DAY)))
+			difference--;
+		break;
+
+	default:
+		difference = -1;
+		break;
+	}
+
+	return (difference < 0) ? 0 : (difference / period) + 1;
+}
+
+
+/**
+ * Convert a day, month and year in the Gregorian calendar into a count of
+ * days from a fixed epoch. The day may be outside the range of the month,
+ * in which case the count continues into the following month.
+ *
+ * \param day			The day to convert.
+ * \param month			The month to convert.
+ * \param year			The year to convert.
+ * \return			The day number.
+ */
+
+static int date_get_day_number(int day, int month, int year)
+{
+	int	era, year_of_era, day_of_year;
+
+	/* Count the years from March, so that leap days fall at the end. */
+
+	if (month <= 2)
+		year--;
+
+	era = ((year >= 0) ? year : year - 399) / 400;
+	year_of_era = year - era * 400;
+	day_of_year = (153 * (month + ((month > 2) ? -3 : 9)) + 2) / 5 + day - 1;
+
+	return era * 146097 + year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+}
+
+
+/**
+ * Convert a day number, as returned by date_get_day_number(), back into
+ * a date in the Gregorian calendar.
+ *
+ * \param number		The day number to convert.
+ * \return			The corresponding date.
+ */
+
+static date_t date_from_day_number(int number)
+{
+	int	era, day_of_era, year_of_era, day_of_year, month_index, day, month, year;
+
+	era = ((number >= 0) ? number : number - 146096) / 146097;
+	day_of_era = number - era * 146097;
+	year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	month_index = (5 * day_of_year + 2) / 153;
+
+	day = day_of_year - (153 * month_index + 2) / 5 + 1;
+	month = (month_index < 10) ? month_index + 3 : month_index - 9;
+	year = year_of_era + era * 400 + ((month <= 2) ? 1 : 0);
+
+	return date_combine_parts(day, month, year);
+}
+
+
 /**
  * Test a string, to see if all its characters are numeric.
  *
@@ -1064,3 +1593,36 @@ static osbool date_is_string_numeric(char *string)
 	return (*string == '\0') ? TRUE : FALSE;
 }
 
+
+/**
+ * Write an integer value into a buffer as a zero-padded decimal number,
+ * in the same way as the printf() %0Nd conversion.
+ *
+ * \param *buffer		Pointer to the buffer to take the digits.
+ * \param value			The value to be written, which must not be
+ *				negative.
+ * \param width			The minimum number of digits to write.
+ * \return			Pointer to the character after the last digit.
+ */
+
+static char *date_write_field(char *buffer, int value, int width)
+{
+	char	digits[DATE_FORMAT_BUFFER_LEN], *ptr, *end;
+
+	end = digits + DATE_FORMAT_BUFFER_LEN;
+	ptr = end;
+
+	do {
+		*(--ptr) = '0' + (value % 10);
+		value /= 10;
+	} while (value > 0);
+
+	while ((end - ptr) < width)
+		*(--ptr) = '0';
+
+	while (ptr < end)
+		*buffer++ = *ptr++;
+
+	return buffer;
+}
+
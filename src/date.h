@@ -272,6 +272,42 @@ date_t date_find_valid_day(date_t date, enum date_adjust direction);
 date_t date_find_working_day(date_t date, enum date_adjust direction);
 
 
+/**
+ * Find the date of an occurrence of a regular event, such as a standing
+ * order, without stepping through all of the occurrences before it. The
+ * occurrences fall on the raw start date plus a whole number of periods,
+ * adjusted to valid working days in the same way as date_find_working_day().
+ *
+ * \param start			The raw date of the first occurrence.
+ * \param unit			The unit of the period between occurrences.
+ * \param period		The period between occurrences.
+ * \param occurrence		The occurrence to find, counting the first as 0.
+ * \param adjust		The direction to adjust the date, or none.
+ * \return			The adjusted date of the occurrence, or NULL_DATE.
+ */
+
+date_t date_find_occurrence(date_t start, enum date_period unit, int period, int occurrence, enum date_adjust adjust);
+
+
+/**
+ * Count the number of occurrences of a regular event, such as a standing
+ * order, which fall on or before a given date. Weekend adjustment is only
+ * applied to the occurrences around the end date, so the cost does not
+ * depend on the number of occurrences counted.
+ *
+ * \param start			The raw date of the first occurrence.
+ * \param unit			The unit of the period between occurrences.
+ * \param period		The period between occurrences.
+ * \param adjust		The direction to adjust the dates, or none.
+ * \param limit			The number of occurrences in the sequence.
+ * \param end			The date to count up to, inclusive, or NULL_DATE
+ *				to count all of the occurrences.
+ * \return			The number of occurrences on or before the date.
+ */
+
+int date_count_occurrences(date_t start, enum date_period unit, int period, enum date_adjust adjust, int limit, date_t end);
+
+
 /**
  * Get the current system date.
  *
@@ -62,6 +62,7 @@
 #include "account.h"
 #include "accview.h"
 #include "analysis.h"
+#include "archive.h"
 #include "budget.h"
 #include "clipboard.h"
 #include "column.h"
@@ -72,6 +73,7 @@
 #include "filing.h"
 #include "find.h"
 #include "flexutils.h"
+#include "forecast.h"
 #include "goto.h"
 #include "interest.h"
 #include "preset.h"
@@ -153,6 +155,8 @@ struct file_block *build_new_file_block(void)
 	new->sorders = NULL;
 	new->presets = NULL;
 	new->analysis = NULL;
+	new->forecast = NULL;
+	new->archive = NULL;
 
 	new->budget = NULL;
 	new->find = NULL;
@@ -163,6 +167,9 @@ struct file_block *build_new_file_block(void)
 	new->reports = NULL;
 	new->import_report = NULL;
 
+	new->batch_depth = 0;
+	new->batch_effects = FILE_BATCH_NONE;
+
 	/* Set up the budget data. */
 
 	new->budget = budget_create(new);
@@ -271,10 +278,29 @@ struct file_block *build_new_file_block(void)
 		return NULL;
 	}
 
+	/* Set up the cash flow forecast module. */
+
+	new->forecast = forecast_create_instance(new);
+	if (new->forecast == NULL) {
+		delete_file(new);
+		error_msgs_report_error("NoMemNewFile");
+		return NULL;
+	}
+
+	/* Set up the transaction archive. */
+
+	new->archive = archive_create_instance(new);
+	if (new->archive == NULL) {
+		delete_file(new);
+		error_msgs_report_error("NoMemNewFile");
+		return NULL;
+	}
+
   /* Set the filename and save status. */
 
   *(new->filename) = '\0';
   new->modified = FALSE;
+  new->data_version = 0;
   new->untitled_count = ++file_untitled_count;
   new->child_x_offset = 0;
 
@@ -367,6 +393,12 @@ void delete_file(struct file_block *file)
 	if (file->analysis != NULL)
 		analysis_delete_instance(file->analysis);
 
+	if (file->forecast != NULL)
+		forecast_delete_instance(file->forecast);
+
+	if (file->archive != NULL)
+		archive_delete_instance(file->archive);
+
 	/* Delink the block from the list of open files. */
 
 	list = &file_list;
@@ -478,6 +510,13 @@ osbool file_check_for_unsaved_data(void)
 
 void file_set_data_integrity(struct file_block *file, osbool unsafe)
 {
+	/* Every change to the data passes through here, so count them in
+	 * order that long-running jobs can spot edits made underneath them.
+	 */
+
+	if (file != NULL && unsafe)
+		file->data_version++;
+
 	if (file != NULL && file->modified != unsafe) {
 		file->modified = unsafe;
 		transact_build_window_title(file);
@@ -498,6 +537,20 @@ osbool file_get_data_integrity(struct file_block *file)
 }
 
 
+/**
+ * Read the data version of a file, which changes every time that the
+ * data in the file is modified.
+ *
+ * \param *file		The file to read.
+ * \return		The current data version.
+ */
+
+unsigned file_get_data_version(struct file_block *file)
+{
+	return (file == NULL) ? 0 : file->data_version;
+}
+
+
 /**
  * Check if the file has a full save path (ie. it has been saved before, or has
  * been loaded from disc).
@@ -664,6 +717,97 @@ void file_redraw_windows(struct file_block *file)
 }
 
 
+/**
+ * Start a batch update on a file. Until the matching call to
+ * file_commit_batch(), side effects such as window redraws, account
+ * recalculations and account view rebuilds are queued up instead of being
+ * performed for each change. Batches may be nested.
+ *
+ * \param *file		The file to start the batch on.
+ */
+
+void file_begin_batch(struct file_block *file)
+{
+	if (file == NULL)
+		return;
+
+	file->batch_depth++;
+}
+
+
+/**
+ * Record side effects for deferral, if a batch update is in progress on a
+ * file.
+ *
+ * \param *file		The file to which the effects apply.
+ * \param effects	The side effects to be deferred.
+ * \return		TRUE if the effects have been deferred; FALSE if the
+ *			caller should perform them immediately.
+ */
+
+osbool file_defer_batch_effects(struct file_block *file, enum file_batch_effects effects)
+{
+	if (file == NULL || file->batch_depth == 0)
+		return FALSE;
+
+	file->batch_effects |= effects;
+
+	return TRUE;
+}
+
+
+/**
+ * End a batch update on a file. When the outermost batch ends, each of the
+ * side effects which were deferred during it is performed once.
+ *
+ * \param *file		The file to end the batch on.
+ */
+
+void file_commit_batch(struct file_block *file)
+{
+	enum file_batch_effects	effects;
+
+	if (file == NULL || file->batch_depth == 0)
+		return;
+
+	if (--file->batch_depth > 0)
+		return;
+
+	/* Take a copy of the effects and clear them down before acting on
+	 * them, as the calls made below will re-enter the defer code.
+	 */
+
+	effects = file->batch_effects;
+	file->batch_effects = FILE_BATCH_NONE;
+
+	/* Check that the per-row balance updates made during the batch
+	 * agree with a full recalculation of the file.
+	 */
+
+	#ifdef DEBUG
+	if (!account_verify_balances(file))
+		debug_printf("\\RAccount balances were inconsistent after a batch update");
+	#endif
+
+	if (effects & FILE_BATCH_TRANSACT_MEMORY)
+		transact_release_spare_memory(file);
+
+	if (effects & FILE_BATCH_TRANSACT_SORT)
+		transact_sort(file->transacts);
+
+	if (effects & FILE_BATCH_TRANSACT_WINDOW) {
+		transact_set_window_extent(file);
+		transact_redraw_all(file);
+	}
+
+	if (effects & FILE_BATCH_ACCOUNT_WINDOWS)
+		account_update_windows(file);
+
+	if (effects & FILE_BATCH_ACCVIEWS)
+		accview_rebuild_all(file);
+}
+
+
 /**
  * Process a file for a change of date: add any new standing orders and
  * recalculate all the accounts
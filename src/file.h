@@ -88,6 +88,17 @@ void file_set_data_integrity(struct file_block *file, osbool unsafe);
 osbool file_get_data_integrity(struct file_block *file);
 
 
+/**
+ * Read the data version of a file, which changes every time that the
+ * data in the file is modified.
+ *
+ * \param *file		The file to read.
+ * \return		The current data version.
+ */
+
+unsigned file_get_data_version(struct file_block *file);
+
+
 /**
  * Check if the file has a full save path (ie. it has been saved before, or has
  * been loaded from disc).
@@ -147,6 +158,41 @@ int file_get_next_open_offset(struct file_block *file);
 void file_redraw_windows(struct file_block *file);
 
 
+/**
+ * Start a batch update on a file. Until the matching call to
+ * file_commit_batch(), side effects such as window redraws, account
+ * recalculations and account view rebuilds are queued up instead of being
+ * performed for each change. Batches may be nested.
+ *
+ * \param *file		The file to start the batch on.
+ */
+
+void file_begin_batch(struct file_block *file);
+
+
+/**
+ * Record side effects for deferral, if a batch update is in progress on a
+ * file.
+ *
+ * \param *file		The file to which the effects apply.
+ * \param effects	The side effects to be deferred.
+ * \return		TRUE if the effects have been deferred; FALSE if the
+ *			caller should perform them immediately.
+ */
+
+osbool file_defer_batch_effects(struct file_block *file, enum file_batch_effects effects);
+
+
+/**
+ * End a batch update on a file. When the outermost batch ends, each of the
+ * side effects which were deferred during it is performed once.
+ *
+ * \param *file		The file to end the batch on.
+ */
+
+void file_commit_batch(struct file_block *file);
+
+
 /**
  * Process a file for a change of date: add any new standing orders and
  * recalculate all the accounts
@@ -74,6 +74,7 @@
 #include "account.h"
 #include "accview.h"
 #include "analysis.h"
+#include "archive.h"
 #include "budget.h"
 #include "column.h"
 #include "currency.h"
@@ -145,6 +146,7 @@ struct filing_block {
 
 static void		filing_open_import_complete_window(struct file_block *file, wimp_pointer *ptr, int imported, int rejected);
 static osbool		filing_process_import_complete_window(void *parent, struct import_dialogue_data *content);
+static void		filing_add_import_log_field(struct report *report, int tab_stop, char *text);
 static char		*filing_find_next_field(struct filing_block *in);
 
 
@@ -219,6 +221,8 @@ void filing_load_cashbook_file(char *filename)
 			preset_read_file(file, &in);
 		else if (string_nocase_strcmp(in.section, "Reports") == 0)
 			analysis_read_file(file, &in);
+		else if (string_nocase_strcmp(in.section, "Archive") == 0)
+			archive_read_file(file, &in);
 		else {
 			do {
 				if (*in.section != '\0')
@@ -282,6 +286,7 @@ void filing_load_cashbook_file(char *filename)
 
 	string_copy(file->filename, filename, FILE_MAX_FILENAME);
 
+	account_rebuild_usage(file);
 	sorder_process(file);
 	transact_sort_file_data(file);
 	account_recalculate_all(file);
@@ -310,6 +315,15 @@ void filing_save_cashbook_file(struct file_block *file, char *filename)
 	bits	load;
 
 
+	/* Place any new archive segments next to the file first, so that the
+	 * file can record where they are.
+	 */
+
+	if (!archive_save_segments(file, filename)) {
+		error_msgs_report_error("ArchiveSaveFail");
+		return;
+	}
+
 	out = fopen(filename, "w");
 
 	if (out == NULL) {
@@ -337,6 +351,7 @@ void filing_save_cashbook_file(struct file_block *file, char *filename)
 	sorder_write_file(file, out);
 	preset_write_file(file, out);
 	analysis_write_file(file, out);
+	archive_write_file(file, out);
 
 	/* Close the file and set the type correctly. */
 
@@ -416,6 +431,8 @@ void filing_import_csv_file(struct file_block *file, char *filename)
 	input = fopen(filename, "r");
 
 	if (input != NULL) {
+		file_begin_batch(file);
+
 		while (fgets(line, FILING_CSV_LINE_LENGTH, input) != NULL) {
 			error = FALSE;
 
@@ -508,9 +525,15 @@ void filing_import_csv_file(struct file_block *file, char *filename)
 				import_count++;
 			}
 
-			string_printf(log, FILING_LOG_LINE_LENGTH, "%s\\t'%s'\\t'%s'\\t'%s'\\t'%s'\\t'%s'\\t'%s'",
-					b1, date, raw_from, raw_to, ref, amount, description);
-			report_write_line(file->import_report, 0, log);
+			report_begin_line(file->import_report, 0, REPORT_LINE_FLAGS_NONE);
+			report_add_text_cell(file->import_report, 0, REPORT_CELL_FLAGS_NONE, b1);
+			filing_add_import_log_field(file->import_report, 1, date);
+			filing_add_import_log_field(file->import_report, 2, raw_from);
+			filing_add_import_log_field(file->import_report, 3, raw_to);
+			filing_add_import_log_field(file->import_report, 4, ref);
+			filing_add_import_log_field(file->import_report, 5, amount);
+			filing_add_import_log_field(file->import_report, 6, description);
+			report_end_line(file->import_report);
 		}
 
 		fclose(input);
@@ -523,6 +546,8 @@ void filing_import_csv_file(struct file_block *file, char *filename)
 		file_set_data_integrity(file, TRUE);
 
 		transact_redraw_all(file);
+
+		file_commit_batch(file);
 	}
 
 	/* Sort out the import results window. */
@@ -542,6 +567,23 @@ void filing_import_csv_file(struct file_block *file, char *filename)
 }
 
 
+/**
+ * Add a quoted field from an imported CSV line to the import log.
+ *
+ * \param *report		The import log report to write to.
+ * \param tab_stop		The tab stop to place the field in.
+ * \param *text			The text of the field.
+ */
+
+static void filing_add_import_log_field(struct report *report, int tab_stop, char *text)
+{
+	char	field[FILING_LOG_LINE_LENGTH];
+
+	string_printf(field, FILING_LOG_LINE_LENGTH, "'%s'", text);
+	report_add_text_cell(report, tab_stop, REPORT_CELL_FLAGS_NONE, field);
+}
+
+
 /**
  * Open the Import Result dialogue for a given import process.
  *
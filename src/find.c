@@ -33,6 +33,7 @@
 
 /* OSLib header files */
 
+#include "oslib/hourglass.h"
 #include "oslib/wimp.h"
 
 /* SF-Lib header files. */
@@ -43,6 +44,7 @@
 #include "sflib/heap.h"
 #include "sflib/icons.h"
 #include "sflib/ihelp.h"
+#include "sflib/msgs.h"
 #include "sflib/string.h"
 #include "sflib/templates.h"
 #include "sflib/windows.h"
@@ -57,14 +59,23 @@
 
 #include "account.h"
 #include "account_menu.h"
+#include "archive.h"
 #include "caret.h"
 #include "column.h"
 #include "currency.h"
 #include "date.h"
 #include "edit.h"
 #include "file.h"
+#include "report.h"
+#include "stringbuild.h"
 #include "transact.h"
 
+/**
+ * The length of the line buffer used in the archived transaction report.
+ */
+
+#define FIND_ARCHIVE_LINE_LENGTH 1024
+
 
 /**
  * Search data.
@@ -87,12 +98,31 @@ struct find_block {
 	enum find_direction	direction;					/**< The direction to search in.					*/
 };
 
+/**
+ * Data relating to a search of the archived transactions.
+ */
+
+struct find_archive_search {
+	struct file_block		*file;					/**< The file whose archive is being searched.				*/
+	struct find_result_dialogue_data *parameters;				/**< The search parameters in use.					*/
+	char				*ref;					/**< The wildcarded Reference to match.					*/
+	char				*desc;					/**< The wildcarded Description to match.				*/
+	char				*from_ident;				/**< The ident of the From account to match, or NULL for none.		*/
+	char				*to_ident;				/**< The ident of the To account to match, or NULL for none.		*/
+
+	struct report			*report;				/**< The report listing the matches, or NULL if none found.		*/
+	struct stringbuild_block	builder;				/**< The string builder used to write the report.			*/
+	char				line[FIND_ARCHIVE_LINE_LENGTH];		/**< The line buffer used by the string builder.			*/
+};
+
 /* Static Function Prototypes. */
 
 static void find_reopen_window(struct find_block *windat, struct find_result_dialogue_data *parameters, wimp_pointer *ptr);
 static osbool find_process_search_window(void *owner, struct find_search_dialogue_data *content);
 static osbool find_process_result_window(wimp_pointer *pointer, void *owner, struct find_result_dialogue_data *content);
 static osbool find_from_line(struct find_block *windat, struct find_result_dialogue_data *parameters);
+static osbool find_search_archive(struct find_block *windat, struct find_result_dialogue_data *parameters, char *ref, char *desc);
+static osbool find_test_archived_transaction(struct archive_segment *segment, struct archive_transaction *transaction, void *data);
 
 
 /**
@@ -413,9 +443,15 @@ static osbool find_from_line(struct find_block *windat, struct find_result_dialo
 	result = transact_search(windat->file, &line, parameters->direction == FIND_UP, parameters->case_sensitive, parameters->logic == FIND_AND,
 			parameters->date, parameters->from, parameters->to, parameters->reconciled, parameters->amount, ref, desc);
 
+	/* If nothing is left in the file, try any transactions which have
+	 * been purged into the archive before giving up.
+	 */
+
 	if (result == TRANSACT_FIELD_NONE) {
+		if (!find_search_archive(windat, parameters, ref, desc))
+			error_msgs_report_info ("BadFind");
+
 		heap_free(parameters);
-		error_msgs_report_info ("BadFind");
 		return FALSE;
 	}
 
@@ -432,3 +468,183 @@ static osbool find_from_line(struct find_block *windat, struct find_result_dialo
 	return TRUE;
 }
 
+
+/**
+ * Search the archived transactions belonging to a file, using the same
+ * criteria as the search of the live transactions. Any matches are listed
+ * in a report, since they can no longer be shown in the transaction window.
+ *
+ * \param *windat		The parent Find instance.
+ * \param *parameters		The search parameters to use.
+ * \param *ref			The wildcarded Reference to match.
+ * \param *desc			The wildcarded Description to match.
+ * \return			TRUE if any matches were found; otherwise FALSE.
+ */
+
+static osbool find_search_archive(struct find_block *windat, struct find_result_dialogue_data *parameters, char *ref, char *desc)
+{
+	struct find_archive_search	*search;
+	date_t				from, to;
+	osbool				found;
+
+	if (windat == NULL || parameters == NULL)
+		return FALSE;
+
+	/* Without anything to match, an AND search would list the whole archive. */
+
+	if (parameters->date == NULL_DATE && parameters->from == NULL_ACCOUNT && parameters->to == NULL_ACCOUNT &&
+			parameters->amount == NULL_CURRENCY && *ref == '\0' && *desc == '\0')
+		return FALSE;
+
+	search = heap_alloc(sizeof(struct find_archive_search));
+	if (search == NULL)
+		return FALSE;
+
+	if (!stringbuild_initialise(&(search->builder), search->line, FIND_ARCHIVE_LINE_LENGTH)) {
+		heap_free(search);
+		return FALSE;
+	}
+
+	search->file = windat->file;
+	search->parameters = parameters;
+	search->ref = ref;
+	search->desc = desc;
+	search->report = NULL;
+
+	/* The archive records accounts by their idents, since the account
+	 * numbers in the file may have changed since the purge.
+	 */
+
+	search->from_ident = (parameters->from != NULL_ACCOUNT) ? account_get_ident(windat->file, parameters->from) : NULL;
+	search->to_ident = (parameters->to != NULL_ACCOUNT) ? account_get_ident(windat->file, parameters->to) : NULL;
+
+	/* If every match must fall on a given date, the segment indexes can
+	 * take us straight to it; otherwise, everything must be read.
+	 */
+
+	if (parameters->logic == FIND_AND && parameters->date != NULL_DATE) {
+		from = parameters->date;
+		to = parameters->date;
+	} else {
+		from = NULL_DATE;
+		to = NULL_DATE;
+	}
+
+	hourglass_on();
+	archive_read_transactions(windat->file, from, to, find_test_archived_transaction, search);
+	hourglass_off();
+
+	found = (search->report != NULL) ? TRUE : FALSE;
+
+	if (search->report != NULL)
+		report_close(search->report);
+
+	stringbuild_cancel(&(search->builder));
+	heap_free(search);
+
+	return found;
+}
+
+
+/**
+ * Test an archived transaction against the search parameters, in the same
+ * way as transact_search() tests the live transactions, and add it to the
+ * report of matches if it passes.
+ *
+ * \param *segment		The segment holding the transaction.
+ * \param *transaction		The transaction to be tested.
+ * \param *data			The archive search data.
+ * \return			TRUE to continue reading; FALSE to stop.
+ */
+
+static osbool find_test_archived_transaction(struct archive_segment *segment, struct archive_transaction *transaction, void *data)
+{
+	struct find_archive_search		*search = data;
+	struct find_result_dialogue_data	*parameters;
+	enum transact_field			test = TRANSACT_FIELD_NONE;
+	osbool					logic_and;
+
+	if (search == NULL || transaction == NULL)
+		return FALSE;
+
+	parameters = search->parameters;
+	logic_and = (parameters->logic == FIND_AND) ? TRUE : FALSE;
+
+	/* For OR tests, the bits start unset and are set as tests pass; for AND
+	 * tests, the required bits start set and are cleared as tests pass.
+	 */
+
+	if (logic_and) {
+		if (parameters->date != NULL_DATE)
+			test |= TRANSACT_FIELD_DATE;
+
+		if (search->from_ident != NULL)
+			test |= TRANSACT_FIELD_FROM;
+
+		if (search->to_ident != NULL)
+			test |= TRANSACT_FIELD_TO;
+
+		if (parameters->amount != NULL_CURRENCY)
+			test |= TRANSACT_FIELD_AMOUNT;
+
+		if (*(search->ref) != '\0')
+			test |= TRANSACT_FIELD_REF;
+
+		if (*(search->desc) != '\0')
+			test |= TRANSACT_FIELD_DESC;
+	}
+
+	if (*(search->desc) != '\0' && string_wildcard_compare(search->desc, transaction->description, !parameters->case_sensitive))
+		test ^= TRANSACT_FIELD_DESC;
+
+	if (parameters->amount != NULL_CURRENCY && parameters->amount == transaction->amount)
+		test ^= TRANSACT_FIELD_AMOUNT;
+
+	if (*(search->ref) != '\0' && string_wildcard_compare(search->ref, transaction->reference, !parameters->case_sensitive))
+		test ^= TRANSACT_FIELD_REF;
+
+	if (search->to_ident != NULL && string_nocase_strcmp(search->to_ident, archive_get_account_ident(segment, transaction->to)) == 0 &&
+			((parameters->reconciled ^ transaction->flags) & TRANS_REC_TO) == 0)
+		test ^= TRANSACT_FIELD_TO;
+
+	if (search->from_ident != NULL && string_nocase_strcmp(search->from_ident, archive_get_account_ident(segment, transaction->from)) == 0 &&
+			((parameters->reconciled ^ transaction->flags) & TRANS_REC_FROM) == 0)
+		test ^= TRANSACT_FIELD_FROM;
+
+	if (parameters->date != NULL_DATE && parameters->date == transaction->date)
+		test ^= TRANSACT_FIELD_DATE;
+
+	if ((logic_and && test) || (!logic_and && !test))
+		return TRUE;
+
+	/* Open the report when the first match is found. */
+
+	if (search->report == NULL) {
+		msgs_lookup("FndArcWinT", search->line, FIND_ARCHIVE_LINE_LENGTH);
+		search->report = report_open(search->file, search->line, NULL);
+
+		if (search->report == NULL)
+			return FALSE;
+
+		stringbuild_reset(&(search->builder));
+		stringbuild_add_message_param(&(search->builder), "FndArcTitle", file_get_leafname(search->file, NULL, 0), NULL, NULL, NULL);
+		stringbuild_report_line(&(search->builder), search->report, 0);
+
+		report_write_line(search->report, 0, "");
+
+		stringbuild_reset(&(search->builder));
+		stringbuild_add_message(&(search->builder), "FndArcHeadings");
+		stringbuild_report_line(&(search->builder), search->report, 1);
+	}
+
+	report_begin_line(search->report, 1, REPORT_LINE_FLAGS_KEEP_TOGETHER);
+	report_add_date_cell(search->report, 0, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_CENTRE, transaction->date);
+	report_add_text_cell(search->report, 1, REPORT_CELL_FLAGS_RULE_AFTER, archive_get_account_name(segment, transaction->from));
+	report_add_text_cell(search->report, 2, REPORT_CELL_FLAGS_RULE_AFTER, archive_get_account_name(segment, transaction->to));
+	report_add_text_cell(search->report, 3, REPORT_CELL_FLAGS_RULE_AFTER, transaction->reference);
+	report_add_currency_cell(search->report, 4, REPORT_CELL_FLAGS_RULE_AFTER | REPORT_CELL_FLAGS_RIGHT, transaction->amount, TRUE);
+	report_add_text_cell(search->report, 5, REPORT_CELL_FLAGS_RULE_AFTER, transaction->description);
+	report_end_line(search->report);
+
+	return TRUE;
+}
@@ -0,0 +1,698 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: forecast.c
+ *
+ * Cash flow forecasting implementation.
+ *
+ * A forecast holds a timeline for each account, running from today for
+ * FORECAST_YEARS years. Each timeline is a list of segments, giving the
+ * balance from a date until the start of the next segment, so an account
+ * with few movements takes little space however long the forecast is.
+ * The balances combine any future-dated transactions with all of the
+ * outstanding occurrences of the standing orders.
+ *
+ * Timelines are built on demand, and discarded individually as the
+ * transactions affecting their accounts are changed. Any which have been
+ * discarded are rebuilt together in a single pass through the file.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* OSLib header files */
+
+#include "oslib/hourglass.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/debug.h"
+#include "sflib/heap.h"
+
+/* Application header files */
+
+#include "global.h"
+#include "forecast.h"
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+#include "sorder.h"
+#include "transact.h"
+
+/**
+ * The number of events to allocate space for at a time while building.
+ */
+
+#define FORECAST_EVENT_ALLOCATION 256
+
+/**
+ * A segment of an account's timeline, during which the balance is constant.
+ */
+
+struct forecast_segment {
+	date_t			start;			/**< The first date on which the balance applies.		*/
+	amt_t			balance;		/**< The balance up until the start of the next segment.	*/
+};
+
+/**
+ * The forecast timeline for a single account.
+ */
+
+struct forecast_timeline {
+	struct forecast_segment	*segments;		/**< The segments in the timeline, in date order.		*/
+	int			segment_count;		/**< The number of segments in the timeline.			*/
+	osbool			valid;			/**< TRUE if the timeline is up to date; else FALSE.		*/
+};
+
+/**
+ * A movement of money into or out of an account, collected while building.
+ */
+
+struct forecast_event {
+	date_t			date;			/**< The date of the movement.					*/
+	acct_t			account;		/**< The account affected.					*/
+	amt_t			amount;			/**< The amount moved into the account.				*/
+};
+
+/**
+ * A cash flow forecast instance.
+ */
+
+struct forecast_block {
+	struct file_block	*file;			/**< The file to which the instance belongs.			*/
+
+	struct forecast_timeline *timelines;		/**< The timelines for the accounts in the file.		*/
+	int			account_count;		/**< The number of accounts with timelines.			*/
+
+	date_t			start;			/**< The date from which the timelines run.			*/
+	date_t			end;			/**< The last date covered by the timelines.			*/
+
+	struct forecast_event	*events;		/**< Space for collecting events while building.		*/
+	int			event_count;		/**< The number of events collected.				*/
+	int			event_size;		/**< The number of events which space is allocated for.	*/
+};
+
+/* Static Function Prototypes. */
+
+static struct forecast_timeline *forecast_find_timeline(struct file_block *file, acct_t account);
+static osbool forecast_build(struct forecast_block *instance);
+static osbool forecast_add_movement(struct forecast_block *instance, amt_t *balances, date_t date, acct_t from, acct_t to, amt_t amount);
+static osbool forecast_add_event(struct forecast_block *instance, date_t date, acct_t account, amt_t amount);
+static osbool forecast_build_timeline(struct forecast_timeline *timeline, amt_t balance, date_t start, struct forecast_event *events, int count);
+static int forecast_compare_events(const void *a, const void *b);
+static void forecast_clear_timeline(struct forecast_timeline *timeline);
+
+
+/**
+ * Create a new cash flow forecast instance.
+ *
+ * \param *file			The file to attach the instance to.
+ * \return			The instance handle, or NULL on failure.
+ */
+
+struct forecast_block *forecast_create_instance(struct file_block *file)
+{
+	struct forecast_block	*new;
+
+	new = heap_alloc(sizeof(struct forecast_block));
+	if (new == NULL)
+		return NULL;
+
+	new->file = file;
+
+	new->timelines = NULL;
+	new->account_count = 0;
+
+	new->start = NULL_DATE;
+	new->end = NULL_DATE;
+
+	new->events = NULL;
+	new->event_count = 0;
+	new->event_size = 0;
+
+	return new;
+}
+
+
+/**
+ * Delete a cash flow forecast instance, and all of its data.
+ *
+ * \param *instance		The instance to be deleted.
+ */
+
+void forecast_delete_instance(struct forecast_block *instance)
+{
+	acct_t	account;
+
+	if (instance == NULL)
+		return;
+
+	if (instance->timelines != NULL) {
+		for (account = 0; account < instance->account_count; account++)
+			forecast_clear_timeline(instance->timelines + account);
+
+		heap_free(instance->timelines);
+	}
+
+	heap_free(instance);
+}
+
+
+/**
+ * Discard the forecast held for an account, so that it will be rebuilt
+ * when it is next required.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to discard the forecast for.
+ */
+
+void forecast_invalidate_account(struct file_block *file, acct_t account)
+{
+	if (file == NULL || file->forecast == NULL || account < 0 || account >= file->forecast->account_count)
+		return;
+
+	file->forecast->timelines[account].valid = FALSE;
+}
+
+
+/**
+ * Discard the forecasts held for all of the accounts in a file, so that
+ * they will be rebuilt when they are next required.
+ *
+ * \param *file			The file to discard the forecasts for.
+ */
+
+void forecast_invalidate_all(struct file_block *file)
+{
+	acct_t	account;
+
+	if (file == NULL || file->forecast == NULL)
+		return;
+
+	for (account = 0; account < file->forecast->account_count; account++)
+		file->forecast->timelines[account].valid = FALSE;
+}
+
+
+/**
+ * Return the last date covered by the forecasts for a file.
+ *
+ * \param *file			The file to interrogate.
+ * \return			The last date in the forecasts, or NULL_DATE.
+ */
+
+date_t forecast_get_end_date(struct file_block *file)
+{
+	if (file == NULL || file->forecast == NULL)
+		return NULL_DATE;
+
+	return date_add_period(date_today(), DATE_PERIOD_YEARS, FORECAST_YEARS);
+}
+
+
+/**
+ * Return the forecast balance of an account at the end of a given date.
+ * Dates before today return today's balance, and dates beyond the end of
+ * the forecast return the final balance.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to return the balance for.
+ * \param date			The date to return the balance on.
+ * \return			The forecast balance.
+ */
+
+amt_t forecast_get_balance(struct file_block *file, acct_t account, date_t date)
+{
+	struct forecast_timeline	*timeline;
+	int				low, high, middle;
+
+	timeline = forecast_find_timeline(file, account);
+	if (timeline == NULL)
+		return 0;
+
+	/* Find the last segment starting on or before the date. The first
+	 * segment always starts on the first day of the forecast.
+	 */
+
+	low = 0;
+	high = timeline->segment_count - 1;
+
+	while (low < high) {
+		middle = (low + high + 1) / 2;
+
+		if (timeline->segments[middle].start <= date)
+			low = middle;
+		else
+			high = middle - 1;
+	}
+
+	return timeline->segments[low].balance;
+}
+
+
+/**
+ * Find the lowest forecast balance of an account between today and a
+ * given date.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to search.
+ * \param to			The last date to search, or NULL_DATE to search
+ *				the whole forecast.
+ * \param *date			Pointer to a variable to take the first date on
+ *				which the lowest balance occurs, or NULL.
+ * \return			The lowest forecast balance.
+ */
+
+amt_t forecast_find_lowest_balance(struct file_block *file, acct_t account, date_t to, date_t *date)
+{
+	struct forecast_timeline	*timeline;
+	int				segment, lowest;
+
+	if (date != NULL)
+		*date = NULL_DATE;
+
+	timeline = forecast_find_timeline(file, account);
+	if (timeline == NULL)
+		return 0;
+
+	lowest = 0;
+
+	for (segment = 1; segment < timeline->segment_count && timeline->segments[segment].start <= to; segment++) {
+		if (timeline->segments[segment].balance < timeline->segments[lowest].balance)
+			lowest = segment;
+	}
+
+	if (date != NULL)
+		*date = timeline->segments[lowest].start;
+
+	return timeline->segments[lowest].balance;
+}
+
+
+/**
+ * Find the first date between today and a given date on which the forecast
+ * balance of an account is overdrawn.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to search.
+ * \param to			The last date to search, or NULL_DATE to search
+ *				the whole forecast.
+ * \return			The first overdrawn date, or NULL_DATE if the
+ *				account does not go overdrawn.
+ */
+
+date_t forecast_find_first_overdraft(struct file_block *file, acct_t account, date_t to)
+{
+	struct forecast_timeline	*timeline;
+	int				segment;
+
+	timeline = forecast_find_timeline(file, account);
+	if (timeline == NULL)
+		return NULL_DATE;
+
+	for (segment = 0; segment < timeline->segment_count && timeline->segments[segment].start <= to; segment++) {
+		if (timeline->segments[segment].balance < 0)
+			return timeline->segments[segment].start;
+	}
+
+	return NULL_DATE;
+}
+
+
+/**
+ * Find the timeline for an account, bringing the forecast up to date first
+ * if required.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to find the timeline for.
+ * \return			Pointer to the timeline, or NULL on failure.
+ */
+
+static struct forecast_timeline *forecast_find_timeline(struct file_block *file, acct_t account)
+{
+	struct forecast_block		*instance;
+	struct forecast_timeline	*timelines;
+	int				accounts;
+	date_t				today;
+	acct_t				i;
+
+	if (file == NULL || file->forecast == NULL)
+		return NULL;
+
+	instance = file->forecast;
+
+	today = date_today();
+	accounts = account_get_count(file);
+
+	if (account < 0 || account >= accounts)
+		return NULL;
+
+	/* If the date has moved on, all of the timelines are out of date. */
+
+	if (today != instance->start) {
+		forecast_invalidate_all(file);
+		instance->start = today;
+		instance->end = date_add_period(today, DATE_PERIOD_YEARS, FORECAST_YEARS);
+	}
+
+	/* Make sure that there's a timeline for every account. */
+
+	if (accounts > instance->account_count) {
+		if (instance->timelines == NULL)
+			timelines = heap_alloc(sizeof(struct forecast_timeline) * accounts);
+		else
+			timelines = heap_extend(instance->timelines, sizeof(struct forecast_timeline) * accounts);
+
+		if (timelines == NULL)
+			return NULL;
+
+		for (i = instance->account_count; i < accounts; i++) {
+			timelines[i].segments = NULL;
+			timelines[i].segment_count = 0;
+			timelines[i].valid = FALSE;
+		}
+
+		instance->timelines = timelines;
+		instance->account_count = accounts;
+	}
+
+	if (!instance->timelines[account].valid && !forecast_build(instance))
+		return NULL;
+
+	return instance->timelines + account;
+}
+
+
+/**
+ * Rebuild all of the timelines in a forecast which are out of date, in a
+ * single pass through the file's transactions and standing orders.
+ *
+ * \param *instance		The forecast instance to rebuild.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool forecast_build(struct forecast_block *instance)
+{
+	struct file_block	*file;
+	amt_t			*balances, amount;
+	acct_t			account;
+	tran_t			transaction;
+	sorder_t		sorder;
+	date_t			date;
+	int			first, last, occurrence;
+	osbool			success = TRUE;
+
+	file = instance->file;
+
+	balances = heap_alloc(sizeof(amt_t) * instance->account_count);
+	if (balances == NULL)
+		return FALSE;
+
+	hourglass_on();
+
+	/* Start each timeline which needs to be built from its account's
+	 * opening balance.
+	 */
+
+	for (account = 0; account < instance->account_count; account++) {
+		balances[account] = 0;
+
+		if (!instance->timelines[account].valid)
+			balances[account] = account_get_opening_balance(file, account);
+	}
+
+	instance->event_count = 0;
+
+	/* Collect the dated transactions. Those up to today are added into the
+	 * starting balances, and those up to the end of the forecast become
+	 * events on the timelines. Undated transactions can't be placed, so are
+	 * left out.
+	 */
+
+	for (transaction = 0; success && transaction < transact_get_count(file); transaction++) {
+		date = transact_get_date(file, transaction);
+		if (date == NULL_DATE)
+			continue;
+
+		success = forecast_add_movement(instance, balances, date, transact_get_from(file, transaction),
+				transact_get_to(file, transaction), transact_get_amount(file, transaction));
+	}
+
+	/* Collect the outstanding occurrences of each standing order, up to the
+	 * end of the forecast.
+	 */
+
+	for (sorder = 0; success && sorder < sorder_get_count(file); sorder++) {
+		for (occurrence = 0; success; occurrence++) {
+			date = sorder_get_occurrence(file, sorder, occurrence, &amount);
+			if (date == NULL_DATE || date > instance->end)
+				break;
+
+			success = forecast_add_movement(instance, balances, date, sorder_get_from(file, sorder),
+					sorder_get_to(file, sorder), amount);
+		}
+	}
+
+	/* Sort the events by account and date, then build the timelines from
+	 * the events for each account in turn.
+	 */
+
+	if (success && instance->event_count > 1)
+		qsort(instance->events, instance->event_count, sizeof(struct forecast_event), forecast_compare_events);
+
+	first = 0;
+
+	for (account = 0; success && account < instance->account_count; account++) {
+		for (last = first; last < instance->event_count && instance->events[last].account == account; last++);
+
+		if (!instance->timelines[account].valid) {
+			success = forecast_build_timeline(instance->timelines + account, balances[account],
+					instance->start, instance->events + first, last - first);
+			instance->timelines[account].valid = success;
+		}
+
+		first = last;
+	}
+
+	#ifdef DEBUG
+	debug_printf("Built forecast from %d events", instance->event_count);
+	#endif
+
+	/* Release the event space, which is only needed while building. */
+
+	if (instance->events != NULL) {
+		heap_free(instance->events);
+		instance->events = NULL;
+		instance->event_size = 0;
+	}
+
+	heap_free(balances);
+
+	hourglass_off();
+
+	return success;
+}
+
+
+/**
+ * Record a movement of money between two accounts while building a forecast.
+ *
+ * \param *instance		The forecast instance being built.
+ * \param *balances		The starting balances being accumulated.
+ * \param date			The date of the movement.
+ * \param from			The account from which the money moves.
+ * \param to			The account to which the money moves.
+ * \param amount		The amount of money moved.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool forecast_add_movement(struct forecast_block *instance, amt_t *balances, date_t date, acct_t from, acct_t to, amt_t amount)
+{
+	if (date > instance->end)
+		return TRUE;
+
+	if (from != NULL_ACCOUNT && from < instance->account_count && !instance->timelines[from].valid) {
+		if (date <= instance->start)
+			balances[from] -= amount;
+		else if (!forecast_add_event(instance, date, from, -amount))
+			return FALSE;
+	}
+
+	if (to != NULL_ACCOUNT && to < instance->account_count && !instance->timelines[to].valid) {
+		if (date <= instance->start)
+			balances[to] += amount;
+		else if (!forecast_add_event(instance, date, to, amount))
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Add an event to the list being collected while building a forecast.
+ *
+ * \param *instance		The forecast instance being built.
+ * \param date			The date of the event.
+ * \param account		The account affected by the event.
+ * \param amount		The amount moved into the account.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool forecast_add_event(struct forecast_block *instance, date_t date, acct_t account, amt_t amount)
+{
+	struct forecast_event	*events;
+	int			size;
+
+	if (instance->event_count >= instance->event_size) {
+		size = instance->event_size + ((instance->event_size > FORECAST_EVENT_ALLOCATION) ? instance->event_size : FORECAST_EVENT_ALLOCATION);
+
+		if (instance->events == NULL)
+			events = heap_alloc(sizeof(struct forecast_event) * size);
+		else
+			events = heap_extend(instance->events, sizeof(struct forecast_event) * size);
+
+		if (events == NULL)
+			return FALSE;
+
+		instance->events = events;
+		instance->event_size = size;
+	}
+
+	instance->events[instance->event_count].date = date;
+	instance->events[instance->event_count].account = account;
+	instance->events[instance->event_count].amount = amount;
+
+	instance->event_count++;
+
+	return TRUE;
+}
+
+
+/**
+ * Build the timeline for an account from its starting balance and events.
+ *
+ * \param *timeline		The timeline to be built.
+ * \param balance		The account's balance at the start of the forecast.
+ * \param start			The date on which the forecast starts.
+ * \param *events		The account's events, in date order.
+ * \param count			The number of events.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool forecast_build_timeline(struct forecast_timeline *timeline, amt_t balance, date_t start, struct forecast_event *events, int count)
+{
+	struct forecast_segment	*segments;
+	int			event;
+
+	forecast_clear_timeline(timeline);
+
+	/* There can be no more segments than there are events, plus the
+	 * starting balance.
+	 */
+
+	segments = heap_alloc(sizeof(struct forecast_segment) * (count + 1));
+	if (segments == NULL)
+		return FALSE;
+
+	timeline->segments = segments;
+
+	segments[0].start = start;
+	segments[0].balance = balance;
+	timeline->segment_count = 1;
+
+	/* Apply all of the events on each date together, and only start a new
+	 * segment if the balance has actually changed.
+	 */
+
+	for (event = 0; event < count; event++) {
+		balance += events[event].amount;
+
+		if (event + 1 < count && events[event + 1].date == events[event].date)
+			continue;
+
+		if (balance == segments[timeline->segment_count - 1].balance)
+			continue;
+
+		segments[timeline->segment_count].start = events[event].date;
+		segments[timeline->segment_count].balance = balance;
+		timeline->segment_count++;
+	}
+
+	/* Give back any space that wasn't needed. */
+
+	if (timeline->segment_count < count + 1) {
+		segments = heap_extend(timeline->segments, sizeof(struct forecast_segment) * timeline->segment_count);
+		if (segments != NULL)
+			timeline->segments = segments;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Compare two forecast events for qsort(), ordering them by account and
+ * then by date.
+ *
+ * \param *a			The first event to compare.
+ * \param *b			The second event to compare.
+ * \return			The result of the comparison.
+ */
+
+static int forecast_compare_events(const void *a, const void *b)
+{
+	const struct forecast_event	*first = a, *second = b;
+
+	if (first->account != second->account)
+		return (first->account < second->account) ? -1 : 1;
+
+	if (first->date != second->date)
+		return (first->date < second->date) ? -1 : 1;
+
+	return 0;
+}
+
+
+/**
+ * Free the segments held in a timeline, leaving it empty and out of date.
+ *
+ * \param *timeline		The timeline to clear.
+ */
+
+static void forecast_clear_timeline(struct forecast_timeline *timeline)
+{
+	if (timeline->segments != NULL)
+		heap_free(timeline->segments);
+
+	timeline->segments = NULL;
+	timeline->segment_count = 0;
+	timeline->valid = FALSE;
+}
+
@@ -0,0 +1,146 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: forecast.h
+ *
+ * Cash flow forecasting interface.
+ */
+
+#ifndef CASHBOOK_FORECAST
+#define CASHBOOK_FORECAST
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+
+/**
+ * The number of years ahead which forecasts cover.
+ */
+
+#define FORECAST_YEARS 5
+
+/**
+ * A cash flow forecast instance handle.
+ */
+
+struct forecast_block;
+
+
+/**
+ * Create a new cash flow forecast instance.
+ *
+ * \param *file			The file to attach the instance to.
+ * \return			The instance handle, or NULL on failure.
+ */
+
+struct forecast_block *forecast_create_instance(struct file_block *file);
+
+
+/**
+ * Delete a cash flow forecast instance, and all of its data.
+ *
+ * \param *instance		The instance to be deleted.
+ */
+
+void forecast_delete_instance(struct forecast_block *instance);
+
+
+/**
+ * Discard the forecast held for an account, so that it will be rebuilt
+ * when it is next required.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to discard the forecast for.
+ */
+
+void forecast_invalidate_account(struct file_block *file, acct_t account);
+
+
+/**
+ * Discard the forecasts held for all of the accounts in a file, so that
+ * they will be rebuilt when they are next required.
+ *
+ * \param *file			The file to discard the forecasts for.
+ */
+
+void forecast_invalidate_all(struct file_block *file);
+
+
+/**
+ * Return the last date covered by the forecasts for a file.
+ *
+ * \param *file			The file to interrogate.
+ * \return			The last date in the forecasts, or NULL_DATE.
+ */
+
+date_t forecast_get_end_date(struct file_block *file);
+
+
+/**
+ * Return the forecast balance of an account at the end of a given date.
+ * Dates before today return today's balance, and dates beyond the end of
+ * the forecast return the final balance.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to return the balance for.
+ * \param date			The date to return the balance on.
+ * \return			The forecast balance.
+ */
+
+amt_t forecast_get_balance(struct file_block *file, acct_t account, date_t date);
+
+
+/**
+ * Find the lowest forecast balance of an account between today and a
+ * given date.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to search.
+ * \param to			The last date to search, or NULL_DATE to search
+ *				the whole forecast.
+ * \param *date			Pointer to a variable to take the first date on
+ *				which the lowest balance occurs, or NULL.
+ * \return			The lowest forecast balance.
+ */
+
+amt_t forecast_find_lowest_balance(struct file_block *file, acct_t account, date_t to, date_t *date);
+
+
+/**
+ * Find the first date between today and a given date on which the forecast
+ * balance of an account is overdrawn.
+ *
+ * \param *file			The file containing the account.
+ * \param account		The account to search.
+ * \param to			The last date to search, or NULL_DATE to search
+ *				the whole forecast.
+ * \return			The first overdrawn date, or NULL_DATE if the
+ *				account does not go overdrawn.
+ */
+
+date_t forecast_find_first_overdraft(struct file_block *file, acct_t account, date_t to);
+
+#endif
+
@@ -0,0 +1,189 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+
+/**
+ * \file: forecast_report.c
+ *
+ * Cash Flow Forecast Report implementation.
+ */
+
+/* ANSI C header files */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/hourglass.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/msgs.h"
+#include "sflib/string.h"
+
+/* Application header files */
+
+#include "global.h"
+#include "forecast_report.h"
+
+#include "account.h"
+#include "currency.h"
+#include "date.h"
+#include "file.h"
+#include "forecast.h"
+#include "report.h"
+#include "stringbuild.h"
+
+
+/* Buffers used in the forecast report. */
+
+#define FORECAST_REPORT_LINE_LENGTH 1024
+#define FORECAST_REPORT_BUF1_LENGTH 256
+#define FORECAST_REPORT_BUF2_LENGTH 32
+
+/* Static Function Prototypes. */
+
+static void forecast_report_write_field(struct report *report, char *token, enum report_cell_flags flags, char *value);
+
+
+/**
+ * Generate a report showing the forecast balances of all of the accounts
+ * in a file.
+ *
+ * \param *file			The file to report on.
+ */
+
+void forecast_report(struct file_block *file)
+{
+	struct report			*report;
+	acct_t				account;
+	int				year;
+	date_t				today, end, date;
+	amt_t				balance;
+	char				line[FORECAST_REPORT_LINE_LENGTH], numbuf1[FORECAST_REPORT_BUF1_LENGTH], numbuf2[FORECAST_REPORT_BUF2_LENGTH];
+	struct stringbuild_block	builder;
+
+	if (file == NULL || file->forecast == NULL)
+		return;
+
+	if (!stringbuild_initialise(&builder, line, FORECAST_REPORT_LINE_LENGTH))
+		return;
+
+	msgs_lookup("FCRWinT", line, FORECAST_REPORT_LINE_LENGTH);
+	report = report_open(file, line, NULL);
+
+	if (report == NULL) {
+		stringbuild_cancel(&builder);
+		return;
+	}
+
+	hourglass_on();
+
+	today = date_today();
+	end = forecast_get_end_date(file);
+
+	stringbuild_reset(&builder);
+	stringbuild_add_message_param(&builder, "FCRTitle", file_get_leafname(file, NULL, 0), NULL, NULL, NULL);
+	stringbuild_report_line(&builder, report, 0);
+
+	stringbuild_reset(&builder);
+	date_convert_to_string(today, numbuf1, FORECAST_REPORT_BUF1_LENGTH);
+	date_convert_to_string(end, numbuf2, FORECAST_REPORT_BUF2_LENGTH);
+	stringbuild_add_message_param(&builder, "FCRHeader", numbuf1, numbuf2, NULL, NULL);
+	stringbuild_report_line(&builder, report, 0);
+
+	/* Output the forecast for each of the full accounts in turn. */
+
+	for (account = 0; account < account_get_count(file); account++) {
+		if ((account_get_type(file, account) & ACCOUNT_FULL) == 0)
+			continue;
+
+		report_write_line(report, 0, ""); /* Separate each entry with a blank line. */
+
+		report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+		report_add_text_cell(report, 0, REPORT_CELL_FLAGS_UNDERLINE, account_get_name(file, account));
+		report_end_line(report);
+
+		currency_convert_to_string(forecast_get_balance(file, account, today), numbuf1, FORECAST_REPORT_BUF1_LENGTH);
+		forecast_report_write_field(report, "FCRToday", REPORT_CELL_FLAGS_NUMERIC, numbuf1);
+
+		for (year = 1; year <= FORECAST_YEARS; year++) {
+			date = date_add_period(today, DATE_PERIOD_YEARS, year);
+
+			string_printf(numbuf2, FORECAST_REPORT_BUF2_LENGTH, "%d", year);
+			currency_convert_to_string(forecast_get_balance(file, account, date), numbuf1, FORECAST_REPORT_BUF1_LENGTH);
+
+			report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+			report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, (year == 1) ? "FCRYear" : "FCRYears", numbuf2, NULL, NULL, NULL);
+			report_add_text_cell(report, 1, REPORT_CELL_FLAGS_NUMERIC, numbuf1);
+			report_end_line(report);
+		}
+
+		balance = forecast_find_lowest_balance(file, account, NULL_DATE, &date);
+
+		currency_convert_to_string(balance, numbuf1, FORECAST_REPORT_BUF1_LENGTH);
+		date_convert_to_string(date, numbuf2, FORECAST_REPORT_BUF2_LENGTH);
+		report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, "FCRLowest", NULL, NULL, NULL, NULL);
+		report_add_message_cell(report, 1, REPORT_CELL_FLAGS_NONE, "FCRLowestValue", numbuf1, numbuf2, NULL, NULL);
+		report_end_line(report);
+
+		date = forecast_find_first_overdraft(file, account, NULL_DATE);
+
+		if (date != NULL_DATE)
+			date_convert_to_string(date, numbuf1, FORECAST_REPORT_BUF1_LENGTH);
+		else
+			msgs_lookup("FCRNotOverdrawn", numbuf1, FORECAST_REPORT_BUF1_LENGTH);
+		forecast_report_write_field(report, "FCROverdrawn", REPORT_CELL_FLAGS_NONE, numbuf1);
+	}
+
+	/* Close the report. */
+
+	stringbuild_cancel(&builder);
+
+	report_close(report);
+
+	hourglass_off();
+}
+
+
+/**
+ * Write a labelled field to the forecast report.
+ *
+ * \param *report		The report to write to.
+ * \param *token		The message token for the field's label.
+ * \param flags			The flags to apply to the field's value.
+ * \param *value		The value to show in the field.
+ */
+
+static void forecast_report_write_field(struct report *report, char *token, enum report_cell_flags flags, char *value)
+{
+	report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+	report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, token, NULL, NULL, NULL, NULL);
+	report_add_text_cell(report, 1, flags, value);
+	report_end_line(report);
+}
+
@@ -70,6 +70,19 @@ struct purge_block;
  * Main file data structure
  */
 
+/**
+ * Side effects which can be deferred until the end of a batch update.
+ */
+
+enum file_batch_effects {
+	FILE_BATCH_NONE = 0x00,					/**< No deferred side effects.						*/
+	FILE_BATCH_TRANSACT_MEMORY = 0x01,			/**< The transaction data block has spare space to release.		*/
+	FILE_BATCH_TRANSACT_WINDOW = 0x02,			/**< The transaction list window needs resizing and redrawing.		*/
+	FILE_BATCH_TRANSACT_SORT = 0x04,			/**< The transaction list window needs sorting.				*/
+	FILE_BATCH_ACCOUNT_WINDOWS = 0x08,			/**< The account list windows need recalculating and redrawing.		*/
+	FILE_BATCH_ACCVIEWS = 0x10				/**< The open account views need rebuilding.				*/
+};
+
 /* File data struct. */
 
 struct file_block
@@ -77,6 +90,7 @@ struct file_block
 	/* Data integrity. */
 
 	osbool				modified;				/**< TRUE if the file has unsaved modifications.		*/
+	unsigned			data_version;				/**< Count of the changes made to the file's data.		*/
 	int				untitled_count;				/**< Count to allow default title of the form <Untitled n>.	*/
 	int				child_x_offset;				/**< Count for child window opening offset.			*/
 
@@ -85,6 +99,11 @@ struct file_block
 	char				filename[FILE_MAX_FILENAME];		/**< The filename on disc; if "", it hasn't been saved before.	*/
 	os_date_and_time		datestamp;				/**< The datestamp of when the file was last saved.		*/
 
+	/* Batch updates. */
+
+	int				batch_depth;				/**< The number of nested batch updates in progress.		*/
+	enum file_batch_effects		batch_effects;				/**< The side effects deferred until the batch completes.	*/
+
 	/* Details of the attached windows. */
 
 	struct transact_block		*transacts;				/**< Data relating to the transaction module.			*/
@@ -116,6 +135,14 @@ struct file_block
 
 	struct analysis_block		*analysis;				/**< Data relating to the analysis report module.		*/
 
+	/* Cash Flow Forecasts */
+
+	struct forecast_block		*forecast;				/**< Data relating to the cash flow forecast module.		*/
+
+	/* Transaction Archive */
+
+	struct archive_block		*archive;				/**< Data relating to the transaction archive.			*/
+
 	/* Dialogue Content. */
 
 	struct goto_block		*go_to;					/**< Data relating to the goto module.				*/
@@ -142,6 +142,10 @@ static char			interest_decimal_point = '.';			/**< The character to use for a de
 
 static struct sort_callback	interest_sort_callbacks;
 
+/* Interest Rate timeline sorting. */
+
+static struct interest_rate	*interest_timeline_rates = NULL;		/**< The rates being sorted while the timeline index is rebuilt.	*/
+
 /**
  * Interest Rate entry data structure.
  */
@@ -197,6 +201,11 @@ struct interest_block {
 	int			display_count;
 	int			display_lines;
 
+	/* The rate timelines. */
+
+	int			*timeline;					/**< The rates, indexed by account, effective date and minimum balance.	*/
+	int			timeline_size;					/**< The number of entries allocated for the timeline index.		*/
+	osbool			timeline_valid;					/**< TRUE if the timeline index is up to date; else FALSE.		*/
 };
 
 /* Static function prototypes. */
@@ -211,6 +220,11 @@ static void		interest_adjust_sort_icon_data(struct interest_block *windat, wimp_
 static void		interest_set_window_extent(struct interest_block *windat);
 static void		interest_force_window_redraw(struct interest_block *windat, int from, int to, wimp_i column);
 static void		interest_decode_window_help(char *buffer, wimp_w w, wimp_i i, os_coord pos, wimp_mouse_state buttons);
+static int		interest_find_timeline_entry(struct interest_block *instance, acct_t account, date_t date);
+static osbool		interest_extend_timeline(struct interest_block *instance);
+static osbool		interest_rebuild_timeline(struct interest_block *instance);
+static int		interest_compare_timeline_entries(const void *a, const void *b);
+static int		interest_compare_rates(struct interest_rate *first, struct interest_rate *second);
 
 
 
@@ -273,6 +287,10 @@ struct interest_block *interest_create_instance(struct file_block *file)
 	new->display_count = 0;
 	new->display_lines = 0;
 
+	new->timeline = NULL;
+	new->timeline_size = 0;
+	new->timeline_valid = FALSE;
+
 	new->active_account = NULL_ACCOUNT;
 
 	/* Initialise the window columns. */
@@ -333,6 +351,9 @@ void interest_delete_instance(struct interest_block *instance)
 	if (instance->display_index != NULL)
 		flexutils_free((void **) &(instance->display_index));
 
+	if (instance->timeline != NULL)
+		heap_free(instance->timeline);
+
 	heap_free(instance);
 }
 
@@ -515,6 +536,7 @@ void interest_delete_window(struct interest_block *instance, acct_t account)
 	if (instance->interest_window != NULL) {
 		ihelp_remove_window(instance->interest_window);
 		event_delete_window(instance->interest_window);
+		window_cancel_redraws(instance->interest_window);
 		wimp_delete_window(instance->interest_window);
 		instance->interest_window = NULL;
 	}
@@ -901,7 +923,7 @@ static void interest_force_window_redraw(struct interest_block *windat, int from
 	window.extent.y1 = WINDOW_ROW_TOP(INTEREST_TOOLBAR_HEIGHT, from);
 	window.extent.y0 = WINDOW_ROW_BASE(INTEREST_TOOLBAR_HEIGHT, to);
 
-	wimp_force_redraw(windat->interest_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
+	window_queue_redraw(windat->interest_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
 }
 
 
@@ -945,7 +967,9 @@ static void interest_decode_window_help(char *buffer, wimp_w w, wimp_i i, os_coo
 
 /**
  * Return an interest rate for a given account on a given date. Returns
- * NULL_RATE on failure.
+ * NULL_RATE on failure. Where several rates take effect on the same date
+ * for different minimum balances, the rate with the lowest minimum balance
+ * is returned.
  *
  * \param *instance		The interest rate module instance to use.
  * \param account		The account to return an interest rate for.
@@ -955,7 +979,294 @@ static void interest_decode_window_help(char *buffer, wimp_w w, wimp_i i, os_coo
 
 rate_t interest_get_current_rate(struct interest_block *instance, acct_t account, date_t date)
 {
-	return NULL_RATE;
+	int	entry;
+
+	entry = interest_find_timeline_entry(instance, account, date);
+	if (entry == -1)
+		return NULL_RATE;
+
+	return instance->rates[instance->timeline[entry]].rate;
+}
+
+
+/**
+ * Return the interest rate which applies to a given balance in an account
+ * on a given date, taking into account the minimum balances of the rates
+ * in force. Returns NULL_RATE if no rate applies.
+ *
+ * \param *instance		The interest rate module instance to use.
+ * \param account		The account to return an interest rate for.
+ * \param date			The date to return the rate for.
+ * \param balance		The balance to return the rate for.
+ * \return			The interest rate on the date in question.
+ */
+
+rate_t interest_get_rate_for_balance(struct interest_block *instance, acct_t account, date_t date, amt_t balance)
+{
+	struct interest_rate	*first, *next;
+	int			entry;
+	rate_t			rate = NULL_RATE;
+
+	entry = interest_find_timeline_entry(instance, account, date);
+	if (entry == -1)
+		return NULL_RATE;
+
+	/* Step through the rates which took effect on the same date, which
+	 * are in order of minimum balance, until the balance isn't reached.
+	 */
+
+	first = instance->rates + instance->timeline[entry];
+
+	while (entry < instance->rate_count) {
+		next = instance->rates + instance->timeline[entry++];
+
+		if (next->account != first->account || next->effective_date != first->effective_date || next->minimum_balance > balance)
+			break;
+
+		rate = next->rate;
+	}
+
+	return rate;
+}
+
+
+/**
+ * Return the date of the first change to the interest rates of an account
+ * which comes after a given date.
+ *
+ * \param *instance		The interest rate module instance to use.
+ * \param account		The account to look up.
+ * \param date			The date to search after.
+ * \return			The date of the next change, or NULL_DATE if
+ *				there are none.
+ */
+
+date_t interest_get_next_change(struct interest_block *instance, acct_t account, date_t date)
+{
+	struct interest_rate	*next;
+	int			low, high, middle;
+
+	if (instance == NULL || (!instance->timeline_valid && !interest_rebuild_timeline(instance)))
+		return NULL_DATE;
+
+	/* Find the first entry in the timeline which comes after the date. */
+
+	low = 0;
+	high = instance->rate_count;
+
+	while (low < high) {
+		middle = (low + high) / 2;
+		next = instance->rates + instance->timeline[middle];
+
+		if (next->account < account || (next->account == account && next->effective_date <= date))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low >= instance->rate_count || instance->rates[instance->timeline[low]].account != account)
+		return NULL_DATE;
+
+	return instance->rates[instance->timeline[low]].effective_date;
+}
+
+
+/**
+ * Return the fraction of a balance which is earned in interest for each
+ * day on which a given rate is in force, on the basis of a 365 day year.
+ *
+ * \param rate			The interest rate to convert.
+ * \return			The daily interest factor, or 0 if the rate
+ *				is NULL_RATE.
+ */
+
+double interest_get_daily_factor(rate_t rate)
+{
+	double	divisor;
+	int	place;
+
+	if (rate == NULL_RATE)
+		return 0.0;
+
+	/* Rates are held as percentages, with interest_decimal_places
+	 * implied decimal places.
+	 */
+
+	divisor = 100.0 * 365.0;
+
+	for (place = 0; place < interest_decimal_places; place++)
+		divisor *= 10.0;
+
+	return (double) rate / divisor;
+}
+
+
+/**
+ * Find the first entry in the rate timeline index for the rates in force
+ * on a given date for an account, rebuilding the index if required.
+ *
+ * \param *instance		The interest rate module instance to use.
+ * \param account		The account to look up.
+ * \param date			The date to look up.
+ * \return			The index of the first timeline entry for the
+ *				rates in force, or -1 if none are.
+ */
+
+static int interest_find_timeline_entry(struct interest_block *instance, acct_t account, date_t date)
+{
+	struct interest_rate	*next;
+	int			low, high, middle;
+	date_t			effective_date;
+
+	if (instance == NULL || account == NULL_ACCOUNT || date == NULL_DATE)
+		return -1;
+
+	if (!instance->timeline_valid && !interest_rebuild_timeline(instance))
+		return -1;
+
+	/* Find the last entry for the account which takes effect on or before
+	 * the date.
+	 */
+
+	low = 0;
+	high = instance->rate_count;
+
+	while (low < high) {
+		middle = (low + high) / 2;
+		next = instance->rates + instance->timeline[middle];
+
+		if (next->account < account || (next->account == account && next->effective_date <= date))
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if (low == 0 || instance->rates[instance->timeline[low - 1]].account != account)
+		return -1;
+
+	/* Step back to the first of the rates which took effect on that date. */
+
+	effective_date = instance->rates[instance->timeline[--low]].effective_date;
+
+	while (low > 0 && instance->rates[instance->timeline[low - 1]].account == account &&
+			instance->rates[instance->timeline[low - 1]].effective_date == effective_date)
+		low--;
+
+	return low;
+}
+
+
+/**
+ * Make sure that the rate timeline index has room for every rate.
+ *
+ * \param *instance		The interest rate module instance to use.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool interest_extend_timeline(struct interest_block *instance)
+{
+	int	*timeline;
+
+	if (instance->timeline_size >= instance->rate_count)
+		return TRUE;
+
+	if (instance->timeline == NULL)
+		timeline = heap_alloc(sizeof(int) * instance->rate_count);
+	else
+		timeline = heap_extend(instance->timeline, sizeof(int) * instance->rate_count);
+
+	if (timeline == NULL)
+		return FALSE;
+
+	instance->timeline = timeline;
+	instance->timeline_size = instance->rate_count;
+
+	return TRUE;
+}
+
+
+/**
+ * Rebuild the rate timeline index from scratch, sorting the rates by
+ * account, effective date and minimum balance.
+ *
+ * \param *instance		The interest rate module instance to use.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool interest_rebuild_timeline(struct interest_block *instance)
+{
+	int	rate;
+
+	if (instance == NULL || !interest_extend_timeline(instance))
+		return FALSE;
+
+	for (rate = 0; rate < instance->rate_count; rate++)
+		instance->timeline[rate] = rate;
+
+	/* The rates are held in a flex block, but nothing can move it while
+	 * the sort is in progress.
+	 */
+
+	interest_timeline_rates = instance->rates;
+
+	if (instance->rate_count > 1)
+		qsort(instance->timeline, instance->rate_count, sizeof(int), interest_compare_timeline_entries);
+
+	interest_timeline_rates = NULL;
+
+	instance->timeline_valid = TRUE;
+
+	return TRUE;
+}
+
+
+/**
+ * Compare two entries in the rate timeline index for qsort(), using the
+ * rates which they refer to.
+ *
+ * \param *a			The first entry to compare.
+ * \param *b			The second entry to compare.
+ * \return			The result of the comparison.
+ */
+
+static int interest_compare_timeline_entries(const void *a, const void *b)
+{
+	int	first = *((const int *) a), second = *((const int *) b);
+	int	result;
+
+	result = interest_compare_rates(interest_timeline_rates + first, interest_timeline_rates + second);
+
+	/* Rates which are otherwise equal stay in the order that they were
+	 * entered.
+	 */
+
+	if (result == 0)
+		result = (first < second) ? -1 : ((first > second) ? 1 : 0);
+
+	return result;
+}
+
+
+/**
+ * Compare two interest rates by account, effective date and minimum balance.
+ *
+ * \param *first		The first rate to compare.
+ * \param *second		The second rate to compare.
+ * \return			The result of the comparison.
+ */
+
+static int interest_compare_rates(struct interest_rate *first, struct interest_rate *second)
+{
+	if (first->account != second->account)
+		return (first->account < second->account) ? -1 : 1;
+
+	if (first->effective_date != second->effective_date)
+		return (first->effective_date < second->effective_date) ? -1 : 1;
+
+	if (first->minimum_balance != second->minimum_balance)
+		return (first->minimum_balance < second->minimum_balance) ? -1 : 1;
+
+	return 0;
 }
 
 
@@ -1159,5 +1470,12 @@ osbool interest_read_file(struct file_block *file, struct filing_block *in)
 		return FALSE;
 	}
 
+	/* Sort the new rates into their timelines. */
+
+	if (!interest_rebuild_timeline(file->interest)) {
+		filing_set_status(in, FILING_STATUS_MEMORY);
+		return FALSE;
+	}
+
 	return TRUE;
 }
@@ -57,6 +57,7 @@ struct interest_block;
 #include "global.h"
 
 #include "account.h"
+#include "currency.h"
 #include "date.h"
 
 /**
@@ -129,7 +130,9 @@ void interest_redraw_all(struct file_block *file);
 
 /**
  * Return an interest rate for a given account on a given date. Returns
- * NULL_RATE on failure.
+ * NULL_RATE on failure. Where several rates take effect on the same date
+ * for different minimum balances, the rate with the lowest minimum balance
+ * is returned.
  *
  * \param *instance		The interest rate module instance to use.
  * \param account		The account to return an interest rate for.
@@ -140,6 +143,47 @@ void interest_redraw_all(struct file_block *file);
 rate_t interest_get_current_rate(struct interest_block *instance, acct_t account, date_t date);
 
 
+/**
+ * Return the interest rate which applies to a given balance in an account
+ * on a given date, taking into account the minimum balances of the rates
+ * in force. Returns NULL_RATE if no rate applies.
+ *
+ * \param *instance		The interest rate module instance to use.
+ * \param account		The account to return an interest rate for.
+ * \param date			The date to return the rate for.
+ * \param balance		The balance to return the rate for.
+ * \return			The interest rate on the date in question.
+ */
+
+rate_t interest_get_rate_for_balance(struct interest_block *instance, acct_t account, date_t date, amt_t balance);
+
+
+/**
+ * Return the date of the first change to the interest rates of an account
+ * which comes after a given date.
+ *
+ * \param *instance		The interest rate module instance to use.
+ * \param account		The account to look up.
+ * \param date			The date to search after.
+ * \return			The date of the next change, or NULL_DATE if
+ *				there are none.
+ */
+
+date_t interest_get_next_change(struct interest_block *instance, acct_t account, date_t date);
+
+
+/**
+ * Return the fraction of a balance which is earned in interest for each
+ * day on which a given rate is in force, on the basis of a 365 day year.
+ *
+ * \param rate			The interest rate to convert.
+ * \return			The daily interest factor, or 0 if the rate
+ *				is NULL_RATE.
+ */
+
+double interest_get_daily_factor(rate_t rate);
+
+
 /**
  * Convert an interest rate into a string, placing the result into a
  * supplied buffer.
@@ -0,0 +1,244 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: linecache.c
+ *
+ * Cache of pre-formatted text for list window redraws.
+ *
+ * Each list window can hold the text that it has formatted for its
+ * lines (dates, amounts, account names and the like) in a small
+ * direct-mapped cache keyed on the index of the underlying record. Each
+ * entry carries a stamp from the cache's current generation: discarding
+ * a single key clears its entry, while discarding everything simply
+ * bumps the generation so that all existing entries become stale.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/heap.h"
+
+/* Application header files */
+
+#include "linecache.h"
+
+
+/**
+ * The key used to mark an unused entry.
+ */
+
+#define LINECACHE_NO_KEY (-1)
+
+/**
+ * A Line Cache entry header.
+ */
+
+struct linecache_entry {
+	int			key;			/**< The key held in the entry, or LINECACHE_NO_KEY.		*/
+	unsigned		stamp;			/**< The cache generation in which the entry was filled.	*/
+};
+
+/**
+ * A Line Cache instance.
+ */
+
+struct linecache_block {
+	size_t			lines;			/**< The number of lines held in the cache.			*/
+	size_t			line_size;		/**< The size of a line of client data, in bytes.		*/
+
+	unsigned		stamp;			/**< The current cache generation.				*/
+
+	struct linecache_entry	*entries;		/**< The array of entry headers.				*/
+	char			*data;			/**< The block of client line data.				*/
+};
+
+/* Static Function Prototypes. */
+
+static void linecache_clear_entries(struct linecache_block *handle);
+
+
+/**
+ * Create a new Line Cache instance, able to hold the formatted text for
+ * a number of window lines at once.
+ *
+ * \param lines			The number of lines to hold in the cache.
+ * \param line_size		The size of the client's per-line data, in bytes.
+ * \return			The new instance handle, or NULL on failure.
+ */
+
+struct linecache_block *linecache_create(size_t lines, size_t line_size)
+{
+	struct linecache_block	*new;
+
+	if (lines == 0 || line_size == 0)
+		return NULL;
+
+	new = heap_alloc(sizeof(struct linecache_block));
+	if (new == NULL)
+		return NULL;
+
+	new->lines = lines;
+	new->line_size = line_size;
+	new->stamp = 0;
+
+	new->entries = heap_alloc(sizeof(struct linecache_entry) * lines);
+	new->data = heap_alloc(line_size * lines);
+
+	if (new->entries == NULL || new->data == NULL) {
+		linecache_destroy(new);
+		return NULL;
+	}
+
+	linecache_clear_entries(new);
+
+	return new;
+}
+
+
+/**
+ * Destroy a Line Cache instance, freeing the memory associated with it.
+ *
+ * \param *handle		The instance to be destroyed.
+ */
+
+void linecache_destroy(struct linecache_block *handle)
+{
+	if (handle == NULL)
+		return;
+
+	if (handle->entries != NULL)
+		heap_free(handle->entries);
+
+	if (handle->data != NULL)
+		heap_free(handle->data);
+
+	heap_free(handle);
+}
+
+
+/**
+ * Find the cached data for a key in a Line Cache instance. If the key is
+ * not currently cached, its slot is claimed and the client is expected to
+ * fill the returned block before it is next used.
+ *
+ * \param *handle		The instance to look the key up in.
+ * \param key			The key to look up, which must not be negative.
+ * \param *valid		Pointer to a variable to take TRUE if the
+ *				returned data is already valid; else FALSE.
+ * \return			Pointer to the cached line data, or NULL.
+ */
+
+void *linecache_find(struct linecache_block *handle, int key, osbool *valid)
+{
+	struct linecache_entry	*entry;
+	size_t			slot;
+
+	if (valid != NULL)
+		*valid = FALSE;
+
+	if (handle == NULL || key < 0)
+		return NULL;
+
+	slot = key % handle->lines;
+	entry = handle->entries + slot;
+
+	if (entry->key == key && entry->stamp == handle->stamp) {
+		if (valid != NULL)
+			*valid = TRUE;
+	} else {
+		entry->key = key;
+		entry->stamp = handle->stamp;
+	}
+
+	return handle->data + (slot * handle->line_size);
+}
+
+
+/**
+ * Discard any cached data held for a single key in a Line Cache instance.
+ *
+ * \param *handle		The instance to update.
+ * \param key			The key to be discarded.
+ */
+
+void linecache_invalidate(struct linecache_block *handle, int key)
+{
+	struct linecache_entry	*entry;
+
+	if (handle == NULL || key < 0)
+		return;
+
+	entry = handle->entries + (key % handle->lines);
+
+	if (entry->key == key)
+		entry->key = LINECACHE_NO_KEY;
+}
+
+
+/**
+ * Discard all of the data held in a Line Cache instance.
+ *
+ * \param *handle		The instance to update.
+ */
+
+void linecache_invalidate_all(struct linecache_block *handle)
+{
+	if (handle == NULL)
+		return;
+
+	/* If the generation counter wraps around, old entries could become
+	 * valid again, so clear them all out explicitly.
+	 */
+
+	if (++handle->stamp == 0)
+		linecache_clear_entries(handle);
+}
+
+
+/**
+ * Mark all of the entries in a Line Cache instance as unused.
+ *
+ * \param *handle		The instance to clear.
+ */
+
+static void linecache_clear_entries(struct linecache_block *handle)
+{
+	size_t	i;
+
+	if (handle == NULL || handle->entries == NULL)
+		return;
+
+	for (i = 0; i < handle->lines; i++) {
+		handle->entries[i].key = LINECACHE_NO_KEY;
+		handle->entries[i].stamp = 0;
+	}
+}
+
@@ -0,0 +1,98 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: linecache.h
+ *
+ * Cache of pre-formatted text for list window redraws.
+ */
+
+#ifndef CASHBOOK_LINECACHE
+#define CASHBOOK_LINECACHE
+
+#include <stdlib.h>
+#include "oslib/types.h"
+
+/**
+ * A Line Cache instance handle.
+ */
+
+struct linecache_block;
+
+
+/**
+ * Create a new Line Cache instance, able to hold the formatted text for
+ * a number of window lines at once.
+ *
+ * \param lines			The number of lines to hold in the cache.
+ * \param line_size		The size of the client's per-line data, in bytes.
+ * \return			The new instance handle, or NULL on failure.
+ */
+
+struct linecache_block *linecache_create(size_t lines, size_t line_size);
+
+
+/**
+ * Destroy a Line Cache instance, freeing the memory associated with it.
+ *
+ * \param *handle		The instance to be destroyed.
+ */
+
+void linecache_destroy(struct linecache_block *handle);
+
+
+/**
+ * Find the cached data for a key in a Line Cache instance. If the key is
+ * not currently cached, its slot is claimed and the client is expected to
+ * fill the returned block before it is next used.
+ *
+ * \param *handle		The instance to look the key up in.
+ * \param key			The key to look up, which must not be negative.
+ * \param *valid		Pointer to a variable to take TRUE if the
+ *				returned data is already valid; else FALSE.
+ * \return			Pointer to the cached line data, or NULL.
+ */
+
+void *linecache_find(struct linecache_block *handle, int key, osbool *valid);
+
+
+/**
+ * Discard any cached data held for a single key in a Line Cache instance.
+ *
+ * \param *handle		The instance to update.
+ * \param key			The key to be discarded.
+ */
+
+void linecache_invalidate(struct linecache_block *handle, int key);
+
+
+/**
+ * Discard all of the data held in a Line Cache instance.
+ *
+ * \param *handle		The instance to update.
+ */
+
+void linecache_invalidate_all(struct linecache_block *handle);
+
+#endif
+
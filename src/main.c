@@ -164,7 +164,19 @@ static void main_poll_loop(void)
 	poll_time = os_read_monotonic_time();
 
 	while (!main_quit_flag) {
-		reason = wimp_poll_idle(0, &blk, poll_time, NULL);
+		/* Pass on any window redraws which were queued up while
+		 * processing the previous event, so that the Wimp only sees
+		 * one request for each area affected.
+		 */
+
+		window_flush_redraws();
+
+		/* If there are reports still being generated or paginated, ask
+		 * for a Null Event straight away so that the work can continue.
+		 */
+
+		reason = wimp_poll_idle(0, &blk, (analysis_generate_pending() || report_paginate_pending()) ?
+				os_read_monotonic_time() : poll_time, NULL);
 
 		/* Events are passed to Event Lib first; only if this fails
 		 * to handle them do they get passed on to the internal
@@ -174,8 +186,13 @@ static void main_poll_loop(void)
 		if (!event_process_event(reason, &blk, 0, NULL)) {
 			switch (reason) {
 			case wimp_NULL_REASON_CODE:
-				poll_time += 6000; /* Wait for a minute for the next Null poll */
-				main_process_date_change();
+				analysis_generate_in_background();
+				report_paginate_in_background();
+
+				if ((int) (os_read_monotonic_time() - poll_time) >= 0) {
+					poll_time += 6000; /* Wait for a minute for the next Null poll */
+					main_process_date_change();
+				}
 				break;
 
 			case wimp_OPEN_WINDOW_REQUEST:
@@ -305,6 +322,8 @@ static void main_initialise(void)
 	config_opt_init("ReportShowTitle", TRUE);					/**< Show report titles in the header on each report page.		*/
 	config_opt_init("ReportShowPageNum", TRUE);					/**< Show page numbers in the footer on each report page.		*/
 	config_opt_init("ReportShowGrid", TRUE);					/**< Show the grid around tabular report data.				*/
+	config_int_init("ReportMemoryLimit", 0);					/**< Report memory before spilling to disc (Kb, 0 = no limit).	*/
+	config_int_init("ReportCacheLimit", 1024);					/**< Memory for closed reports kept for re-use (Kb, 0 = none).	*/
 
 	config_opt_init("PrintText", FALSE);						/**< Print in legacy text mode instead of graphics.			*/
 	config_opt_init("PrintTextFormat", TRUE);					/**< Include Fancy Text formatting when PrintText == TRUE.		*/
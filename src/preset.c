@@ -661,6 +661,9 @@ static osbool preset_process_edit_window(void *parent, struct preset_dialogue_da
 	windat->presets[content->preset].action_key = content->action_key;
 	windat->presets[content->preset].flags = content->flags;
 	windat->presets[content->preset].date = content->date;
+	account_change_usage(windat->file, windat->presets[content->preset].from, content->from);
+	account_change_usage(windat->file, windat->presets[content->preset].to, content->to);
+
 	windat->presets[content->preset].from = content->from;
 	windat->presets[content->preset].to = content->to;
 	windat->presets[content->preset].amount = content->amount;
@@ -751,6 +754,9 @@ static osbool preset_delete(struct file_block *file, int preset)
 
 	/* Delete the preset */
 
+	account_change_usage(file, file->presets->presets[preset].from, NULL_ACCOUNT);
+	account_change_usage(file, file->presets->presets[preset].to, NULL_ACCOUNT);
+
 	if (!flexutils_delete_object((void **) &(file->presets->presets), sizeof(struct preset), preset)) {
 		error_msgs_report_error("BadDelete");
 		return FALSE;
@@ -931,27 +937,3 @@ osbool preset_read_file(struct file_block *file, struct filing_block *in)
 	return TRUE;
 }
 
-
-/**
- * Check the presets in a file to see if the given account is used
- * in any of them.
- *
- * \param *file			The file to check.
- * \param account		The account to search for.
- * \return			TRUE if the account is used; FALSE if not.
- */
-
-osbool preset_check_account(struct file_block *file, acct_t account)
-{
-	int		i;
-
-	if (file == NULL || file->presets == NULL)
-		return FALSE;
-
-	for (i = 0; i < file->presets->preset_count; i++)
-		if (file->presets->presets[i].from == account || file->presets->presets[i].to == account)
-			return TRUE;
-
-	return FALSE;
-}
-
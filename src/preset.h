@@ -372,17 +372,5 @@ void preset_write_file(struct file_block *file, FILE *out);
 
 osbool preset_read_file(struct file_block *file, struct filing_block *in);
 
-
-/**
- * Check the presets in a file to see if the given account is used
- * in any of them.
- *
- * \param *file			The file to check.
- * \param account		The account to search for.
- * \return			TRUE if the account is used; FALSE if not.
- */
-
-osbool preset_check_account(struct file_block *file, acct_t account);
-
 #endif
 
@@ -72,6 +72,7 @@
 #include "file.h"
 #include "filing.h"
 #include "flexutils.h"
+#include "linecache.h"
 #include "preset.h"
 #include "preset_dialogue.h"
 #include "print_dialogue.h"
@@ -150,6 +151,12 @@
 
 #define PRESET_LIST_WINDOW_COLUMNS 10
 
+/**
+ * The number of lines of formatted text to cache for redraws.
+ */
+
+#define PRESET_LIST_WINDOW_CACHE_LINES 64
+
 /**
  * The Preset List Window column map.
  */
@@ -202,6 +209,38 @@ struct preset_list_window_redraw {
 	preset_t				preset;
 };
 
+/**
+ * Preset List Window cached line text, held to avoid formatting the
+ * contents of each row every time that it is redrawn.
+ */
+
+struct preset_list_window_cache {
+	/**
+	 * The ident of the From account.
+	 */
+	char					from_ident[ACCOUNT_IDENT_LEN];
+
+	/**
+	 * The name of the From account.
+	 */
+	char					from_name[ACCOUNT_NAME_LEN];
+
+	/**
+	 * The ident of the To account.
+	 */
+	char					to_ident[ACCOUNT_IDENT_LEN];
+
+	/**
+	 * The name of the To account.
+	 */
+	char					to_name[ACCOUNT_NAME_LEN];
+
+	/**
+	 * The formatted amount.
+	 */
+	char					amount[AMOUNT_FIELD_LEN];
+};
+
 /**
  * Preset List Window instance data structure.
  */
@@ -251,6 +290,12 @@ struct preset_list_window {
 	 * Flex array holding the line data for the window.
 	 */
 	struct preset_list_window_redraw	*line_data;
+
+	/**
+	 * Cache of formatted text for the lines in the window, keyed on
+	 * preset number.
+	 */
+	struct linecache_block			*line_cache;
 };
 
 /**
@@ -393,6 +438,7 @@ struct preset_list_window *preset_list_window_create_instance(struct preset_bloc
 
 	new->display_lines = 0;
 	new->line_data = NULL;
+	new->line_cache = NULL;
 
 	/* Initialise the window columns. */
 
@@ -420,6 +466,14 @@ struct preset_list_window *preset_list_window_create_instance(struct preset_bloc
 		return NULL;
 	}
 
+	/* Set up the redraw text cache. */
+
+	new->line_cache = linecache_create(PRESET_LIST_WINDOW_CACHE_LINES, sizeof(struct preset_list_window_cache));
+	if (new->line_cache == NULL) {
+		preset_list_window_delete_instance(new);
+		return NULL;
+	}
+
 	return new;
 }
 
@@ -438,6 +492,8 @@ void preset_list_window_delete_instance(struct preset_list_window *windat)
 	if (windat->line_data != NULL)
 		flexutils_free((void **) &(windat->line_data));
 
+	linecache_destroy(windat->line_cache);
+
 	column_delete_instance(windat->columns);
 	sort_delete_instance(windat->sort);
 
@@ -585,6 +641,7 @@ static void preset_list_window_delete(struct preset_list_window *windat)
 	if (windat->preset_window != NULL) {
 		ihelp_remove_window(windat->preset_window);
 		event_delete_window(windat->preset_window);
+		window_cancel_redraws(windat->preset_window);
 		wimp_delete_window(windat->preset_window);
 		windat->preset_window = NULL;
 	}
@@ -905,13 +962,14 @@ static void preset_list_window_scroll_handler(wimp_scroll *scroll)
 static void preset_list_window_redraw_handler(wimp_draw *redraw)
 {
 	struct preset_list_window	*windat;
+	struct preset_list_window_cache	*cache;
 	struct file_block		*file;
 	int				top, base, y, select;
 	acct_t				account;
 	enum transact_flags		flags;
 	preset_t			preset;
 	char				icon_buffer[TRANSACT_DESCRIPT_FIELD_LEN]; /* Assumes descript is longest. */
-	osbool				more;
+	osbool				more, cached;
 
 	windat = event_get_window_user_data(redraw->w);
 	if (windat == NULL || windat->instance == NULL || windat->columns == NULL)
@@ -960,6 +1018,26 @@ static void preset_list_window_redraw_handler(wimp_draw *redraw)
 
 			flags = preset_get_flags(file, preset);
 
+			/* Find the formatted text for the line, building it if it
+			 * isn't already in the cache.
+			 */
+
+			cache = linecache_find(windat->line_cache, preset, &cached);
+			if (cache == NULL)
+				continue;
+
+			if (!cached) {
+				account = preset_get_from(file, preset);
+				string_copy(cache->from_ident, account_get_ident(file, account), ACCOUNT_IDENT_LEN);
+				string_copy(cache->from_name, account_get_name(file, account), ACCOUNT_NAME_LEN);
+
+				account = preset_get_to(file, preset);
+				string_copy(cache->to_ident, account_get_ident(file, account), ACCOUNT_IDENT_LEN);
+				string_copy(cache->to_name, account_get_name(file, account), ACCOUNT_NAME_LEN);
+
+				currency_convert_to_string(preset_get_amount(file, preset), cache->amount, AMOUNT_FIELD_LEN);
+			}
+
 			/* Key field */
 
 			window_plot_char_field(PRESET_LIST_WINDOW_KEY, preset_get_action_key(file, preset), wimp_COLOUR_BLACK);
@@ -970,23 +1048,19 @@ static void preset_list_window_redraw_handler(wimp_draw *redraw)
 
 			/* From field */
 
-			account = preset_get_from(file, preset);
-
-			window_plot_text_field(PRESET_LIST_WINDOW_FROM, account_get_ident(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(PRESET_LIST_WINDOW_FROM, cache->from_ident, wimp_COLOUR_BLACK);
 			window_plot_reconciled_field(PRESET_LIST_WINDOW_FROM_REC, (flags & TRANS_REC_FROM), wimp_COLOUR_BLACK);
-			window_plot_text_field(PRESET_LIST_WINDOW_FROM_NAME, account_get_name(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(PRESET_LIST_WINDOW_FROM_NAME, cache->from_name, wimp_COLOUR_BLACK);
 
 			/* To field */
 
-			account = preset_get_to(file, preset);
-
-			window_plot_text_field(PRESET_LIST_WINDOW_TO, account_get_ident(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(PRESET_LIST_WINDOW_TO, cache->to_ident, wimp_COLOUR_BLACK);
 			window_plot_reconciled_field(PRESET_LIST_WINDOW_TO_REC, (flags & TRANS_REC_TO), wimp_COLOUR_BLACK);
-			window_plot_text_field(PRESET_LIST_WINDOW_TO_NAME, account_get_name(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(PRESET_LIST_WINDOW_TO_NAME, cache->to_name, wimp_COLOUR_BLACK);
 
 			/* Amount field */
 
-			window_plot_currency_field(PRESET_LIST_WINDOW_AMOUNT, preset_get_amount(file, preset), wimp_COLOUR_BLACK);
+			window_plot_text_field(PRESET_LIST_WINDOW_AMOUNT, cache->amount, wimp_COLOUR_BLACK);
 
 			/* Description field */
 
@@ -1142,7 +1216,8 @@ void preset_list_window_build_title(struct preset_list_window *windat)
 
 /**
  * Force the redraw of one or all of the presets in the given Preset list
- * bwindow.
+ * bwindow. Any cached text for the affected presets is discarded, so this
+ * must be called whenever their contents change.
  *
  * \param *file			The file owning the window to redraw.
  * \param preset		The preset to redraw, or NULL_PRESET for all.
@@ -1156,9 +1231,11 @@ void preset_list_window_redraw(struct preset_list_window *windat, preset_t prese
 		return;
 
 	if (preset != NULL_PRESET) {
+		linecache_invalidate(windat->line_cache, preset);
 		from = preset_list_window_get_line_from_preset(windat, preset);
 		to = from;
 	} else {
+		linecache_invalidate_all(windat->line_cache);
 		from = 0;
 		to = windat->display_lines - 1;
 	}
@@ -1196,7 +1273,7 @@ static void preset_list_window_force_redraw(struct preset_list_window *windat, i
 	window.extent.y1 = WINDOW_ROW_TOP(PRESET_LIST_WINDOW_TOOLBAR_HEIGHT, from);
 	window.extent.y0 = WINDOW_ROW_BASE(PRESET_LIST_WINDOW_TOOLBAR_HEIGHT, to);
 
-	wimp_force_redraw(windat->preset_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
+	window_queue_redraw(windat->preset_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
 }
 
 
@@ -1369,6 +1446,8 @@ static struct report *preset_list_window_print(struct report *report, void *data
 	preset_t			preset;
 	char				rec_char[REC_FIELD_LEN];
 	wimp_i				columns[PRESET_LIST_WINDOW_COLUMNS];
+	struct stringbuild_block	builder;
+	char				buffer[PRINT_MAX_LINE_LEN];
 
 	if (report == NULL || windat == NULL || windat->instance == NULL)
 		return NULL;
@@ -1382,87 +1461,92 @@ static struct report *preset_list_window_print(struct report *report, void *data
 
 	msgs_lookup("RecChar", rec_char, REC_FIELD_LEN);
 
+	if (!stringbuild_initialise(&builder, buffer, PRINT_MAX_LINE_LEN))
+		return NULL;
+
 	hourglass_on();
 
 	/* Output the page title. */
 
-	stringbuild_reset();
+	stringbuild_reset(&builder);
 
-	stringbuild_add_string("\\b\\u");
-	stringbuild_add_message_param("PresetTitle",
+	stringbuild_add_string(&builder, "\\b\\u");
+	stringbuild_add_message_param(&builder, "PresetTitle",
 			file_get_leafname(file, NULL, 0),
 			NULL, NULL, NULL);
 
-	stringbuild_report_line(report, 1);
+	stringbuild_report_line(&builder, report, 1);
 
 	report_write_line(report, 1, "");
 
 	/* Output the headings line, taking the text from the window icons. */
 
-	stringbuild_reset();
-	columns_print_heading_names(windat->columns, windat->preset_pane);
-	stringbuild_report_line(report, 0);
+	stringbuild_reset(&builder);
+	columns_print_heading_names(windat->columns, windat->preset_pane, &builder);
+	stringbuild_report_line(&builder, report, 0);
 
 	/* Output the standing order data as a set of delimited lines. */
 
 	for (line = 0; line < windat->display_lines; line++) {
 		preset = windat->line_data[line].preset;
 
-		stringbuild_reset();
+		stringbuild_reset(&builder);
 
 		for (column = 0; column < PRESET_LIST_WINDOW_COLUMNS; column++) {
 			if (column == 0)
-				stringbuild_add_string("\\k");
+				stringbuild_add_string(&builder, "\\k");
 			else
-				stringbuild_add_string("\\t");
+				stringbuild_add_string(&builder, "\\t");
 
 			switch (columns[column]) {
 			case PRESET_LIST_WINDOW_KEY:
-				stringbuild_add_printf("\\v\\c%c", preset_get_action_key(file, preset));
+				stringbuild_add_printf(&builder, "\\v\\c%c", preset_get_action_key(file, preset));
 				/* Note that action_key can be zero, in which case %c terminates. */
 				break;
 			case PRESET_LIST_WINDOW_NAME:
-				stringbuild_add_printf("\\v%s", preset_get_name(file, preset, NULL, 0));
+				stringbuild_add_printf(&builder, "\\v%s", preset_get_name(file, preset, NULL, 0));
 				break;
 			case PRESET_LIST_WINDOW_FROM:
-				stringbuild_add_string(account_get_ident(file, preset_get_from(file, preset)));
+				stringbuild_add_string(&builder, account_get_ident(file, preset_get_from(file, preset)));
 				break;
 			case PRESET_LIST_WINDOW_FROM_REC:
 				if (preset_get_flags(file, preset) & TRANS_REC_FROM)
-					stringbuild_add_string(rec_char);
+					stringbuild_add_string(&builder, rec_char);
 				break;
 			case PRESET_LIST_WINDOW_FROM_NAME:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(account_get_name(file, preset_get_from(file, preset)));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, account_get_name(file, preset_get_from(file, preset)));
 				break;
 			case PRESET_LIST_WINDOW_TO:
-				stringbuild_add_string(account_get_ident(file, preset_get_to(file, preset)));
+				stringbuild_add_string(&builder, account_get_ident(file, preset_get_to(file, preset)));
 				break;
 			case PRESET_LIST_WINDOW_TO_REC:
 				if (preset_get_flags(file, preset) & TRANS_REC_TO)
-					stringbuild_add_string(rec_char);
+					stringbuild_add_string(&builder, rec_char);
 				break;
 			case PRESET_LIST_WINDOW_TO_NAME:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(account_get_name(file, preset_get_to(file, preset)));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, account_get_name(file, preset_get_to(file, preset)));
 				break;
 			case PRESET_LIST_WINDOW_AMOUNT:
-				stringbuild_add_string("\\v\\d\\r");
-				stringbuild_add_currency(preset_get_amount(file, preset), FALSE);
+				stringbuild_add_string(&builder, "\\v\\d\\r");
+				stringbuild_add_currency(&builder, preset_get_amount(file, preset), FALSE);
 				break;
 			case PRESET_LIST_WINDOW_DESCRIPTION:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(preset_get_description(file, preset, NULL, 0));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, preset_get_description(file, preset, NULL, 0));
 				break;
 			default:
-				stringbuild_add_string("\\s");
+				stringbuild_add_string(&builder, "\\s");
 				break;
 			}
 		}
 
-		stringbuild_report_line(report, 0);
+		stringbuild_report_line(&builder, report, 0);
 	}
 
+	stringbuild_cancel(&builder);
+
 	hourglass_off();
 
 	return report;
@@ -1491,6 +1575,7 @@ void preset_list_window_sort(struct preset_list_window *windat)
 
 	sort_process(windat->sort, windat->display_lines);
 
+	linecache_invalidate_all(windat->line_cache);
 	preset_list_window_force_redraw(windat, 0, windat->display_lines - 1, wimp_ICON_WINDOW);
 
 	hourglass_off();
@@ -1601,6 +1686,8 @@ osbool preset_list_window_initialise_entries(struct preset_list_window *windat,
 	for (i = 0; i < presets; i++)
 		windat->line_data[i].preset = i;
 
+	linecache_invalidate_all(windat->line_cache);
+
 	preset_list_window_sort(windat);
 
 	return TRUE;
@@ -1631,6 +1718,8 @@ osbool preset_list_window_add_preset(struct preset_list_window *windat, preset_t
 
 	windat->line_data[windat->display_lines - 1].preset = preset;
 
+	linecache_invalidate(windat->line_cache, preset);
+
 	preset_list_window_set_extent(windat);
 
 	if (config_opt_read("AutoSortPresets"))
@@ -1674,6 +1763,10 @@ osbool preset_list_window_delete_preset(struct preset_list_window *windat, prese
 
 	windat->display_lines--;
 
+	/* The following presets have been renumbered, so the cache is invalid. */
+
+	linecache_invalidate_all(windat->line_cache);
+
 	/* Update the preset window. */
 
 	preset_list_window_set_extent(windat);
@@ -78,7 +78,8 @@ void preset_list_window_build_title(struct preset_list_window *windat);
 
 /**
  * Force the redraw of one or all of the presets in the given Preset list
- * bwindow.
+ * bwindow. Any cached text for the affected presets is discarded, so this
+ * must be called whenever their contents change.
  *
  * \param *file			The file owning the window to redraw.
  * \param preset		The preset to redraw, or NULL_PRESET for all.
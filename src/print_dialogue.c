@@ -61,15 +61,8 @@
 #include "date.h"
 #include "dialogue.h"
 #include "report.h"
-#include "stringbuild.h"
 
 
-/**
- * The maximum space allocated for a print line.
- */
-
-#define PRINT_MAX_LINE_LEN 4096
-
 /**
  * The maximum space allocated for a print report title.
  */
@@ -443,7 +436,6 @@ static void print_dialogue_fill_window(struct file_block *file, wimp_w window, o
 
 static osbool print_dialogue_process_window(struct file_block *file, wimp_w window, wimp_pointer *pointer, enum dialogue_icon_type type, void *parent, void *data)
 {
-	char				print_line[PRINT_MAX_LINE_LEN];
 	struct report			*report_in, *report_out;
 	struct print_dialogue_block	*instance = data;
 
@@ -465,15 +457,10 @@ static osbool print_dialogue_process_window(struct file_block *file, wimp_w wind
 	instance->to = date_convert_from_string(icons_get_indirected_text_addr(window, PRINT_DIALOGUE_RANGE_TO),
 			NULL_DATE, 0);
 
-	if (!stringbuild_initialise(print_line, PRINT_MAX_LINE_LEN))
-		return FALSE;
-
 	report_in = print_dialogue_create_report(instance);
 
 	report_out = print_dialogue_callback(report_in, print_dialogue_client_data, instance->from, instance->to);
 
-	stringbuild_cancel();
-
 	if (report_in != NULL && report_out == NULL)
 		report_delete(report_in);
 
@@ -32,6 +32,12 @@
 
 #include "global.h"
 
+/**
+ * The maximum space allocated for a line in a printed report.
+ */
+
+#define PRINT_MAX_LINE_LEN 4096
+
 /**
  * A Print Dialogue Definition.
  */
@@ -48,7 +48,6 @@
 #include "purge.h"
 
 #include "account.h"
-#include "accview.h"
 #include "date.h"
 #include "file.h"
 #include "purge_dialogue.h"
@@ -70,7 +69,7 @@ struct purge_block {
 
 
 static osbool		purge_process_window(void *owner, struct purge_dialogue_data *content);
-static void		purge_file(struct file_block *file, osbool transactions, date_t date, osbool accounts, osbool headings, osbool sorders);
+static void		purge_file(struct file_block *file, osbool transactions, date_t date, osbool archive, osbool accounts, osbool headings, osbool sorders);
 
 
 /**
@@ -167,6 +166,7 @@ void purge_open_window(struct purge_block *purge, wimp_pointer *ptr, osbool rest
 static osbool purge_process_window(void *owner, struct purge_dialogue_data *content)
 {
 	struct purge_block *windat = owner;
+	osbool archive;
 
 	if (windat == NULL || content == NULL)
 		return TRUE;
@@ -175,13 +175,18 @@ static osbool purge_process_window(void *owner, struct purge_dialogue_data *cont
 			error_msgs_report_question("PurgeFileNotSaved", "PurgeFileNotSavedB") == 4)
 		return FALSE;
 
+	/* Offer to keep the purged transactions in the file's archive. */
+
+	archive = (content->remove_transactions &&
+			error_msgs_report_question("PurgeArchive", "PurgeArchiveB") == 3) ? TRUE : FALSE;
+
 	windat->transactions = content->remove_transactions;
 	windat->accounts = content->remove_accounts;
 	windat->headings = content->remove_headings;
 	windat->sorders = content->remove_sorders;
 	windat->before = content->keep_from;
 
-	purge_file(windat->file, windat->transactions, windat->before,
+	purge_file(windat->file, windat->transactions, windat->before, archive,
 		windat->accounts, windat->headings, windat->sorders);
 
 	return TRUE;
@@ -194,12 +199,13 @@ static osbool purge_process_window(void *owner, struct purge_dialogue_data *cont
  * \param *file			The file to be purged.
  * \param transactions		TRUE to purge transactions; FALSE to ignore.
  * \param cutoff		The cutoff transaction date, or NULL_DATE for all.
+ * \param archive		TRUE to archive purged transactions; FALSE to discard.
  * \param accounts		TRUE to purge accounts; FALSE to ignore.
  * \param headings		TRUE to purge headings; FALSE to ignore.
  * \param sorders		TRUE to purge standing orders; FALSE to ignore.
  */
 
-static void purge_file(struct file_block *file, osbool transactions, date_t cutoff, osbool accounts, osbool headings, osbool sorders)
+static void purge_file(struct file_block *file, osbool transactions, date_t cutoff, osbool archive, osbool accounts, osbool headings, osbool sorders)
 {
 	hourglass_on();
 
@@ -213,10 +219,20 @@ static void purge_file(struct file_block *file, osbool transactions, date_t cuto
 	debug_printf("\\OPurging file");
 #endif
 
-	/* Purge unused transactions from the file. */
+	/* Collect the window updates from all of the purges together. */
+
+	file_begin_batch(file);
 
-	if (transactions)
-		transact_purge(file, cutoff);
+	/* Purge unused transactions from the file. If they can't be archived
+	 * as requested, the problem has already been reported and nothing has
+	 * been changed, so stop here.
+	 */
+
+	if (transactions && !transact_purge(file, cutoff, archive)) {
+		file_commit_batch(file);
+		hourglass_off();
+		return;
+	}
 
 	/* Purge any unused standing orders from the file. */
 
@@ -230,7 +246,8 @@ static void purge_file(struct file_block *file, osbool transactions, date_t cuto
 
 	/* Recalculate the file and update the window. */
 
-	accview_rebuild_all(file);
+	file_defer_batch_effects(file, FILE_BATCH_ACCVIEWS);
+	file_commit_batch(file);
 
 	/* account_recalculate_all(file); */
 
@@ -29,6 +29,7 @@
 
 /* ANSI C header files */
 
+#include <limits.h>
 #include <math.h>
 #include <string.h>
 #include <stdlib.h>
@@ -73,6 +74,7 @@
 #include "report.h"
 
 #include "analysis.h"
+#include "analysis_template.h"
 #include "analysis_template_save.h"
 #include "caret.h"
 #include "dialogue.h"
@@ -82,6 +84,7 @@
 #include "flexutils.h"
 #include "print_dialogue.h"
 #include "print_protocol.h"
+#include "report_arena.h"
 #include "report_cell.h"
 #include "report_draw.h"
 #include "report_fonts.h"
@@ -91,6 +94,7 @@
 #include "report_region.h"
 #include "report_tabs.h"
 #include "report_textdump.h"
+#include "report_widths.h"
 #include "transact.h"
 #include "window.h"
 
@@ -167,6 +171,13 @@
 
 #define REPORT_MAX_PAGE_STRING_LEN 64
 
+/**
+ * The number of rows of pages to lay out in one go, when paginating a
+ * report in the background.
+ */
+
+#define REPORT_PAGINATE_ROWS 10
+
 /**
  * The height of the Report window toolbar.
  */
@@ -234,6 +245,12 @@
 
 #define REPORT_MIN_HEIGHT 800
 
+/**
+ * The size of buffer used to format currency and date cells.
+ */
+
+#define REPORT_VALUE_CELL_LEN 32
+
 
 struct report_print_pagination {
 	int		header_line;						/**< A line to repeat as a header at the top of the page, or -1 for none.			*/
@@ -256,6 +273,47 @@ struct report_pagination_area {
 	unsigned	bottom_line;						/**< The last line in the range.							*/
 };
 
+/**
+ * The state of the pagination of a report, which is carried out a few page
+ * rows at a time so that it can be resumed when more pages are required.
+ */
+
+struct report_pagination {
+	osbool				active;				/**< TRUE if pagination is in progress; FALSE if complete or abandoned.	*/
+	osbool				extent_pending;			/**< TRUE if the window extent must be updated after pagination.	*/
+
+	struct report_page_layout	layout;				/**< The page layout details for the report.				*/
+
+	struct report_pagination_area	main_area;			/**< The area holding the "new" lines on the current page.		*/
+	struct report_pagination_area	repeat_area;			/**< The area holding lines repeated at the top of the current page.	*/
+
+	int				body_height;			/**< The vertical space available for lines on a page, in OS Units.	*/
+	int				used_height;			/**< The space on the current page taken by repeated lines.		*/
+
+	int				pages_across;			/**< The number of pages across each row.				*/
+	int				pages_down;			/**< The number of the current page row.				*/
+
+	unsigned			line;				/**< The next line to be processed.					*/
+
+	unsigned			repeat_line;			/**< The line to repeat at the top of new pages, or REPORT_LINE_NONE.	*/
+	int				repeat_line_ypos;		/**< The Y-Pos of the line to be repeated.				*/
+	int				repeat_line_height;		/**< The height of the line to be repeated.				*/
+	int				repeat_tab_bar;			/**< The tab bar of the previous line processed.			*/
+};
+
+/**
+ * A line which is being assembled in a report.
+ */
+
+struct report_open_line {
+	osbool			active;						/**< TRUE if a line has been started; FALSE if not.		*/
+	int			tab_bar;					/**< The tab bar used by the line.				*/
+	int			next_stop;					/**< The first tab stop which can take a new cell.		*/
+	unsigned		first_cell;					/**< Offset of the line's first cell in the cell data block.	*/
+	size_t			cell_count;					/**< The number of cells stored for the line so far.		*/
+	enum report_line_flags	flags;						/**< The flags to be applied to the line.			*/
+};
+
 /**
  * Report status flags.
  */
@@ -263,7 +321,8 @@ struct report_pagination_area {
 enum report_status {
 	REPORT_STATUS_NONE = 0x00,						/**< No status flags set.					*/
 	REPORT_STATUS_MEMERR = 0x01,						/**< A memory allocation error has occurred, so stop allowing writes. */
-	REPORT_STATUS_CLOSED = 0x02						/**< The report has been closed to writing.			*/
+	REPORT_STATUS_CLOSED = 0x02,						/**< The report has been closed to writing.			*/
+	REPORT_STATUS_CACHED = 0x04						/**< The report's window has closed, but it is held for re-use.	*/
 };
 
 /**
@@ -292,6 +351,20 @@ struct report {
 	enum report_status	flags;
 	int			print_pending;
 
+	/* Background generation details. */
+
+	int			progress;					/**< The percentage of the report generated, or -1 if unknown.	*/
+	void			(*cancel)(void *data);				/**< Callback to cancel the generation of the report, or NULL.	*/
+	void			*cancel_data;					/**< Data to pass to the cancel callback.			*/
+
+	/* Report cache details. */
+
+	osbool			cacheable;					/**< TRUE if the report can be cached when its window closes.	*/
+	unsigned		cache_key;					/**< The hash of the template and title used for the report.	*/
+	unsigned		cache_version;					/**< The file data version from which the report was generated.	*/
+	date_t			cache_date;					/**< The date on which the report was generated.		*/
+	unsigned		cache_stamp;					/**< The order in which the report was last used.		*/
+
 	/* Tab details */
 
 	struct report_tabs_block	*tabs;
@@ -299,6 +372,7 @@ struct report {
 	/* Font data */
 
 	struct report_fonts_block	*fonts;
+	struct report_widths_block	*widths;				/**< Cache of cell widths measured in the report's fonts.	*/
 
 	/* Display options. */
 
@@ -313,13 +387,19 @@ struct report {
 
 	int			cell_baseline;					/**< The font baseline in a cell body, in OS Units.		*/
 
+	struct report_arena_block	*arena;					/**< The arena holding the report's data blocks.		*/
+
 	struct report_textdump_block	*content;
 	struct report_cell_block	*cells;
 	struct report_line_block	*lines;
 
+	struct report_open_line		line;					/**< Details of the line currently being assembled.		*/
+
 	struct report_page_block	*pages;
 	struct report_region_block	*regions;
 
+	struct report_pagination	pagination;				/**< The state of any pagination in progress.			*/
+
 	unsigned			page_title;				/**< Textdump offset for the page title, if any.		*/
 
 	/* Report template details. */
@@ -346,14 +426,26 @@ static struct saveas_block	*report_saveas_text = NULL;			/**< The Save Text save
 static struct saveas_block	*report_saveas_csv = NULL;			/**< The Save CSV saveas data handle.								*/
 static struct saveas_block	*report_saveas_tsv = NULL;			/**< The Save TSV saveas data handle.								*/
 
+static struct report_widths_callback	report_widths_callbacks;		/**< The callbacks used to measure cell widths in reports.					*/
+
+static int			report_pagination_pending = 0;			/**< The number of reports with pagination or an extent update still pending.			*/
+
+static unsigned			report_cache_stamp = 0;				/**< The stamp given to the last report to be used.						*/
+
 
 
 static void			report_close_and_calculate(struct report *report);
-static osbool			report_add_cell(struct report *report, char *text, enum report_cell_flags flags, int tab_bar, int tab_stop, unsigned *first_cell_offset);
+static osbool			report_add_cell(struct report *report, char *text, enum report_cell_flags flags, int tab_stop);
 
 
 static void			report_reflow_content(struct report *report);
+static os_error			*report_measure_text(void *data, char *text, enum report_cell_flags flags, struct report_fonts_extent *extent);
 
+static void			report_cache_trim(struct file_block *file);
+static size_t			report_get_memory(struct report *report);
+
+static void			report_view_open(struct report *report);
+static osbool			report_view_create_window(struct report *report);
 static void			report_view_close_window_handler(wimp_close *close);
 static void			report_view_delete_window(struct report *report);
 static void			report_view_redraw_handler(wimp_draw *redraw);
@@ -399,6 +491,10 @@ static os_error *report_plot_cell(struct report *report, os_box *outline, char *
 static osbool report_handle_message_set_printer(wimp_message *message);
 static void report_repaginate_all(struct file_block *file);
 static void report_paginate(struct report *report);
+static void report_paginate_rows(struct report *report, int rows);
+static void report_paginate_finish(struct report *report);
+static void report_paginate_file_in_background(struct file_block *file);
+static void report_paginate_update_extent(struct report *report);
 static void report_add_page_row(struct report *report, struct report_page_layout *layout,
 		struct report_pagination_area *main_area, struct report_pagination_area *repeat_area, int row, int columns);
 static void report_set_display_option(struct report *report, enum report_display option, osbool state);
@@ -440,6 +536,12 @@ void report_initialise(osspriteop_area *sprites)
 	report_fonts_initialise();
 	report_draw_set_line_width(REPORT_GRID_LINE_THICKNESS);
 
+	report_widths_callbacks.measure = report_measure_text;
+
+#ifdef DEBUG
+	report_widths_verify();
+#endif
+
 	/* Register the Wimp message handlers. */
 
 	event_add_message_handler(message_SET_PRINTER, EVENT_MESSAGE_INCOMING, report_handle_message_set_printer);
@@ -459,6 +561,7 @@ void report_initialise(osspriteop_area *sprites)
 struct report *report_open(struct file_block *file, char *title, struct analysis_report *template)
 {
 	struct report	*new;
+	size_t		memory_limit;
 
 #ifdef DEBUG
 	debug_printf("\\GOpening report");
@@ -477,6 +580,16 @@ struct report *report_open(struct file_block *file, char *title, struct analysis
 	new->flags = REPORT_STATUS_NONE;
 	new->print_pending = 0;
 
+	new->progress = -1;
+	new->cancel = NULL;
+	new->cancel_data = NULL;
+
+	new->cacheable = FALSE;
+	new->cache_key = 0;
+	new->cache_version = 0;
+	new->cache_date = NULL_DATE;
+	new->cache_stamp = 0;
+
 	new->display = REPORT_DISPLAY_NONE;
 
 	if (config_opt_read("ReportRotate"))
@@ -494,6 +607,14 @@ struct report *report_open(struct file_block *file, char *title, struct analysis
 
 	new->page_title = REPORT_TEXTDUMP_NULL;
 
+	/* The content, cells, lines, pages and regions are all allocated from
+	 * the report's arena, so that they can be freed together.
+	 */
+
+	new->arena = report_arena_create();
+	if (new->arena == NULL)
+		new->flags |= REPORT_STATUS_MEMERR;
+
 	new->tabs = report_tabs_create();
 	if (new->tabs == NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
@@ -502,23 +623,31 @@ struct report *report_open(struct file_block *file, char *title, struct analysis
 	if (new->fonts == NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
 
-	new->content = report_textdump_create(0, 200, '\0');
+	new->widths = report_widths_create(0, &report_widths_callbacks, new->fonts);
+	if (new->widths == NULL)
+		new->flags |= REPORT_STATUS_MEMERR;
+
+	new->content = report_textdump_create(new->arena, 0, 200, '\0');
 	if (new->content == NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
 
-	new->cells = report_cell_create(0);
+	/* The memory limit applies separately to the cell and line stores. */
+
+	memory_limit = config_int_read("ReportMemoryLimit") * 1024;
+
+	new->cells = report_cell_create(new->arena, 0, memory_limit);
 	if (new->cells == NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
 
-	new->lines = report_line_create(0);
+	new->lines = report_line_create(new->arena, 0, memory_limit);
 	if (new->lines == NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
 
-	new->pages = report_page_create(0);
+	new->pages = report_page_create(new->arena, 0);
 	if (new->pages == NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
 
-	new->regions = report_region_create(0);
+	new->regions = report_region_create(new->arena, 0);
 	if (new->regions == NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
 
@@ -530,6 +659,11 @@ struct report *report_open(struct file_block *file, char *title, struct analysis
 	if (new->page_title == REPORT_TEXTDUMP_NULL)
 		new->flags |= REPORT_STATUS_MEMERR;
 
+	new->line.active = FALSE;
+
+	new->pagination.active = FALSE;
+	new->pagination.extent_pending = FALSE;
+
 	new->template = template;
 
 	return (new);
@@ -589,10 +723,6 @@ void report_set_options(struct report *report, osbool fitwidth, osbool rotate, o
 
 void report_close(struct report *report)
 {
-	wimp_window_state	parent;
-	int			xextent, yextent;
-	os_error		*error;
-
 #ifdef DEBUG
 	debug_printf("\\GClosing report");
 #endif
@@ -605,34 +735,146 @@ void report_close(struct report *report)
 
 	report_close_and_calculate(report);
 
-	/* Set up the window title */
+	report_view_open(report);
+}
 
-	report_window_def->title_data.indirected_text.text = report->window_title;
+
+/**
+ * Set the key under which a report can be held in the cache once its
+ * window has been closed. Reports without a key are deleted when their
+ * windows close.
+ *
+ * \param *report		The report handle.
+ * \param key			The hash of the report's template and title.
+ * \param version		The file data version used to generate the report.
+ * \param date			The date on which the report was generated.
+ */
+
+void report_set_cache_key(struct report *report, unsigned key, unsigned version, date_t date)
+{
+	if (report == NULL)
+		return;
+
+	report->cacheable = TRUE;
+	report->cache_key = key;
+	report->cache_version = version;
+	report->cache_date = date;
+}
+
+
+/**
+ * Find a cached report in a file which was generated from a given template,
+ * with the same key, file data version and date.
+ *
+ * \param *file			The file to search.
+ * \param *template		The template to match.
+ * \param key			The hash of the template and title to match.
+ * \param version		The file data version to match.
+ * \param date			The date to match.
+ * \return			The matching report, or NULL if none was found.
+ */
+
+struct report *report_find_cached(struct file_block *file, struct analysis_report *template, unsigned key, unsigned version, date_t date)
+{
+	struct report	*report;
+
+	if (file == NULL || template == NULL)
+		return NULL;
+
+	/* Clear out any reports which have gone stale since they were cached. */
+
+	report_cache_trim(file);
+
+	report = file->reports;
+
+	while (report != NULL) {
+		if ((report->flags & REPORT_STATUS_CACHED) && report->cache_key == key && report->cache_version == version &&
+				report->cache_date == date && analysis_template_compare(report->template, template))
+			return report;
+
+		report = report->next;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Take a report out of the cache, and open a window to display it on
+ * screen again.
+ *
+ * \param *report		The report handle.
+ */
+
+void report_reopen(struct report *report)
+{
+	if (report == NULL || !(report->flags & REPORT_STATUS_CACHED))
+		return;
 
 #ifdef DEBUG
-	debug_printf("Report window width: %d", report->width);
+	debug_printf("\\GReopening cached report");
 #endif
 
-	/* Position the report window. */
+	report->flags &= ~REPORT_STATUS_CACHED;
+	report->cache_stamp = ++report_cache_stamp;
 
-	transact_get_window_state(report->file, &parent);
+	report_view_open(report);
+}
 
-	if (!report_get_window_extent(report, &xextent, &yextent)) {
-		xextent = REPORT_MIN_WIDTH;
-		yextent = REPORT_MIN_HEIGHT;
+
+/**
+ * Delete all of the cached reports belonging to a file. This should be
+ * called when the Choices change, as the cached reports were formatted
+ * using the old date and currency settings.
+ *
+ * \param *file			The file to flush the cache for.
+ */
+
+void report_flush_cache(struct file_block *file)
+{
+	struct report	*report, *next;
+
+	if (file == NULL)
+		return;
+
+	report = file->reports;
+
+	while (report != NULL) {
+		next = report->next;
+
+		if (report->flags & REPORT_STATUS_CACHED)
+			report_delete(report);
+
+		report = next;
 	}
+}
 
-	window_set_initial_area(report_window_def, xextent, yextent,
-			parent.visible.x0 + CHILD_WINDOW_OFFSET + file_get_next_open_offset(report->file),
-			parent.visible.y0 - CHILD_WINDOW_OFFSET, 0);
 
-	error = xwimp_create_window(report_window_def, &(report->window));
-	if (error != NULL) {
+/**
+ * Open the window and toolbar for a report which has been closed. If the
+ * report was generated in the background, its window will already be on
+ * screen showing the progress.
+ *
+ * \param *report		The report handle.
+ */
+
+static void report_view_open(struct report *report)
+{
+	os_error		*error;
+
+	if (report == NULL)
+		return;
+
+	if (report->window == NULL && !report_view_create_window(report)) {
 		report_delete(report);
-		error_report_os_error(error, wimp_ERROR_BOX_CANCEL_ICON);
 		return;
 	}
 
+	if (report->progress != -1) {
+		string_copy(report->window_title, report_textdump_get_base(report->content) + report->page_title, WINDOW_TITLE_LENGTH);
+		xwimp_force_redraw_title(report->window);
+	}
+
 	/* Position the report toolbar pane. */
 
 	windows_place_as_toolbar(report_window_def, report_toolbar_def, REPORT_TOOLBAR_HEIGHT - 4);
@@ -646,22 +888,19 @@ void report_close(struct report *report)
 
 	report_view_toolbar_prepare(report);
 
-	/* Open the two windows. */
+	/* Open the toolbar, and bring the finished report to the front. */
 
-	ihelp_add_window(report->window, "Report", NULL);
 	ihelp_add_window(report->toolbar, "ReportTB", NULL);
 
+	report_set_window_extent(report);
+
 	windows_open(report->window);
 	windows_open_nested_as_toolbar(report->toolbar, report->window,
 			REPORT_TOOLBAR_HEIGHT - 4, TRUE);
 
-	/* Register event handles for the two windows. */
+	/* Register the remaining event handles for the two windows. */
 
-	event_add_window_user_data(report->window, report);
 	event_add_window_menu(report->window, report_view_menu);
-	event_add_window_close_event(report->window, report_view_close_window_handler);
-	event_add_window_scroll_event(report->window, report_view_scroll_handler);
-	event_add_window_redraw_event(report->window, report_view_redraw_handler);
 	event_add_window_menu_prepare(report->window, report_view_menu_prepare_handler);
 	event_add_window_menu_selection(report->window, report_view_menu_selection_handler);
 	event_add_window_menu_warning(report->window, report_view_menu_warning_handler);
@@ -678,6 +917,71 @@ void report_close(struct report *report)
 }
 
 
+/**
+ * Show the progress of a report which is being generated in the background,
+ * opening a window for it if there isn't one on screen already.
+ *
+ * \param *report		The report handle.
+ * \param percent		The percentage of the report which is complete.
+ */
+
+void report_show_progress(struct report *report, int percent)
+{
+	char	name[WINDOW_TITLE_LENGTH], value[16];
+	osbool	first;
+
+	if (report == NULL || (report->flags & (REPORT_STATUS_CLOSED | REPORT_STATUS_MEMERR)) ||
+			report->page_title == REPORT_TEXTDUMP_NULL)
+		return;
+
+	if (percent < 0)
+		percent = 0;
+	else if (percent > 100)
+		percent = 100;
+
+	if (percent == report->progress)
+		return;
+
+	first = (report->progress == -1) ? TRUE : FALSE;
+	report->progress = percent;
+
+	/* Update the title to show the progress. */
+
+	string_copy(name, report_textdump_get_base(report->content) + report->page_title, WINDOW_TITLE_LENGTH);
+	string_printf(value, sizeof(value), "%d", percent);
+	msgs_param_lookup("RepProgress", report->window_title, WINDOW_TITLE_LENGTH, name, value, NULL, NULL);
+
+	/* Open the window on the first update; if that fails, it will be
+	 * tried again when the report is closed.
+	 */
+
+	if (report->window != NULL)
+		xwimp_force_redraw_title(report->window);
+	else if (first)
+		report_view_create_window(report);
+}
+
+
+/**
+ * Set a callback to be used if a report being generated in the background
+ * is deleted before it has been closed, so that the generation can be
+ * abandoned.
+ *
+ * \param *report		The report handle.
+ * \param *callback		The function to call, or NULL for none.
+ * \param *data		Data to pass to the callback function.
+ */
+
+void report_set_cancel_handler(struct report *report, void (*callback)(void *data), void *data)
+{
+	if (report == NULL)
+		return;
+
+	report->cancel = callback;
+	report->cancel_data = data;
+}
+
+
 /**
  * Close off a report that has had data written to it, and send it directly
  * to the printing system before deleting it.
@@ -701,6 +1005,8 @@ void report_close_and_print(struct report *report, osbool text, osbool textforma
 
 	report_close_and_calculate(report);
 
+	report_paginate_finish(report);
+
 	if (!report_page_paginated(report->pages)) {
 		error_msgs_report_error("PrintPgFail");
 		report_delete(report);
@@ -720,10 +1026,17 @@ void report_close_and_print(struct report *report, osbool text, osbool textforma
 
 static void report_close_and_calculate(struct report *report)
 {
+#ifdef DEBUG
+	size_t	memory, peak;
+#endif
+
 	if (report == NULL || (report->flags & REPORT_STATUS_CLOSED))
 		return;
 
-	/* Mark the report as closed. */
+	/* Complete any line which has been left open, then mark the report as closed. */
+
+	if (report->line.active)
+		report_end_line(report);
 
 	report->flags |= REPORT_STATUS_CLOSED;
 
@@ -734,6 +1047,11 @@ static void report_close_and_calculate(struct report *report)
 	report_line_close(report->lines);
 	report_tabs_close(report->tabs);
 
+#ifdef DEBUG
+	report_arena_get_usage(report->arena, &memory, &peak);
+	debug_printf("Report arena: %dKb claimed at peak, %dKb on closing", peak / 1024, memory / 1024);
+#endif
+
 	/* Set up the display details. */
 
 	report_fonts_set_faces(report->fonts, config_str_read("ReportFontNormal"), config_str_read("ReportFontBold"), NULL, NULL);
@@ -757,6 +1075,7 @@ static void report_close_and_calculate(struct report *report)
 void report_delete(struct report *report)
 {
 	struct report		**rep;
+	void			(*cancel)(void *data);
 
 #ifdef DEBUG
 	debug_printf("\\RDeleting report");
@@ -765,19 +1084,35 @@ void report_delete(struct report *report)
 	if (report == NULL)
 		return;
 
+	/* If the report is still being generated, tell the generator to stop. */
+
+	if (report->cancel != NULL) {
+		cancel = report->cancel;
+		report->cancel = NULL;
+		cancel(report->cancel_data);
+	}
+
 	/* Delete any window that is still associated with the report. */
 
 	report_view_delete_window(report);
 
-	/* Free the flex blocks. */
+	/* Abandon any pagination which is still in progress. */
+
+	if (report->pagination.active || report->pagination.extent_pending)
+		report_pagination_pending--;
+
+	/* Free the data blocks. The stores are destroyed individually to
+	 * release any disc space that they hold, but their memory is all
+	 * returned with the arena.
+	 */
 
-	report_textdump_destroy(report->content);
 	report_cell_destroy(report->cells);
 	report_line_destroy(report->lines);
+	report_arena_destroy(report->arena);
+
 	report_fonts_destroy(report->fonts);
+	report_widths_destroy(report->widths);
 	report_tabs_destroy(report->tabs);
-	report_page_destroy(report->pages);
-	report_region_destroy(report->regions);
 
 	if (report->template != NULL)
 		heap_free(report->template);
@@ -834,9 +1169,7 @@ struct file_block *report_get_file(struct report *report)
 void report_write_line(struct report *report, int tab_bar, char *text)
 {
 	char			*c, *copy;
-	unsigned		first_cell_offset;
-	int			tab_stop, cell_count;
-	enum report_line_flags	line_flags;
+	int			tab_stop;
 	enum report_cell_flags	cell_flags;
 
 #ifdef DEBUG
@@ -854,14 +1187,11 @@ void report_write_line(struct report *report, int tab_bar, char *text)
 		return;
 	}
 
-	tab_stop = 0;
-	cell_count = 0;
+	report_begin_line(report, tab_bar, REPORT_LINE_FLAGS_NONE);
 
-	line_flags = REPORT_LINE_FLAGS_NONE;
+	tab_stop = 0;
 	cell_flags = REPORT_CELL_FLAGS_NONE;
 
-	first_cell_offset = REPORT_CELL_NULL;
-
 	c = copy;
 
 	while ((*text != '\0') && !(report->flags & REPORT_STATUS_MEMERR)) {
@@ -886,7 +1216,7 @@ void report_write_line(struct report *report, int tab_bar, char *text)
 				break;
 
 			case 'k':
-				line_flags |= REPORT_LINE_FLAGS_KEEP_TOGETHER;
+				report->line.flags |= REPORT_LINE_FLAGS_KEEP_TOGETHER;
 				break;
 
 			case 'o':
@@ -904,10 +1234,7 @@ void report_write_line(struct report *report, int tab_bar, char *text)
 			case 't':
 				*c++ = '\0';
 
-				if (report_add_cell(report, copy, cell_flags, tab_bar, tab_stop, &first_cell_offset))
-					cell_count++;
-
-				tab_stop++;
+				report_add_cell(report, copy, cell_flags, tab_stop++);
 
 				c = copy;
 				cell_flags = REPORT_CELL_FLAGS_NONE;
@@ -918,7 +1245,6 @@ void report_write_line(struct report *report, int tab_bar, char *text)
 				break;
 				
 			case 'v':
-				line_flags |= REPORT_LINE_FLAGS_RULE_BELOW;
 				cell_flags |= REPORT_CELL_FLAGS_RULE_AFTER;
 				break;
 			}
@@ -929,36 +1255,177 @@ void report_write_line(struct report *report, int tab_bar, char *text)
 
 	*c = '\0';
 
-	if (report_add_cell(report, copy, cell_flags, tab_bar, tab_stop, &first_cell_offset))
-		cell_count++;
+	report_add_cell(report, copy, cell_flags, tab_stop);
 
 	/* Store the line in the report. */
 
-	if (!report_line_add(report->lines, first_cell_offset, cell_count, tab_bar, line_flags))
-		report->flags |= REPORT_STATUS_MEMERR;
+	report_end_line(report);
 
 	free(copy);
 }
 
 
 /**
- * Add a cell to a report.
+ * Start a new line in an open report, which can then be filled with cells
+ * using the report_add_*_cell() calls before being completed with
+ * report_end_line(). Any line which is already open will be completed first.
+ *
+ * Cells must be added in ascending order of tab stop. A cell flagged with
+ * REPORT_CELL_FLAGS_RULE_AFTER will also place a rule below its line.
+ *
+ * \param *report		The report to write to.
+ * \param tab_bar		The tab bar to use.
+ * \param flags			The flags to apply to the line.
+ */
+
+void report_begin_line(struct report *report, int tab_bar, enum report_line_flags flags)
+{
+	if (report == NULL || (report->flags & REPORT_STATUS_CLOSED))
+		return;
+
+	if (report->line.active)
+		report_end_line(report);
+
+	report->line.active = TRUE;
+	report->line.tab_bar = tab_bar;
+	report->line.next_stop = 0;
+	report->line.first_cell = REPORT_CELL_NULL;
+	report->line.cell_count = 0;
+	report->line.flags = flags;
+}
+
+
+/**
+ * Add a cell containing a text string to the current line of a report.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param *text			The text to place in the cell, or NULL.
+ */
+
+void report_add_text_cell(struct report *report, int tab_stop, enum report_cell_flags flags, char *text)
+{
+	report_add_cell(report, text, flags, tab_stop);
+}
+
+
+/**
+ * Add a cell containing a message from the application messages, with
+ * optional parameter substitution, to the current line of a report.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param *token		The token of the message to place in the cell.
+ * \param *a			Pointer to parameter %0, or NULL.
+ * \param *b			Pointer to parameter %1, or NULL.
+ * \param *c			Pointer to parameter %2, or NULL.
+ * \param *d			Pointer to parameter %3, or NULL.
+ */
+
+void report_add_message_cell(struct report *report, int tab_stop, enum report_cell_flags flags, char *token, char *a, char *b, char *c, char *d)
+{
+	char	buffer[REPORT_MAX_LINE_LEN];
+
+	if (report == NULL || token == NULL)
+		return;
+
+	msgs_param_lookup(token, buffer, REPORT_MAX_LINE_LEN, a, b, c, d);
+	report_add_cell(report, buffer, flags, tab_stop);
+}
+
+
+/**
+ * Add a cell containing a currency amount to the current line of a report.
+ * The cell will be flagged as numeric, in addition to the flags supplied.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param amount		The amount to place in the cell.
+ * \param print_zeros		TRUE to show zero amounts as 0; FALSE to
+ *				leave the cell blank.
+ */
+
+void report_add_currency_cell(struct report *report, int tab_stop, enum report_cell_flags flags, amt_t amount, osbool print_zeros)
+{
+	char	buffer[REPORT_VALUE_CELL_LEN];
+
+	if (report == NULL)
+		return;
+
+	currency_flexible_convert_to_string(amount, buffer, REPORT_VALUE_CELL_LEN, print_zeros);
+	report_add_cell(report, buffer, flags | REPORT_CELL_FLAGS_NUMERIC, tab_stop);
+}
+
+
+/**
+ * Add a cell containing a date to the current line of a report.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param date			The date to place in the cell.
+ */
+
+void report_add_date_cell(struct report *report, int tab_stop, enum report_cell_flags flags, date_t date)
+{
+	char	buffer[REPORT_VALUE_CELL_LEN];
+
+	if (report == NULL)
+		return;
+
+	date_convert_to_string(date, buffer, REPORT_VALUE_CELL_LEN);
+	report_add_cell(report, buffer, flags, tab_stop);
+}
+
+
+/**
+ * Complete the current line in an open report, and store it.
+ *
+ * \param *report		The report to write to.
+ */
+
+void report_end_line(struct report *report)
+{
+	if (report == NULL || !report->line.active)
+		return;
+
+	report->line.active = FALSE;
+
+	if ((report->flags & REPORT_STATUS_MEMERR) || (report->flags & REPORT_STATUS_CLOSED))
+		return;
+
+	if (!report_line_add(report->lines, report->line.first_cell, report->line.cell_count, report->line.tab_bar, report->line.flags))
+		report->flags |= REPORT_STATUS_MEMERR;
+}
+
+
+/**
+ * Add a cell to the line currently being assembled in a report. Cells must
+ * be added in ascending order of tab stop; any which would be out of
+ * sequence are ignored. A cell with a rule after it will also place a rule
+ * below the line.
  *
  * \param *report		The report to add the cell to.
- * \param *text			Pointer to the text to be stored in the cell.
- * \param flags			The flags to be applied to the cell.
- * \param tab_bar		The tab bar to which the cell belongs.
- * \param tab_stop		The tab stop to which the cell belongs.
- * \param *first_cell_offset	Pointer to a variable holding the first cell offet,
- *				to be updated on return.
- * \return			TRUE if a cell was added; otherwise FALSE.
+ * \param *text			Pointer to the text to be stored in the cell, or NULL.
+ * \param flags			The flags to apply to the cell.
+ * \param tab_stop		The tab stop which the cell belongs to.
+ * \return			TRUE if a cell was stored; otherwise FALSE.
  */
 
-static osbool report_add_cell(struct report *report, char *text, enum report_cell_flags flags, int tab_bar, int tab_stop, unsigned *first_cell_offset)
+static osbool report_add_cell(struct report *report, char *text, enum report_cell_flags flags, int tab_stop)
 {
 	unsigned			content_offset, cell_offset;
 	enum report_tabs_stop_flags	tab_flags = REPORT_TABS_STOP_FLAGS_NONE;
 
+	if (report == NULL || !report->line.active || tab_stop < report->line.next_stop ||
+			(report->flags & REPORT_STATUS_MEMERR) || (report->flags & REPORT_STATUS_CLOSED))
+		return FALSE;
+
+	report->line.next_stop = tab_stop + 1;
+
 	if (text != NULL && *text != '\0') {
 		content_offset = report_textdump_store(report->content, text);
 		if (content_offset == REPORT_TEXTDUMP_NULL) {
@@ -979,15 +1446,22 @@ static osbool report_add_cell(struct report *report, char *text, enum report_cel
 		cell_offset = REPORT_CELL_NULL;
 	}
 
-	if (*first_cell_offset == REPORT_CELL_NULL)
-		*first_cell_offset = cell_offset;
+	if (report->line.first_cell == REPORT_CELL_NULL)
+		report->line.first_cell = cell_offset;
 
-	if (flags & REPORT_CELL_FLAGS_RULE_AFTER)
+	if (flags & REPORT_CELL_FLAGS_RULE_AFTER) {
 		tab_flags |= REPORT_TABS_STOP_FLAGS_RULE_AFTER;
+		report->line.flags |= REPORT_LINE_FLAGS_RULE_BELOW;
+	}
+
+	report_tabs_set_stop_flags(report->tabs, report->line.tab_bar, tab_stop, tab_flags);
+
+	if (cell_offset == REPORT_CELL_NULL)
+		return FALSE;
 
-	report_tabs_set_stop_flags(report->tabs, tab_bar, tab_stop, tab_flags);
+	report->line.cell_count++;
 
-	return (cell_offset == REPORT_CELL_NULL) ? FALSE : TRUE;
+	return TRUE;
 }
 
 
@@ -1001,13 +1475,14 @@ static osbool report_add_cell(struct report *report, char *text, enum report_cel
 
 static void report_reflow_content(struct report *report)
 {
-	int			font_width, font_height, font_descender, text_width;
-	int			line_space, rule_space, ypos;
-	unsigned		line, cell;
-	char			*content_base, *content;
-	size_t			line_count;
-	struct report_line_data	*line_data;
-	struct report_cell_data	*cell_data;
+	int				font_width, font_height, font_descender, text_width;
+	int				line_space, rule_space, ypos;
+	unsigned			line, cell, font_set;
+	char				*content_base, *content;
+	size_t				line_count;
+	struct report_line_data		*line_data;
+	struct report_cell_data		*cell_data;
+	struct report_fonts_extent	extent;
 
 	if (report == NULL)
 		return;
@@ -1026,6 +1501,8 @@ static void report_reflow_content(struct report *report)
 
 	line_space = report_fonts_get_linespace(report->fonts);
 
+	font_set = report_fonts_get_font_set(report->fonts);
+
 	content_base = report_textdump_get_base(report->content);
 
 	/* Work through the report, line by line, calculating the column positions. */
@@ -1050,7 +1527,7 @@ static void report_reflow_content(struct report *report)
 		}
 
 		ypos += (line_space + rule_space);
-		line_data->ypos = -ypos;
+		report_line_set_ypos(report->lines, line, -ypos);
 
 		if (!report_tabs_start_line_format(report->tabs, line_data->tab_bar)) {
 			report->flags |= REPORT_STATUS_MEMERR;
@@ -1068,7 +1545,14 @@ static void report_reflow_content(struct report *report)
 			} else if (cell_data->offset != REPORT_TEXTDUMP_NULL) {
 				content = content_base + cell_data->offset;
 
-				report_fonts_get_string_width(report->fonts, content, cell_data->flags, &font_width);
+				/* Widths are cached between reflows, but the font heights
+				 * must still be gathered from every cell.
+				 */
+
+				report_widths_get_extent(report->widths, cell_data->offset, content, cell_data->flags, font_set, &extent);
+				report_fonts_include_extent(report->fonts, &extent);
+
+				font_width = extent.width;
 				text_width = string_ctrl_strlen(content);
 
 				/* If the column is indented, add the indent to the column widths. */
@@ -1104,6 +1588,23 @@ static void report_reflow_content(struct report *report)
 }
 
 
+/**
+ * Measure a piece of text for the width cache, using the fonts in a
+ * report's Report Fonts instance.
+ *
+ * \param *data			The Report Fonts instance to measure with.
+ * \param *text			Pointer to the text to measure.
+ * \param flags			The cell formatting flags to be applied.
+ * \param *extent		Pointer to a structure to take the extent.
+ * \return			A pointer to an OS Error block, or NULL on success.
+ */
+
+static os_error *report_measure_text(void *data, char *text, enum report_cell_flags flags, struct report_fonts_extent *extent)
+{
+	return report_fonts_get_string_extent((struct report_fonts_block *) data, text, flags, extent);
+}
+
+
 /**
  * Test for any pending report print jobs on the specified file.
  *
@@ -1129,6 +1630,144 @@ osbool report_get_pending_print_jobs(struct file_block *file)
 }
 
 
+/**
+ * Trim the cached reports belonging to a file, deleting any which are out
+ * of date and then removing the least recently used until the memory
+ * that they use falls within the configured limit.
+ *
+ * \param *file			The file to trim the cache for.
+ */
+
+static void report_cache_trim(struct file_block *file)
+{
+	struct report	*report, *next, *oldest;
+	size_t		limit, used;
+	unsigned	version;
+	date_t		today;
+
+	if (file == NULL)
+		return;
+
+	limit = config_int_read("ReportCacheLimit") * 1024;
+	version = file_get_data_version(file);
+	today = date_today();
+
+	/* Reports which no longer match the file data can never be reused. */
+
+	report = file->reports;
+
+	while (report != NULL) {
+		next = report->next;
+
+		if ((report->flags & REPORT_STATUS_CACHED) && (report->cache_version != version || report->cache_date != today))
+			report_delete(report);
+
+		report = next;
+	}
+
+	/* Evict the least recently used reports until the cache fits into memory. */
+
+	do {
+		oldest = NULL;
+		used = 0;
+
+		for (report = file->reports; report != NULL; report = report->next) {
+			if (!(report->flags & REPORT_STATUS_CACHED))
+				continue;
+
+			used += report_get_memory(report);
+
+			if (oldest == NULL || (int) (report->cache_stamp - oldest->cache_stamp) < 0)
+				oldest = report;
+		}
+
+		if (oldest != NULL && used > limit)
+			report_delete(oldest);
+	} while (oldest != NULL && used > limit);
+}
+
+
+/**
+ * Calculate the memory being used to hold a report's content.
+ *
+ * \param *report		The report to measure.
+ * \return			The memory used, in bytes.
+ */
+
+static size_t report_get_memory(struct report *report)
+{
+	size_t	memory;
+
+	if (report == NULL)
+		return 0;
+
+	report_arena_get_usage(report->arena, &memory, NULL);
+
+	return memory;
+}
+
+
+/**
+ * Create and open the main window for a report, without its toolbar. The
+ * window can be used to show progress while the report is being generated.
+ * On failure, the report is left for the caller to deal with.
+ *
+ * \param *report		The report to open a window for.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool report_view_create_window(struct report *report)
+{
+	wimp_window_state	parent;
+	int			xextent, yextent;
+	os_error		*error;
+
+	if (report == NULL)
+		return FALSE;
+
+	/* Set up the window title */
+
+	report_window_def->title_data.indirected_text.text = report->window_title;
+
+#ifdef DEBUG
+	debug_printf("Report window width: %d", report->width);
+#endif
+
+	/* Position the report window. */
+
+	transact_get_window_state(report->file, &parent);
+
+	if (!report_get_window_extent(report, &xextent, &yextent)) {
+		xextent = REPORT_MIN_WIDTH;
+		yextent = REPORT_MIN_HEIGHT;
+	}
+
+	window_set_initial_area(report_window_def, xextent, yextent,
+			parent.visible.x0 + CHILD_WINDOW_OFFSET + file_get_next_open_offset(report->file),
+			parent.visible.y0 - CHILD_WINDOW_OFFSET, 0);
+
+	error = xwimp_create_window(report_window_def, &(report->window));
+	if (error != NULL) {
+		report->window = NULL;
+		error_report_os_error(error, wimp_ERROR_BOX_CANCEL_ICON);
+		return FALSE;
+	}
+
+	ihelp_add_window(report->window, "Report", NULL);
+
+	windows_open(report->window);
+
+	/* Register the event handles needed while the report is incomplete. */
+
+	event_add_window_user_data(report->window, report);
+	event_add_window_close_event(report->window, report_view_close_window_handler);
+	event_add_window_scroll_event(report->window, report_view_scroll_handler);
+	event_add_window_redraw_event(report->window, report_view_redraw_handler);
+
+	return TRUE;
+}
+
+
 /**
  * Handle Close events on Report View windows, deleting the window and (if there
  * are no print jobs pending) its data block.
@@ -1152,10 +1791,22 @@ static void report_view_close_window_handler(wimp_close *close)
 
 	report_view_delete_window(report);
 
-	/* Delete the report, if there are no pending print jobs. */
+	/* If there are no pending print jobs, either hold the report in the
+	 * cache so that it can be reopened if the same report is run again,
+	 * or delete it.
+	 */
+
+	if (report->print_pending > 0)
+		return;
 
-	if (report->print_pending == 0)
+	if (report->cacheable && (report->flags & REPORT_STATUS_CLOSED) && !(report->flags & REPORT_STATUS_MEMERR) &&
+			config_int_read("ReportCacheLimit") > 0) {
+		report->flags |= REPORT_STATUS_CACHED;
+		report->cache_stamp = ++report_cache_stamp;
+		report_cache_trim(report->file);
+	} else {
 		report_delete(report);
+	}
 }
 
 
@@ -1493,6 +2144,17 @@ static void report_view_redraw_handler(wimp_draw *redraw)
 	if (report == NULL)
 		return;
 
+	/* There's nothing to plot until the report has been closed. */
+
+	if (!(report->flags & REPORT_STATUS_CLOSED)) {
+		more = wimp_redraw_window(redraw);
+
+		while (more)
+			more = wimp_get_rectangle(redraw);
+
+		return;
+	}
+
 	/* Find the required font, set it and calculate the font size from the linespacing in points. */
 
 	report_fonts_find(report->fonts);
@@ -1587,6 +2249,10 @@ static void report_view_redraw_page_handler(struct report *report, wimp_draw *re
 	x1 = report_page_find_from_xpos(report->pages, redraw->clip.x1 - ox, TRUE);
 	y1 = report_page_find_from_ypos(report->pages, redraw->clip.y0 - oy, TRUE);
 
+	/* Make sure that the pages to be plotted have been laid out. */
+
+	report_paginate_rows(report, y1 + 1);
+
 	/* Plot the background. */
 
 	wimp_set_colour(wimp_COLOUR_LIGHT_GREY);
@@ -2106,7 +2772,11 @@ static void report_print_as_graphic(struct report *report)
 	struct report_page_data		*page_data;
 	struct report_region_data	*region_data;
 
-	/* If the report hasn't been paginated, we can't continue. */
+	/* Complete any pagination still in progress; if the report hasn't
+	 * been paginated, we can't continue.
+	 */
+
+	report_paginate_finish(report);
 
 	if (!report_page_paginated(report->pages))
 		return;
@@ -2455,9 +3125,9 @@ static os_error *report_plot_page_number_region(struct report *report, struct re
 		string_printf(n3, REPORT_MAX_PAGE_NUMBER_LEN, "%d", region->data.page_number.minor);
 		string_printf(n4, REPORT_MAX_PAGE_NUMBER_LEN, "%d", x_count);
 
-		msgs_param_lookup("Page2", content, REPORT_MAX_PAGE_STRING_LEN, n1, n3, n2, n4);
+		msgs_param_lookup((report_page_provisional(report->pages)) ? "Page2P" : "Page2", content, REPORT_MAX_PAGE_STRING_LEN, n1, n3, n2, n4);
 	} else {
-		msgs_param_lookup("Page1", content, REPORT_MAX_PAGE_STRING_LEN, n1, n2, NULL, NULL);
+		msgs_param_lookup((report_page_provisional(report->pages)) ? "Page1P" : "Page1", content, REPORT_MAX_PAGE_STRING_LEN, n1, n2, NULL, NULL);
 	}
 
 	/* Plot the page number information. */
@@ -2853,27 +3523,31 @@ static void report_repaginate_all(struct file_block *file)
 
 
 /**
- * Repaginate a report.
+ * Repaginate a report. Only the first few rows of pages are laid out
+ * immediately: the remainder are added on demand by report_paginate_rows(),
+ * or in the background by report_paginate_in_background().
  *
- * \param *report		The handle of the report to be repaginated.
+ * \param *report		The report to be repaginated.
  */
 
 static void report_paginate(struct report *report)
 {
-	struct report_line_data		*line_data;
-	struct report_page_layout	layout;
-	struct report_pagination_area	repeat_area, main_area;
-	int				line_height, repeat_line_height, repeat_line_ypos, repeat_tab_bar;
-	int				pages_across, pages_down, target_width;
-	int				field_height, body_height, used_height;
-	size_t				line_count;
-	unsigned			line, repeat_line;
+	struct report_pagination	*state;
+	int				target_width, field_height;
 
 	if (report == NULL)
 		return;
 
+	state = &(report->pagination);
+
 	/* Reset any existing pagination. */
 
+	if (state->active || state->extent_pending) {
+		state->active = FALSE;
+		state->extent_pending = FALSE;
+		report_pagination_pending--;
+	}
+
 	report_page_clear(report->pages);
 	report_region_clear(report->regions);
 
@@ -2893,51 +3567,91 @@ static void report_paginate(struct report *report)
 			(report->display & REPORT_DISPLAY_SHOW_NUMBERS) ? field_height : 0) != NULL)
 		return;
 
-	report_page_get_areas(report->pages, &layout);
-	if (layout.areas == REPORT_PAGE_AREA_NONE)
+	report_page_get_areas(report->pages, &(state->layout));
+	if (state->layout.areas == REPORT_PAGE_AREA_NONE)
 		return;
 
 	/* Calculate column positions across the pages. */
 
-	pages_across = report_tabs_paginate(report->tabs, layout.body.x1 - layout.body.x0);
-	if (pages_across == 0)
+	state->pages_across = report_tabs_paginate(report->tabs, state->layout.body.x1 - state->layout.body.x0);
+	if (state->pages_across == 0)
 		return;
 
 	/* The Body Height is the vertical space, in OS Units, which is available
 	 * to take output lines on the page.
 	 */
 
-	body_height = layout.body.y1 - layout.body.y0;
+	state->body_height = state->layout.body.y1 - state->layout.body.y0;
+	if (state->body_height <= 0)
+		return;
 
 	/* Initialise areas to hold the main "new" lines on the page, and to hold
 	 * any lines repeated at the top of new pages.
 	 */
 
-	main_area.active = TRUE;
-	main_area.height = 0;
-	main_area.ypos_offset = 0;
-	main_area.top_line = 0;
-	main_area.bottom_line = 0;
+	state->main_area.active = TRUE;
+	state->main_area.height = 0;
+	state->main_area.ypos_offset = 0;
+	state->main_area.top_line = 0;
+	state->main_area.bottom_line = 0;
+
+	state->repeat_area.active = FALSE;
+	state->repeat_area.height = 0;
+	state->repeat_area.ypos_offset = 0;
+	state->repeat_area.top_line = 0;
+	state->repeat_area.bottom_line = 0;
+
+	state->repeat_line = REPORT_LINE_NONE;
+	state->repeat_line_ypos = 0;
+	state->repeat_line_height = 0;
+	state->repeat_tab_bar = -1;
+	state->pages_down = 1;
+	state->used_height = 0;
+	state->line = 0;
+
+	state->active = TRUE;
+	report_pagination_pending++;
+
+	/* Until the pagination is complete, estimate the number of page rows
+	 * from the total height of the report.
+	 */
+
+	report_page_set_estimate(report->pages, (report->height + state->body_height - 1) / state->body_height);
+
+	/* Lay out the first few rows of pages, so that there's something to show. */
+
+	report_paginate_rows(report, REPORT_PAGINATE_ROWS);
+}
+
+
+/**
+ * Continue the pagination of a report until a given number of rows of pages
+ * have been laid out, or there are no more lines to process.
+ *
+ * \param *report		The report to be paginated.
+ * \param rows			The number of page rows required.
+ */
+
+static void report_paginate_rows(struct report *report, int rows)
+{
+	struct report_pagination	*state;
+	struct report_line_data		*line_data;
+	int				line_height;
+	size_t				line_count;
 
-	repeat_area.active = FALSE;
-	repeat_area.height = 0;
-	repeat_area.ypos_offset = 0;
-	repeat_area.top_line = 0;
-	repeat_area.bottom_line = 0;
+	if (report == NULL || report->pagination.active == FALSE)
+		return;
 
-	repeat_line = REPORT_LINE_NONE;
-	repeat_line_ypos = 0;
-	repeat_line_height = 0;
-	repeat_tab_bar = -1;
-	pages_down = 1;
-	used_height = 0;
+	state = &(report->pagination);
 
-	/* Process the lines in the report one at a time. */
+	/* Process the lines in the report one at a time, until the required
+	 * number of page rows have been completed.
+	 */
 
 	line_count = report_line_get_count(report->lines);
 
-	for (line = 0; line < line_count; line++) {
-		line_data = report_line_get_info(report->lines, line, &line_height);
+	for (; state->line < line_count && (state->pages_down - 1) < rows; state->line++) {
+		line_data = report_line_get_info(report->lines, state->line, &line_height);
 		if (line_data == NULL)
 			continue;
 
@@ -2948,26 +3662,26 @@ static void report_paginate(struct report *report)
 		 */
 
 		if ((line_data->flags & REPORT_LINE_FLAGS_KEEP_TOGETHER) &&
-				((line_data->tab_bar != repeat_tab_bar) || (repeat_line == REPORT_LINE_NONE))) {
-			repeat_line = line;
-			repeat_line_ypos = line_data->ypos;
-			repeat_line_height = line_height;
+				((line_data->tab_bar != state->repeat_tab_bar) || (state->repeat_line == REPORT_LINE_NONE))) {
+			state->repeat_line = state->line;
+			state->repeat_line_ypos = line_data->ypos;
+			state->repeat_line_height = line_height;
 		} else if (!(line_data->flags & REPORT_LINE_FLAGS_KEEP_TOGETHER)) {
-			repeat_line = REPORT_LINE_NONE;
+			state->repeat_line = REPORT_LINE_NONE;
 		}
 
-		repeat_tab_bar = line_data->tab_bar;
+		state->repeat_tab_bar = line_data->tab_bar;
 
 		/* If the line falls out of the visible area, package up the current page
 		 * data and add it to the page output before continuing.
 		 */
 
-		if ((main_area.ypos_offset - line_data->ypos) > (body_height - used_height)) {
-			report_add_page_row(report, &layout, &main_area, &repeat_area, pages_down, pages_across);
+		if ((state->main_area.ypos_offset - line_data->ypos) > (state->body_height - state->used_height)) {
+			report_add_page_row(report, &(state->layout), &(state->main_area), &(state->repeat_area), state->pages_down, state->pages_across);
 
 			/* Add a new page row. */
 
-			pages_down++;
+			state->pages_down++;
 
 			/* Calculate the starting position -- line and vertical offset in
 			 * OS Units of all of the Y-Pos values -- for the new page. The
@@ -2975,51 +3689,165 @@ static void report_paginate(struct report *report)
 			 * Y-Pos plus the line's height.
 			 */
 
-			main_area.ypos_offset = line_data->ypos + line_height;
-			main_area.top_line = line;
+			state->main_area.ypos_offset = line_data->ypos + line_height;
+			state->main_area.top_line = state->line;
 
 			/* If there's a line currently being repeated at the top of the
 			 * page, set up the repeat area and update the Used Height to
 			 * reflect the space lost to "new" lines.
 			 */
 
-			if (repeat_line != REPORT_LINE_NONE) {
-				repeat_area.active = TRUE;
-				repeat_area.height = repeat_line_height;
-				repeat_area.ypos_offset = repeat_line_ypos - repeat_line_height;
-				repeat_area.top_line = repeat_line;
-				repeat_area.bottom_line = repeat_line;
-				used_height = repeat_area.height;
+			if (state->repeat_line != REPORT_LINE_NONE) {
+				state->repeat_area.active = TRUE;
+				state->repeat_area.height = state->repeat_line_height;
+				state->repeat_area.ypos_offset = state->repeat_line_ypos - state->repeat_line_height;
+				state->repeat_area.top_line = state->repeat_line;
+				state->repeat_area.bottom_line = state->repeat_line;
+				state->used_height = state->repeat_area.height;
 			} else {
-				repeat_area.active = FALSE;
-				used_height = 0;
+				state->repeat_area.active = FALSE;
+				state->used_height = 0;
 			}
 		}
 
 		/* Record the current line details. */
 
-		main_area.bottom_line = line;
-		main_area.height = main_area.ypos_offset - line_data->ypos;
+		state->main_area.bottom_line = state->line;
+		state->main_area.height = state->main_area.ypos_offset - line_data->ypos;
 
 		/* If this is the first line of the page, and there are no cells on it,
 		 * skip it so that we don't have blank lines at the top of a page.
 		 */
 
-		if (main_area.top_line == line && line_data->cell_count == 0) {
-			main_area.ypos_offset = line_data->ypos;
-			main_area.top_line = line + 1;
+		if (state->main_area.top_line == state->line && line_data->cell_count == 0) {
+			state->main_area.ypos_offset = line_data->ypos;
+			state->main_area.top_line = state->line + 1;
 		}
 	}
 
+	/* If there are still lines to process, leave them for later. */
+
+	if (state->line < line_count)
+		return;
+
 	/* If there are any lines left to put out on a page, do so. */
 
-	if (line > main_area.top_line)
-		report_add_page_row(report, &layout, &main_area, &repeat_area, pages_down, pages_across);
+	if (state->line > state->main_area.top_line)
+		report_add_page_row(report, &(state->layout), &(state->main_area), &(state->repeat_area), state->pages_down, state->pages_across);
 
 	/* Close the pages and regions off, to finish the pagination. */
 
 	report_page_close(report->pages);
 	report_region_close(report->regions);
+
+	/* The page counts are now final, so the window extent must be brought
+	 * into line and everything redrawn to replace the provisional footers.
+	 * Pagination can finish from inside a redraw, so this is left for the
+	 * next Null Event: the report stays on the pending count until then.
+	 */
+
+	state->active = FALSE;
+	state->extent_pending = TRUE;
+}
+
+
+/**
+ * Complete any pagination of a report which is still in progress.
+ *
+ * \param *report		The report to be paginated.
+ */
+
+static void report_paginate_finish(struct report *report)
+{
+	if (report == NULL || report->pagination.active == FALSE)
+		return;
+
+	hourglass_on();
+	report_paginate_rows(report, INT_MAX);
+	hourglass_off();
+}
+
+
+/**
+ * Test whether any reports have pagination which is still in progress,
+ * and which should be continued by calling report_paginate_in_background().
+ *
+ * \return			TRUE if there is work pending; otherwise FALSE.
+ */
+
+osbool report_paginate_pending(void)
+{
+	return (report_pagination_pending > 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * Continue the pagination of any reports which still have some in progress,
+ * adding a few rows of pages to each. This should be called on Null Events
+ * while report_paginate_pending() returns TRUE.
+ */
+
+void report_paginate_in_background(void)
+{
+	if (report_pagination_pending > 0)
+		file_process_all(report_paginate_file_in_background);
+}
+
+
+/**
+ * Continue the pagination of any reports in a file which still have some
+ * in progress.
+ *
+ * \param *file			The file to be processed.
+ */
+
+static void report_paginate_file_in_background(struct file_block *file)
+{
+	struct report	*report;
+	int		rows;
+
+	if (file == NULL)
+		return;
+
+	report = file->reports;
+
+	while (report != NULL) {
+		if (report->pagination.active) {
+			rows = report->pagination.pages_down - 1 + REPORT_PAGINATE_ROWS;
+
+			report_paginate_rows(report, rows);
+		}
+
+		if (report->pagination.extent_pending)
+			report_paginate_update_extent(report);
+
+		report = report->next;
+	}
+}
+
+
+/**
+ * Bring the window extent of a report into line once its pagination has
+ * completed, and queue a redraw of the whole window to replace the
+ * provisional page footers.
+ *
+ * \param *report		The report to be updated.
+ */
+
+static void report_paginate_update_extent(struct report *report)
+{
+	int	width, height;
+
+	if (report == NULL || report->pagination.extent_pending == FALSE)
+		return;
+
+	report->pagination.extent_pending = FALSE;
+	report_pagination_pending--;
+
+	report_set_window_extent(report);
+
+	if (report->window != NULL && report_get_window_extent(report, &width, &height))
+		window_queue_redraw(report->window, 0, -height, width, 0);
 }
 
 
@@ -30,6 +30,11 @@
 #ifndef CASHBOOK_REPORT
 #define CASHBOOK_REPORT
 
+#include "currency.h"
+#include "date.h"
+#include "report_cell.h"
+#include "report_line.h"
+
 /* Report data block format consists of a series of lines as follows:
  *
  * <tab-bar-data><format flag>text[\t<format flag>text]\0
@@ -97,6 +102,80 @@ void report_set_options(struct report *report, osbool fitwidth, osbool rotate, o
 void report_close(struct report *report);
 
 
+/**
+ * Set the key under which a report can be held in the cache once its
+ * window has been closed. Reports without a key are deleted when their
+ * windows close.
+ *
+ * \param *report		The report handle.
+ * \param key			The hash of the report's template and title.
+ * \param version		The file data version used to generate the report.
+ * \param date			The date on which the report was generated.
+ */
+
+void report_set_cache_key(struct report *report, unsigned key, unsigned version, date_t date);
+
+
+/**
+ * Find a cached report in a file which was generated from a given template,
+ * with the same key, file data version and date.
+ *
+ * \param *file			The file to search.
+ * \param *template		The template to match.
+ * \param key			The hash of the template and title to match.
+ * \param version		The file data version to match.
+ * \param date			The date to match.
+ * \return			The matching report, or NULL if none was found.
+ */
+
+struct report *report_find_cached(struct file_block *file, struct analysis_report *template, unsigned key, unsigned version, date_t date);
+
+
+/**
+ * Take a report out of the cache, and open a window to display it on
+ * screen again.
+ *
+ * \param *report		The report handle.
+ */
+
+void report_reopen(struct report *report);
+
+
+/**
+ * Delete all of the cached reports belonging to a file. This should be
+ * called when the Choices change, as the cached reports were formatted
+ * using the old date and currency settings.
+ *
+ * \param *file			The file to flush the cache for.
+ */
+
+void report_flush_cache(struct file_block *file);
+
+
+/**
+ * Show the progress of a report which is being generated in the background,
+ * opening a window for it if there isn't one on screen already.
+ *
+ * \param *report		The report handle.
+ * \param percent		The percentage of the report which is complete.
+ */
+
+void report_show_progress(struct report *report, int percent);
+
+
+/**
+ * Set a callback to be used if a report being generated in the background
+ * is deleted before it has been closed, so that the generation can be
+ * abandoned.
+ *
+ * \param *report		The report handle.
+ * \param *callback		The function to call, or NULL for none.
+ * \param *data		Data to pass to the callback function.
+ */
+
+void report_set_cancel_handler(struct report *report, void (*callback)(void *data), void *data);
+
+
 /**
  * Close off a report that has had data written to it, and send it directly
  * to the printing system before deleting it.
@@ -150,6 +229,87 @@ struct file_block *report_get_file(struct report *report);
 void report_write_line(struct report *report, int bar, char *text);
 
 
+/**
+ * Start a new line in an open report, which can then be filled with cells
+ * using the report_add_*_cell() calls before being completed with
+ * report_end_line(). Any line which is already open will be completed first.
+ *
+ * Cells must be added in ascending order of tab stop. A cell flagged with
+ * REPORT_CELL_FLAGS_RULE_AFTER will also place a rule below its line.
+ *
+ * \param *report		The report to write to.
+ * \param tab_bar		The tab bar to use.
+ * \param flags			The flags to apply to the line.
+ */
+
+void report_begin_line(struct report *report, int tab_bar, enum report_line_flags flags);
+
+
+/**
+ * Add a cell containing a text string to the current line of a report.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param *text			The text to place in the cell, or NULL.
+ */
+
+void report_add_text_cell(struct report *report, int tab_stop, enum report_cell_flags flags, char *text);
+
+
+/**
+ * Add a cell containing a message from the application messages, with
+ * optional parameter substitution, to the current line of a report.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param *token		The token of the message to place in the cell.
+ * \param *a			Pointer to parameter %0, or NULL.
+ * \param *b			Pointer to parameter %1, or NULL.
+ * \param *c			Pointer to parameter %2, or NULL.
+ * \param *d			Pointer to parameter %3, or NULL.
+ */
+
+void report_add_message_cell(struct report *report, int tab_stop, enum report_cell_flags flags, char *token, char *a, char *b, char *c, char *d);
+
+
+/**
+ * Add a cell containing a currency amount to the current line of a report.
+ * The cell will be flagged as numeric, in addition to the flags supplied.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param amount		The amount to place in the cell.
+ * \param print_zeros		TRUE to show zero amounts as 0; FALSE to
+ *				leave the cell blank.
+ */
+
+void report_add_currency_cell(struct report *report, int tab_stop, enum report_cell_flags flags, amt_t amount, osbool print_zeros);
+
+
+/**
+ * Add a cell containing a date to the current line of a report.
+ *
+ * \param *report		The report to write to.
+ * \param tab_stop		The tab stop to place the cell in.
+ * \param flags			The flags to apply to the cell.
+ * \param date			The date to place in the cell.
+ */
+
+void report_add_date_cell(struct report *report, int tab_stop, enum report_cell_flags flags, date_t date);
+
+
+/**
+ * Complete the current line in an open report, and store it.
+ *
+ * \param *report		The report to write to.
+ */
+
+void report_end_line(struct report *report);
+
+
 /**
  * Test for any pending report print jobs on the specified file.
  *
@@ -180,5 +340,24 @@ void report_redraw_all(struct file_block *file);
 
 void report_process_all_templates(struct file_block *file, void (*callback)(struct analysis_report *template, void *data), void *data);
 
+
+/**
+ * Test whether any reports have pagination which is still in progress,
+ * and which should be continued by calling report_paginate_in_background().
+ *
+ * \return			TRUE if there is work pending; otherwise FALSE.
+ */
+
+osbool report_paginate_pending(void);
+
+
+/**
+ * Continue the pagination of any reports which still have some in progress,
+ * adding a few rows of pages to each. This should be called on Null Events
+ * while report_paginate_pending() returns TRUE.
+ */
+
+void report_paginate_in_background(void);
+
 #endif
 
@@ -0,0 +1,487 @@
+/* Copyright 2003-2017, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: report_arena.c
+ *
+ * Per-report memory arena implementation.
+ *
+ * Small blocks are carved sequentially out of shared chunks, which start
+ * at REPORT_ARENA_MIN_CHUNK bytes and double in size up to a maximum of
+ * REPORT_ARENA_MAX_CHUNK. The most recent block in the current chunk can
+ * grow or shrink in place; any other small block is moved when it grows,
+ * leaving its old space unused until the arena is destroyed. Blocks above
+ * REPORT_ARENA_LARGE_BLOCK bytes are given a chunk of their own, which is
+ * resized on the heap directly, so that the large and growing arrays of a
+ * report do not leave copies of themselves behind.
+ */
+
+/* ANSI C Header files. */
+
+#include <stdlib.h>
+#include <string.h>
+
+/* SFLib Header files. */
+
+#include "sflib/debug.h"
+#include "sflib/heap.h"
+
+/* OSLib Header files. */
+
+#include "oslib/types.h"
+
+/* Application header files. */
+
+#include "report_arena.h"
+
+/**
+ * The alignment of blocks allocated from the arena.
+ */
+
+#define REPORT_ARENA_ALIGNMENT 8
+
+/**
+ * The size of the first shared chunk in an arena.
+ */
+
+#define REPORT_ARENA_MIN_CHUNK 4096
+
+/**
+ * The maximum size of a shared chunk in an arena.
+ */
+
+#define REPORT_ARENA_MAX_CHUNK 65536
+
+/**
+ * Blocks larger than this are given a chunk of their own.
+ */
+
+#define REPORT_ARENA_LARGE_BLOCK 16384
+
+/**
+ * Round a block size up to the arena alignment.
+ */
+
+#define report_arena_round(size) (((size) + REPORT_ARENA_ALIGNMENT - 1) & ~(REPORT_ARENA_ALIGNMENT - 1))
+
+/**
+ * A chunk of memory claimed from the heap by an arena.
+ */
+
+struct report_arena_chunk {
+	struct report_arena_chunk	*next;			/**< The next chunk in the arena.				*/
+	struct report_arena_chunk	*previous;		/**< The previous chunk in the arena.				*/
+
+	size_t				size;			/**< The space available in the chunk, in bytes.		*/
+	size_t				used;			/**< The space allocated from the chunk, in bytes.		*/
+	size_t				last;			/**< The offset of the most recently allocated block.		*/
+};
+
+/**
+ * The size of a chunk header, rounded up to maintain block alignment.
+ */
+
+#define REPORT_ARENA_HEADER_SIZE (report_arena_round(sizeof(struct report_arena_chunk)))
+
+/**
+ * Find the data held in a chunk.
+ */
+
+#define report_arena_chunk_data(chunk) (((char *) (chunk)) + REPORT_ARENA_HEADER_SIZE)
+
+/**
+ * A Report Arena instance data block.
+ */
+
+struct report_arena_block {
+	struct report_arena_chunk	*chunks;		/**< The list of chunks claimed by the arena.			*/
+	struct report_arena_chunk	*current;		/**< The shared chunk being allocated from, or NULL.		*/
+	size_t				next_chunk;		/**< The size of the next shared chunk to be claimed.		*/
+
+	size_t				claimed;		/**< The number of bytes currently claimed from the heap.	*/
+	size_t				peak;			/**< The largest number of bytes claimed from the heap.		*/
+	size_t				live;			/**< The number of bytes in blocks currently allocated.		*/
+};
+
+/* Static Function Prototypes. */
+
+static size_t report_arena_block_size(size_t size);
+static struct report_arena_chunk *report_arena_claim_chunk(struct report_arena_block *handle, size_t size);
+static void report_arena_release_chunk(struct report_arena_block *handle, struct report_arena_chunk *chunk);
+static osbool report_arena_is_last(struct report_arena_block *handle, void *block, size_t size);
+
+
+/**
+ * Create a new report arena.
+ *
+ * \return			The arena handle, or NULL on failure.
+ */
+
+struct report_arena_block *report_arena_create(void)
+{
+	struct report_arena_block	*new;
+
+	new = heap_alloc(sizeof(struct report_arena_block));
+	if (new == NULL)
+		return NULL;
+
+	new->chunks = NULL;
+	new->current = NULL;
+	new->next_chunk = REPORT_ARENA_MIN_CHUNK;
+
+	new->claimed = 0;
+	new->peak = 0;
+	new->live = 0;
+
+	return new;
+}
+
+
+/**
+ * Destroy a report arena, returning all of the memory allocated from it
+ * to the heap.
+ *
+ * \param *handle		The arena to be destroyed.
+ */
+
+void report_arena_destroy(struct report_arena_block *handle)
+{
+	struct report_arena_chunk	*chunk, *next;
+
+	if (handle == NULL)
+		return;
+
+#ifdef DEBUG
+	debug_printf("Report arena: %dKb claimed at peak, %dKb at end, %dKb in use", handle->peak / 1024, handle->claimed / 1024, handle->live / 1024);
+#endif
+
+	for (chunk = handle->chunks; chunk != NULL; chunk = next) {
+		next = chunk->next;
+		heap_free(chunk);
+	}
+
+	heap_free(handle);
+}
+
+
+/**
+ * Allocate a block of memory from a report arena.
+ *
+ * \param *handle		The arena to allocate from.
+ * \param size			The size of the block required, in bytes.
+ * \return			Pointer to the new block, or NULL on failure.
+ */
+
+void *report_arena_alloc(struct report_arena_block *handle, size_t size)
+{
+	struct report_arena_chunk	*chunk;
+	size_t				chunk_size;
+
+	if (handle == NULL)
+		return NULL;
+
+	size = report_arena_block_size(size);
+
+	/* Large blocks get a chunk to themselves. */
+
+	if (size > REPORT_ARENA_LARGE_BLOCK) {
+		chunk = report_arena_claim_chunk(handle, size);
+		if (chunk == NULL)
+			return NULL;
+
+		chunk->used = size;
+		handle->live += size;
+
+		return report_arena_chunk_data(chunk);
+	}
+
+	/* If the current shared chunk is full, claim a bigger one. Any space
+	 * left at the end of the old chunk is abandoned.
+	 */
+
+	if (handle->current == NULL || handle->current->size - handle->current->used < size) {
+		chunk_size = handle->next_chunk;
+
+		while (chunk_size < size)
+			chunk_size *= 2;
+
+		chunk = report_arena_claim_chunk(handle, chunk_size);
+		if (chunk == NULL)
+			return NULL;
+
+		handle->current = chunk;
+
+		if (handle->next_chunk < REPORT_ARENA_MAX_CHUNK)
+			handle->next_chunk *= 2;
+	}
+
+	chunk = handle->current;
+
+	chunk->last = chunk->used;
+	chunk->used += size;
+	handle->live += size;
+
+	return report_arena_chunk_data(chunk) + chunk->last;
+}
+
+
+/**
+ * Change the size of a block allocated from a report arena. The block
+ * may move, in which case its contents are copied; if the new space
+ * can't be found, the existing block is left untouched.
+ *
+ * \param *handle		The arena holding the block.
+ * \param *block		The block to be resized, or NULL to allocate
+ *				a new block.
+ * \param old_size		The current size of the block, in bytes, as
+ *				last allocated.
+ * \param new_size		The new size required, in bytes.
+ * \return			Pointer to the resized block, or NULL on failure.
+ */
+
+void *report_arena_extend(struct report_arena_block *handle, void *block, size_t old_size, size_t new_size)
+{
+	struct report_arena_chunk	*chunk, *extended;
+	void				*new;
+
+	if (handle == NULL)
+		return NULL;
+
+	if (block == NULL)
+		return report_arena_alloc(handle, new_size);
+
+	old_size = report_arena_block_size(old_size);
+	new_size = report_arena_block_size(new_size);
+
+	if (old_size == new_size)
+		return block;
+
+	/* A large block which is staying large can be resized on the heap. */
+
+	if (old_size > REPORT_ARENA_LARGE_BLOCK && new_size > REPORT_ARENA_LARGE_BLOCK) {
+		chunk = (struct report_arena_chunk *) ((char *) block - REPORT_ARENA_HEADER_SIZE);
+
+		extended = heap_extend(chunk, REPORT_ARENA_HEADER_SIZE + new_size);
+		if (extended == NULL)
+			return NULL;
+
+		if (extended->previous != NULL)
+			extended->previous->next = extended;
+		else
+			handle->chunks = extended;
+
+		if (extended->next != NULL)
+			extended->next->previous = extended;
+
+		handle->claimed = handle->claimed + new_size - old_size;
+		handle->live = handle->live + new_size - old_size;
+
+		if (handle->claimed > handle->peak)
+			handle->peak = handle->claimed;
+
+		extended->size = new_size;
+		extended->used = new_size;
+
+		return report_arena_chunk_data(extended);
+	}
+
+	/* A small block which was the last to be allocated can change in place
+	 * if there's room in its chunk, and any small block can shrink.
+	 */
+
+	if (old_size <= REPORT_ARENA_LARGE_BLOCK && new_size <= REPORT_ARENA_LARGE_BLOCK) {
+		if (report_arena_is_last(handle, block, old_size) &&
+				handle->current->last + new_size <= handle->current->size) {
+			handle->current->used = handle->current->last + new_size;
+			handle->live = handle->live + new_size - old_size;
+			return block;
+		}
+
+		if (new_size < old_size) {
+			handle->live -= old_size - new_size;
+			return block;
+		}
+	}
+
+	/* Otherwise, the block must move. */
+
+	new = report_arena_alloc(handle, new_size);
+	if (new == NULL)
+		return NULL;
+
+	memcpy(new, block, (old_size < new_size) ? old_size : new_size);
+
+	report_arena_free(handle, block, old_size);
+
+	return new;
+}
+
+
+/**
+ * Release a block allocated from a report arena, so that its space can
+ * be reused where possible.
+ *
+ * \param *handle		The arena holding the block.
+ * \param *block		The block to be released.
+ * \param size			The current size of the block, in bytes.
+ */
+
+void report_arena_free(struct report_arena_block *handle, void *block, size_t size)
+{
+	if (handle == NULL || block == NULL)
+		return;
+
+	size = report_arena_block_size(size);
+
+	handle->live -= size;
+
+	/* Large blocks can be handed straight back to the heap, while the
+	 * space from a small block can only be reused if it was the last
+	 * one allocated.
+	 */
+
+	if (size > REPORT_ARENA_LARGE_BLOCK) {
+		report_arena_release_chunk(handle, (struct report_arena_chunk *) ((char *) block - REPORT_ARENA_HEADER_SIZE));
+	} else if (report_arena_is_last(handle, block, size)) {
+		handle->current->used = handle->current->last;
+	}
+}
+
+
+/**
+ * Return the amount of heap memory claimed by a report arena, both
+ * now and at its peak.
+ *
+ * \param *handle		The arena to query.
+ * \param *current		Pointer to a variable to take the number of
+ *				bytes currently claimed, or NULL.
+ * \param *peak			Pointer to a variable to take the largest
+ *				number of bytes claimed, or NULL.
+ */
+
+void report_arena_get_usage(struct report_arena_block *handle, size_t *current, size_t *peak)
+{
+	if (current != NULL)
+		*current = (handle == NULL) ? 0 : handle->claimed;
+
+	if (peak != NULL)
+		*peak = (handle == NULL) ? 0 : handle->peak;
+}
+
+
+/**
+ * Convert a requested block size into the size which will be allocated.
+ *
+ * \param size			The requested size, in bytes.
+ * \return			The allocated size, in bytes.
+ */
+
+static size_t report_arena_block_size(size_t size)
+{
+	return (size == 0) ? REPORT_ARENA_ALIGNMENT : report_arena_round(size);
+}
+
+
+/**
+ * Claim a new chunk from the heap, and link it in to an arena.
+ *
+ * \param *handle		The arena to add the chunk to.
+ * \param size			The space required in the chunk, in bytes.
+ * \return			Pointer to the new chunk, or NULL on failure.
+ */
+
+static struct report_arena_chunk *report_arena_claim_chunk(struct report_arena_block *handle, size_t size)
+{
+	struct report_arena_chunk	*chunk;
+
+	chunk = heap_alloc(REPORT_ARENA_HEADER_SIZE + size);
+	if (chunk == NULL)
+		return NULL;
+
+	chunk->size = size;
+	chunk->used = 0;
+	chunk->last = 0;
+
+	chunk->previous = NULL;
+	chunk->next = handle->chunks;
+
+	if (handle->chunks != NULL)
+		handle->chunks->previous = chunk;
+
+	handle->chunks = chunk;
+
+	handle->claimed += REPORT_ARENA_HEADER_SIZE + size;
+
+	if (handle->claimed > handle->peak)
+		handle->peak = handle->claimed;
+
+	return chunk;
+}
+
+
+/**
+ * Unlink a chunk from an arena, and return it to the heap.
+ *
+ * \param *handle		The arena holding the chunk.
+ * \param *chunk		The chunk to release.
+ */
+
+static void report_arena_release_chunk(struct report_arena_block *handle, struct report_arena_chunk *chunk)
+{
+	if (chunk->previous != NULL)
+		chunk->previous->next = chunk->next;
+	else
+		handle->chunks = chunk->next;
+
+	if (chunk->next != NULL)
+		chunk->next->previous = chunk->previous;
+
+	if (handle->current == chunk)
+		handle->current = NULL;
+
+	handle->claimed -= REPORT_ARENA_HEADER_SIZE + chunk->size;
+
+	heap_free(chunk);
+}
+
+
+/**
+ * Test whether a small block is the most recent allocation from the
+ * current shared chunk of an arena.
+ *
+ * \param *handle		The arena holding the block.
+ * \param *block		The block to test.
+ * \param size			The allocated size of the block, in bytes.
+ * \return			TRUE if the block is the last allocated; else FALSE.
+ */
+
+static osbool report_arena_is_last(struct report_arena_block *handle, void *block, size_t size)
+{
+	struct report_arena_chunk	*chunk = handle->current;
+
+	if (chunk == NULL || chunk->used - chunk->last != size)
+		return FALSE;
+
+	return ((char *) block == report_arena_chunk_data(chunk) + chunk->last) ? TRUE : FALSE;
+}
+
@@ -0,0 +1,122 @@
+/* Copyright 2003-2017, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: report_arena.h
+ *
+ * Per-report memory arena.
+ *
+ * A report arena supplies the memory for all of the data blocks which
+ * belong to a single report, taking it from the heap in chunks which
+ * grow geometrically as the report is built. Blocks in the arena can be
+ * extended or released, but the memory is only returned to the heap when
+ * the whole arena is destroyed, so a report can be torn down in a single
+ * call without shuffling or fragmenting the heap.
+ */
+
+#ifndef CASHBOOK_REPORT_ARENA
+#define CASHBOOK_REPORT_ARENA
+
+#include <stdlib.h>
+
+/**
+ * A Report Arena instance handle.
+ */
+
+struct report_arena_block;
+
+
+/**
+ * Create a new report arena.
+ *
+ * \return			The arena handle, or NULL on failure.
+ */
+
+struct report_arena_block *report_arena_create(void);
+
+
+/**
+ * Destroy a report arena, returning all of the memory allocated from it
+ * to the heap.
+ *
+ * \param *handle		The arena to be destroyed.
+ */
+
+void report_arena_destroy(struct report_arena_block *handle);
+
+
+/**
+ * Allocate a block of memory from a report arena.
+ *
+ * \param *handle		The arena to allocate from.
+ * \param size			The size of the block required, in bytes.
+ * \return			Pointer to the new block, or NULL on failure.
+ */
+
+void *report_arena_alloc(struct report_arena_block *handle, size_t size);
+
+
+/**
+ * Change the size of a block allocated from a report arena. The block
+ * may move, in which case its contents are copied; if the new space
+ * can't be found, the existing block is left untouched.
+ *
+ * \param *handle		The arena holding the block.
+ * \param *block		The block to be resized, or NULL to allocate
+ *				a new block.
+ * \param old_size		The current size of the block, in bytes, as
+ *				last allocated.
+ * \param new_size		The new size required, in bytes.
+ * \return			Pointer to the resized block, or NULL on failure.
+ */
+
+void *report_arena_extend(struct report_arena_block *handle, void *block, size_t old_size, size_t new_size);
+
+
+/**
+ * Release a block allocated from a report arena, so that its space can
+ * be reused where possible.
+ *
+ * \param *handle		The arena holding the block.
+ * \param *block		The block to be released.
+ * \param size			The current size of the block, in bytes.
+ */
+
+void report_arena_free(struct report_arena_block *handle, void *block, size_t size);
+
+
+/**
+ * Return the amount of heap memory claimed by a report arena, both
+ * now and at its peak.
+ *
+ * \param *handle		The arena to query.
+ * \param *current		Pointer to a variable to take the number of
+ *				bytes currently claimed, or NULL.
+ * \param *peak			Pointer to a variable to take the largest
+ *				number of bytes claimed, or NULL.
+ */
+
+void report_arena_get_usage(struct report_arena_block *handle, size_t *current, size_t *peak);
+
+#endif
+
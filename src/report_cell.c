@@ -33,14 +33,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Acorn C Header files. */
-
-#include "flex.h"
-
 /* SFLib Header files. */
 
 #include "sflib/debug.h"
-#include "sflib/heap.h"
 
 /* OSLib Header files. */
 
@@ -50,7 +45,8 @@
 
 #include "report_cell.h"
 
-#include "flexutils.h"
+#include "report_arena.h"
+#include "report_store.h"
 
 /**
  * The default allocation block size.
@@ -64,38 +60,33 @@
  */
 
 struct report_cell_block {
-	struct report_cell_data	*cells;
-	size_t			size;
-	size_t			cell_count;
-	size_t			allocation;
+	struct report_store_block	*cells;			/**< The store holding the cell data.				*/
 };
 
 
 /**
  * Initialise a report cell data block
  *
+ * \param *arena		The arena from which to allocate memory.
  * \param allocation		The allocation block size, or 0 for the default.
+ * \param limit			The amount of memory to hold cells in before
+ *				spilling them to disc, in bytes, or 0 for no limit.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_cell_block *report_cell_create(size_t allocation)
+struct report_cell_block *report_cell_create(struct report_arena_block *arena, size_t allocation, size_t limit)
 {
 	struct report_cell_block	*new;
 
-	new = heap_alloc(sizeof(struct report_cell_block));
+	new = report_arena_alloc(arena, sizeof(struct report_cell_block));
 	if (new == NULL)
 		return NULL;
 
-	new->allocation = (allocation == 0) ? REPORT_CELL_ALLOCATION : allocation;
-
-	new->cells = NULL;
-	new->cell_count = 0;
-	new->size = new->allocation;
-
-	/* Claim the memory for the dump itself. */
+	/* Claim the memory for the cell store itself. */
 
-	if (!flexutils_allocate((void **) &(new->cells), sizeof(struct report_cell_data), new->allocation)) {
-		heap_free(new);
+	new->cells = report_store_create(arena, sizeof(struct report_cell_data), (allocation == 0) ? REPORT_CELL_ALLOCATION : allocation, limit);
+	if (new->cells == NULL) {
+		report_arena_free(arena, new, sizeof(struct report_cell_block));
 		return NULL;
 	}
 
@@ -104,7 +95,8 @@ struct report_cell_block *report_cell_create(size_t allocation)
 
 
 /**
- * Destroy a report cell data block, freeing the memory associated with it.
+ * Destroy a report cell data block. The memory is returned when the
+ * block's arena is destroyed.
  *
  * \param *handle		The block to be destroyed.
  */
@@ -114,9 +106,7 @@ void report_cell_destroy(struct report_cell_block *handle)
 	if (handle == NULL)
 		return;
 
-	flexutils_free((void **) &(handle->cells));
-
-	heap_free(handle);
+	report_store_destroy(handle->cells);
 }
 
 
@@ -129,33 +119,33 @@ void report_cell_destroy(struct report_cell_block *handle)
 
 void report_cell_clear(struct report_cell_block *handle)
 {
-	if (handle == NULL || handle->cells == NULL)
+	if (handle == NULL)
 		return;
 
-	handle->cell_count = 0;
-
-	if (flexutils_resize((void **) &(handle->cells), sizeof(struct report_cell_data), handle->allocation))
-		handle->size = handle->allocation;
+	report_store_clear(handle->cells);
 }
 
 
 /**
- * Close a report cell data block, so that its allocation shrinks to
- * occupy only the space used by data.
+ * Close a report cell data block, once all of the cells have been added.
  *
  * \param *handle		The block to be closed.
  */
 
 void report_cell_close(struct report_cell_block *handle)
 {
-	if (handle == NULL || handle->cells == NULL)
-		return;
+#ifdef DEBUG
+	size_t		resident;
+	unsigned	transfers;
+#endif
 
-	if (flexutils_resize((void **) &(handle->cells), sizeof(struct report_cell_data), handle->cell_count))
-		handle->size = handle->cell_count;
+	if (handle == NULL)
+		return;
 
 #ifdef DEBUG
-	debug_printf("Cell data: %d records, using %dKb", handle->cell_count, handle->cell_count * sizeof (struct report_cell_data) / 1024);
+	report_store_get_usage(handle->cells, &resident, &transfers);
+	debug_printf("Cell data: %d records, using %dKb in memory after %d disc transfers",
+			report_store_get_count(handle->cells), resident / 1024, transfers);
 #endif
 }
 
@@ -172,32 +162,26 @@ void report_cell_close(struct report_cell_block *handle)
 
 unsigned report_cell_add(struct report_cell_block *handle, unsigned offset, int tab_stop, enum report_cell_flags flags)
 {
-	unsigned new;
+	struct report_cell_data	cell;
+	unsigned		new;
 
-	if (handle == NULL || handle->cells == NULL)
+	if (handle == NULL)
 		return REPORT_CELL_NULL;
 
-	if (handle->cell_count >= handle->size) {
-		if (!flexutils_resize((void **) &(handle->cells), sizeof(struct report_cell_data), handle->size + handle->allocation))
-			return REPORT_CELL_NULL;
-
-		handle->size += handle->allocation;
-	}
-
-	new = handle->cell_count++;
+	cell.flags = flags;
+	cell.offset = offset;
+	cell.tab_stop = tab_stop;
 
-	handle->cells[new].flags = flags;
-	handle->cells[new].offset = offset;
-	handle->cells[new].tab_stop = tab_stop;
+	new = report_store_add(handle->cells, &cell);
 
-	return new;
+	return (new == REPORT_STORE_NULL) ? REPORT_CELL_NULL : new;
 }
 
 
 /**
- * Return details about a line held in a report line data block. The data
- * returned is transient, and not guaranteed to remain valid if the flex
- * heap shifts.
+ * Return details about a cell held in a report cell data block. The data
+ * returned is transient, and not guaranteed to remain valid once other
+ * cells have been requested.
  *
  * \param *handle		The block to query.
  * \param line			The cell to query.
@@ -206,12 +190,30 @@ unsigned report_cell_add(struct report_cell_block *handle, unsigned offset, int
 
 struct report_cell_data *report_cell_get_info(struct report_cell_block *handle, unsigned cell)
 {
-	if (handle == NULL || handle->cells == NULL)
+	if (handle == NULL)
 		return NULL;
 
-	if (cell >= handle->cell_count)
-		return NULL;
+	return report_store_get(handle->cells, cell, FALSE);
+}
+
+
+/**
+ * Return the amount of memory being used to hold a report cell data block,
+ * not counting any data which has been spilled to disc.
+ *
+ * \param *handle		The block to query.
+ * \return			The memory in use, in bytes.
+ */
+
+size_t report_cell_get_memory(struct report_cell_block *handle)
+{
+	size_t	resident;
+
+	if (handle == NULL)
+		return 0;
+
+	report_store_get_usage(handle->cells, &resident, NULL);
 
-	return handle->cells + cell;
+	return resident;
 }
 
@@ -31,6 +31,8 @@
 #ifndef CASHBOOK_REPORT_CELL
 #define CASHBOOK_REPORT_CELL
 
+#include "report_arena.h"
+
 /**
  * Flags relating to a cell in a report.
  */
@@ -77,15 +79,19 @@ struct report_cell_block;
 /**
  * Initialise a report cell data block
  *
+ * \param *arena		The arena from which to allocate memory.
  * \param allocation		The allocation block size, or 0 for the default.
+ * \param limit			The amount of memory to hold cells in before
+ *				spilling them to disc, in bytes, or 0 for no limit.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_cell_block *report_cell_create(size_t allocation);
+struct report_cell_block *report_cell_create(struct report_arena_block *arena, size_t allocation, size_t limit);
 
 
 /**
- * Destroy a report cell data block, freeing the memory associated with it.
+ * Destroy a report cell data block. The memory is returned when the
+ * block's arena is destroyed.
  *
  * \param *handle		The block to be destroyed.
  */
@@ -104,8 +110,7 @@ void report_cell_clear(struct report_cell_block *handle);
 
 
 /**
- * Close a report cell data block, so that its allocation shrinks to
- * occupy only the space used by data.
+ * Close a report cell data block, once all of the cells have been added.
  *
  * \param *handle		The block to be closed.
  */
@@ -127,9 +132,9 @@ unsigned report_cell_add(struct report_cell_block *handle, unsigned offset, int
 
 
 /**
- * Return details about a line held in a report line data block. The data
- * returned is transient, and not guaranteed to remain valid if the flex
- * heap shifts.
+ * Return details about a cell held in a report cell data block. The data
+ * returned is transient, and not guaranteed to remain valid once other
+ * cells have been requested.
  *
  * \param *handle		The block to query.
  * \param line			The cell to query.
@@ -138,5 +143,16 @@ unsigned report_cell_add(struct report_cell_block *handle, unsigned offset, int
 
 struct report_cell_data *report_cell_get_info(struct report_cell_block *handle, unsigned cell);
 
+
+/**
+ * Return the amount of memory being used to hold a report cell data block,
+ * not counting any data which has been spilled to disc.
+ *
+ * \param *handle		The block to query.
+ * \return			The memory in use, in bytes.
+ */
+
+size_t report_cell_get_memory(struct report_cell_block *handle);
+
 #endif
 
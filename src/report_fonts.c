@@ -80,6 +80,8 @@ struct report_fonts_block {
 
 	int				max_height;			/**< The maximum font height encountered, in millipoints.		*/
 	int				max_descender;			/**< The maximum font descender encountered, in millipoints.		*/
+
+	unsigned			font_set;			/**< A value which changes whenever the faces or size are updated.	*/
 };
 
 /**
@@ -163,6 +165,7 @@ struct report_fonts_block *report_fonts_create(void)
 	new->linespace = 130;
 	new->max_height = 0;
 	new->max_descender = 0;
+	new->font_set = 0;
 
 	return new;
 }
@@ -202,6 +205,8 @@ void report_fonts_set_faces(struct report_fonts_block *handle, char *normal, cha
 	if (handle == NULL)
 		return;
 
+	handle->font_set++;
+
 	if (normal != NULL)
 		report_fonts_set_face(&(handle->normal), normal);
 
@@ -265,6 +270,7 @@ void report_fonts_set_size(struct report_fonts_block *handle, int size, int line
 
 	handle->size = size;
 	handle->linespace = linespace;
+	handle->font_set++;
 }
 
 
@@ -291,6 +297,24 @@ void report_fonts_get_size(struct report_fonts_block *handle, int *size, int *li
 }
 
 
+/**
+ * Return a value identifying the current set of faces and size in a Report
+ * Fonts instance. The value changes whenever either is updated, so that any
+ * measurements taken using the old fonts can be identified and discarded.
+ *
+ * \param *handle		The Report Fonts instance to query.
+ * \return			The current font set value.
+ */
+
+unsigned report_fonts_get_font_set(struct report_fonts_block *handle)
+{
+	if (handle == NULL)
+		return 0;
+
+	return handle->font_set;
+}
+
+
 /**
  * Return the required line spacing, in OS Units, for the fonts specified
  * in a Report Fonts instance.
@@ -352,8 +376,8 @@ os_error *report_fonts_find(struct report_fonts_block *handle)
 
 /**
  * Return the greatest line and descender height encountered during any
- * call to report_fonts_get_string_width() since the last call to
- * report_fonts_find(), in OS Units.
+ * call to report_fonts_get_string_width() or report_fonts_include_extent()
+ * since the last call to report_fonts_find(), in OS Units.
  *
  * \param *handle		The Reports Fonts instance to query
  * \param *height		Pointer to variable to take the height.
@@ -416,8 +440,8 @@ void report_fonts_lose(struct report_fonts_block *handle)
 
 os_error *report_fonts_get_string_width(struct report_fonts_block *handle, char *text, enum report_cell_flags flags, int *width)
 {
-	os_error	*error;
-	font_f		font;
+	os_error			*error;
+	struct report_fonts_extent	extent;
 
 	if (width != NULL)
 		*width = 0;
@@ -425,6 +449,46 @@ os_error *report_fonts_get_string_width(struct report_fonts_block *handle, char
 	if (handle == NULL || width == NULL)
 		return NULL;
 
+	error = report_fonts_get_string_extent(handle, text, flags, &extent);
+	if (error != NULL)
+		return error;
+
+	report_fonts_include_extent(handle, &extent);
+
+	*width = extent.width;
+
+	return NULL;
+}
+
+
+/**
+ * Return the extent of a string in a given font, taking into account any
+ * cell formatting which is applied. Unlike report_fonts_get_string_width(),
+ * the maximum line and descender heights are not updated; the extent can
+ * be passed to report_fonts_include_extent() to do this.
+ *
+ * \param *handle		The Reports Fonts instance to use.
+ * \param *text			Pointer to the text to measure.
+ * \param flags			The cell formatting flags to be applied.
+ * \param *extent		Pointer to a structure to take the extent.
+ * \return			A pointer to an OS Error block, or NULL on success.
+ */
+
+os_error *report_fonts_get_string_extent(struct report_fonts_block *handle, char *text, enum report_cell_flags flags, struct report_fonts_extent *extent)
+{
+	os_error	*error;
+	font_f		font;
+
+	if (extent == NULL)
+		return NULL;
+
+	extent->width = 0;
+	extent->height = 0;
+	extent->descender = 0;
+
+	if (handle == NULL)
+		return NULL;
+
 	font = report_fonts_get_handle(handle, flags);
 	if (font == font_SYSTEM)
 		return NULL;
@@ -434,13 +498,32 @@ os_error *report_fonts_get_string_width(struct report_fonts_block *handle, char
 	if (error != NULL)
 		return error;
 
-	if ((report_fonts_scan_block.bbox.y1 - report_fonts_scan_block.bbox.y0) > handle->max_height)
-		handle->max_height = report_fonts_scan_block.bbox.y1 - report_fonts_scan_block.bbox.y0;
+	extent->height = report_fonts_scan_block.bbox.y1 - report_fonts_scan_block.bbox.y0;
+	extent->descender = report_fonts_scan_block.bbox.y0;
+
+	return xfont_convertto_os(report_fonts_scan_block.bbox.x1 - report_fonts_scan_block.bbox.x0, 0, &(extent->width), NULL);
+}
+
+
+/**
+ * Update the maximum line and descender heights in a Report Fonts instance
+ * to take into account a string extent, which can have been measured
+ * previously using report_fonts_get_string_extent().
+ *
+ * \param *handle		The Reports Fonts instance to update.
+ * \param *extent		Pointer to the extent to include.
+ */
+
+void report_fonts_include_extent(struct report_fonts_block *handle, struct report_fonts_extent *extent)
+{
+	if (handle == NULL || extent == NULL)
+		return;
 
-	if (report_fonts_scan_block.bbox.y0 < handle->max_descender)
-		handle->max_descender = report_fonts_scan_block.bbox.y0;
+	if (extent->height > handle->max_height)
+		handle->max_height = extent->height;
 
-	return xfont_convertto_os(report_fonts_scan_block.bbox.x1 - report_fonts_scan_block.bbox.x0, 0, width, NULL);
+	if (extent->descender < handle->max_descender)
+		handle->max_descender = extent->descender;
 }
 
 
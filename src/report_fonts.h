@@ -41,6 +41,16 @@
 
 struct report_fonts_block;
 
+/**
+ * The extent of a string measured in a Report Fonts instance.
+ */
+
+struct report_fonts_extent {
+	int				width;				/**< The width of the string, in OS Units.				*/
+	int				height;				/**< The height of the string's bounding box, in millipoints.		*/
+	int				descender;			/**< The descender of the string's bounding box, in millipoints.	*/
+};
+
 /**
  * Initialise the Report Fonts module.
  */
@@ -124,6 +134,18 @@ void report_fonts_set_size(struct report_fonts_block *handle, int size, int line
 void report_fonts_get_size(struct report_fonts_block *handle, int *size, int *linespace);
 
 
+/**
+ * Return a value identifying the current set of faces and size in a Report
+ * Fonts instance. The value changes whenever either is updated, so that any
+ * measurements taken using the old fonts can be identified and discarded.
+ *
+ * \param *handle		The Report Fonts instance to query.
+ * \return			The current font set value.
+ */
+
+unsigned report_fonts_get_font_set(struct report_fonts_block *handle);
+
+
 /**
  * Return the required line spacing, in OS Units, for the fonts specified
  * in a Report Fonts instance.
@@ -148,8 +170,8 @@ os_error *report_fonts_find(struct report_fonts_block *handle);
 
 /**
  * Return the greatest line and descender height encountered during any
- * call to report_fonts_get_string_width() since the last call to
- * report_fonts_find(), in OS Units.
+ * call to report_fonts_get_string_width() or report_fonts_include_extent()
+ * since the last call to report_fonts_find(), in OS Units.
  *
  * \param *handle		The Reports Fonts instance to query
  * \param *height		Pointer to variable to take the height.
@@ -184,6 +206,34 @@ void report_fonts_lose(struct report_fonts_block *handle);
 os_error *report_fonts_get_string_width(struct report_fonts_block *handle, char *text, enum report_cell_flags flags, int *width);
 
 
+/**
+ * Return the extent of a string in a given font, taking into account any
+ * cell formatting which is applied. Unlike report_fonts_get_string_width(),
+ * the maximum line and descender heights are not updated; the extent can
+ * be passed to report_fonts_include_extent() to do this.
+ *
+ * \param *handle		The Reports Fonts instance to use.
+ * \param *text			Pointer to the text to measure.
+ * \param flags			The cell formatting flags to be applied.
+ * \param *extent		Pointer to a structure to take the extent.
+ * \return			A pointer to an OS Error block, or NULL on success.
+ */
+
+os_error *report_fonts_get_string_extent(struct report_fonts_block *handle, char *text, enum report_cell_flags flags, struct report_fonts_extent *extent);
+
+
+/**
+ * Update the maximum line and descender heights in a Report Fonts instance
+ * to take into account a string extent, which can have been measured
+ * previously using report_fonts_get_string_extent().
+ *
+ * \param *handle		The Reports Fonts instance to update.
+ * \param *extent		Pointer to the extent to include.
+ */
+
+void report_fonts_include_extent(struct report_fonts_block *handle, struct report_fonts_extent *extent);
+
+
 /**
  * Paint text in a given font, taking into account any cell formatting which
  * is applied.
@@ -33,14 +33,9 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Acorn C Header files. */
-
-#include "flex.h"
-
 /* SFLib Header files. */
 
 #include "sflib/debug.h"
-#include "sflib/heap.h"
 
 /* OSLib Header files. */
 
@@ -50,7 +45,8 @@
 
 #include "report_line.h"
 
-#include "flexutils.h"
+#include "report_arena.h"
+#include "report_store.h"
 
 /**
  * The default allocation block size.
@@ -64,38 +60,33 @@
  */
 
 struct report_line_block {
-	struct report_line_data	*lines;
-	size_t			size;
-	size_t			line_count;
-	size_t			allocation;
+	struct report_store_block	*lines;			/**< The store holding the line data.				*/
 };
 
 
 /**
  * Initialise a report line data block
  *
+ * \param *arena		The arena from which to allocate memory.
  * \param allocation		The allocation block size, or 0 for the default.
+ * \param limit			The amount of memory to hold lines in before
+ *				spilling them to disc, in bytes, or 0 for no limit.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_line_block *report_line_create(size_t allocation)
+struct report_line_block *report_line_create(struct report_arena_block *arena, size_t allocation, size_t limit)
 {
 	struct report_line_block	*new;
 
-	new = heap_alloc(sizeof(struct report_line_block));
+	new = report_arena_alloc(arena, sizeof(struct report_line_block));
 	if (new == NULL)
 		return NULL;
 
-	new->allocation = (allocation == 0) ? REPORT_LINE_ALLOCATION : allocation;
-
-	new->lines = NULL;
-	new->line_count = 0;
-	new->size = new->allocation;
-
-	/* Claim the memory for the dump itself. */
+	/* Claim the memory for the line store itself. */
 
-	if (!flexutils_allocate((void **) &(new->lines), sizeof(struct report_line_data), new->allocation)) {
-		heap_free(new);
+	new->lines = report_store_create(arena, sizeof(struct report_line_data), (allocation == 0) ? REPORT_LINE_ALLOCATION : allocation, limit);
+	if (new->lines == NULL) {
+		report_arena_free(arena, new, sizeof(struct report_line_block));
 		return NULL;
 	}
 
@@ -104,7 +95,8 @@ struct report_line_block *report_line_create(size_t allocation)
 
 
 /**
- * Destroy a report line data block, freeing the memory associated with it.
+ * Destroy a report line data block. The memory is returned when the
+ * block's arena is destroyed.
  *
  * \param *handle		The block to be destroyed.
  */
@@ -114,9 +106,7 @@ void report_line_destroy(struct report_line_block *handle)
 	if (handle == NULL)
 		return;
 
-	flexutils_free((void **) &(handle->lines));
-
-	heap_free(handle);
+	report_store_destroy(handle->lines);
 }
 
 
@@ -129,33 +119,33 @@ void report_line_destroy(struct report_line_block *handle)
 
 void report_line_clear(struct report_line_block *handle)
 {
-	if (handle == NULL || handle->lines == NULL)
+	if (handle == NULL)
 		return;
 
-	handle->line_count = 0;
-
-	if (flexutils_resize((void **) &(handle->lines), sizeof(struct report_line_data), handle->allocation))
-		handle->size = handle->allocation;
+	report_store_clear(handle->lines);
 }
 
 
 /**
- * Close a report line data block, so that its allocation shrinks to
- * occupy only the space used by data.
+ * Close a report line data block, once all of the lines have been added.
  *
  * \param *handle		The block to be closed.
  */
 
 void report_line_close(struct report_line_block *handle)
 {
-	if (handle == NULL || handle->lines == NULL)
-		return;
+#ifdef DEBUG
+	size_t		resident;
+	unsigned	transfers;
+#endif
 
-	if (flexutils_resize((void **) &(handle->lines), sizeof(struct report_line_data), handle->line_count))
-		handle->size = handle->line_count;
+	if (handle == NULL)
+		return;
 
 #ifdef DEBUG
-	debug_printf("Line data: %d records, using %dKb", handle->line_count, handle->line_count * sizeof (struct report_line_data) / 1024);
+	report_store_get_usage(handle->lines, &resident, &transfers);
+	debug_printf("Line data: %d records, using %dKb in memory after %d disc transfers",
+			report_store_get_count(handle->lines), resident / 1024, transfers);
 #endif
 }
 
@@ -173,19 +163,13 @@ void report_line_close(struct report_line_block *handle)
 
 osbool report_line_add(struct report_line_block *handle, unsigned first_cell, size_t cell_count, int tab_bar, enum report_line_flags flags)
 {
-	unsigned new;
+	struct report_line_data	line, *previous;
+	size_t			count;
 
-	if (handle == NULL || handle->lines == NULL)
+	if (handle == NULL)
 		return FALSE;
 
-	if (handle->line_count >= handle->size) {
-		if (!flexutils_resize((void **) &(handle->lines), sizeof(struct report_line_data), handle->size + handle->allocation))
-			return FALSE;
-
-		handle->size += handle->allocation;
-	}
-
-	new = handle->line_count++;
+	count = report_store_get_count(handle->lines);
 
 	/* If there's a rule below this, process the ruleoff rules. */
 
@@ -198,19 +182,21 @@ osbool report_line_add(struct report_line_block *handle, unsigned first_cell, si
 		 * remove the "last line" flag from the line above.
 		 */
 
-		if ((new == 0) || (!(handle->lines[new - 1].flags & REPORT_LINE_FLAGS_RULE_BELOW) || (tab_bar != handle->lines[new - 1].tab_bar)))
+		previous = (count > 0) ? report_store_get(handle->lines, count - 1, TRUE) : NULL;
+
+		if ((previous == NULL) || (!(previous->flags & REPORT_LINE_FLAGS_RULE_BELOW) || (tab_bar != previous->tab_bar)))
 			flags |= REPORT_LINE_FLAGS_RULE_ABOVE;
 		else
-			handle->lines[new - 1].flags &= ~REPORT_LINE_FLAGS_RULE_LAST;
+			previous->flags &= ~REPORT_LINE_FLAGS_RULE_LAST;
 	}
 
-	handle->lines[new].flags = flags;
-	handle->lines[new].first_cell = first_cell;
-	handle->lines[new].cell_count = cell_count;
-	handle->lines[new].tab_bar = tab_bar;
-	handle->lines[new].ypos = 0;
+	line.flags = flags;
+	line.first_cell = first_cell;
+	line.cell_count = cell_count;
+	line.tab_bar = tab_bar;
+	line.ypos = 0;
 
-	return TRUE;
+	return (report_store_add(handle->lines, &line) == REPORT_STORE_NULL) ? FALSE : TRUE;
 }
 
 
@@ -223,17 +209,18 @@ osbool report_line_add(struct report_line_block *handle, unsigned first_cell, si
 
 size_t report_line_get_count(struct report_line_block *handle)
 {
-	if (handle == NULL || handle->lines == NULL)
+	if (handle == NULL)
 		return 0;
 
-	return handle->line_count;
+	return report_store_get_count(handle->lines);
 }
 
 
 /**
  * Return details about a line held in a report line data block. The data
- * returned is transient, and not guaracteed to remain valid if the flex
- * heap shifts. Optionally return the height of the line, in OS units.
+ * returned is transient, and not guaranteed to remain valid once other
+ * lines have been requested. Optionally return the height of the line,
+ * in OS units.
  *
  * \param *handle		The block to query.
  * \param line			The line to query.
@@ -244,20 +231,53 @@ size_t report_line_get_count(struct report_line_block *handle)
 
 struct report_line_data *report_line_get_info(struct report_line_block *handle, unsigned line, int *height)
 {
-	if (handle == NULL || handle->lines == NULL)
-		return NULL;
+	struct report_line_data	*data;
+	int			previous_ypos = 0;
 
-	if (line >= handle->line_count)
+	if (handle == NULL)
 		return NULL;
 
-	if (height != NULL) {
-		if (line == 0)
-			*height = -handle->lines[line].ypos;
-		else
-			*height = handle->lines[line - 1].ypos - handle->lines[line].ypos;
+	/* Read the previous line first, as it might share a chunk with the
+	 * line being returned.
+	 */
+
+	if (height != NULL && line > 0) {
+		data = report_store_get(handle->lines, line - 1, FALSE);
+		if (data == NULL)
+			return NULL;
+
+		previous_ypos = data->ypos;
 	}
 
-	return handle->lines + line;
+	data = report_store_get(handle->lines, line, FALSE);
+	if (data == NULL)
+		return NULL;
+
+	if (height != NULL)
+		*height = previous_ypos - data->ypos;
+
+	return data;
+}
+
+
+/**
+ * Set the vertical position of a line held in a report line data block.
+ *
+ * \param *handle		The block to update.
+ * \param line			The line to update.
+ * \param ypos			The new position of the line, in OS Units.
+ */
+
+void report_line_set_ypos(struct report_line_block *handle, unsigned line, int ypos)
+{
+	struct report_line_data	*data;
+
+	if (handle == NULL)
+		return;
+
+	data = report_store_get(handle->lines, line, TRUE);
+	if (data != NULL)
+		data->ypos = ypos;
 }
 
 
@@ -271,18 +291,25 @@ struct report_line_data *report_line_get_info(struct report_line_block *handle,
 
 unsigned report_line_find_from_ypos(struct report_line_block *handle, int ypos)
 {
-	unsigned	a, b, c;
+	struct report_line_data	*data;
+	unsigned		a, b, c;
+	size_t			count;
 
-	if (handle == NULL || handle->lines == NULL)
+	count = report_line_get_count(handle);
+	if (count == 0)
 		return 0;
 
 	a = 0;
-	b = handle->line_count - 1;
+	b = count - 1;
 
 	while (a < b) {
 		c = a + ((b - a) / 2);
 
-		if (ypos >= handle->lines[c].ypos)
+		data = report_store_get(handle->lines, c, FALSE);
+		if (data == NULL)
+			break;
+
+		if (ypos >= data->ypos)
 			b = c;
 		else if (c < b)
 			a = c + 1;
@@ -293,3 +320,24 @@ unsigned report_line_find_from_ypos(struct report_line_block *handle, int ypos)
 	return a;
 }
 
+
+/**
+ * Return the amount of memory being used to hold a report line data block,
+ * not counting any data which has been spilled to disc.
+ *
+ * \param *handle		The block to query.
+ * \return			The memory in use, in bytes.
+ */
+
+size_t report_line_get_memory(struct report_line_block *handle)
+{
+	size_t	resident;
+
+	if (handle == NULL)
+		return 0;
+
+	report_store_get_usage(handle->lines, &resident, NULL);
+
+	return resident;
+}
+
@@ -31,6 +31,8 @@
 #ifndef CASHBOOK_REPORT_LINE
 #define CASHBOOK_REPORT_LINE
 
+#include "report_arena.h"
+
 /**
  * No line
  */
@@ -73,15 +75,19 @@ struct report_line_block;
 /**
  * Initialise a report line data block
  *
+ * \param *arena		The arena from which to allocate memory.
  * \param allocation		The allocation block size, or 0 for the default.
+ * \param limit			The amount of memory to hold lines in before
+ *				spilling them to disc, in bytes, or 0 for no limit.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_line_block *report_line_create(size_t allocation);
+struct report_line_block *report_line_create(struct report_arena_block *arena, size_t allocation, size_t limit);
 
 
 /**
- * Destroy a report line data block, freeing the memory associated with it.
+ * Destroy a report line data block. The memory is returned when the
+ * block's arena is destroyed.
  *
  * \param *handle		The block to be destroyed.
  */
@@ -100,8 +106,7 @@ void report_line_clear(struct report_line_block *handle);
 
 
 /**
- * Close a report line data block, so that its allocation shrinks to
- * occupy only the space used by data.
+ * Close a report line data block, once all of the lines have been added.
  *
  * \param *handle		The block to be closed.
  */
@@ -135,17 +140,31 @@ size_t report_line_get_count(struct report_line_block *handle);
 
 /**
  * Return details about a line held in a report line data block. The data
- * returned is transient, and not guaracteed to remain valid if the flex
- * heap shifts.
+ * returned is transient, and not guaranteed to remain valid once other
+ * lines have been requested. Optionally return the height of the line,
+ * in OS units.
  *
  * \param *handle		The block to query.
  * \param line			The line to query.
+ * \param *height		Pointer to a variable to take the line's height
+ *				in OS Units, or NULL.
  * \return			Pointer to the line data block, or NULL.
  */
 
 struct report_line_data *report_line_get_info(struct report_line_block *handle, unsigned line, int *height);
 
 
+/**
+ * Set the vertical position of a line held in a report line data block.
+ *
+ * \param *handle		The block to update.
+ * \param line			The line to update.
+ * \param ypos			The new position of the line, in OS Units.
+ */
+
+void report_line_set_ypos(struct report_line_block *handle, unsigned line, int ypos);
+
+
 /**
  * Find a line based on a redraw position on the y axis.
  *
@@ -156,5 +175,16 @@ struct report_line_data *report_line_get_info(struct report_line_block *handle,
 
 unsigned report_line_find_from_ypos(struct report_line_block *handle, int ypos);
 
+
+/**
+ * Return the amount of memory being used to hold a report line data block,
+ * not counting any data which has been spilled to disc.
+ *
+ * \param *handle		The block to query.
+ * \return			The memory in use, in bytes.
+ */
+
+size_t report_line_get_memory(struct report_line_block *handle);
+
 #endif
 
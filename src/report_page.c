@@ -33,16 +33,11 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Acorn C Header files. */
-
-#include "flex.h"
-
 /* SFLib Header files. */
 
 #include "sflib/config.h"
 #include "sflib/debug.h"
 #include "sflib/errors.h"
-#include "sflib/heap.h"
 
 /* OSLib Header files. */
 
@@ -54,7 +49,7 @@
 
 #include "report_page.h"
 
-#include "flexutils.h"
+#include "report_arena.h"
 
 /**
  * The default allocation block size.
@@ -79,6 +74,7 @@
  */
 
 struct report_page_block {
+	struct report_arena_block	*arena;
 	struct report_page_data	*pages;
 	size_t			size;
 	size_t			page_count;
@@ -103,27 +99,33 @@ struct report_page_block {
 
 	osbool			landscape;		/**< TRUE if the layout is landscape; FALSE if portrait.	*/
 	osbool			paginated;		/**< TRUE if there is pagination data; FALSE if not.		*/
+	osbool			complete;		/**< TRUE if the pagination data is complete; FALSE if not.	*/
+	int			estimated_rows;		/**< The estimated number of page rows, while incomplete.	*/
 };
 
 /* Static Function Prototypes. */
 
+static int report_page_get_rows(struct report_page_block *handle);
 static void report_page_scale_area(os_box *area, int scale);
 
 /**
  * Initialise a report page data block
  *
- * \param allocation		The allocation block size, or 0 for the default.
+ * \param *arena		The arena from which to allocate memory.
+ * \param allocation		The initial allocation size, or 0 for the default.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_page_block *report_page_create(size_t allocation)
+struct report_page_block *report_page_create(struct report_arena_block *arena, size_t allocation)
 {
 	struct report_page_block	*new;
 
-	new = heap_alloc(sizeof(struct report_page_block));
+	new = report_arena_alloc(arena, sizeof(struct report_page_block));
 	if (new == NULL)
 		return NULL;
 
+	new->arena = arena;
+
 	new->allocation = (allocation == 0) ? REPORT_PAGE_ALLOCATION : allocation;
 
 	new->pages = NULL;
@@ -137,11 +139,14 @@ struct report_page_block *report_page_create(size_t allocation)
 	new->active_areas = REPORT_PAGE_AREA_NONE;
 
 	new->paginated = FALSE;
+	new->complete = FALSE;
+	new->estimated_rows = 0;
 
 	/* Claim the memory for the pages themselves. */
 
-	if (!flexutils_allocate((void **) &(new->pages), sizeof(struct report_page_data), new->allocation)) {
-		heap_free(new);
+	new->pages = report_arena_alloc(arena, sizeof(struct report_page_data) * new->allocation);
+	if (new->pages == NULL) {
+		report_arena_free(arena, new, sizeof(struct report_page_block));
 		return NULL;
 	}
 
@@ -160,9 +165,8 @@ void report_page_destroy(struct report_page_block *handle)
 	if (handle == NULL)
 		return;
 
-	flexutils_free((void **) &(handle->pages));
-
-	heap_free(handle);
+	report_arena_free(handle->arena, handle->pages, sizeof(struct report_page_data) * handle->size);
+	report_arena_free(handle->arena, handle, sizeof(struct report_page_block));
 }
 
 
@@ -186,31 +190,37 @@ void report_page_clear(struct report_page_block *handle)
 	handle->active_areas = REPORT_PAGE_AREA_NONE;
 
 	handle->paginated = FALSE;
-
-	if (flexutils_resize((void **) &(handle->pages), sizeof(struct report_page_data), handle->allocation))
-		handle->size = handle->allocation;
+	handle->complete = FALSE;
+	handle->estimated_rows = 0;
 }
 
 
 /**
  * Close a report page data block, so that its allocation shrinks to
  * occupy only the space used by data. This will also mark the data
- * as being valid.
+ * as being complete.
  *
  * \param *handle		The block to be closed.
  */
 
 void report_page_close(struct report_page_block *handle)
 {
+	struct report_page_data	*data;
+
 	if (handle == NULL || handle->pages == NULL)
 		return;
 
-	if (flexutils_resize((void **) &(handle->pages), sizeof(struct report_page_data), handle->page_count))
+	data = report_arena_extend(handle->arena, handle->pages, sizeof(struct report_page_data) * handle->size, sizeof(struct report_page_data) * handle->page_count);
+	if (data != NULL) {
+		handle->pages = data;
 		handle->size = handle->page_count;
+	}
 
 	if (handle->page_count > 0)
 		handle->paginated = TRUE;
 
+	handle->complete = TRUE;
+
 #ifdef DEBUG
 	debug_printf("Page data: %d records, using %dKb", handle->page_count, handle->page_count * sizeof(struct report_page_data) / 1024);
 	debug_printf("Page layout: x=%d, y=%d", handle->page_layout.x, handle->page_layout.y);
@@ -231,6 +241,38 @@ osbool report_page_paginated(struct report_page_block *handle)
 }
 
 
+/**
+ * Report whether a page data block contains pagination data which is
+ * still being added to, so that the page counts are only estimates.
+ *
+ * \param *handle		The block to test.
+ * \return			TRUE if the data is provisional; FALSE if not.
+ */
+
+osbool report_page_provisional(struct report_page_block *handle)
+{
+	return (handle == NULL) ? FALSE : (handle->paginated && !handle->complete);
+}
+
+
+/**
+ * Set the estimated number of page rows which will be in a page data
+ * block once pagination is complete. Until the block is closed, this
+ * will be used as the row count if it exceeds the rows added so far.
+ *
+ * \param *handle		The block to update.
+ * \param rows			The estimated number of page rows.
+ */
+
+void report_page_set_estimate(struct report_page_block *handle, int rows)
+{
+	if (handle == NULL)
+		return;
+
+	handle->estimated_rows = rows;
+}
+
+
 /**
  * Start a new row of pages in the page output.
  *
@@ -261,7 +303,9 @@ osbool report_page_new_row(struct report_page_block *handle)
 
 osbool report_page_add(struct report_page_block *handle, unsigned first_region, size_t region_count)
 {
-	unsigned new;
+	struct report_page_data	*data;
+	unsigned		new;
+	size_t			size;
 
 	if (handle == NULL || handle->pages == NULL)
 		return FALSE;
@@ -269,10 +313,14 @@ osbool report_page_add(struct report_page_block *handle, unsigned first_region,
 	/* Check and increase the memory allocation if required. */
 
 	if (handle->page_count >= handle->size) {
-		if (!flexutils_resize((void **) &(handle->pages), sizeof(struct report_page_data), handle->size + handle->allocation))
+		size = (handle->size > 0) ? handle->size * 2 : handle->allocation;
+
+		data = report_arena_extend(handle->arena, handle->pages, sizeof(struct report_page_data) * handle->size, sizeof(struct report_page_data) * size);
+		if (data == NULL)
 			return FALSE;
 
-		handle->size += handle->allocation;
+		handle->pages = data;
+		handle->size = size;
 	}
 
 	/* Set up the new page. */
@@ -288,6 +336,12 @@ osbool report_page_add(struct report_page_block *handle, unsigned first_region,
 	if (handle->column > handle->page_layout.x)
 		handle->page_layout.x = handle->column;
 
+	/* The data becomes usable as soon as there's a page, even if more are
+	 * still to be added.
+	 */
+
+	handle->paginated = TRUE;
+
 	return TRUE;
 }
 
@@ -310,8 +364,8 @@ size_t report_page_get_count(struct report_page_block *handle)
 
 /**
  * Return details about a page held in a report page data block. The data
- * returned is transient, and not guaracteed to remain valid if the flex
- * heap shifts.
+ * returned is transient, and not guaracteed to remain valid if more
+ * data is added to the block.
  *
  * \param *handle		The block to query.
  * \param line			The page to query.
@@ -332,7 +386,8 @@ struct report_page_data *report_page_get_info(struct report_page_block *handle,
 
 /**
  * Return the number of pages in the X and Y directions. No page counts can be
- * returned if the pages have not been calculated.
+ * returned if the pages have not been calculated. If pagination is still in
+ * progress, the Y page count will be an estimate.
  *
  * \param *handle		The block to query.
  * \param *x			Pointer to a variable to take the X page count.
@@ -350,7 +405,7 @@ osbool report_page_get_layout_pages(struct report_page_block *handle, int *x, in
 		*x = handle->page_layout.x;
 
 	if (y != NULL)
-		*y = handle->page_layout.y;
+		*y = report_page_get_rows(handle);
 
 	return TRUE;
 }
@@ -359,7 +414,8 @@ osbool report_page_get_layout_pages(struct report_page_block *handle, int *x, in
 /**
  * Calculate the extent of an on-screen representation of the pages,
  * based on the 2D layout and the on-screen page size. No size can be
- * returned if the pages have not been calculated.
+ * returned if the pages have not been calculated. If pagination is still
+ * in progress, the Y size will be based on an estimated page count.
  *
  * \param *handle		The block to query.
  * \param *x			Pointer to a variable to take the X size, in OS Units.
@@ -377,7 +433,7 @@ osbool report_page_get_layout_extent(struct report_page_block *handle, int *x, i
 		*x = (handle->display_size.x + (2 * REPORT_PAGE_BORDER)) * handle->page_layout.x;
 
 	if (y != NULL)
-		*y = (handle->display_size.y + (2 * REPORT_PAGE_BORDER)) * handle->page_layout.y;
+		*y = (handle->display_size.y + (2 * REPORT_PAGE_BORDER)) * report_page_get_rows(handle);
 
 	return TRUE;
 }
@@ -480,9 +536,15 @@ unsigned report_page_get_outline(struct report_page_block *handle, int x, int y,
 	if (x < 0 || x >= handle->page_layout.x || y < 0 || y >= handle->page_layout.y)
 		return REPORT_PAGE_NONE;
 
-	/* Search the page list for the page in question. */
+	/* Pages are added a row at a time, so unless some failed to be added,
+	 * the page will be at the obvious index. If not, search the page list
+	 * for the page in question.
+	 */
+
+	page = (y * handle->page_layout.x) + x;
 
-	page = 0;
+	if (page >= handle->page_count || handle->pages[page].position.x != x || handle->pages[page].position.y != y)
+		page = 0;
 
 	while (page < handle->page_count && (handle->pages[page].position.x != x || handle->pages[page].position.y != y))
 		page++;
@@ -748,6 +810,23 @@ osbool report_page_calculate_position(struct report_page_block *handle, os_box *
 }
 
 
+/**
+ * Return the number of page rows in a page data block, using the estimated
+ * number if pagination is still in progress and more rows are expected.
+ *
+ * \param *handle		The block to query.
+ * \return			The number of page rows.
+ */
+
+static int report_page_get_rows(struct report_page_block *handle)
+{
+	if (handle->complete || handle->estimated_rows < handle->page_layout.y)
+		return handle->page_layout.y;
+
+	return handle->estimated_rows;
+}
+
+
 /**
  * Scale the values in an OS Box area to a given transformation.
  *
@@ -33,6 +33,7 @@
 
 #include "oslib/os.h"
 #include "oslib/types.h"
+#include "report_arena.h"
 
 /**
  * No page
@@ -122,11 +123,12 @@ struct report_page_block;
 /**
  * Initialise a report page data block
  *
- * \param allocation		The allocation block size, or 0 for the default.
+ * \param *arena		The arena from which to allocate memory.
+ * \param allocation		The initial allocation size, or 0 for the default.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_page_block *report_page_create(size_t allocation);
+struct report_page_block *report_page_create(struct report_arena_block *arena, size_t allocation);
 
 
 /**
@@ -150,7 +152,8 @@ void report_page_clear(struct report_page_block *handle);
 
 /**
  * Close a report page data block, so that its allocation shrinks to
- * occupy only the space used by data.
+ * occupy only the space used by data. This will also mark the data
+ * as being complete.
  *
  * \param *handle		The block to be closed.
  */
@@ -168,6 +171,29 @@ void report_page_close(struct report_page_block *handle);
 osbool report_page_paginated(struct report_page_block *handle);
 
 
+/**
+ * Report whether a page data block contains pagination data which is
+ * still being added to, so that the page counts are only estimates.
+ *
+ * \param *handle		The block to test.
+ * \return			TRUE if the data is provisional; FALSE if not.
+ */
+
+osbool report_page_provisional(struct report_page_block *handle);
+
+
+/**
+ * Set the estimated number of page rows which will be in a page data
+ * block once pagination is complete. Until the block is closed, this
+ * will be used as the row count if it exceeds the rows added so far.
+ *
+ * \param *handle		The block to update.
+ * \param rows			The estimated number of page rows.
+ */
+
+void report_page_set_estimate(struct report_page_block *handle, int rows);
+
+
 /**
  * Start a new row of pages in the page output.
  *
@@ -202,8 +228,8 @@ size_t report_page_get_count(struct report_page_block *handle);
 
 /**
  * Return details about a page held in a report page data block. The data
- * returned is transient, and not guaracteed to remain valid if the flex
- * heap shifts.
+ * returned is transient, and not guaracteed to remain valid if more
+ * data is added to the block.
  *
  * \param *handle		The block to query.
  * \param line			The page to query.
@@ -215,7 +241,8 @@ struct report_page_data *report_page_get_info(struct report_page_block *handle,
 
 /**
  * Return the number of pages in the X and Y directions. No page counts can be
- * returned if the pages have not been calculated.
+ * returned if the pages have not been calculated. If pagination is still in
+ * progress, the Y page count will be an estimate.
  *
  * \param *handle		The block to query.
  * \param *x			Pointer to a variable to take the X page count.
@@ -230,7 +257,8 @@ osbool report_page_get_layout_pages(struct report_page_block *handle, int *x, in
 /**
  * Calculate the extent of an on-screen representation of the pages,
  * based on the 2D layout and the on-screen page size. No size can be
- * returned if the pages have not been calculated.
+ * returned if the pages have not been calculated. If pagination is still
+ * in progress, the Y size will be based on an estimated page count.
  *
  * \param *handle		The block to query.
  * \param *x			Pointer to a variable to take the X size, in OS Units.
@@ -33,16 +33,11 @@
 #include <stdlib.h>
 #include <string.h>
 
-/* Acorn C Header files. */
-
-#include "flex.h"
-
 /* SFLib Header files. */
 
 #include "sflib/config.h"
 #include "sflib/debug.h"
 #include "sflib/errors.h"
-#include "sflib/heap.h"
 
 /* OSLib Header files. */
 
@@ -54,7 +49,7 @@
 
 #include "report_region.h"
 
-#include "flexutils.h"
+#include "report_arena.h"
 #include "report_textdump.h"
 
 /**
@@ -68,6 +63,7 @@
  */
 
 struct report_region_block {
+	struct report_arena_block	*arena;
 	struct report_region_data	*regions;
 	size_t				size;
 	size_t				region_count;
@@ -82,18 +78,21 @@ static unsigned report_region_add(struct report_region_block *handle, int x0, in
 /**
  * Initialise a report page region data block
  *
- * \param allocation		The allocation block size, or 0 for the default.
+ * \param *arena		The arena from which to allocate memory.
+ * \param allocation		The initial allocation size, or 0 for the default.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_region_block *report_region_create(size_t allocation)
+struct report_region_block *report_region_create(struct report_arena_block *arena, size_t allocation)
 {
 	struct report_region_block	*new;
 
-	new = heap_alloc(sizeof(struct report_region_block));
+	new = report_arena_alloc(arena, sizeof(struct report_region_block));
 	if (new == NULL)
 		return NULL;
 
+	new->arena = arena;
+
 	new->allocation = (allocation == 0) ? REPORT_REGION_ALLOCATION : allocation;
 
 	new->regions = NULL;
@@ -102,8 +101,9 @@ struct report_region_block *report_region_create(size_t allocation)
 
 	/* Claim the memory for the regions themselves. */
 
-	if (!flexutils_allocate((void **) &(new->regions), sizeof(struct report_region_data), new->allocation)) {
-		heap_free(new);
+	new->regions = report_arena_alloc(arena, sizeof(struct report_region_data) * new->allocation);
+	if (new->regions == NULL) {
+		report_arena_free(arena, new, sizeof(struct report_region_block));
 		return NULL;
 	}
 
@@ -123,9 +123,8 @@ void report_region_destroy(struct report_region_block *handle)
 	if (handle == NULL)
 		return;
 
-	flexutils_free((void **) &(handle->regions));
-
-	heap_free(handle);
+	report_arena_free(handle->arena, handle->regions, sizeof(struct report_region_data) * handle->size);
+	report_arena_free(handle->arena, handle, sizeof(struct report_region_block));
 }
 
 
@@ -142,9 +141,6 @@ void report_region_clear(struct report_region_block *handle)
 		return;
 
 	handle->region_count = 0;
-
-	if (flexutils_resize((void **) &(handle->regions), sizeof(struct report_region_data), handle->allocation))
-		handle->size = handle->allocation;
 }
 
 
@@ -157,11 +153,16 @@ void report_region_clear(struct report_region_block *handle)
 
 void report_region_close(struct report_region_block *handle)
 {
+	struct report_region_data	*data;
+
 	if (handle == NULL || handle->regions == NULL)
 		return;
 
-	if (flexutils_resize((void **) &(handle->regions), sizeof(struct report_region_data), handle->region_count))
+	data = report_arena_extend(handle->arena, handle->regions, sizeof(struct report_region_data) * handle->size, sizeof(struct report_region_data) * handle->region_count);
+	if (data != NULL) {
+		handle->regions = data;
 		handle->size = handle->region_count;
+	}
 
 #ifdef DEBUG
 	debug_printf("Region data: %d records, using %dKb", handle->region_count, handle->region_count * sizeof (struct report_region_data) / 1024);
@@ -259,16 +260,22 @@ unsigned report_region_add_lines(struct report_region_block *handle, os_box *out
 
 static unsigned report_region_add(struct report_region_block *handle, int x0, int y0, int x1, int y1)
 {
-	unsigned new;
+	struct report_region_data	*data;
+	unsigned			new;
+	size_t				size;
 
 	if (handle == NULL || handle->regions == NULL)
 		return REPORT_REGION_NONE;
 
 	if (handle->region_count >= handle->size) {
-		if (!flexutils_resize((void **) &(handle->regions), sizeof(struct report_region_data), handle->size + handle->allocation))
+		size = (handle->size > 0) ? handle->size * 2 : handle->allocation;
+
+		data = report_arena_extend(handle->arena, handle->regions, sizeof(struct report_region_data) * handle->size, sizeof(struct report_region_data) * size);
+		if (data == NULL)
 			return REPORT_REGION_NONE;
 
-		handle->size += handle->allocation;
+		handle->regions = data;
+		handle->size = size;
 	}
 
 	new = handle->region_count++;
@@ -286,8 +293,8 @@ static unsigned report_region_add(struct report_region_block *handle, int x0, in
 
 /**
  * Return details about a region held in a report region data block. The data
- * returned is transient, and not guaracteed to remain valid if the flex
- * heap shifts.
+ * returned is transient, and not guaracteed to remain valid if more
+ * data is added to the block.
  *
  * \param *handle		The block to query.
  * \param region			The region to query.
@@ -33,6 +33,7 @@
 
 #include "oslib/os.h"
 #include "oslib/types.h"
+#include "report_arena.h"
 
 /**
  * No region
@@ -93,11 +94,12 @@ struct report_region_block;
 /**
  * Initialise a report page region data block
  *
- * \param allocation		The allocation block size, or 0 for the default.
+ * \param *arena		The arena from which to allocate memory.
+ * \param allocation		The initial allocation size, or 0 for the default.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_region_block *report_region_create(size_t allocation);
+struct report_region_block *report_region_create(struct report_arena_block *arena, size_t allocation);
 
 
 /**
@@ -171,8 +173,8 @@ unsigned report_region_add_lines(struct report_region_block *handle, os_box *out
 
 /**
  * Return details about a region held in a report region data block. The data
- * returned is transient, and not guaracteed to remain valid if the flex
- * heap shifts.
+ * returned is transient, and not guaracteed to remain valid if more
+ * data is added to the block.
  *
  * \param *handle		The block to query.
  * \param region			The region to query.
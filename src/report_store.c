@@ -0,0 +1,522 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: report_store.c
+ *
+ * Paged storage for fixed-size report records.
+ *
+ * Records are held in fixed-size chunks, indexed from a table on the heap.
+ * Chunks on disc are written to a temporary file at a position fixed by
+ * their chunk number, so no free space management is required; the file
+ * is only created when the first chunk needs to be written out.
+ */
+
+/* ANSI C Header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* SFLib Header files. */
+
+#include "sflib/debug.h"
+
+/* OSLib Header files. */
+
+#include "oslib/types.h"
+
+/* Application header files. */
+
+#include "report_store.h"
+
+#include "report_arena.h"
+
+/**
+ * The number of chunk table entries to allocate at a time.
+ */
+
+#define REPORT_STORE_TABLE_ALLOCATION 32
+
+/**
+ * A chunk of records in a report store.
+ */
+
+struct report_store_chunk {
+	char				*data;			/**< The chunk data in memory, or NULL if not resident.		*/
+	osbool				on_disc;		/**< TRUE if a copy of the chunk is held in the file.		*/
+	osbool				dirty;			/**< TRUE if the copy in memory has changed since writing.	*/
+	unsigned			last_used;		/**< The store's access counter when the chunk was last used.	*/
+};
+
+/**
+ * A Report Store instance data block.
+ */
+
+struct report_store_block {
+	struct report_arena_block	*arena;			/**< The arena from which the store's memory is allocated.	*/
+
+	size_t				record_size;		/**< The size of a record, in bytes.				*/
+	size_t				chunk_records;		/**< The number of records in a chunk.				*/
+	size_t				chunk_size;		/**< The size of a chunk, in bytes.				*/
+
+	size_t				record_count;		/**< The number of records in the store.			*/
+
+	struct report_store_chunk	*chunks;		/**< The table of chunks.					*/
+	size_t				chunk_count;		/**< The number of chunks in use.				*/
+	size_t				table_size;		/**< The number of entries allocated in the chunk table.	*/
+
+	size_t				resident;		/**< The number of chunks currently held in memory.		*/
+	size_t				max_resident;		/**< The number of chunks allowed in memory, or 0 for no limit.	*/
+
+	unsigned			clock;			/**< A counter, incremented on each chunk access.		*/
+	unsigned			transfers;		/**< The number of chunks read from or written to disc.		*/
+
+	FILE				*file;			/**< The temporary file holding spilled chunks, or NULL.	*/
+
+	char				*spare;			/**< A list of chunk buffers available for reuse, or NULL.	*/
+};
+
+/* Static Function Prototypes. */
+
+static char *report_store_find_chunk(struct report_store_block *handle, size_t chunk);
+static void report_store_make_space(struct report_store_block *handle, size_t keep);
+static osbool report_store_write_chunk(struct report_store_block *handle, size_t chunk);
+static osbool report_store_read_chunk(struct report_store_block *handle, size_t chunk);
+static char *report_store_claim_buffer(struct report_store_block *handle);
+static void report_store_release_buffer(struct report_store_block *handle, char *data);
+
+
+/**
+ * Initialise a report store.
+ *
+ * \param *arena		The arena from which to allocate memory.
+ * \param record_size		The size of a record, in bytes.
+ * \param chunk_records		The number of records to hold in each chunk.
+ * \param limit			The amount of memory to use for records before
+ *				spilling to disk, in bytes, or 0 for no limit.
+ * \return			The store handle, or NULL on failure.
+ */
+
+struct report_store_block *report_store_create(struct report_arena_block *arena, size_t record_size, size_t chunk_records, size_t limit)
+{
+	struct report_store_block	*new;
+
+	/* Released chunk buffers are chained through their first word. */
+
+	if (arena == NULL || record_size == 0 || chunk_records == 0 || record_size * chunk_records < sizeof(char *))
+		return NULL;
+
+	new = report_arena_alloc(arena, sizeof(struct report_store_block));
+	if (new == NULL)
+		return NULL;
+
+	new->arena = arena;
+
+	new->record_size = record_size;
+	new->chunk_records = chunk_records;
+	new->chunk_size = record_size * chunk_records;
+
+	new->record_count = 0;
+
+	new->chunk_count = 0;
+	new->table_size = REPORT_STORE_TABLE_ALLOCATION;
+
+	new->resident = 0;
+
+	if (limit == 0) {
+		new->max_resident = 0;
+	} else {
+		new->max_resident = limit / new->chunk_size;
+
+		if (new->max_resident < REPORT_STORE_MIN_CHUNKS)
+			new->max_resident = REPORT_STORE_MIN_CHUNKS;
+	}
+
+	new->clock = 0;
+	new->transfers = 0;
+
+	new->file = NULL;
+	new->spare = NULL;
+
+	new->chunks = report_arena_alloc(arena, sizeof(struct report_store_chunk) * new->table_size);
+	if (new->chunks == NULL) {
+		report_arena_free(arena, new, sizeof(struct report_store_block));
+		return NULL;
+	}
+
+	return new;
+}
+
+
+/**
+ * Destroy a report store, freeing the disc space associated with it. The
+ * memory is returned when the store's arena is destroyed.
+ *
+ * \param *handle		The store to be destroyed.
+ */
+
+void report_store_destroy(struct report_store_block *handle)
+{
+	if (handle == NULL)
+		return;
+
+	report_store_clear(handle);
+}
+
+
+/**
+ * Clear the contents of a report store, so that it will behave as if
+ * just created.
+ *
+ * \param *handle		The store to be cleared.
+ */
+
+void report_store_clear(struct report_store_block *handle)
+{
+	size_t	chunk;
+
+	if (handle == NULL)
+		return;
+
+	for (chunk = 0; chunk < handle->chunk_count; chunk++) {
+		if (handle->chunks[chunk].data != NULL)
+			report_store_release_buffer(handle, handle->chunks[chunk].data);
+	}
+
+	/* The temporary file is deleted automatically once closed. */
+
+	if (handle->file != NULL) {
+		fclose(handle->file);
+		handle->file = NULL;
+	}
+
+	handle->record_count = 0;
+	handle->chunk_count = 0;
+	handle->resident = 0;
+}
+
+
+/**
+ * Add a new record to the end of a report store.
+ *
+ * \param *handle		The store to add to.
+ * \param *record		Pointer to the record data to be copied in.
+ * \return			The new record's index, or REPORT_STORE_NULL.
+ */
+
+unsigned report_store_add(struct report_store_block *handle, void *record)
+{
+	struct report_store_chunk	*table;
+	size_t				chunk;
+	char				*data;
+
+	if (handle == NULL || record == NULL)
+		return REPORT_STORE_NULL;
+
+	chunk = handle->record_count / handle->chunk_records;
+
+	/* If the record is the first in a new chunk, create the chunk. */
+
+	if (chunk >= handle->chunk_count) {
+		if (handle->chunk_count >= handle->table_size) {
+			table = report_arena_extend(handle->arena, handle->chunks, sizeof(struct report_store_chunk) * handle->table_size,
+					sizeof(struct report_store_chunk) * handle->table_size * 2);
+			if (table == NULL)
+				return REPORT_STORE_NULL;
+
+			handle->chunks = table;
+			handle->table_size *= 2;
+		}
+
+		report_store_make_space(handle, chunk);
+
+		data = report_store_claim_buffer(handle);
+		if (data == NULL)
+			return REPORT_STORE_NULL;
+
+		handle->chunks[chunk].data = data;
+		handle->chunks[chunk].on_disc = FALSE;
+		handle->chunks[chunk].dirty = TRUE;
+		handle->chunks[chunk].last_used = handle->clock;
+
+		handle->chunk_count++;
+		handle->resident++;
+	}
+
+	data = report_store_find_chunk(handle, chunk);
+	if (data == NULL)
+		return REPORT_STORE_NULL;
+
+	memcpy(data + (handle->record_count % handle->chunk_records) * handle->record_size, record, handle->record_size);
+	handle->chunks[chunk].dirty = TRUE;
+
+	return handle->record_count++;
+}
+
+
+/**
+ * Return a pointer to a record held in a report store, reading it back
+ * from disc if required. The data returned is transient.
+ *
+ * \param *handle		The store to query.
+ * \param index			The index of the record to return.
+ * \param update		TRUE if the caller will change the record; FALSE
+ *				if the record will only be read.
+ * \return			Pointer to the record, or NULL on failure.
+ */
+
+void *report_store_get(struct report_store_block *handle, unsigned index, osbool update)
+{
+	size_t	chunk;
+	char	*data;
+
+	if (handle == NULL || index >= handle->record_count)
+		return NULL;
+
+	chunk = index / handle->chunk_records;
+
+	data = report_store_find_chunk(handle, chunk);
+	if (data == NULL)
+		return NULL;
+
+	if (update)
+		handle->chunks[chunk].dirty = TRUE;
+
+	return data + (index % handle->chunk_records) * handle->record_size;
+}
+
+
+/**
+ * Return the number of records held in a report store.
+ *
+ * \param *handle		The store to query.
+ * \return			The number of records in the store, or 0.
+ */
+
+size_t report_store_get_count(struct report_store_block *handle)
+{
+	if (handle == NULL)
+		return 0;
+
+	return handle->record_count;
+}
+
+
+/**
+ * Return the amount of memory used by the records held in memory by a
+ * report store, and the number of chunks which have been read or written
+ * to disc.
+ *
+ * \param *handle		The store to query.
+ * \param *resident		Pointer to a variable to take the memory used,
+ *				in bytes, or NULL.
+ * \param *transfers		Pointer to a variable to take the number of
+ *				chunk transfers to or from disc, or NULL.
+ */
+
+void report_store_get_usage(struct report_store_block *handle, size_t *resident, unsigned *transfers)
+{
+	if (resident != NULL)
+		*resident = (handle == NULL) ? 0 : handle->resident * handle->chunk_size;
+
+	if (transfers != NULL)
+		*transfers = (handle == NULL) ? 0 : handle->transfers;
+}
+
+
+/**
+ * Find the data for a chunk in a report store, bringing it into memory
+ * if necessary.
+ *
+ * \param *handle		The store holding the chunk.
+ * \param chunk			The chunk to find.
+ * \return			Pointer to the chunk data, or NULL on failure.
+ */
+
+static char *report_store_find_chunk(struct report_store_block *handle, size_t chunk)
+{
+	handle->chunks[chunk].last_used = ++handle->clock;
+
+	if (handle->chunks[chunk].data == NULL) {
+		report_store_make_space(handle, chunk);
+
+		if (!report_store_read_chunk(handle, chunk))
+			return NULL;
+	}
+
+	return handle->chunks[chunk].data;
+}
+
+
+/**
+ * Make space for another chunk to be brought into memory in a report store,
+ * by writing out the least recently used chunk if the store is at its limit.
+ * If a chunk can't be written, it stays in memory and the limit is exceeded.
+ *
+ * \param *handle		The store to process.
+ * \param keep			A chunk which must not be written out.
+ */
+
+static void report_store_make_space(struct report_store_block *handle, size_t keep)
+{
+	size_t		chunk, oldest;
+	unsigned	age, oldest_age;
+
+	if (handle->max_resident == 0 || handle->resident < handle->max_resident)
+		return;
+
+	oldest = handle->chunk_count;
+	oldest_age = 0;
+
+	for (chunk = 0; chunk < handle->chunk_count; chunk++) {
+		if (chunk == keep || handle->chunks[chunk].data == NULL)
+			continue;
+
+		age = handle->clock - handle->chunks[chunk].last_used;
+
+		if (oldest == handle->chunk_count || age > oldest_age) {
+			oldest = chunk;
+			oldest_age = age;
+		}
+	}
+
+	if (oldest == handle->chunk_count)
+		return;
+
+	if (handle->chunks[oldest].dirty && !report_store_write_chunk(handle, oldest))
+		return;
+
+	report_store_release_buffer(handle, handle->chunks[oldest].data);
+	handle->chunks[oldest].data = NULL;
+	handle->resident--;
+}
+
+
+/**
+ * Write a chunk from a report store out to the temporary file, creating
+ * the file if necessary.
+ *
+ * \param *handle		The store holding the chunk.
+ * \param chunk			The chunk to write.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool report_store_write_chunk(struct report_store_block *handle, size_t chunk)
+{
+	if (handle->file == NULL) {
+		handle->file = tmpfile();
+		if (handle->file == NULL)
+			return FALSE;
+	}
+
+	if (fseek(handle->file, (long) (chunk * handle->chunk_size), SEEK_SET) != 0)
+		return FALSE;
+
+	if (fwrite(handle->chunks[chunk].data, handle->chunk_size, 1, handle->file) != 1)
+		return FALSE;
+
+	handle->chunks[chunk].on_disc = TRUE;
+	handle->chunks[chunk].dirty = FALSE;
+	handle->transfers++;
+
+	return TRUE;
+}
+
+
+/**
+ * Read a chunk back into memory from the temporary file used by a report
+ * store.
+ *
+ * \param *handle		The store holding the chunk.
+ * \param chunk			The chunk to read.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool report_store_read_chunk(struct report_store_block *handle, size_t chunk)
+{
+	char	*data;
+
+	if (handle->file == NULL || handle->chunks[chunk].on_disc == FALSE)
+		return FALSE;
+
+	data = report_store_claim_buffer(handle);
+	if (data == NULL)
+		return FALSE;
+
+	if (fseek(handle->file, (long) (chunk * handle->chunk_size), SEEK_SET) != 0 ||
+			fread(data, handle->chunk_size, 1, handle->file) != 1) {
+		report_store_release_buffer(handle, data);
+		return FALSE;
+	}
+
+#ifdef DEBUG
+	debug_printf("Reading report store chunk %d from disc", chunk);
+#endif
+
+	handle->chunks[chunk].data = data;
+	handle->chunks[chunk].dirty = FALSE;
+	handle->resident++;
+	handle->transfers++;
+
+	return TRUE;
+}
+
+
+/**
+ * Claim a buffer to hold a chunk of records in a report store, reusing
+ * one which has been released if possible.
+ *
+ * \param *handle		The store to claim a buffer for.
+ * \return			Pointer to the buffer, or NULL on failure.
+ */
+
+static char *report_store_claim_buffer(struct report_store_block *handle)
+{
+	char	*data;
+
+	if (handle->spare == NULL)
+		return report_arena_alloc(handle->arena, handle->chunk_size);
+
+	data = handle->spare;
+	memcpy(&(handle->spare), data, sizeof(char *));
+
+	return data;
+}
+
+
+/**
+ * Release a chunk buffer in a report store, so that it can be reused
+ * for another chunk. Arena memory can't be freed individually, so the
+ * buffers are chained together using their first word.
+ *
+ * \param *handle		The store to release the buffer to.
+ * \param *data		The buffer to release.
+ */
+
+static void report_store_release_buffer(struct report_store_block *handle, char *data)
+{
+	memcpy(data, &(handle->spare), sizeof(char *));
+	handle->spare = data;
+}
+
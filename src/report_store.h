@@ -0,0 +1,150 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: report_store.h
+ *
+ * Paged storage for fixed-size report records.
+ *
+ * A report store holds an array of fixed-size records in chunks taken
+ * from its report's arena. If a memory limit is given, the least recently
+ * used chunks are written out to a temporary file once the limit is
+ * reached, and read back in again when next required, so that very large
+ * reports can be assembled and displayed in a bounded amount of memory.
+ *
+ * Pointers returned by report_store_get() are transient: the chunk
+ * holding the record is guaranteed to stay in memory only until records
+ * in REPORT_STORE_MIN_CHUNKS other chunks have been requested.
+ */
+
+#ifndef CASHBOOK_REPORT_STORE
+#define CASHBOOK_REPORT_STORE
+
+#include <stdlib.h>
+#include "oslib/types.h"
+#include "report_arena.h"
+
+/**
+ * The minimum number of chunks which a store will keep in memory.
+ */
+
+#define REPORT_STORE_MIN_CHUNKS 4
+
+/**
+ * 'NULL' value for use with the unsigned record indexes.
+ */
+
+#define REPORT_STORE_NULL 0xffffffff
+
+/**
+ * A Report Store instance handle.
+ */
+
+struct report_store_block;
+
+
+/**
+ * Initialise a report store.
+ *
+ * \param *arena		The arena from which to allocate memory.
+ * \param record_size		The size of a record, in bytes.
+ * \param chunk_records		The number of records to hold in each chunk.
+ * \param limit			The amount of memory to use for records before
+ *				spilling to disk, in bytes, or 0 for no limit.
+ * \return			The store handle, or NULL on failure.
+ */
+
+struct report_store_block *report_store_create(struct report_arena_block *arena, size_t record_size, size_t chunk_records, size_t limit);
+
+
+/**
+ * Destroy a report store, freeing the disc space associated with it. The
+ * memory is returned when the store's arena is destroyed.
+ *
+ * \param *handle		The store to be destroyed.
+ */
+
+void report_store_destroy(struct report_store_block *handle);
+
+
+/**
+ * Clear the contents of a report store, so that it will behave as if
+ * just created.
+ *
+ * \param *handle		The store to be cleared.
+ */
+
+void report_store_clear(struct report_store_block *handle);
+
+
+/**
+ * Add a new record to the end of a report store.
+ *
+ * \param *handle		The store to add to.
+ * \param *record		Pointer to the record data to be copied in.
+ * \return			The new record's index, or REPORT_STORE_NULL.
+ */
+
+unsigned report_store_add(struct report_store_block *handle, void *record);
+
+
+/**
+ * Return a pointer to a record held in a report store, reading it back
+ * from disc if required. The data returned is transient.
+ *
+ * \param *handle		The store to query.
+ * \param index			The index of the record to return.
+ * \param update		TRUE if the caller will change the record; FALSE
+ *				if the record will only be read.
+ * \return			Pointer to the record, or NULL on failure.
+ */
+
+void *report_store_get(struct report_store_block *handle, unsigned index, osbool update);
+
+
+/**
+ * Return the number of records held in a report store.
+ *
+ * \param *handle		The store to query.
+ * \return			The number of records in the store, or 0.
+ */
+
+size_t report_store_get_count(struct report_store_block *handle);
+
+
+/**
+ * Return the amount of memory used by the records held in memory by a
+ * report store, and the number of chunks which have been read or written
+ * to disc.
+ *
+ * \param *handle		The store to query.
+ * \param *resident		Pointer to a variable to take the memory used,
+ *				in bytes, or NULL.
+ * \param *transfers		Pointer to a variable to take the number of
+ *				chunk transfers to or from disc, or NULL.
+ */
+
+void report_store_get_usage(struct report_store_block *handle, size_t *resident, unsigned *transfers);
+
+#endif
+
@@ -24,51 +24,80 @@
 /**
  * \file: report_textdump.c
  *
- * Text storage in a flex block.
+ * Text storage in a report arena block.
  */
 
 /* ANSI C Header files. */
 
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
-/* Acorn C Header files. */
-
-#include "flex.h"
-
 /* SFLib Header files. */
 
 #include "sflib/debug.h"
-#include "sflib/heap.h"
 
 /* OSLib Header files. */
 
+#include "oslib/os.h"
 #include "oslib/types.h"
 
 /* Application header files. */
 
 #include "report_textdump.h"
 
+#include "report_arena.h"
+
 /**
  * The default allocation block size.
  */
 
 #define REPORT_TEXTDUMP_ALLOCATION 10240
 
+/**
+ * The largest step by which the text dump will be extended in one go, once
+ * geometric growth has taken it beyond this size.
+ */
+
+#define REPORT_TEXTDUMP_MAX_STEP (1024 * 1024)
+
+/**
+ * The smallest hash table which will be created.
+ */
+
+#define REPORT_TEXTDUMP_MIN_HASHES 16
+
+/**
+ * The FNV-1a offset basis.
+ */
+
+#define REPORT_TEXTDUMP_FNV_BASIS 2166136261u
+
+/**
+ * The FNV-1a prime.
+ */
+
+#define REPORT_TEXTDUMP_FNV_PRIME 16777619u
+
 /**
  * A Report Textdump instance data block.
  */
 
 struct report_textdump_block {
+	struct report_arena_block	*arena;				/**< The arena from which the dump's memory is allocated.		*/
 	byte			*text;					/**< The general text string dump.					*/
 	unsigned		*hash;					/**< The hash table, or NULL if none.					*/
 	unsigned		free;					/**< Offset to the first free character in the text dump.		*/
 	size_t			size;					/**< The current claimed size of the text dump.				*/
 	size_t			allocation;				/**< The allocation block size of the text dump.			*/
-	size_t			hashes;					/**< The size of the hash table, or 0 if none.				*/
+	size_t			hashes;					/**< The size of the hash table, or 0 if none; always a power of 2.	*/
+	size_t			initial_hashes;				/**< The size of the hash table when the block was created.		*/
+	size_t			entries;				/**< The number of distinct strings held in the hash table.		*/
 	char			terminator;				/**< The terminating character for strings added to the text dump.	*/
 	osbool			open;					/**< TRUE if the block is still open for additions; otherwise FALSE.	*/
+
+	struct report_textdump_stats	stats;				/**< Usage statistics for the block.					*/
 };
 
 /**
@@ -77,25 +106,47 @@ struct report_textdump_block {
 
 struct report_textdump_header {
 	unsigned		next;					/**< Offset to the next entry in the hash chain.			*/
+	unsigned		hash;					/**< The full hash value of the stored text.				*/
+	unsigned		length;					/**< The length of the stored text, excluding its terminator.		*/
 	char			text[UNKNOWN];				/**< The stored text string.						*/
 };
 
+/**
+ * The size of a hashed entry header, up to the start of the text.
+ */
+
+#define REPORT_TEXTDUMP_HEADER_SIZE (offsetof(struct report_textdump_header, text))
+
+/**
+ * Find the header of a hashed entry at a given offset into the text dump.
+ */
+
+#define report_textdump_header_at(handle, offset) ((struct report_textdump_header *) ((handle)->text + (offset)))
+
 /* Static Function Prototypes. */
 
-static int	report_textdump_make_hash(struct report_textdump_block *handle, char *text);
+static unsigned	report_textdump_make_hash(char *text, size_t *length);
+static osbool	report_textdump_extend(struct report_textdump_block *handle, size_t required);
+static void	report_textdump_resize_hash(struct report_textdump_block *handle);
+static void	report_textdump_reset_stats(struct report_textdump_block *handle);
+#ifdef DEBUG
+static void	report_textdump_benchmark(struct report_textdump_block *handle);
+#endif
 
 
 /**
  * Initialise a text storage block.
  *
+ * \param *arena		The arena from which to allocate memory.
  * \param allocation		The allocation block size, or 0 for the default.
- * \param hash			The size of the duplicate hash table, or 0 for none.
+ * \param hash			The initial size of the duplicate hash table, or 0
+ *				for none. The table will grow as strings are added.
  * \param terminator		The character to terminate dumped strings with. This
  *				must be \0 if hashing is to be used.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_textdump_block *report_textdump_create(size_t allocation, size_t hash, char terminator)
+struct report_textdump_block *report_textdump_create(struct report_arena_block *arena, size_t allocation, size_t hash, char terminator)
 {
 	struct report_textdump_block	*new;
 	int				i;
@@ -105,43 +156,62 @@ struct report_textdump_block *report_textdump_create(size_t allocation, size_t h
 	if (hash > 0 && terminator != '\0')
 		return NULL;
 
-	new = heap_alloc(sizeof(struct report_textdump_block));
+	new = report_arena_alloc(arena, sizeof(struct report_textdump_block));
 	if (new == NULL)
 		return NULL;
 
+	new->arena = arena;
+
 	new->allocation = (allocation == 0) ? REPORT_TEXTDUMP_ALLOCATION : allocation;
 
 	new->text = NULL;
 	new->free = 0;
 	new->size = new->allocation;
 
-	new->hashes = hash;
+	/* Round the hash table up to a power of two, so that bucket numbers
+	 * can be found by masking the full hash values.
+	 */
+
+	if (hash > 0) {
+		new->hashes = REPORT_TEXTDUMP_MIN_HASHES;
+
+		while (new->hashes < hash)
+			new->hashes *= 2;
+	} else {
+		new->hashes = 0;
+	}
+
+	new->initial_hashes = new->hashes;
+	new->entries = 0;
 	new->hash = NULL;
 
 	new->open = TRUE;
 
 	new->terminator = terminator;
 
+	report_textdump_reset_stats(new);
+
 	/* If a hash table has been requested, claim and initialise the storage. */
 
-	if (hash > 0) {
-		new->hash = heap_alloc(hash * sizeof(unsigned));
+	if (new->hashes > 0) {
+		new->hash = report_arena_alloc(arena, new->hashes * sizeof(unsigned));
 
 		if (new->hash == NULL) {
-			heap_free(new);
+			report_arena_free(arena, new, sizeof(struct report_textdump_block));
 			return NULL;
 		}
 
-		for (i = 0; i < hash; i++)
+		for (i = 0; i < new->hashes; i++)
 			new->hash[i] = REPORT_TEXTDUMP_NULL;
 	}
 
 	/* Claim the memory for the dump itself. */
 
-	if (flex_alloc((flex_ptr) &(new->text), new->allocation * sizeof(byte)) == 0) {
+	new->text = report_arena_alloc(arena, new->allocation * sizeof(byte));
+	if (new->text == NULL) {
 		if (new->hash != NULL)
-			heap_free(new->hash);
-		heap_free(new);
+			report_arena_free(arena, new->hash, new->hashes * sizeof(unsigned));
+		report_arena_free(arena, new, sizeof(struct report_textdump_block));
 		return NULL;
 	}
 
@@ -161,12 +231,12 @@ void report_textdump_destroy(struct report_textdump_block *handle)
 		return;
 
 	if (handle->text != NULL)
-		flex_free((flex_ptr) &(handle->text));
+		report_arena_free(handle->arena, handle->text, handle->size * sizeof(byte));
 
 	if (handle->hash != NULL)
-		heap_free(handle->hash);
+		report_arena_free(handle->arena, handle->hash, handle->hashes * sizeof(unsigned));
 
-	heap_free(handle);
+	report_arena_free(handle->arena, handle, sizeof(struct report_textdump_block));
 }
 
 
@@ -178,12 +248,28 @@ void report_textdump_destroy(struct report_textdump_block *handle)
 
 void report_textdump_clear(struct report_textdump_block *handle)
 {
-	int	i;
+	unsigned	*hash;
+	byte		*text;
+	int		i;
 
 	if (handle == NULL)
 		return;
 
 	handle->free = 0;
+	handle->entries = 0;
+
+	report_textdump_reset_stats(handle);
+
+	/* Return the hash table to its original size, if it has grown. */
+
+	if (handle->hash != NULL && handle->hashes != handle->initial_hashes) {
+		hash = report_arena_extend(handle->arena, handle->hash, handle->hashes * sizeof(unsigned), handle->initial_hashes * sizeof(unsigned));
+
+		if (hash != NULL) {
+			handle->hash = hash;
+			handle->hashes = handle->initial_hashes;
+		}
+	}
 
 	if (handle->hash != NULL)
 		for (i = 0; i < handle->hashes; i++)
@@ -192,8 +278,11 @@ void report_textdump_clear(struct report_textdump_block *handle)
 	if (handle->text == NULL)
 		return;
 
-	if (flex_extend((flex_ptr) &(handle->text), handle->allocation * sizeof(byte)) == 1)
+	text = report_arena_extend(handle->arena, handle->text, handle->size * sizeof(byte), handle->allocation * sizeof(byte));
+	if (text != NULL) {
+		handle->text = text;
 		handle->size = handle->allocation;
+	}
 
 	handle->open = TRUE;
 }
@@ -208,21 +297,29 @@ void report_textdump_clear(struct report_textdump_block *handle)
 
 void report_textdump_close(struct report_textdump_block *handle)
 {
+	byte	*text;
+
 	if (handle == NULL || handle->text == NULL || handle->open == FALSE)
 		return;
 
-	if (flex_extend((flex_ptr) &(handle->text), handle->free * sizeof(byte)) == 1)
+	text = report_arena_extend(handle->arena, handle->text, handle->size * sizeof(byte), handle->free * sizeof(byte));
+	if (text != NULL) {
+		handle->text = text;
 		handle->size = handle->free;
+	}
 
 #ifdef DEBUG
-	debug_printf("Content data: %dKb", handle->free / 1024);
+	debug_printf("Content data: %dKb, %u hits, %u misses, %u extensions", handle->free / 1024,
+			handle->stats.hits, handle->stats.misses, handle->stats.extensions);
+
+	report_textdump_benchmark(handle);
 #endif
 }
 
 
 /**
  * Return the offset base for a text block. The returned value is only guaranteed
- * to be correct unitl the Flex heap is altered.
+ * to be correct until more text is added to the block.
  *
  * \param handle		The block handle.
  * \return			The block base, or NULL on error.
@@ -254,6 +351,47 @@ size_t report_textdump_get_size(struct report_textdump_block *handle)
 }
 
 
+/**
+ * Return the usage statistics for a text block, for use when tuning its
+ * allocation and hash parameters.
+ *
+ * \param *handle		The block handle.
+ * \param *stats		Pointer to a structure to take the statistics.
+ * \return			TRUE if successful; FALSE on error.
+ */
+
+osbool report_textdump_get_stats(struct report_textdump_block *handle, struct report_textdump_stats *stats)
+{
+	unsigned	offset;
+	size_t		i, chain;
+
+	if (handle == NULL || stats == NULL)
+		return FALSE;
+
+	*stats = handle->stats;
+
+	stats->entries = handle->entries;
+	stats->buckets = handle->hashes;
+	stats->bytes_used = handle->free;
+	stats->bytes_allocated = handle->size;
+	stats->longest_chain = 0;
+
+	/* Walk the hash chains to find the longest. */
+
+	for (i = 0; i < handle->hashes; i++) {
+		chain = 0;
+
+		for (offset = handle->hash[i]; offset != REPORT_TEXTDUMP_NULL; offset = report_textdump_header_at(handle, offset)->next)
+			chain++;
+
+		if (chain > stats->longest_chain)
+			stats->longest_chain = chain;
+	}
+
+	return TRUE;
+}
+
+
 /**
  * Store a text string in the text dump, allocating new memory if required,
  * and returning the offset to the stored string.
@@ -265,78 +403,280 @@ size_t report_textdump_get_size(struct report_textdump_block *handle)
 
 unsigned report_textdump_store(struct report_textdump_block *handle, char *text)
 {
-	int		length, blocks;
-	unsigned	offset;
-	int		hash = -1;
+	struct report_textdump_header	*header;
+	size_t				length, text_length;
+	unsigned			offset, hash = 0;
 
 	if (handle == NULL || text == NULL || handle->open == FALSE)
 		return REPORT_TEXTDUMP_NULL;
 
 	if (handle->hash != NULL) {
-		hash = report_textdump_make_hash(handle, text);
+		hash = report_textdump_make_hash(text, &text_length);
+
+		/* Only compare the strings themselves if both the full hash
+		 * and the length match; this rejects almost all of the other
+		 * entries in the chain without touching their text.
+		 */
+
+		offset = handle->hash[hash & (handle->hashes - 1)];
 
-		offset = handle->hash[hash];
+		while (offset != REPORT_TEXTDUMP_NULL) {
+			header = report_textdump_header_at(handle, offset);
 
-		while (offset != REPORT_TEXTDUMP_NULL &&
-				strcmp(((struct report_textdump_header *) (handle->text + offset))->text, text) != 0)
-			offset = ((struct report_textdump_header *) (handle->text + offset))->next;
+			if (header->hash == hash && header->length == text_length && strcmp(header->text, text) == 0)
+				break;
+
+			offset = header->next;
+		}
 
 		if (offset != REPORT_TEXTDUMP_NULL) {
-			return offset + sizeof(unsigned);
+			handle->stats.hits++;
+			return offset + REPORT_TEXTDUMP_HEADER_SIZE;
 		}
 
-		length = (strlen(text) + sizeof(struct report_textdump_header)) & 0xfffffffc;
+		handle->stats.misses++;
+
+		length = (REPORT_TEXTDUMP_HEADER_SIZE + text_length + 1 + 3) & ~3u;
 	} else {
-		length = strlen(text) + 1;
+		text_length = strlen(text);
+		length = text_length + 1;
 	}
 
-	if ((handle->free + length) > handle->size) {
-		for (blocks = 1; (handle->free + length) > (handle->size + blocks * handle->allocation); blocks++);
+	handle->stats.bytes_requested += text_length + 1;
 
-		if (flex_extend((flex_ptr) &(handle->text), (handle->size + blocks * handle->allocation) * sizeof(char)) == 0)
-			return REPORT_TEXTDUMP_NULL;
-
-		handle->size += blocks * handle->allocation;
-	}
+	if ((handle->free + length) > handle->size && !report_textdump_extend(handle, handle->free + length))
+		return REPORT_TEXTDUMP_NULL;
 
 	offset = handle->free;
 
-	if (handle->hash != NULL && hash != -1) {
-		((struct report_textdump_header *) (handle->text + offset))->next = handle->hash[hash];
-		handle->hash[hash] = offset;
-		offset += sizeof(unsigned);
+	if (handle->hash != NULL) {
+		header = report_textdump_header_at(handle, offset);
+
+		header->hash = hash;
+		header->length = text_length;
+		header->next = handle->hash[hash & (handle->hashes - 1)];
+		handle->hash[hash & (handle->hashes - 1)] = offset;
+
+		offset += REPORT_TEXTDUMP_HEADER_SIZE;
 	}
 
-	strcpy((char *) (handle->text + offset), text);
+	memcpy(handle->text + offset, text, text_length + 1);
 
 	if (handle->terminator != '\0')
-		*(((char *) handle->text) + offset + length - 1) = handle->terminator;
+		*(((char *) handle->text) + offset + text_length) = handle->terminator;
 
 	handle->free += length;
 
+	/* Grow the hash table if it has become more than three-quarters full. */
+
+	if (handle->hash != NULL && ++handle->entries > (handle->hashes / 4) * 3)
+		report_textdump_resize_hash(handle);
+
 	return offset;
 }
 
 
 /**
- * Create a hash for a given text string in a given text dump.
+ * Create a hash for a given text string, using the 32-bit FNV-1a algorithm,
+ * and find the length of the string at the same time.
  *
- * \param *handle		The handle of the relevant text dump.
  * \param *text			Pointer to the string to hash.
- * \return			The calculated hash, or -1.
+ * \param *length		Pointer to a variable to return the string length.
+ * \return			The calculated hash.
+ */
+
+static unsigned report_textdump_make_hash(char *text, size_t *length)
+{
+	unsigned	hash = REPORT_TEXTDUMP_FNV_BASIS;
+	char		*c = text;
+
+	while (*c != '\0') {
+		hash ^= (unsigned char) *c++;
+		hash *= REPORT_TEXTDUMP_FNV_PRIME;
+	}
+
+	*length = c - text;
+
+	return hash;
+}
+
+
+/**
+ * Extend the memory claimed for a text dump, growing it geometrically so
+ * that large reports need only a handful of extensions.
+ *
+ * \param *handle		The handle of the text dump to extend.
+ * \param required		The minimum size required, in bytes.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool report_textdump_extend(struct report_textdump_block *handle, size_t required)
+{
+	byte	*text;
+	size_t	step, size;
+
+	/* Try to double the block, up to a maximum step. */
+
+	step = handle->size;
+
+	if (step < handle->allocation)
+		step = handle->allocation;
+	else if (step > REPORT_TEXTDUMP_MAX_STEP)
+		step = REPORT_TEXTDUMP_MAX_STEP;
+
+	size = handle->size + step;
+
+	if (size < required)
+		size = required;
+
+	/* If that fails, fall back to claiming just what is needed. */
+
+	text = report_arena_extend(handle->arena, handle->text, handle->size * sizeof(byte), size * sizeof(byte));
+
+	if (text == NULL) {
+		size = required;
+
+		text = report_arena_extend(handle->arena, handle->text, handle->size * sizeof(byte), size * sizeof(byte));
+		if (text == NULL)
+			return FALSE;
+	}
+
+	handle->text = text;
+	handle->size = size;
+	handle->stats.extensions++;
+
+	return TRUE;
+}
+
+
+/**
+ * Double the size of the hash table in a text dump, and redistribute the
+ * existing entries using the full hash values held in their headers. If the
+ * memory can not be found, the existing table is left in place.
+ *
+ * \param *handle		The handle of the text dump to update.
+ */
+
+static void report_textdump_resize_hash(struct report_textdump_block *handle)
+{
+	struct report_textdump_header	*header;
+	unsigned			*hash, offset, next;
+	size_t				hashes, i;
+
+	hashes = handle->hashes * 2;
+
+	hash = report_arena_alloc(handle->arena, hashes * sizeof(unsigned));
+	if (hash == NULL)
+		return;
+
+	for (i = 0; i < hashes; i++)
+		hash[i] = REPORT_TEXTDUMP_NULL;
+
+	for (i = 0; i < handle->hashes; i++) {
+		for (offset = handle->hash[i]; offset != REPORT_TEXTDUMP_NULL; offset = next) {
+			header = report_textdump_header_at(handle, offset);
+			next = header->next;
+
+			header->next = hash[header->hash & (hashes - 1)];
+			hash[header->hash & (hashes - 1)] = offset;
+		}
+	}
+
+	report_arena_free(handle->arena, handle->hash, handle->hashes * sizeof(unsigned));
+
+	handle->hash = hash;
+	handle->hashes = hashes;
+	handle->stats.rehashes++;
+}
+
+
+/**
+ * Reset the usage statistics for a text dump.
+ *
+ * \param *handle		The handle of the text dump to reset.
  */
 
-static int report_textdump_make_hash(struct report_textdump_block *handle, char *text)
+static void report_textdump_reset_stats(struct report_textdump_block *handle)
 {
-	int hash = 0, length, i;
+	handle->stats.hits = 0;
+	handle->stats.misses = 0;
+	handle->stats.extensions = 0;
+	handle->stats.rehashes = 0;
+	handle->stats.bytes_requested = 0;
+	handle->stats.entries = 0;
+	handle->stats.buckets = 0;
+	handle->stats.longest_chain = 0;
+	handle->stats.bytes_used = 0;
+	handle->stats.bytes_allocated = 0;
+}
+
 
-	if (handle == NULL || text == NULL)
-		return -1;
+#ifdef DEBUG
 
-	length = strlen(text);
-	for (i = 0; i < length; i++)
-		hash += text[i];
+/**
+ * Replay the strings held in a hashed text dump into a new dump with the
+ * same parameters, timing how long it takes to store them all and then to
+ * look them all up again. Each string should be stored at the same offset
+ * in the copy as in the original, and then be found there; any which are
+ * not are counted as failures. The results are written to the debug output.
+ *
+ * \param *handle		The handle of the text dump to replay.
+ */
 
-	return hash % handle->hashes;
+static void report_textdump_benchmark(struct report_textdump_block *handle)
+{
+	struct report_arena_block	*arena;
+	struct report_textdump_block	*copy;
+	struct report_textdump_header	*header;
+	unsigned			offset;
+	os_t				start, times[2];
+	int				pass, failures = 0;
+
+	if (handle == NULL || handle->hash == NULL || handle->entries == 0)
+		return;
+
+	/* Use a separate arena, so that the report's own memory use is not
+	 * affected by the copy.
+	 */
+
+	arena = report_arena_create();
+	if (arena == NULL)
+		return;
+
+	copy = report_textdump_create(arena, handle->allocation, handle->initial_hashes, '\0');
+	if (copy == NULL) {
+		report_arena_destroy(arena);
+		return;
+	}
+
+	/* The first pass stores each string into the copy, and the second
+	 * finds each one again.
+	 */
+
+	for (pass = 0; pass < 2; pass++) {
+		start = os_read_monotonic_time();
+
+		for (offset = 0; offset < handle->free; offset += (REPORT_TEXTDUMP_HEADER_SIZE + header->length + 1 + 3) & ~3u) {
+			header = report_textdump_header_at(handle, offset);
+
+			if (report_textdump_store(copy, header->text) != offset + REPORT_TEXTDUMP_HEADER_SIZE)
+				failures++;
+		}
+
+		times[pass] = os_read_monotonic_time() - start;
+	}
+
+	if (copy->stats.misses != handle->entries || copy->stats.hits != handle->entries)
+		failures++;
+
+	if (failures > 0)
+		debug_printf("\\RContent replay found %d failures", failures);
+
+	debug_printf("Content replay: %u strings; store %dcs, lookup %dcs, %u rehashes, %u extensions",
+			handle->entries, times[0], times[1], copy->stats.rehashes, copy->stats.extensions);
+
+	report_textdump_destroy(copy);
+	report_arena_destroy(arena);
 }
 
+#endif
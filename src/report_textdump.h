@@ -25,9 +25,9 @@
 /**
  * \file: report_textdump.h
  *
- * Text storage in a flex block.
+ * Text storage in a report arena block.
  *
- * A text dump maintains a block on the flex heap, which is used to store strings
+ * A text dump maintains a block in a report arena, which is used to store strings
  * of text.  A string is added using report_textdump_store(), which returns an offset
  * from the base of the block.  If
  *
@@ -37,18 +37,19 @@
  *
  *  report_textdump_get_base(dump) + offset;
  *
- * The block's base must always be refound whenever there is a chance that
- * blocks on the flex heap might have moved.
+ * The block's base must always be refound whenever more text has been added,
+ * as the block may have moved in the arena.
  *
  * If the block is initialised with hash = 0, then strings will be added
  * byte-aligned to the block with '\0' byte terminators between them.
  * Identical strings will be added mutliple times.
  *
- * If the block is initialised with hash > 0, then a hash of that size will be
- * created and all new strings will be looked up via it.  If a exact duplicate
+ * If the block is initialised with hash > 0, then a hash of at least that size
+ * will be created and all new strings will be looked up via it.  The table
+ * doubles in size whenever it becomes three-quarters full.  If a exact duplicate
  * of an existing string is added, then the offset of the previous copy is
  * returned instead.  In this mode, all strings are stored word-aligned and an
- * overhead of up to 7 bytes is incurred for each new string stored (on top of
+ * overhead of up to 15 bytes is incurred for each new string stored (on top of
  * the string plus its '\0' terminator).
  *
  * Alternatively, if the terminator is set to other than \0, strings added to
@@ -62,6 +63,7 @@
 
 #include <stdlib.h>
 #include "oslib/types.h"
+#include "report_arena.h"
 
 /**
  * A Report Textdump instance handle.
@@ -75,18 +77,37 @@ struct report_textdump_block;
 
 #define REPORT_TEXTDUMP_NULL 0xffffffff
 
+/**
+ * Usage statistics for a Report Textdump instance.
+ */
+
+struct report_textdump_stats {
+	unsigned		hits;					/**< The number of strings found already in the dump.			*/
+	unsigned		misses;					/**< The number of strings which had to be added to a hashed dump.	*/
+	unsigned		extensions;				/**< The number of times that the dump's memory has been extended.	*/
+	unsigned		rehashes;				/**< The number of times that the hash table has been resized.		*/
+	size_t			bytes_requested;			/**< The total size of all the strings passed in, with terminators.	*/
+	size_t			entries;				/**< The number of distinct strings held in the hash table.		*/
+	size_t			buckets;				/**< The current size of the hash table.				*/
+	size_t			longest_chain;				/**< The length of the longest hash chain.				*/
+	size_t			bytes_used;				/**< The number of bytes used in the dump.				*/
+	size_t			bytes_allocated;			/**< The number of bytes claimed for the dump.				*/
+};
+
 
 /**
  * Initialise a text storage block.
  *
+ * \param *arena		The arena from which to allocate memory.
  * \param allocation		The allocation block size, or 0 for the default.
- * \param hash			The size of the duplicate hash table, or 0 for none.
+ * \param hash			The initial size of the duplicate hash table, or 0
+ *				for none. The table will grow as strings are added.
  * \param terminator		The character to terminate dumped strings with. This
  *				must be \0 if hashing is to be used.
  * \return			The block handle, or NULL on failure.
  */
 
-struct report_textdump_block *report_textdump_create(size_t allocation, size_t hash, char terminator);
+struct report_textdump_block *report_textdump_create(struct report_arena_block *arena, size_t allocation, size_t hash, char terminator);
 
 
 /**
@@ -119,7 +140,7 @@ void report_textdump_close(struct report_textdump_block *handle);
 
 /**
  * Return the offset base for a text block. The returned value is only guaranteed
- * to be correct unitl the Flex heap is altered.
+ * to be correct until more text is added to the block.
  *
  * \param			The block handle.
  * \return			The block base, or NULL on error.
@@ -139,6 +160,18 @@ char *report_textdump_get_base(struct report_textdump_block *text);
 size_t report_textdump_get_size(struct report_textdump_block *handle);
 
 
+/**
+ * Return the usage statistics for a text block, for use when tuning its
+ * allocation and hash parameters.
+ *
+ * \param *handle		The block handle.
+ * \param *stats		Pointer to a structure to take the statistics.
+ * \return			TRUE if successful; FALSE on error.
+ */
+
+osbool report_textdump_get_stats(struct report_textdump_block *handle, struct report_textdump_stats *stats);
+
+
 /**
  * Store a text string in the text dump, allocating new memory if required,
  * and returning the offset to the stored string.
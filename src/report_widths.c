@@ -0,0 +1,547 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: report_widths.c
+ *
+ * Cache of measured cell widths for report reflows.
+ *
+ * The entries are held in an open-addressed hash table on the heap, which
+ * doubles in size when it becomes three-quarters full. As with the Line
+ * Cache, each entry carries a stamp from the cache's current generation so
+ * that the whole table can be discarded by bumping the generation.
+ */
+
+/* ANSI C header files */
+
+#include <stdlib.h>
+
+/* OSLib header files */
+
+#include "oslib/os.h"
+#include "oslib/types.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/debug.h"
+#include "sflib/heap.h"
+
+/* Application header files */
+
+#include "report_widths.h"
+
+#include "report_cell.h"
+#include "report_fonts.h"
+#include "report_textdump.h"
+
+
+/**
+ * The default number of entries to allocate.
+ */
+
+#define REPORT_WIDTHS_ENTRIES 512
+
+/**
+ * The cell flags which select a font face, and so affect a measurement.
+ */
+
+#define REPORT_WIDTHS_STYLE_FLAGS (REPORT_CELL_FLAGS_BOLD | REPORT_CELL_FLAGS_ITALIC)
+
+#ifdef DEBUG
+
+/**
+ * The number of distinct text offsets used by report_widths_verify().
+ */
+
+#define REPORT_WIDTHS_VERIFY_OFFSETS 200
+
+/**
+ * The text dump offset for which the fake measurement back end used by
+ * report_widths_verify() returns an error.
+ */
+
+#define REPORT_WIDTHS_VERIFY_ERROR_OFFSET 37
+
+/**
+ * The text measured by the fake back end used by report_widths_verify(),
+ * which takes a tail of a different length for each offset.
+ */
+
+static char report_widths_verify_text[] = "abcdefghijklm";
+
+/**
+ * The state of the fake measurement back end used by report_widths_verify().
+ */
+
+struct report_widths_fake {
+	int				scale;			/**< The width of each character, standing in for the font size.	*/
+	int				calls;			/**< The number of measurements requested.				*/
+	osbool				fail;			/**< TRUE if the next measurement should fail.				*/
+};
+
+/**
+ * The error returned by the fake measurement back end.
+ */
+
+static os_error report_widths_fake_error = {0, "Fake measurement failure"};
+
+#endif
+
+/**
+ * A Report Widths cache entry.
+ */
+
+struct report_widths_entry {
+	unsigned			offset;			/**< The text dump offset of the measured text.			*/
+	enum report_cell_flags		style;			/**< The style flags used to measure the text.			*/
+	unsigned			stamp;			/**< The cache generation in which the entry was filled, or 0.	*/
+	struct report_fonts_extent	extent;			/**< The measured extent of the text.				*/
+};
+
+/**
+ * A Report Widths instance.
+ */
+
+struct report_widths_block {
+	struct report_widths_callback	*callback;		/**< The client's measurement callback.				*/
+	void				*data;			/**< The client data to pass to the callback.			*/
+
+	size_t				size;			/**< The number of entries in the table; always a power of 2.	*/
+	size_t				used;			/**< The number of entries filled in the current generation.	*/
+
+	unsigned			stamp;			/**< The current cache generation.				*/
+	unsigned			font_set;		/**< The font set value for which the entries are valid.	*/
+
+	struct report_widths_entry	*entries;		/**< The table of cache entries.				*/
+};
+
+/* Static Function Prototypes. */
+
+static struct report_widths_entry *report_widths_find_entry(struct report_widths_block *handle, unsigned offset, enum report_cell_flags style);
+static void report_widths_grow(struct report_widths_block *handle);
+static void report_widths_clear_entries(struct report_widths_entry *entries, size_t size);
+#ifdef DEBUG
+static char *report_widths_fake_text(unsigned offset);
+static os_error *report_widths_fake_measure(void *data, char *text, enum report_cell_flags flags, struct report_fonts_extent *extent);
+#endif
+
+
+/**
+ * Create a new Report Widths instance.
+ *
+ * \param entries		The number of entries to allocate initially,
+ *				or 0 for the default.
+ * \param *callback		Pointer to the client-supplied measurement callback.
+ * \param *data			Pointer to client data to be returned on all callbacks.
+ * \return			The new instance handle, or NULL on failure.
+ */
+
+struct report_widths_block *report_widths_create(size_t entries, struct report_widths_callback *callback, void *data)
+{
+	struct report_widths_block	*new;
+
+	if (callback == NULL || callback->measure == NULL)
+		return NULL;
+
+	new = heap_alloc(sizeof(struct report_widths_block));
+	if (new == NULL)
+		return NULL;
+
+	new->callback = callback;
+	new->data = data;
+
+	if (entries == 0)
+		entries = REPORT_WIDTHS_ENTRIES;
+
+	for (new->size = 16; new->size < entries; new->size *= 2);
+
+	new->used = 0;
+	new->stamp = 1;
+	new->font_set = 0;
+
+	new->entries = heap_alloc(sizeof(struct report_widths_entry) * new->size);
+	if (new->entries == NULL) {
+		heap_free(new);
+		return NULL;
+	}
+
+	report_widths_clear_entries(new->entries, new->size);
+
+	return new;
+}
+
+
+/**
+ * Destroy a Report Widths instance, freeing the memory associated with it.
+ *
+ * \param *handle		The instance to be destroyed.
+ */
+
+void report_widths_destroy(struct report_widths_block *handle)
+{
+	if (handle == NULL)
+		return;
+
+	if (handle->entries != NULL)
+		heap_free(handle->entries);
+
+	heap_free(handle);
+}
+
+
+/**
+ * Discard all of the measurements held in a Report Widths instance.
+ *
+ * \param *handle		The instance to update.
+ */
+
+void report_widths_invalidate(struct report_widths_block *handle)
+{
+	if (handle == NULL)
+		return;
+
+	handle->used = 0;
+
+	/* If the generation counter wraps around, old entries could become
+	 * valid again, so clear them all out explicitly. Stamp 0 is kept to
+	 * mark unused entries.
+	 */
+
+	if (++handle->stamp == 0) {
+		report_widths_clear_entries(handle->entries, handle->size);
+		handle->stamp = 1;
+	}
+}
+
+
+/**
+ * Find the extent of a piece of text, returning the cached value if one
+ * is available or calling the client to measure it if not.
+ *
+ * \param *handle		The instance to use.
+ * \param offset		The offset of the text in the report's text
+ *				dump, or REPORT_TEXTDUMP_NULL if it isn't there.
+ * \param *text			Pointer to the text to be measured.
+ * \param flags			The cell formatting flags to be applied.
+ * \param font_set		The font set value for the current fonts.
+ * \param *extent		Pointer to a structure to take the extent.
+ * \return			A pointer to an OS Error block, or NULL on success.
+ */
+
+os_error *report_widths_get_extent(struct report_widths_block *handle, unsigned offset, char *text,
+		enum report_cell_flags flags, unsigned font_set, struct report_fonts_extent *extent)
+{
+	struct report_widths_entry	*entry;
+	enum report_cell_flags		style;
+	os_error			*error;
+
+	if (handle == NULL || text == NULL || extent == NULL)
+		return NULL;
+
+	if (offset == REPORT_TEXTDUMP_NULL)
+		return handle->callback->measure(handle->data, text, flags, extent);
+
+	/* If the fonts have changed, everything measured so far is stale. */
+
+	if (font_set != handle->font_set) {
+		report_widths_invalidate(handle);
+		handle->font_set = font_set;
+	}
+
+	style = flags & REPORT_WIDTHS_STYLE_FLAGS;
+
+	entry = report_widths_find_entry(handle, offset, style);
+
+	if (entry->stamp == handle->stamp) {
+		*extent = entry->extent;
+		return NULL;
+	}
+
+	/* Measure the text, and only cache the result if it was successful. */
+
+	error = handle->callback->measure(handle->data, text, flags, extent);
+	if (error != NULL)
+		return error;
+
+	entry->offset = offset;
+	entry->style = style;
+	entry->stamp = handle->stamp;
+	entry->extent = *extent;
+
+	if (++handle->used > (handle->size / 4) * 3)
+		report_widths_grow(handle);
+
+	return NULL;
+}
+
+
+/**
+ * Find the entry in a Report Widths instance which either holds a given
+ * key, or which is free to take it.
+ *
+ * \param *handle		The instance to search.
+ * \param offset		The text dump offset to look up.
+ * \param style			The style flags to look up.
+ * \return			Pointer to the entry.
+ */
+
+static struct report_widths_entry *report_widths_find_entry(struct report_widths_block *handle, unsigned offset, enum report_cell_flags style)
+{
+	struct report_widths_entry	*entry;
+	unsigned			hash;
+	size_t				slot;
+
+	hash = (offset ^ ((unsigned) style << 24)) * 2654435761u;
+	slot = (hash ^ (hash >> 16)) & (handle->size - 1);
+
+	/* The table is never allowed to fill, so there will always be an
+	 * unused entry to stop the probe.
+	 */
+
+	while (1) {
+		entry = handle->entries + slot;
+
+		if (entry->stamp != handle->stamp || (entry->offset == offset && entry->style == style))
+			return entry;
+
+		slot = (slot + 1) & (handle->size - 1);
+	}
+}
+
+
+/**
+ * Double the size of the table in a Report Widths instance, carrying the
+ * current entries over. If the memory can not be found, the existing
+ * entries are discarded instead so that the table can never fill up.
+ *
+ * \param *handle		The instance to grow.
+ */
+
+static void report_widths_grow(struct report_widths_block *handle)
+{
+	struct report_widths_entry	*old, *entry;
+	size_t				old_size, i;
+
+	old = handle->entries;
+	old_size = handle->size;
+
+	handle->entries = heap_alloc(sizeof(struct report_widths_entry) * old_size * 2);
+	if (handle->entries == NULL) {
+		handle->entries = old;
+		report_widths_invalidate(handle);
+		return;
+	}
+
+	handle->size = old_size * 2;
+
+	report_widths_clear_entries(handle->entries, handle->size);
+
+	for (i = 0; i < old_size; i++) {
+		if (old[i].stamp != handle->stamp)
+			continue;
+
+		entry = report_widths_find_entry(handle, old[i].offset, old[i].style);
+		*entry = old[i];
+	}
+
+	heap_free(old);
+}
+
+
+/**
+ * Mark all of the entries in a table as unused.
+ *
+ * \param *entries		The table of entries to clear.
+ * \param size			The number of entries in the table.
+ */
+
+static void report_widths_clear_entries(struct report_widths_entry *entries, size_t size)
+{
+	size_t	i;
+
+	if (entries == NULL)
+		return;
+
+	for (i = 0; i < size; i++)
+		entries[i].stamp = 0;
+}
+
+
+#ifdef DEBUG
+
+/**
+ * Check the behaviour of the width cache against a deterministic fake
+ * measurement back end, whose widths depend only on the text, the style
+ * flags and a scale which stands in for the font size. The cache is
+ * started small so that it must grow, and is checked to measure each text
+ * and style once, to return the measured extents from then on, to ignore
+ * the non-style flags, to re-measure everything when the font set changes,
+ * to pass through text which isn't in the dump and not to cache failed
+ * measurements. Any problems are written to the debug output.
+ *
+ * \return			TRUE if all the checks passed; FALSE if not.
+ */
+
+osbool report_widths_verify(void)
+{
+	struct report_widths_callback	callback;
+	struct report_widths_block	*handle;
+	struct report_widths_fake	fake;
+	struct report_fonts_extent	extent, expected;
+	enum report_cell_flags		flags;
+	unsigned			offset, font_set;
+	int				pass, style, calls, failures = 0;
+
+	callback.measure = report_widths_fake_measure;
+
+	fake.scale = 10;
+	fake.calls = 0;
+	fake.fail = FALSE;
+
+	handle = report_widths_create(16, &callback, &fake);
+	if (handle == NULL)
+		return FALSE;
+
+	/* The first pass should measure every text in every style once. The
+	 * second should find them all in the cache, even with different
+	 * alignment flags, and the third should measure them all again in
+	 * the new font set.
+	 */
+
+	for (pass = 0; pass < 3; pass++) {
+		font_set = (pass < 2) ? 1 : 2;
+		fake.scale = (pass < 2) ? 10 : 12;
+		calls = fake.calls;
+
+		for (offset = 0; offset < REPORT_WIDTHS_VERIFY_OFFSETS; offset++) {
+			for (style = 0; style < 4; style++) {
+				flags = ((style & 1) ? REPORT_CELL_FLAGS_BOLD : 0) | ((style & 2) ? REPORT_CELL_FLAGS_ITALIC : 0);
+				if (pass == 1)
+					flags |= REPORT_CELL_FLAGS_RIGHT | REPORT_CELL_FLAGS_UNDERLINE;
+
+				report_widths_fake_measure(&fake, report_widths_fake_text(offset), flags, &expected);
+				fake.calls--;
+
+				if (report_widths_get_extent(handle, offset, report_widths_fake_text(offset), flags, font_set, &extent) != NULL ||
+						extent.width != expected.width || extent.height != expected.height ||
+						extent.descender != expected.descender) {
+					debug_printf("\\RWidth cache gave %d for offset %d, style %d, pass %d, not %d", extent.width, offset, style, pass, expected.width);
+					failures++;
+				}
+			}
+		}
+
+		if (fake.calls - calls != ((pass == 1) ? 0 : REPORT_WIDTHS_VERIFY_OFFSETS * 4)) {
+			debug_printf("\\RWidth cache made %d measurements on pass %d", fake.calls - calls, pass);
+			failures++;
+		}
+	}
+
+	/* Text which isn't in the dump must be measured every time. */
+
+	calls = fake.calls;
+
+	for (pass = 0; pass < 2; pass++)
+		report_widths_get_extent(handle, REPORT_TEXTDUMP_NULL, report_widths_verify_text, REPORT_CELL_FLAGS_NONE, font_set, &extent);
+
+	if (fake.calls - calls != 2) {
+		debug_printf("\\RWidth cache made %d measurements of text outside the dump", fake.calls - calls);
+		failures++;
+	}
+
+	/* A failed measurement must be reported, and not be cached. */
+
+	report_widths_invalidate(handle);
+
+	fake.fail = TRUE;
+	if (report_widths_get_extent(handle, REPORT_WIDTHS_VERIFY_ERROR_OFFSET, report_widths_fake_text(REPORT_WIDTHS_VERIFY_ERROR_OFFSET),
+			REPORT_CELL_FLAGS_NONE, font_set, &extent) == NULL) {
+		debug_printf("\\RWidth cache did not report a failed measurement");
+		failures++;
+	}
+
+	calls = fake.calls;
+	report_widths_get_extent(handle, REPORT_WIDTHS_VERIFY_ERROR_OFFSET, report_widths_fake_text(REPORT_WIDTHS_VERIFY_ERROR_OFFSET),
+			REPORT_CELL_FLAGS_NONE, font_set, &extent);
+
+	if (fake.calls - calls != 1) {
+		debug_printf("\\RWidth cache kept a failed measurement");
+		failures++;
+	}
+
+	report_widths_destroy(handle);
+
+	debug_printf("Report width cache checks complete, with %d failures", failures);
+
+	return (failures == 0) ? TRUE : FALSE;
+}
+
+
+/**
+ * Return the text used by report_widths_verify() for a given text dump
+ * offset, whose length depends on the offset.
+ *
+ * \param offset		The text dump offset.
+ * \return			Pointer to the text.
+ */
+
+static char *report_widths_fake_text(unsigned offset)
+{
+	return report_widths_verify_text + (offset % (sizeof(report_widths_verify_text) - 1));
+}
+
+
+/**
+ * A fake measurement back end for report_widths_verify(), which gives each
+ * character a width set by the scale and adds a different amount for each
+ * of the bold and italic styles.
+ *
+ * \param *data			The fake back end's state.
+ * \param *text			Pointer to the text to measure.
+ * \param flags			The cell formatting flags to be applied.
+ * \param *extent		Pointer to a structure to take the extent.
+ * \return			A pointer to an OS Error block, or NULL on success.
+ */
+
+static os_error *report_widths_fake_measure(void *data, char *text, enum report_cell_flags flags, struct report_fonts_extent *extent)
+{
+	struct report_widths_fake	*fake = data;
+	int				length;
+
+	fake->calls++;
+
+	if (fake->fail) {
+		fake->fail = FALSE;
+		return &report_widths_fake_error;
+	}
+
+	for (length = 0; text[length] != '\0'; length++);
+
+	extent->width = length * fake->scale + ((flags & REPORT_CELL_FLAGS_BOLD) ? 3 : 0) + ((flags & REPORT_CELL_FLAGS_ITALIC) ? 5 : 0);
+	extent->height = fake->scale * 1000;
+	extent->descender = fake->scale * 250;
+
+	return NULL;
+}
+
+#endif
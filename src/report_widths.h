@@ -0,0 +1,140 @@
+/* Copyright 2003-2019, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of CashBook:
+ *
+ *   http://www.stevefryatt.org.uk/software/
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: report_widths.h
+ *
+ * Cache of measured cell widths for report reflows.
+ *
+ * The cells in a report repeat heavily -- dates, account names and common
+ * amounts -- and the text dump stores each distinct string only once, so
+ * that the offset of the text in the dump, together with the cell flags
+ * which select a font face, identify a measurement. The cache holds the
+ * extents returned by a client-supplied measurement callback, keyed on
+ * these values and on a font set value supplied by the client: whenever
+ * the font set changes, all of the existing entries are discarded.
+ */
+
+#ifndef CASHBOOK_REPORT_WIDTHS
+#define CASHBOOK_REPORT_WIDTHS
+
+#include <stdlib.h>
+#include "oslib/os.h"
+#include "oslib/types.h"
+#include "report_cell.h"
+#include "report_fonts.h"
+
+/**
+ * A Report Widths instance handle.
+ */
+
+struct report_widths_block;
+
+/**
+ * The callback which clients must supply, to measure text which is not
+ * held in the cache.
+ */
+
+struct report_widths_callback {
+	/**
+	 * Request the client measure a string of text.
+	 *
+	 * \param *data			The client data supplied to report_widths_create().
+	 * \param *text			Pointer to the text to measure.
+	 * \param flags			The cell formatting flags to be applied.
+	 * \param *extent		Pointer to a structure to take the extent.
+	 * \return			A pointer to an OS Error block, or NULL on success.
+	 */
+
+	os_error		*(*measure)(void *data, char *text, enum report_cell_flags flags, struct report_fonts_extent *extent);
+};
+
+
+/**
+ * Create a new Report Widths instance.
+ *
+ * \param entries		The number of entries to allocate initially,
+ *				or 0 for the default.
+ * \param *callback		Pointer to the client-supplied measurement callback.
+ * \param *data			Pointer to client data to be returned on all callbacks.
+ * \return			The new instance handle, or NULL on failure.
+ */
+
+struct report_widths_block *report_widths_create(size_t entries, struct report_widths_callback *callback, void *data);
+
+
+/**
+ * Destroy a Report Widths instance, freeing the memory associated with it.
+ *
+ * \param *handle		The instance to be destroyed.
+ */
+
+void report_widths_destroy(struct report_widths_block *handle);
+
+
+/**
+ * Discard all of the measurements held in a Report Widths instance.
+ *
+ * \param *handle		The instance to update.
+ */
+
+void report_widths_invalidate(struct report_widths_block *handle);
+
+
+/**
+ * Find the extent of a piece of text, returning the cached value if one
+ * is available or calling the client to measure it if not.
+ *
+ * \param *handle		The instance to use.
+ * \param offset		The offset of the text in the report's text
+ *				dump, or REPORT_TEXTDUMP_NULL if it isn't there.
+ * \param *text			Pointer to the text to be measured.
+ * \param flags			The cell formatting flags to be applied.
+ * \param font_set		The font set value for the current fonts.
+ * \param *extent		Pointer to a structure to take the extent.
+ * \return			A pointer to an OS Error block, or NULL on success.
+ */
+
+os_error *report_widths_get_extent(struct report_widths_block *handle, unsigned offset, char *text,
+		enum report_cell_flags flags, unsigned font_set, struct report_fonts_extent *extent);
+
+
+#ifdef DEBUG
+/**
+ * Check the behaviour of the width cache against a deterministic fake
+ * measurement back end, whose widths depend only on the text, the style
+ * flags and a scale which stands in for the font size. The cache is
+ * started small so that it must grow, and is checked to measure each text
+ * and style once, to return the measured extents from then on, to ignore
+ * the non-style flags, to re-measure everything when the font set changes,
+ * to pass through text which isn't in the dump and not to cache failed
+ * measurements. Any problems are written to the debug output.
+ *
+ * \return			TRUE if all the checks passed; FALSE if not.
+ */
+
+osbool report_widths_verify(void);
+#endif
+
+#endif
+
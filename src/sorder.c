@@ -63,6 +63,7 @@
 #include "file.h"
 #include "filing.h"
 #include "flexutils.h"
+#include "forecast.h"
 #include "sorder_dialogue.h"
 #include "sorder_list_window.h"
 #include "transact.h"
@@ -92,6 +93,8 @@ struct sorder {
 	amt_t			last_amount;
 	char			reference[TRANSACT_REF_FIELD_LEN];
 	char			description[TRANSACT_DESCRIPT_FIELD_LEN];
+
+	int			due_slot;					/**< The order's position in the due heap, or -1 if not in the heap. */
 };
 
 
@@ -119,6 +122,28 @@ struct sorder_block {
 	 * The number of standing orders defined in the file.
 	 */
 	sorder_t		sorder_count;
+
+	/**
+	 * A binary min-heap of the active standing orders, keyed on their
+	 * adjusted next dates, so that the next order to fall due can be
+	 * found without scanning them all.
+	 */
+	sorder_t		*due;
+
+	/**
+	 * The number of standing orders in the due heap.
+	 */
+	int			due_count;
+
+	/**
+	 * The number of entries allocated in the due heap.
+	 */
+	int			due_size;
+
+	/**
+	 * TRUE if the due heap is up to date; FALSE if it must be rebuilt.
+	 */
+	osbool			due_valid;
 };
 
 /* Static Function Prototypes. */
@@ -130,6 +155,19 @@ static sorder_t			sorder_add(struct file_block *file);
 static osbool			sorder_delete(struct file_block *file, sorder_t sorder);
 
 static enum date_adjust		sorder_get_date_adjustment(enum transact_flags flags);
+static int			sorder_find_window_total(struct sorder *order, date_t from, date_t to, amt_t *total);
+static void			sorder_add_occurrence(struct file_block *file, sorder_t order, tran_t transaction);
+static int			sorder_count_due_occurrences(struct sorder_block *windat, date_t date);
+static int			sorder_count_due_from_slot(struct sorder_block *windat, int slot, date_t date);
+static int			sorder_count_order_occurrences(struct sorder *order, date_t date);
+
+static sorder_t			sorder_due_peek(struct sorder_block *windat);
+static void			sorder_due_update(struct sorder_block *windat, sorder_t sorder);
+static osbool			sorder_due_rebuild(struct sorder_block *windat);
+static void			sorder_due_sift_up(struct sorder_block *windat, int slot);
+static void			sorder_due_sift_down(struct sorder_block *windat, int slot);
+static osbool			sorder_due_before(struct sorder_block *windat, sorder_t first, sorder_t second);
+static void			sorder_due_place(struct sorder_block *windat, int slot, sorder_t sorder);
 
 
 /**
@@ -173,6 +211,11 @@ struct sorder_block *sorder_create_instance(struct file_block *file)
 	new->sorders = NULL;
 	new->sorder_count = 0;
 
+	new->due = NULL;
+	new->due_count = 0;
+	new->due_size = 0;
+	new->due_valid = FALSE;
+
 	/* Initialise the standing order window. */
 
 	new->sorder_window = sorder_list_window_create_instance(new);
@@ -208,6 +251,9 @@ void sorder_delete_instance(struct sorder_block *windat)
 	if (windat->sorders != NULL)
 		flexutils_free((void **) &(windat->sorders));
 
+	if (windat->due != NULL)
+		heap_free(windat->due);
+
 	heap_free(windat);
 }
 
@@ -408,6 +454,9 @@ static osbool sorder_process_edit_window(void *parent, struct sorder_dialogue_da
 
 	/* Get the from and to fields. */
 
+	account_change_usage(windat->file, windat->sorders[content->sorder].from, content->from);
+	account_change_usage(windat->file, windat->sorders[content->sorder].to, content->to);
+
 	windat->sorders[content->sorder].from = content->from;
 	windat->sorders[content->sorder].to = content->to;
 
@@ -422,6 +471,8 @@ static osbool sorder_process_edit_window(void *parent, struct sorder_dialogue_da
 	string_copy(windat->sorders[content->sorder].reference, content->reference, TRANSACT_REF_FIELD_LEN);
 	string_copy(windat->sorders[content->sorder].description, content->description, TRANSACT_DESCRIPT_FIELD_LEN);
 
+	sorder_due_update(windat, content->sorder);
+
 	/* Update the display. */
 
 	if (config_opt_read("AutoSortSOrders"))
@@ -465,6 +516,11 @@ static osbool sorder_stop_from_edit_window(struct sorder_block *windat, struct s
 	windat->sorders[content->sorder].adjusted_next_date = NULL_DATE;
 	windat->sorders[content->sorder].left = 0;
 
+	sorder_due_update(windat, content->sorder);
+
+	forecast_invalidate_account(windat->file, windat->sorders[content->sorder].from);
+	forecast_invalidate_account(windat->file, windat->sorders[content->sorder].to);
+
 	/* Free the standing order edit window's contents. */
 
 	content->active = FALSE;
@@ -539,6 +595,8 @@ static sorder_t sorder_add(struct file_block *file)
 	*file->sorders->sorders[new].reference = '\0';
 	*file->sorders->sorders[new].description = '\0';
 
+	file->sorders->sorders[new].due_slot = -1;
+
 	sorder_list_window_add_sorder(file->sorders->sorder_window, new);
 
 	file_set_data_integrity(file, TRUE);
@@ -562,6 +620,12 @@ static osbool sorder_delete(struct file_block *file, sorder_t sorder)
 
 	/* Delete the order */
 
+	account_change_usage(file, file->sorders->sorders[sorder].from, NULL_ACCOUNT);
+	account_change_usage(file, file->sorders->sorders[sorder].to, NULL_ACCOUNT);
+
+	forecast_invalidate_account(file, file->sorders->sorders[sorder].from);
+	forecast_invalidate_account(file, file->sorders->sorders[sorder].to);
+
 	if (!flexutils_delete_object((void **) &(file->sorders->sorders), sizeof(struct sorder), sorder)) {
 		error_msgs_report_error("BadDelete");
 		return FALSE;
@@ -569,6 +633,12 @@ static osbool sorder_delete(struct file_block *file, sorder_t sorder)
 
 	file->sorders->sorder_count--;
 
+	/* The orders above the deleted one have moved down, so the heap
+	 * will need to be rebuilt before it is next used.
+	 */
+
+	file->sorders->due_valid = FALSE;
+
 	if (!sorder_list_window_delete_sorder(file->sorders->sorder_window, sorder)) {
 		error_msgs_report_error("BadDelete");
 		return FALSE;
@@ -588,15 +658,55 @@ static osbool sorder_delete(struct file_block *file, sorder_t sorder)
 
 void sorder_purge(struct file_block *file)
 {
-	int	i;
+	sorder_t	sorder, *remap, count, out = 0;
 
-	if (file == NULL || file->sorders == NULL)
+	if (file == NULL || file->sorders == NULL || file->sorders->sorder_count == 0)
 		return;
 
-	for (i = 0; i < file->sorders->sorder_count; i++) {
-		if (file->sorders->sorders[i].adjusted_next_date == NULL_DATE && sorder_delete(file, i))
-			i--; /* Account for the record having been deleted. */
+	count = file->sorders->sorder_count;
+
+	remap = heap_alloc(sizeof(sorder_t) * count);
+	if (remap == NULL) {
+		error_msgs_report_error("NoMemPurge");
+		return;
+	}
+
+	/* Close up the gaps left by the finished orders in a single pass,
+	 * keeping the remaining orders in the same order and recording the
+	 * new index of each old one.
+	 */
+
+	for (sorder = 0; sorder < count; sorder++) {
+		if (file->sorders->sorders[sorder].adjusted_next_date == NULL_DATE) {
+			account_change_usage(file, file->sorders->sorders[sorder].from, NULL_ACCOUNT);
+			account_change_usage(file, file->sorders->sorders[sorder].to, NULL_ACCOUNT);
+			remap[sorder] = NULL_SORDER;
+			continue;
+		}
+
+		if (out != sorder)
+			file->sorders->sorders[out] = file->sorders->sorders[sorder];
+
+		remap[sorder] = out++;
+	}
+
+	if (out < count) {
+		file->sorders->sorder_count = out;
+
+		/* The orders have moved, so the heap will need to be rebuilt
+		 * before it is next used.
+		 */
+
+		file->sorders->due_valid = FALSE;
+
+		if (!flexutils_resize((void **) &(file->sorders->sorders), sizeof(struct sorder), out) ||
+				!sorder_list_window_remap_sorders(file->sorders->sorder_window, remap, count))
+			error_msgs_report_error("BadDelete");
+
+		file_set_data_integrity(file, TRUE);
 	}
+
+	heap_free(remap);
 }
 
 
@@ -631,6 +741,23 @@ int sorder_get_count(struct file_block *file)
 }
 
 
+/**
+ * Find the standing order in a file which will next fall due.
+ *
+ * \param *file			The file to interrogate.
+ * \return			The next standing order due, or NULL_SORDER if
+ *				there are no active orders.
+ */
+
+sorder_t sorder_get_next_due(struct file_block *file)
+{
+	if (file == NULL || file->sorders == NULL)
+		return NULL_SORDER;
+
+	return sorder_due_peek(file->sorders);
+}
+
+
 /**
  * Return the file associated with a standing order instance.
  *
@@ -759,6 +886,54 @@ amt_t sorder_get_amount(struct file_block *file, sorder_t sorder, enum sorder_am
 }
 
 
+/**
+ * Find the date and amount of one of the outstanding occurrences of a
+ * standing order, without stepping through those which come before it.
+ *
+ * \param *file			The file containing the standing order.
+ * \param sorder		The standing order to interrogate.
+ * \param occurrence		The occurrence to find, counting the next one
+ *				due as 0.
+ * \param *amount		Pointer to a variable to take the amount of the
+ *				occurrence, or NULL.
+ * \return			The date of the occurrence, or NULL_DATE if the
+ *				order has no such occurrence outstanding.
+ */
+
+date_t sorder_get_occurrence(struct file_block *file, sorder_t sorder, int occurrence, amt_t *amount)
+{
+	struct sorder	*order;
+
+	if (amount != NULL)
+		*amount = 0;
+
+	if (file == NULL || file->sorders == NULL || !sorder_valid(file->sorders, sorder))
+		return NULL_DATE;
+
+	order = file->sorders->sorders + sorder;
+
+	if (order->adjusted_next_date == NULL_DATE || occurrence < 0 || occurrence >= order->left)
+		return NULL_DATE;
+
+	/* The amounts follow the same rules as sorder_process(). */
+
+	if (amount != NULL) {
+		if (occurrence == 0 && order->left == order->number)
+			*amount = order->first_amount;
+		else if (occurrence == order->left - 1)
+			*amount = order->last_amount;
+		else
+			*amount = order->normal_amount;
+	}
+
+	if (occurrence == 0)
+		return order->adjusted_next_date;
+
+	return date_find_occurrence(order->raw_next_date, order->period_unit, order->period,
+			occurrence, sorder_get_date_adjustment(order->flags));
+}
+
+
 /**
  * Return a date associated with a standing order.
  *
@@ -899,11 +1074,11 @@ char *sorder_get_description(struct file_block *file, sorder_t sorder, char *buf
 
 void sorder_process(struct file_block *file)
 {
-	unsigned int	today;
+	date_t		today;
 	sorder_t	order;
-	amt_t		amount;
+	tran_t		first, transaction;
+	int		count, added;
 	osbool		changed;
-	char		ref[TRANSACT_REF_FIELD_LEN], desc[TRANSACT_DESCRIPT_FIELD_LEN];
 
 	if (file == NULL || file->sorders == NULL)
 		return;
@@ -915,62 +1090,56 @@ void sorder_process(struct file_block *file)
 	today = date_today();
 	changed = FALSE;
 
-	for (order = 0; order < file->sorders->sorder_count; order++) {
-		#ifdef DEBUG
-		debug_printf ("Processing order %d...", order);
-		#endif
-
-		/* While the next date for the standing order is today or before today, process it. */
+	/* Process the orders as a batch, so that the transaction window
+	 * and account totals are only updated once at the end.
+	 */
 
-		while (file->sorders->sorders[order].adjusted_next_date!= NULL_DATE && file->sorders->sorders[order].adjusted_next_date <= today) {
-			/* Action the standing order. */
+	file_begin_batch(file);
 
-			if (file->sorders->sorders[order].left == file->sorders->sorders[order].number)
-				amount = file->sorders->sorders[order].first_amount;
-			else if (file->sorders->sorders[order].left == 1)
-				amount = file->sorders->sorders[order].last_amount;
-			else
-				amount = file->sorders->sorders[order].normal_amount;
+	/* Count the occurrences which have fallen due across all of the
+	 * orders, so that space can be made for their transactions in one go.
+	 */
 
-			/* Reference and description are copied out of the block first as pointers are passed in to transact_add_raw_entry()
-			 * and the act of adding the transaction will move the flex block and invalidate those pointers before they
-			 * get used.
-			 */
+	count = sorder_count_due_occurrences(file->sorders, today);
+	first = (count > 0) ? transact_add_raw_entries(file, count) : NULL_TRANSACTION;
+	added = 0;
 
-			string_copy(ref, file->sorders->sorders[order].reference, TRANSACT_REF_FIELD_LEN);
-			string_copy(desc, file->sorders->sorders[order].description, TRANSACT_DESCRIPT_FIELD_LEN);
+	/* Take orders from the due heap one occurrence at a time until the
+	 * next one isn't due yet, so that the transactions are created in
+	 * date order. If space couldn't be reserved, or the count falls short,
+	 * any further transactions are added individually.
+	 */
 
-			transact_add_raw_entry(file, file->sorders->sorders[order].adjusted_next_date,
-					file->sorders->sorders[order].from, file->sorders->sorders[order].to,
-					file->sorders->sorders[order].flags & (TRANS_REC_FROM | TRANS_REC_TO), amount, ref, desc);
+	while ((order = sorder_due_peek(file->sorders)) != NULL_SORDER && file->sorders->sorders[order].adjusted_next_date <= today) {
+		#ifdef DEBUG
+		debug_printf ("Processing order %d...", order);
+		#endif
 
-			#ifdef DEBUG
-			debug_printf("Adding SO, ref '%s', desc '%s'...", file->sorders->sorders[order].reference, file->sorders->sorders[order].description);
-			#endif
+		transaction = (first != NULL_TRANSACTION && added < count) ? first + added++ : NULL_TRANSACTION;
 
-			changed = TRUE;
+		sorder_add_occurrence(file, order, transaction);
 
-			/* Decrement the outstanding orders. */
+		sorder_due_update(file->sorders, order);
 
-			file->sorders->sorders[order].left--;
+		changed = TRUE;
+	}
 
-			/* If there are outstanding orders to carry out, work out the next date and remember that. */
+	/* Merge the new transactions into the existing ones, which avoids a
+	 * full sort of the file. Any space which wasn't used is left blank at
+	 * the end of the file, and can be stripped off.
+	 */
 
-			if (file->sorders->sorders[order].left > 0) {
-				file->sorders->sorders[order].raw_next_date = date_add_period(file->sorders->sorders[order].raw_next_date,
-						file->sorders->sorders[order].period_unit, file->sorders->sorders[order].period);
+	if (first != NULL_TRANSACTION) {
+		transact_merge_raw_entries(file, first);
 
-				file->sorders->sorders[order].adjusted_next_date = date_find_working_day(file->sorders->sorders[order].raw_next_date,
-						sorder_get_date_adjustment(file->sorders->sorders[order].flags));
-			} else {
-				file->sorders->sorders[order].adjusted_next_date = NULL_DATE;
-			}
+		if (added < count)
+			transact_strip_blanks_from_end(file);
+	}
 
-			/* Redraw the standing order in the standing order window. */
+	/* Redraw the standing order window. */
 
-			sorder_list_window_redraw(file->sorders->sorder_window, order, TRUE);
-		}
-	}
+	if (changed)
+		sorder_redraw_all(file);
 
 	/* Update the trial values for the file. */
 
@@ -992,6 +1161,151 @@ void sorder_process(struct file_block *file)
 
 		accview_rebuild_all(file);
 	}
+
+	file_commit_batch(file);
+}
+
+
+/**
+ * Action the next occurrence of a standing order, adding its transaction to
+ * the file and moving the order on to its following date.
+ *
+ * \param *file			The file containing the order.
+ * \param order			The order to action.
+ * \param transaction		A transaction already created to take the
+ *				occurrence, or NULL_TRANSACTION to add one.
+ */
+
+static void sorder_add_occurrence(struct file_block *file, sorder_t order, tran_t transaction)
+{
+	amt_t	amount;
+	char	ref[TRANSACT_REF_FIELD_LEN], desc[TRANSACT_DESCRIPT_FIELD_LEN];
+
+	if (file->sorders->sorders[order].left == file->sorders->sorders[order].number)
+		amount = file->sorders->sorders[order].first_amount;
+	else if (file->sorders->sorders[order].left == 1)
+		amount = file->sorders->sorders[order].last_amount;
+	else
+		amount = file->sorders->sorders[order].normal_amount;
+
+	/* Reference and description are copied out of the block first as pointers are passed in to transact_add_raw_entry()
+	 * and the act of adding the transaction will move the flex block and invalidate those pointers before they
+	 * get used.
+	 */
+
+	string_copy(ref, file->sorders->sorders[order].reference, TRANSACT_REF_FIELD_LEN);
+	string_copy(desc, file->sorders->sorders[order].description, TRANSACT_DESCRIPT_FIELD_LEN);
+
+	if (transaction != NULL_TRANSACTION)
+		transact_set_raw_entry(file, transaction, file->sorders->sorders[order].adjusted_next_date,
+				file->sorders->sorders[order].from, file->sorders->sorders[order].to,
+				file->sorders->sorders[order].flags & (TRANS_REC_FROM | TRANS_REC_TO), amount, ref, desc);
+	else
+		transact_add_raw_entry(file, file->sorders->sorders[order].adjusted_next_date,
+				file->sorders->sorders[order].from, file->sorders->sorders[order].to,
+				file->sorders->sorders[order].flags & (TRANS_REC_FROM | TRANS_REC_TO), amount, ref, desc);
+
+	#ifdef DEBUG
+	debug_printf("Adding SO, ref '%s', desc '%s'...", file->sorders->sorders[order].reference, file->sorders->sorders[order].description);
+	#endif
+
+	/* Decrement the outstanding orders. */
+
+	file->sorders->sorders[order].left--;
+
+	/* If there are outstanding orders to carry out, work out the next date and remember that. */
+
+	if (file->sorders->sorders[order].left > 0) {
+		file->sorders->sorders[order].raw_next_date = date_add_period(file->sorders->sorders[order].raw_next_date,
+				file->sorders->sorders[order].period_unit, file->sorders->sorders[order].period);
+
+		file->sorders->sorders[order].adjusted_next_date = date_find_working_day(file->sorders->sorders[order].raw_next_date,
+				sorder_get_date_adjustment(file->sorders->sorders[order].flags));
+	} else {
+		file->sorders->sorders[order].adjusted_next_date = NULL_DATE;
+	}
+}
+
+
+/**
+ * Count the occurrences of all of the standing orders in an instance which
+ * fall due on or before a given date.
+ *
+ * \param *windat		The standing order instance to count.
+ * \param date			The date to count up to, inclusive.
+ * \return			The number of occurrences due.
+ */
+
+static int sorder_count_due_occurrences(struct sorder_block *windat, date_t date)
+{
+	sorder_t	sorder;
+	int		count;
+
+	/* Make sure that the due heap is up to date, and if it is, only visit
+	 * the part of it holding the orders which are due.
+	 */
+
+	if (sorder_due_peek(windat) == NULL_SORDER)
+		return 0;
+
+	if (windat->due_valid)
+		return sorder_count_due_from_slot(windat, 0, date);
+
+	count = 0;
+
+	for (sorder = 0; sorder < windat->sorder_count; sorder++)
+		count += sorder_count_order_occurrences(windat->sorders + sorder, date);
+
+	return count;
+}
+
+
+/**
+ * Count the occurrences falling due on or before a given date for the
+ * standing orders in the due heap, starting from a given slot and working
+ * down. As the heap is ordered by date, the search stops as soon as an order
+ * is found which isn't yet due.
+ *
+ * \param *windat		The standing order instance to count.
+ * \param slot			The heap slot to start from.
+ * \param date			The date to count up to, inclusive.
+ * \return			The number of occurrences due.
+ */
+
+static int sorder_count_due_from_slot(struct sorder_block *windat, int slot, date_t date)
+{
+	struct sorder	*order;
+
+	if (slot >= windat->due_count)
+		return 0;
+
+	order = windat->sorders + windat->due[slot];
+
+	if (order->adjusted_next_date > date)
+		return 0;
+
+	return sorder_count_order_occurrences(order, date) +
+			sorder_count_due_from_slot(windat, 2 * slot + 1, date) +
+			sorder_count_due_from_slot(windat, 2 * slot + 2, date);
+}
+
+
+/**
+ * Count the outstanding occurrences of a standing order which fall due on or
+ * before a given date.
+ *
+ * \param *order		The order to count.
+ * \param date			The date to count up to, inclusive.
+ * \return			The number of occurrences due.
+ */
+
+static int sorder_count_order_occurrences(struct sorder *order, date_t date)
+{
+	if (order == NULL || order->adjusted_next_date == NULL_DATE || order->adjusted_next_date > date || order->left <= 0)
+		return 0;
+
+	return date_count_occurrences(order->raw_next_date, order->period_unit, order->period,
+			sorder_get_date_adjustment(order->flags), order->left, date);
 }
 
 
@@ -1004,9 +1318,9 @@ void sorder_process(struct file_block *file)
 
 void sorder_trial(struct file_block *file)
 {
-	unsigned int	trial_date, raw_next_date, adjusted_next_date;
+	date_t		trial_date;
 	sorder_t	order;
-	int		amount, left;
+	amt_t		amount;
 
 	#ifdef DEBUG
 	debug_printf("\\YStanding Order trialling");
@@ -1020,52 +1334,23 @@ void sorder_trial(struct file_block *file)
 
 	account_zero_sorder_trial(file);
 
-	/* Process the standing orders. */
+	/* Process the standing orders, totalling the occurrences of each which
+	 * fall due on or before the trial date in one go.
+	 */
 
 	for (order = 0; order < file->sorders->sorder_count; order++) {
+		if (sorder_find_window_total(file->sorders->sorders + order, NULL_DATE, trial_date, &amount) == 0)
+			continue;
+
 		#ifdef DEBUG
-		debug_printf("Trialling order %d...", order);
+		debug_printf("Adding trial SO, ref '%s', desc '%s'...", file->sorders->sorders[order].reference, file->sorders->sorders[order].description);
 		#endif
 
-		/* While the next date for the standing order is today or before today, process it. */
+		if (file->sorders->sorders[order].from != NULL_ACCOUNT)
+			account_adjust_sorder_trial(file, file->sorders->sorders[order].from, -amount);
 
-		raw_next_date = file->sorders->sorders[order].raw_next_date;
-		adjusted_next_date = file->sorders->sorders[order].adjusted_next_date;
-		left = file->sorders->sorders[order].left;
-
-		while (adjusted_next_date!= NULL_DATE && adjusted_next_date <= trial_date) {
-			/* Action the standing order. */
-
-			if (left == file->sorders->sorders[order].number)
-				amount = file->sorders->sorders[order].first_amount;
-			else if (file->sorders->sorders[order].left == 1)
-				amount = file->sorders->sorders[order].last_amount;
-			else
-				amount = file->sorders->sorders[order].normal_amount;
-
-			#ifdef DEBUG
-			debug_printf("Adding trial SO, ref '%s', desc '%s'...", file->sorders->sorders[order].reference, file->sorders->sorders[order].description);
-			#endif
-
-			if (file->sorders->sorders[order].from != NULL_ACCOUNT)
-				account_adjust_sorder_trial(file, file->sorders->sorders[order].from, -amount);
-
-			if (file->sorders->sorders[order].to != NULL_ACCOUNT)
-				account_adjust_sorder_trial(file, file->sorders->sorders[order].to, +amount);
-
-			/* Decrement the outstanding orders. */
-
-			left--;
-
-			/* If there are outstanding orders to carry out, work out the next date and remember that. */
-
-			if (left > 0) {
-				raw_next_date = date_add_period(raw_next_date, file->sorders->sorders[order].period_unit, file->sorders->sorders[order].period);
-				adjusted_next_date = date_find_working_day(raw_next_date, sorder_get_date_adjustment(file->sorders->sorders[order].flags));
-			} else {
-				adjusted_next_date = NULL_DATE;
-			}
-		}
+		if (file->sorders->sorders[order].to != NULL_ACCOUNT)
+			account_adjust_sorder_trial(file, file->sorders->sorders[order].to, +amount);
 	}
 }
 
@@ -1179,6 +1464,7 @@ osbool sorder_read_file(struct file_block *file, struct filing_block *in)
 			file->sorders->sorders[sorder].last_amount = currency_get_currency_field(in);
 			*(file->sorders->sorders[sorder].reference) = '\0';
 			*(file->sorders->sorders[sorder].description) = '\0';
+			file->sorders->sorders[sorder].due_slot = -1;
 		} else if (sorder != NULL_SORDER && filing_test_token(in, "Ref")) {
 			filing_get_text_value(in, file->sorders->sorders[sorder].reference, TRANSACT_REF_FIELD_LEN);
 		} else if (sorder != NULL_SORDER && filing_test_token(in, "Desc")) {
@@ -1195,6 +1481,10 @@ osbool sorder_read_file(struct file_block *file, struct filing_block *in)
 		return FALSE;
 	}
 
+	/* Build the due heap from the orders which have been loaded. */
+
+	file->sorders->due_valid = FALSE;
+
 	/* Initialise the standing order list window contents. */
 
 	if (!sorder_list_window_initialise_entries(file->sorders->sorder_window, file->sorders->sorder_count)) {
@@ -1206,30 +1496,6 @@ osbool sorder_read_file(struct file_block *file, struct filing_block *in)
 }
 
 
-/**
- * Check the standing orders in a file to see if the given account is used
- * in any of them.
- *
- * \param *file			The file to check.
- * \param account		The account to search for.
- * \return			TRUE if the account is used; FALSE if not.
- */
-
-osbool sorder_check_account(struct file_block *file, int account)
-{
-	int		i;
-
-	if (file == NULL || file->sorders == NULL)
-		return FALSE;
-
-	for (i = 0; i < file->sorders->sorder_count; i++)
-		if (file->sorders->sorders[i].from == account || file->sorders->sorders[i].to == account)
-			return TRUE;
-
-	return FALSE;
-}
-
-
 /**
  * Return a standing order date adjustment value based on the standing order
  * flags.
@@ -1248,3 +1514,291 @@ static enum date_adjust sorder_get_date_adjustment(enum transact_flags flags)
 		return DATE_ADJUST_NONE;
 }
 
+
+/**
+ * Find the number of outstanding occurrences of a standing order which fall
+ * due within a range of dates, and the total amount that they will transfer.
+ *
+ * \param *order		The standing order to examine.
+ * \param from			The first date in the range, or NULL_DATE
+ *				to start from the next occurrence.
+ * \param to			The last date in the range, or NULL_DATE to
+ *				include all of the outstanding occurrences.
+ * \param *total		Pointer to a variable to take the total amount.
+ * \return			The number of occurrences in the range.
+ */
+
+static int sorder_find_window_total(struct sorder *order, date_t from, date_t to, amt_t *total)
+{
+	enum date_adjust	adjust;
+	int			first, last;
+
+	*total = 0;
+
+	if (order == NULL || order->adjusted_next_date == NULL_DATE || order->left <= 0)
+		return 0;
+
+	adjust = sorder_get_date_adjustment(order->flags);
+
+	/* The occurrences are counted from the next one due, so those in the
+	 * range run from first up to, but not including, last.
+	 */
+
+	first = (from == NULL_DATE) ? 0 : date_count_occurrences(order->raw_next_date, order->period_unit,
+			order->period, adjust, order->left, date_add_period(from, DATE_PERIOD_DAYS, -1));
+	last = date_count_occurrences(order->raw_next_date, order->period_unit, order->period, adjust, order->left, to);
+
+	if (last <= first)
+		return 0;
+
+	*total = (last - first) * order->normal_amount;
+
+	/* The first of all the orders takes the first amount, and the last
+	 * one takes the last amount unless it was also the first.
+	 */
+
+	if (first == 0 && order->left == order->number)
+		*total += order->first_amount - order->normal_amount;
+
+	if (last == order->left && (order->left > 1 || order->left != order->number))
+		*total += order->last_amount - order->normal_amount;
+
+	return last - first;
+}
+
+
+/**
+ * Return the standing order at the top of the due heap, rebuilding the heap
+ * first if required. If the heap can't be built, the orders are scanned.
+ *
+ * \param *windat		The standing order instance to query.
+ * \return			The next order due, or NULL_SORDER if none.
+ */
+
+static sorder_t sorder_due_peek(struct sorder_block *windat)
+{
+	sorder_t	sorder, next;
+
+	if (windat == NULL)
+		return NULL_SORDER;
+
+	if (windat->due_valid || sorder_due_rebuild(windat))
+		return (windat->due_count > 0) ? windat->due[0] : NULL_SORDER;
+
+	next = NULL_SORDER;
+
+	for (sorder = 0; sorder < windat->sorder_count; sorder++) {
+		if (windat->sorders[sorder].adjusted_next_date != NULL_DATE &&
+				(next == NULL_SORDER || sorder_due_before(windat, sorder, next)))
+			next = sorder;
+	}
+
+	return next;
+}
+
+
+/**
+ * Update the position of a standing order in the due heap, following a
+ * change to its next date.
+ *
+ * \param *windat		The standing order instance holding the order.
+ * \param sorder		The order which has changed.
+ */
+
+static void sorder_due_update(struct sorder_block *windat, sorder_t sorder)
+{
+	sorder_t	last;
+	int		slot;
+
+	if (windat == NULL || !windat->due_valid || sorder == NULL_SORDER || sorder >= windat->sorder_count)
+		return;
+
+	slot = windat->sorders[sorder].due_slot;
+
+	/* An order which is no longer active leaves the heap, with the last
+	 * entry taking its place.
+	 */
+
+	if (windat->sorders[sorder].adjusted_next_date == NULL_DATE) {
+		if (slot == -1)
+			return;
+
+		windat->sorders[sorder].due_slot = -1;
+
+		last = windat->due[--windat->due_count];
+
+		if (slot < windat->due_count) {
+			sorder_due_place(windat, slot, last);
+			sorder_due_sift_up(windat, slot);
+			sorder_due_sift_down(windat, windat->sorders[last].due_slot);
+		}
+
+		return;
+	}
+
+	/* An order which has become active joins the end of the heap. If
+	 * there's no room, the heap is rebuilt from scratch later on.
+	 */
+
+	if (slot == -1) {
+		if (windat->due_count >= windat->due_size) {
+			windat->due_valid = FALSE;
+			return;
+		}
+
+		slot = windat->due_count++;
+		sorder_due_place(windat, slot, sorder);
+	}
+
+	sorder_due_sift_up(windat, slot);
+	sorder_due_sift_down(windat, windat->sorders[sorder].due_slot);
+}
+
+
+/**
+ * Rebuild the due heap for a standing order instance from scratch.
+ *
+ * \param *windat		The standing order instance to rebuild.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+static osbool sorder_due_rebuild(struct sorder_block *windat)
+{
+	sorder_t	*due;
+	sorder_t	sorder;
+	int		slot;
+
+	/* Allocate space for every order, so that orders can become active
+	 * without the heap needing to grow.
+	 */
+
+	if (windat->due_size < windat->sorder_count || windat->due == NULL) {
+		if (windat->due == NULL)
+			due = heap_alloc(sizeof(sorder_t) * (windat->sorder_count + 1));
+		else
+			due = heap_extend(windat->due, sizeof(sorder_t) * (windat->sorder_count + 1));
+
+		if (due == NULL)
+			return FALSE;
+
+		windat->due = due;
+		windat->due_size = windat->sorder_count + 1;
+	}
+
+	windat->due_count = 0;
+
+	for (sorder = 0; sorder < windat->sorder_count; sorder++) {
+		if (windat->sorders[sorder].adjusted_next_date != NULL_DATE) {
+			sorder_due_place(windat, windat->due_count++, sorder);
+		} else {
+			windat->sorders[sorder].due_slot = -1;
+		}
+	}
+
+	for (slot = windat->due_count / 2 - 1; slot >= 0; slot--)
+		sorder_due_sift_down(windat, slot);
+
+	windat->due_valid = TRUE;
+
+	return TRUE;
+}
+
+
+/**
+ * Move an entry in the due heap up towards the root, until its parent is
+ * due before it.
+ *
+ * \param *windat		The standing order instance to update.
+ * \param slot			The heap slot to move.
+ */
+
+static void sorder_due_sift_up(struct sorder_block *windat, int slot)
+{
+	sorder_t	sorder;
+	int		parent;
+
+	sorder = windat->due[slot];
+
+	while (slot > 0) {
+		parent = (slot - 1) / 2;
+
+		if (!sorder_due_before(windat, sorder, windat->due[parent]))
+			break;
+
+		sorder_due_place(windat, slot, windat->due[parent]);
+		slot = parent;
+	}
+
+	sorder_due_place(windat, slot, sorder);
+}
+
+
+/**
+ * Move an entry in the due heap down away from the root, until both of its
+ * children are due after it.
+ *
+ * \param *windat		The standing order instance to update.
+ * \param slot			The heap slot to move.
+ */
+
+static void sorder_due_sift_down(struct sorder_block *windat, int slot)
+{
+	sorder_t	sorder;
+	int		child;
+
+	sorder = windat->due[slot];
+
+	while ((child = 2 * slot + 1) < windat->due_count) {
+		if (child + 1 < windat->due_count && sorder_due_before(windat, windat->due[child + 1], windat->due[child]))
+			child++;
+
+		if (!sorder_due_before(windat, windat->due[child], sorder))
+			break;
+
+		sorder_due_place(windat, slot, windat->due[child]);
+		slot = child;
+	}
+
+	sorder_due_place(windat, slot, sorder);
+}
+
+
+/**
+ * Test whether one standing order falls due before another. Orders due on
+ * the same day are taken in the order in which they are held.
+ *
+ * \param *windat		The standing order instance holding the orders.
+ * \param first			The first order to compare.
+ * \param second		The second order to compare.
+ * \return			TRUE if the first order is due before the second.
+ */
+
+static osbool sorder_due_before(struct sorder_block *windat, sorder_t first, sorder_t second)
+{
+	date_t	first_date, second_date;
+
+	first_date = windat->sorders[first].adjusted_next_date;
+	second_date = windat->sorders[second].adjusted_next_date;
+
+	if (first_date != second_date)
+		return (first_date < second_date) ? TRUE : FALSE;
+
+	return (first < second) ? TRUE : FALSE;
+}
+
+
+/**
+ * Place a standing order into a slot in the due heap, recording the slot
+ * in the order.
+ *
+ * \param *windat		The standing order instance to update.
+ * \param slot			The heap slot to fill.
+ * \param sorder		The order to place in the slot.
+ */
+
+static void sorder_due_place(struct sorder_block *windat, int slot, sorder_t sorder)
+{
+	windat->due[slot] = sorder;
+	windat->sorders[sorder].due_slot = slot;
+}
+
@@ -180,6 +180,17 @@ sorder_t sorder_get_sorder_from_line(struct file_block *file, int line);
 int sorder_get_count(struct file_block *file);
 
 
+/**
+ * Find the standing order in a file which will next fall due.
+ *
+ * \param *file			The file to interrogate.
+ * \return			The next standing order due, or NULL_SORDER if
+ *				there are no active orders.
+ */
+
+sorder_t sorder_get_next_due(struct file_block *file);
+
+
 /**
  * Return the file associated with a standing order instance.
  *
@@ -257,6 +268,23 @@ enum date_period sorder_get_period_unit(struct file_block *file, sorder_t sorder
 amt_t sorder_get_amount(struct file_block *file, sorder_t sorder, enum sorder_amount type);
 
 
+/**
+ * Find the date and amount of one of the outstanding occurrences of a
+ * standing order, without stepping through those which come before it.
+ *
+ * \param *file			The file containing the standing order.
+ * \param sorder		The standing order to interrogate.
+ * \param occurrence		The occurrence to find, counting the next one
+ *				due as 0.
+ * \param *amount		Pointer to a variable to take the amount of the
+ *				occurrence, or NULL.
+ * \return			The date of the occurrence, or NULL_DATE if the
+ *				order has no such occurrence outstanding.
+ */
+
+date_t sorder_get_occurrence(struct file_block *file, sorder_t sorder, int occurrence, amt_t *amount);
+
+
 /**
  * Return a date associated with a standing order.
  *
@@ -365,17 +393,5 @@ void sorder_write_file(struct file_block *file, FILE *f);
 
 osbool sorder_read_file(struct file_block *file, struct filing_block *in);
 
-
-/**
- * Check the standing orders in a file to see if the given account is used
- * in any of them.
- *
- * \param *file			The file to check.
- * \param account		The account to search for.
- * \return			TRUE if the account is used; FALSE if not.
- */
-
-osbool sorder_check_account(struct file_block *file, int account);
-
 #endif
 
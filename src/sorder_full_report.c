@@ -73,6 +73,10 @@
 #define SORDER_REPORT_BUF2_LENGTH 32
 #define SORDER_REPORT_BUF3_LENGTH 32
 
+/* Static Function Prototypes. */
+
+static void sorder_full_report_write_field(struct report *report, char *token, enum report_cell_flags flags, char *value);
+
 
 /**
  * Generate a report detailing all of the standing orders in a file.
@@ -89,18 +93,19 @@ void sorder_full_report(struct file_block *file)
 	date_t			next_date;
 	enum transact_flags	flags;
 	char			line[SORDER_REPORT_LINE_LENGTH], numbuf1[SORDER_REPORT_BUF1_LENGTH], numbuf2[SORDER_REPORT_BUF2_LENGTH], numbuf3[SORDER_REPORT_BUF3_LENGTH];
+	struct stringbuild_block	builder;
 
 	if (file == NULL || file->sorders == NULL)
 		return;
 
-	if (!stringbuild_initialise(line, SORDER_REPORT_LINE_LENGTH))
+	if (!stringbuild_initialise(&builder, line, SORDER_REPORT_LINE_LENGTH))
 		return;
 
 	msgs_lookup("SORWinT", line, SORDER_REPORT_LINE_LENGTH);
 	report = report_open(file, line, NULL);
 
 	if (report == NULL) {
-		stringbuild_cancel();
+		stringbuild_cancel(&builder);
 		return;
 	}
 
@@ -108,19 +113,19 @@ void sorder_full_report(struct file_block *file)
 
 	sorder_count = sorder_get_count(file);
 
-	stringbuild_reset();
-	stringbuild_add_message_param("SORTitle", file_get_leafname(file, NULL, 0), NULL, NULL, NULL);
-	stringbuild_report_line(report, 0);
+	stringbuild_reset(&builder);
+	stringbuild_add_message_param(&builder, "SORTitle", file_get_leafname(file, NULL, 0), NULL, NULL, NULL);
+	stringbuild_report_line(&builder, report, 0);
 
-	stringbuild_reset();
+	stringbuild_reset(&builder);
 	date_convert_to_string(date_today(), numbuf1, SORDER_REPORT_BUF1_LENGTH);
-	stringbuild_add_message_param("SORHeader", numbuf1, NULL, NULL, NULL);
-	stringbuild_report_line(report, 0);
+	stringbuild_add_message_param(&builder, "SORHeader", numbuf1, NULL, NULL, NULL);
+	stringbuild_report_line(&builder, report, 0);
 
-	stringbuild_reset();
+	stringbuild_reset(&builder);
 	string_printf(numbuf1, SORDER_REPORT_BUF1_LENGTH, "%d", sorder_count);
-	stringbuild_add_message_param("SORCount", numbuf1, NULL, NULL, NULL);
-	stringbuild_report_line(report, 0);
+	stringbuild_add_message_param(&builder, "SORCount", numbuf1, NULL, NULL, NULL);
+	stringbuild_report_line(&builder, report, 0);
 
 	/* Output the data for each of the standing orders in turn. */
 
@@ -129,65 +134,47 @@ void sorder_full_report(struct file_block *file)
 
 		sorder = sorder_get_sorder_from_line(file, i);
 
-		stringbuild_reset();
 		string_printf(numbuf1, SORDER_REPORT_BUF1_LENGTH, "%d", i + 1);
-		stringbuild_add_message_param("SORNumber", numbuf1, NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
-
-		stringbuild_reset();
-		stringbuild_add_message_param("SORFrom", account_get_name(file, sorder_get_from(file, sorder)), NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
+		report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_UNDERLINE, "SORNumber", numbuf1, NULL, NULL, NULL);
+		report_end_line(report);
 
-		stringbuild_reset();
-		stringbuild_add_message_param("SORTo", account_get_name(file, sorder_get_to(file, sorder)), NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
-
-		stringbuild_reset();
-		stringbuild_add_message_param("SORRef", sorder_get_reference(file, sorder, NULL, 0), NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
+		sorder_full_report_write_field(report, "SORFrom", REPORT_CELL_FLAGS_NONE, account_get_name(file, sorder_get_from(file, sorder)));
+		sorder_full_report_write_field(report, "SORTo", REPORT_CELL_FLAGS_NONE, account_get_name(file, sorder_get_to(file, sorder)));
+		sorder_full_report_write_field(report, "SORRef", REPORT_CELL_FLAGS_NONE, sorder_get_reference(file, sorder, NULL, 0));
 
 		normal_amount = sorder_get_amount(file, sorder, SORDER_AMOUNT_NORMAL);
 
-		stringbuild_reset();
 		currency_convert_to_string(normal_amount, numbuf1, SORDER_REPORT_BUF1_LENGTH);
-		stringbuild_add_message_param("SORAmount", numbuf1, NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
+		sorder_full_report_write_field(report, "SORAmount", REPORT_CELL_FLAGS_NUMERIC, numbuf1);
 
 		first_amount = sorder_get_amount(file, sorder, SORDER_AMOUNT_FIRST);
 
 		if (normal_amount != first_amount) {
-			stringbuild_reset();
 			currency_convert_to_string(first_amount, numbuf1, SORDER_REPORT_BUF1_LENGTH);
-			stringbuild_add_message_param("SORFirst", numbuf1, NULL, NULL, NULL);
-			stringbuild_report_line(report, 0);
+			sorder_full_report_write_field(report, "SORFirst", REPORT_CELL_FLAGS_NUMERIC, numbuf1);
 		}
 
 		last_amount = sorder_get_amount(file, sorder, SORDER_AMOUNT_LAST);
 
 		if (normal_amount != last_amount) {
-			stringbuild_reset();
 			currency_convert_to_string(last_amount, numbuf1, SORDER_REPORT_BUF1_LENGTH);
-			stringbuild_add_message_param("SORFirst", numbuf1, NULL, NULL, NULL);
-			stringbuild_report_line(report, 0);
+			sorder_full_report_write_field(report, "SORLast", REPORT_CELL_FLAGS_NUMERIC, numbuf1);
 		}
 
-		stringbuild_reset();
-		stringbuild_add_message_param("SORDesc", sorder_get_description(file, sorder, NULL, 0), NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
+		sorder_full_report_write_field(report, "SORDesc", REPORT_CELL_FLAGS_NONE, sorder_get_description(file, sorder, NULL, 0));
 
-		stringbuild_reset();
 		string_printf(numbuf1, SORDER_REPORT_BUF1_LENGTH, "%d", sorder_get_transactions(file, sorder, SORDER_TRANSACTIONS_TOTAL));
 		string_printf(numbuf2, SORDER_REPORT_BUF2_LENGTH, "%d", sorder_get_transactions(file, sorder, SORDER_TRANSACTIONS_DONE));
 		string_printf(numbuf3, SORDER_REPORT_BUF3_LENGTH, "%d", sorder_get_transactions(file, sorder, SORDER_TRANSACTIONS_LEFT));
-		stringbuild_add_message_param("SORCounts", numbuf1, numbuf2, numbuf3, NULL);
-		stringbuild_report_line(report, 0);
+		report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, "SORCounts", NULL, NULL, NULL, NULL);
+		report_add_message_cell(report, 1, REPORT_CELL_FLAGS_NONE, "SORCountsValue", numbuf1, numbuf2, numbuf3, NULL);
+		report_end_line(report);
 
-		stringbuild_reset();
 		date_convert_to_string(sorder_get_date(file, sorder, SORDER_DATE_START), numbuf1, SORDER_REPORT_BUF1_LENGTH);
-		stringbuild_add_message_param("SORStart", numbuf1, NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
+		sorder_full_report_write_field(report, "SORStart", REPORT_CELL_FLAGS_NONE, numbuf1);
 
-		stringbuild_reset();
 		string_printf(numbuf1, SORDER_REPORT_BUF1_LENGTH, "%d", sorder_get_period(file, sorder));
 		switch (sorder_get_period_unit(file, sorder)) {
 		case DATE_PERIOD_DAYS:
@@ -206,38 +193,53 @@ void sorder_full_report(struct file_block *file)
 			*numbuf2 = '\0';
 			break;
 		}
-		stringbuild_add_message_param("SOREvery", numbuf1, numbuf2, NULL, NULL);
-		stringbuild_report_line(report, 0);
+		report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+		report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, "SOREvery", NULL, NULL, NULL, NULL);
+		report_add_message_cell(report, 1, REPORT_CELL_FLAGS_NONE, "SOREveryValue", numbuf1, numbuf2, NULL, NULL);
+		report_end_line(report);
 
 		flags = sorder_get_flags(file, sorder);
 
-		if (flags & TRANS_SKIP_FORWARD) {
-			stringbuild_reset();
-			stringbuild_add_message("SORAvoidFwd");
-			stringbuild_report_line(report, 0);
-		} else if (flags & TRANS_SKIP_BACKWARD) {
-			stringbuild_reset();
-			stringbuild_add_message("SORAvoidBack");
-			stringbuild_report_line(report, 0);
+		if (flags & (TRANS_SKIP_FORWARD | TRANS_SKIP_BACKWARD)) {
+			report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+			report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT,
+					(flags & TRANS_SKIP_FORWARD) ? "SORAvoidFwd" : "SORAvoidBack", NULL, NULL, NULL, NULL);
+			report_end_line(report);
 		}
 
 		next_date = sorder_get_date(file, sorder, SORDER_DATE_ADJUSTED_NEXT);
 
-		stringbuild_reset();
 		if (next_date != NULL_DATE)
 			date_convert_to_string(next_date, numbuf1, SORDER_REPORT_BUF1_LENGTH);
 		else
 			msgs_lookup("SOrderStopped", numbuf1, SORDER_REPORT_BUF1_LENGTH);
-		stringbuild_add_message_param("SORNext", numbuf1, NULL, NULL, NULL);
-		stringbuild_report_line(report, 0);
+		sorder_full_report_write_field(report, "SORNext", REPORT_CELL_FLAGS_NONE, numbuf1);
 	}
 
 	/* Close the report. */
 
-	stringbuild_cancel();
+	stringbuild_cancel(&builder);
 
 	report_close(report);
 
 	hourglass_off();
 }
 
+
+/**
+ * Write a labelled field from a standing order to the full report.
+ *
+ * \param *report		The report to write to.
+ * \param *token		The message token for the field's label.
+ * \param flags			The flags to apply to the field's value.
+ * \param *value		The value to show in the field.
+ */
+
+static void sorder_full_report_write_field(struct report *report, char *token, enum report_cell_flags flags, char *value)
+{
+	report_begin_line(report, 0, REPORT_LINE_FLAGS_NONE);
+	report_add_message_cell(report, 0, REPORT_CELL_FLAGS_INDENT, token, NULL, NULL, NULL, NULL);
+	report_add_text_cell(report, 1, flags, value);
+	report_end_line(report);
+}
+
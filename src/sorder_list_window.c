@@ -76,6 +76,7 @@
 #include "file.h"
 #include "filing.h"
 #include "flexutils.h"
+#include "linecache.h"
 #include "print_dialogue.h"
 #include "sorder.h"
 #include "sorder_dialogue.h"
@@ -125,6 +126,7 @@
 #define SORDER_LIST_WINDOW_MENU_EXPTSV 4
 #define SORDER_LIST_WINDOW_MENU_PRINT 5
 #define SORDER_LIST_WINDOW_MENU_FULLREP 6
+#define SORDER_LIST_WINDOW_MENU_NEXTDUE 7
 
 /* Standing Order Sort Window icons. */
 
@@ -157,6 +159,12 @@
 
 #define SORDER_LIST_WINDOW_COLUMNS 10
 
+/**
+ * The number of lines of formatted text to cache for redraws.
+ */
+
+#define SORDER_LIST_WINDOW_CACHE_LINES 64
+
 /* The Standing Order List Window column map. */
 
 static struct column_map sorder_list_window_columns[SORDER_LIST_WINDOW_COLUMNS] = {
@@ -207,6 +215,43 @@ struct sorder_list_window_redraw {
 	sorder_t				sorder;
 };
 
+/**
+ * Standing Order List Window cached line text, held to avoid formatting
+ * the contents of each row every time that it is redrawn.
+ */
+
+struct sorder_list_window_cache {
+	/**
+	 * The ident of the From account.
+	 */
+	char					from_ident[ACCOUNT_IDENT_LEN];
+
+	/**
+	 * The name of the From account.
+	 */
+	char					from_name[ACCOUNT_NAME_LEN];
+
+	/**
+	 * The ident of the To account.
+	 */
+	char					to_ident[ACCOUNT_IDENT_LEN];
+
+	/**
+	 * The name of the To account.
+	 */
+	char					to_name[ACCOUNT_NAME_LEN];
+
+	/**
+	 * The formatted normal amount.
+	 */
+	char					amount[AMOUNT_FIELD_LEN];
+
+	/**
+	 * The formatted next date.
+	 */
+	char					next_date[DATE_FIELD_LEN];
+};
+
 /**
  * Standing Order List Window instance data structure.
  */
@@ -256,6 +301,12 @@ struct sorder_list_window {
 	 * Flex array holding the line data for the window.
 	 */
 	struct sorder_list_window_redraw	*line_data;
+
+	/**
+	 * Cache of formatted text for the lines in the window, keyed on
+	 * standing order number.
+	 */
+	struct linecache_block			*line_cache;
 };
 
 /**
@@ -399,6 +450,7 @@ struct sorder_list_window *sorder_list_window_create_instance(struct sorder_bloc
 
 	new->display_lines = 0;
 	new->line_data = NULL;
+	new->line_cache = NULL;
 
 	/* Initialise the window columns. */
 
@@ -426,6 +478,14 @@ struct sorder_list_window *sorder_list_window_create_instance(struct sorder_bloc
 		return NULL;
 	}
 
+	/* Set up the redraw text cache. */
+
+	new->line_cache = linecache_create(SORDER_LIST_WINDOW_CACHE_LINES, sizeof(struct sorder_list_window_cache));
+	if (new->line_cache == NULL) {
+		sorder_list_window_delete_instance(new);
+		return NULL;
+	}
+
 	return new;
 }
 
@@ -444,6 +504,8 @@ void sorder_list_window_delete_instance(struct sorder_list_window *windat)
 	if (windat->line_data != NULL)
 		flexutils_free((void **) &(windat->line_data));
 
+	linecache_destroy(windat->line_cache);
+
 	column_delete_instance(windat->columns);
 	sort_delete_instance(windat->sort);
 
@@ -592,6 +654,7 @@ static void sorder_list_window_delete(struct sorder_list_window *windat)
 	if (windat->sorder_window != NULL) {
 		ihelp_remove_window (windat->sorder_window);
 		event_delete_window(windat->sorder_window);
+		window_cancel_redraws(windat->sorder_window);
 		wimp_delete_window(windat->sorder_window);
 		windat->sorder_window = NULL;
 	}
@@ -787,6 +850,7 @@ static void sorder_list_window_menu_prepare_handler(wimp_w w, wimp_menu *menu, w
 	}
 
 	menus_shade_entry(sorder_list_window_menu, SORDER_LIST_WINDOW_MENU_EDIT, sorder_list_window_menu_line == -1);
+	menus_shade_entry(sorder_list_window_menu, SORDER_LIST_WINDOW_MENU_NEXTDUE, sorder_get_next_due(sorder_get_file(windat->instance)) == NULL_SORDER);
 
 	sorder_list_window_force_redraw(windat, sorder_list_window_menu_line, sorder_list_window_menu_line, wimp_ICON_WINDOW);
 }
@@ -837,6 +901,11 @@ static void sorder_list_window_menu_selection_handler(wimp_w w, wimp_menu *menu,
 	case SORDER_LIST_WINDOW_MENU_FULLREP:
 		sorder_full_report(file);
 		break;
+
+	case SORDER_LIST_WINDOW_MENU_NEXTDUE:
+		if (sorder_get_next_due(file) != NULL_SORDER)
+			sorder_open_edit_window(file, sorder_get_next_due(file), &pointer);
+		break;
 	}
 }
 
@@ -915,6 +984,7 @@ static void sorder_list_window_scroll_handler(wimp_scroll *scroll)
 static void sorder_list_window_window_redraw_handler(wimp_draw *redraw)
 {
 	struct sorder_list_window	*windat;
+	struct sorder_list_window_cache	*cache;
 	struct file_block		*file;
 	sorder_t			sorder;
 	acct_t				account;
@@ -922,7 +992,7 @@ static void sorder_list_window_window_redraw_handler(wimp_draw *redraw)
 	enum transact_flags		flags;
 	int				top, base, y, select;
 	char				icon_buffer[TRANSACT_DESCRIPT_FIELD_LEN]; /* Assumes descript is longest. */
-	osbool				more;
+	osbool				more, cached;
 
 	windat = event_get_window_user_data(redraw->w);
 	if (windat == NULL || windat->instance == NULL || windat->columns == NULL)
@@ -970,26 +1040,48 @@ static void sorder_list_window_window_redraw_handler(wimp_draw *redraw)
 			}
 
 			flags =  sorder_get_flags(file, sorder);
+			next_date = sorder_get_date(file, sorder, SORDER_DATE_ADJUSTED_NEXT);
 
-			/* From field */
+			/* Find the formatted text for the line, building it if it
+			 * isn't already in the cache.
+			 */
+
+			cache = linecache_find(windat->line_cache, sorder, &cached);
+			if (cache == NULL)
+				continue;
+
+			if (!cached) {
+				account = sorder_get_from(file, sorder);
+				string_copy(cache->from_ident, account_get_ident(file, account), ACCOUNT_IDENT_LEN);
+				string_copy(cache->from_name, account_get_name(file, account), ACCOUNT_NAME_LEN);
+
+				account = sorder_get_to(file, sorder);
+				string_copy(cache->to_ident, account_get_ident(file, account), ACCOUNT_IDENT_LEN);
+				string_copy(cache->to_name, account_get_name(file, account), ACCOUNT_NAME_LEN);
+
+				currency_convert_to_string(sorder_get_amount(file, sorder, SORDER_AMOUNT_NORMAL), cache->amount, AMOUNT_FIELD_LEN);
+
+				if (next_date != NULL_DATE)
+					date_convert_to_string(next_date, cache->next_date, DATE_FIELD_LEN);
+				else
+					*(cache->next_date) = '\0';
+			}
 
-			account = sorder_get_from(file, sorder);
+			/* From field */
 
-			window_plot_text_field(SORDER_LIST_WINDOW_FROM, account_get_ident(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(SORDER_LIST_WINDOW_FROM, cache->from_ident, wimp_COLOUR_BLACK);
 			window_plot_reconciled_field(SORDER_LIST_WINDOW_FROM_REC, (flags & TRANS_REC_FROM), wimp_COLOUR_BLACK);
-			window_plot_text_field(SORDER_LIST_WINDOW_FROM_NAME, account_get_name(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(SORDER_LIST_WINDOW_FROM_NAME, cache->from_name, wimp_COLOUR_BLACK);
 
 			/* To field */
 
-			account = sorder_get_to(file, sorder);
-
-			window_plot_text_field(SORDER_LIST_WINDOW_TO, account_get_ident(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(SORDER_LIST_WINDOW_TO, cache->to_ident, wimp_COLOUR_BLACK);
 			window_plot_reconciled_field(SORDER_LIST_WINDOW_TO_REC, (flags & TRANS_REC_TO), wimp_COLOUR_BLACK);
-			window_plot_text_field(SORDER_LIST_WINDOW_TO_NAME, account_get_name(file, account), wimp_COLOUR_BLACK);
+			window_plot_text_field(SORDER_LIST_WINDOW_TO_NAME, cache->to_name, wimp_COLOUR_BLACK);
 
 			/* Amount field */
 
-			window_plot_currency_field(SORDER_LIST_WINDOW_AMOUNT, sorder_get_amount(file, sorder, SORDER_AMOUNT_NORMAL), wimp_COLOUR_BLACK);
+			window_plot_text_field(SORDER_LIST_WINDOW_AMOUNT, cache->amount, wimp_COLOUR_BLACK);
 
 			/* Description field */
 
@@ -997,10 +1089,8 @@ static void sorder_list_window_window_redraw_handler(wimp_draw *redraw)
 
 			/* Next date field */
 
-			next_date = sorder_get_date(file, sorder, SORDER_DATE_ADJUSTED_NEXT);
-
 			if (next_date != NULL_DATE)
-				window_plot_date_field(SORDER_LIST_WINDOW_NEXTDATE, next_date, wimp_COLOUR_BLACK);
+				window_plot_text_field(SORDER_LIST_WINDOW_NEXTDATE, cache->next_date, wimp_COLOUR_BLACK);
 			else
 				window_plot_message_field(SORDER_LIST_WINDOW_NEXTDATE, "SOrderStopped", wimp_COLOUR_BLACK);
 
@@ -1161,7 +1251,8 @@ void sorder_list_window_build_title(struct sorder_list_window *windat)
 
 /**
  * Force the redraw of one or all of the standing orders in the given
- * Standing Order list window.
+ * Standing Order list window. Any cached text for the affected orders
+ * is discarded, so this must be called whenever their contents change.
  *
  * \param *windat		The standing order window to redraw.
  * \param sorder		The standing order to redraw, or NULL_SORDER for all.
@@ -1176,9 +1267,11 @@ void sorder_list_window_redraw(struct sorder_list_window *windat, sorder_t sorde
 		return;
 
 	if (sorder != NULL_SORDER) {
+		linecache_invalidate(windat->line_cache, sorder);
 		from = sorder_list_window_get_line_from_sorder(windat, sorder);
 		to = from;
 	} else {
+		linecache_invalidate_all(windat->line_cache);
 		from = 0;
 		to = windat->display_lines - 1;
 	}
@@ -1222,7 +1315,7 @@ static void sorder_list_window_force_redraw(struct sorder_list_window *windat, i
 	window.extent.y1 = WINDOW_ROW_TOP(SORDER_LIST_WINDOW_TOOLBAR_HEIGHT, from);
 	window.extent.y0 = WINDOW_ROW_BASE(SORDER_LIST_WINDOW_TOOLBAR_HEIGHT, to);
 
-	wimp_force_redraw(windat->sorder_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
+	window_queue_redraw(windat->sorder_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
 }
 
 
@@ -1395,6 +1488,8 @@ static struct report *sorder_list_window_print(struct report *report, void *data
 	date_t				next_date;
 	char				rec_char[REC_FIELD_LEN];
 	wimp_i				columns[SORDER_LIST_WINDOW_COLUMNS];
+	struct stringbuild_block	builder;
+	char				buffer[PRINT_MAX_LINE_LEN];
 
 	if (report == NULL || windat == NULL || windat->instance == NULL)
 		return NULL;
@@ -1408,91 +1503,96 @@ static struct report *sorder_list_window_print(struct report *report, void *data
 
 	msgs_lookup("RecChar", rec_char, REC_FIELD_LEN);
 
+	if (!stringbuild_initialise(&builder, buffer, PRINT_MAX_LINE_LEN))
+		return NULL;
+
 	hourglass_on();
 
 	/* Output the page title. */
 
-	stringbuild_reset();
+	stringbuild_reset(&builder);
 
-	stringbuild_add_string("\\b\\u");
-	stringbuild_add_message_param("SOrderTitle",
+	stringbuild_add_string(&builder, "\\b\\u");
+	stringbuild_add_message_param(&builder, "SOrderTitle",
 			file_get_leafname(file, NULL, 0),
 			NULL, NULL, NULL);
 
-	stringbuild_report_line(report, 1);
+	stringbuild_report_line(&builder, report, 1);
 
 	report_write_line(report, 1, "");
 
 	/* Output the headings line, taking the text from the window icons. */
 
-	stringbuild_reset();
-	columns_print_heading_names(windat->columns, windat->sorder_pane/*, report, 0*/);
-	stringbuild_report_line(report, 0);
+	stringbuild_reset(&builder);
+	columns_print_heading_names(windat->columns, windat->sorder_pane, &builder);
+	stringbuild_report_line(&builder, report, 0);
 
 	/* Output the standing order data as a set of delimited lines. */
 
 	for (line = 0; line < windat->display_lines; line++) {
 		sorder = windat->line_data[line].sorder;
 
-		stringbuild_reset();
+		stringbuild_reset(&builder);
 
 		for (column = 0; column < SORDER_LIST_WINDOW_COLUMNS; column++) {
 			if (column == 0)
-				stringbuild_add_string("\\k");
+				stringbuild_add_string(&builder, "\\k");
 			else
-				stringbuild_add_string("\\t");
+				stringbuild_add_string(&builder, "\\t");
 
 			switch (columns[column]) {
 			case SORDER_LIST_WINDOW_FROM:
-				stringbuild_add_string(account_get_ident(file, sorder_get_from(file, sorder)));
+				stringbuild_add_string(&builder, account_get_ident(file, sorder_get_from(file, sorder)));
 				break;
 			case SORDER_LIST_WINDOW_FROM_REC:
 				if (sorder_get_flags(file, sorder) & TRANS_REC_FROM)
-					stringbuild_add_string(rec_char);
+					stringbuild_add_string(&builder, rec_char);
 				break;
 			case SORDER_LIST_WINDOW_FROM_NAME:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(account_get_name(file, sorder_get_from(file, sorder)));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, account_get_name(file, sorder_get_from(file, sorder)));
 				break;
 			case SORDER_LIST_WINDOW_TO:
-				stringbuild_add_string(account_get_ident(file, sorder_get_to(file, sorder)));
+				stringbuild_add_string(&builder, account_get_ident(file, sorder_get_to(file, sorder)));
 				break;
 			case SORDER_LIST_WINDOW_TO_REC:
 				if (sorder_get_flags(file, sorder) & TRANS_REC_TO)
-					stringbuild_add_string(rec_char);
+					stringbuild_add_string(&builder, rec_char);
 				break;
 			case SORDER_LIST_WINDOW_TO_NAME:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(account_get_name(file, sorder_get_to(file, sorder)));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, account_get_name(file, sorder_get_to(file, sorder)));
 				break;
 			case SORDER_LIST_WINDOW_AMOUNT:
-				stringbuild_add_string("\\v\\d\\r");
-				stringbuild_add_currency(sorder_get_amount(file, sorder, SORDER_AMOUNT_NORMAL), FALSE);
+				stringbuild_add_string(&builder, "\\v\\d\\r");
+				stringbuild_add_currency(&builder, sorder_get_amount(file, sorder, SORDER_AMOUNT_NORMAL), FALSE);
 				break;
 			case SORDER_LIST_WINDOW_DESCRIPTION:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(sorder_get_description(file, sorder, NULL, 0));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, sorder_get_description(file, sorder, NULL, 0));
 				break;
 			case SORDER_LIST_WINDOW_NEXTDATE:
-				stringbuild_add_string("\\v\\c");
+				stringbuild_add_string(&builder, "\\v\\c");
 				next_date = sorder_get_date(file, sorder, SORDER_DATE_ADJUSTED_NEXT);
 				if (next_date != NULL_DATE)
-					stringbuild_add_date(next_date);
+					stringbuild_add_date(&builder, next_date);
 				else
-					stringbuild_add_message("SOrderStopped");
+					stringbuild_add_message(&builder, "SOrderStopped");
 				break;
 			case SORDER_LIST_WINDOW_LEFT:
-				stringbuild_add_printf("\\v\\d\\r%d", sorder_get_transactions(file, sorder, SORDER_TRANSACTIONS_LEFT));
+				stringbuild_add_printf(&builder, "\\v\\d\\r%d", sorder_get_transactions(file, sorder, SORDER_TRANSACTIONS_LEFT));
 				break;
 			default:
-				stringbuild_add_string("\\s");
+				stringbuild_add_string(&builder, "\\s");
 				break;
 			}
 		}
 
-		stringbuild_report_line(report, 0);
+		stringbuild_report_line(&builder, report, 0);
 	}
 
+	stringbuild_cancel(&builder);
+
 	hourglass_off();
 
 	return report;
@@ -1521,6 +1621,7 @@ void sorder_list_window_sort(struct sorder_list_window *windat)
 
 	sort_process(windat->sort, windat->display_lines);
 
+	linecache_invalidate_all(windat->line_cache);
 	sorder_list_window_force_redraw(windat, 0, windat->display_lines - 1, wimp_ICON_WINDOW);
 
 	hourglass_off();
@@ -1626,6 +1727,8 @@ osbool sorder_list_window_initialise_entries(struct sorder_list_window *windat,
 	for (i = 0; i < sorders; i++)
 		windat->line_data[i].sorder = i;
 
+	linecache_invalidate_all(windat->line_cache);
+
 	sorder_list_window_sort(windat);
 
 	return TRUE;
@@ -1656,6 +1759,8 @@ osbool sorder_list_window_add_sorder(struct sorder_list_window *windat, sorder_t
 
 	windat->line_data[windat->display_lines - 1].sorder = sorder;
 
+	linecache_invalidate(windat->line_cache, sorder);
+
 	sorder_list_window_set_extent(windat);
 
 	if (config_opt_read("AutoSortSOrders"))
@@ -1699,6 +1804,10 @@ osbool sorder_list_window_delete_sorder(struct sorder_list_window *windat, sorde
 
 	windat->display_lines--;
 
+	/* The following orders have been renumbered, so the cache is invalid. */
+
+	linecache_invalidate_all(windat->line_cache);
+
 	/* Update the preset window. */
 
 	sorder_list_window_set_extent(windat);
@@ -1714,6 +1823,65 @@ osbool sorder_list_window_delete_sorder(struct sorder_list_window *windat, sorde
 }
 
 
+/**
+ * Remove any number of standing orders from an instance of the standing
+ * order list window in a single pass, following the compaction of the
+ * underlying standing order data, and renumber the remaining entries to
+ * match.
+ *
+ * \param *windat		The standing order list window instance to update.
+ * \param *remap		An array giving the new index of each of the old
+ *				standing orders, or NULL_SORDER if removed.
+ * \param count			The number of entries in the remap array.
+ * \return			TRUE on success; FALSE on failure.
+ */
+
+osbool sorder_list_window_remap_sorders(struct sorder_list_window *windat, sorder_t *remap, int count)
+{
+	int		line, lines = 0;
+	sorder_t	sorder;
+
+	if (windat == NULL || windat->line_data == NULL || remap == NULL)
+		return FALSE;
+
+	/* Renumber the lines which remain, and close up any gaps left by
+	 * those which have gone, keeping the display order intact.
+	 */
+
+	for (line = 0; line < windat->display_lines; line++) {
+		sorder = windat->line_data[line].sorder;
+
+		if (sorder < 0 || sorder >= count || remap[sorder] == NULL_SORDER)
+			continue;
+
+		windat->line_data[lines].sorder = remap[sorder];
+		lines++;
+	}
+
+	if (lines < windat->display_lines && !flexutils_resize((void **) &(windat->line_data), sizeof(struct sorder_list_window_redraw), lines))
+		return FALSE;
+
+	windat->display_lines = lines;
+
+	/* The standing orders have been renumbered, so the cache is invalid. */
+
+	linecache_invalidate_all(windat->line_cache);
+
+	/* Update the standing order window. */
+
+	sorder_list_window_set_extent(windat);
+
+	windows_open(windat->sorder_window);
+
+	if (config_opt_read("AutoSortSOrders"))
+		sorder_list_window_sort(windat);
+	else
+		sorder_list_window_force_redraw(windat, 0, windat->display_lines, wimp_ICON_WINDOW);
+
+	return TRUE;
+}
+
+
 /**
  * Save the standing order list window details from a window to a CashBook
  * file. This assumes that the caller has already created a suitable section
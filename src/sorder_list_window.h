@@ -81,7 +81,8 @@ void sorder_list_window_build_title(struct sorder_list_window *windat);
 
 /**
  * Force the redraw of one or all of the standing orders in the given
- * Standing Order list window.
+ * Standing Order list window. Any cached text for the affected orders
+ * is discarded, so this must be called whenever their contents change.
  *
  * \param *windat		The standing order window to redraw.
  * \param sorder		The standing order to redraw, or NULL_SORDER for all.
@@ -148,6 +149,22 @@ osbool sorder_list_window_add_sorder(struct sorder_list_window *windat, sorder_t
 osbool sorder_list_window_delete_sorder(struct sorder_list_window *windat, sorder_t sorder);
 
 
+/**
+ * Remove any number of standing orders from an instance of the standing
+ * order list window in a single pass, following the compaction of the
+ * underlying standing order data, and renumber the remaining entries to
+ * match.
+ *
+ * \param *windat		The standing order list window instance to update.
+ * \param *remap		An array giving the new index of each of the old
+ *				standing orders, or NULL_SORDER if removed.
+ * \param count			The number of entries in the remap array.
+ * \return			TRUE on success; FALSE on failure.
+ */
+
+osbool sorder_list_window_remap_sorders(struct sorder_list_window *windat, sorder_t *remap, int count);
+
+
 /**
  * Save the standing order list window details from a window to a CashBook
  * file. This assumes that the caller has already created a suitable section
@@ -53,69 +53,56 @@
 #include "report.h"
 
 
-/* Global Variables. */
-
-/**
- * The buffer into which the string is being constructed, or NULL for none.
- */
-
-static char *stringbuild_buffer = NULL;
-
-/**
- * The first unused location in the buffer, or NULL if none.
- */
-
-static char *stringbuild_ptr = NULL;
+/* Macros. */
 
 /**
- * The location of the final character in the buffer, or NULL if none.
+ * Check whether a stringbuild instance is valid.
  */
 
-static char *stringbuild_end = NULL;
+#define stringbuild_valid(instance) (((instance) != NULL) && ((instance)->buffer != NULL) && ((instance)->ptr != NULL) && ((instance)->end != NULL))
 
 /**
- * Set TRUE if a line was too long for the buffer.
+ * Return the space remaining in a stringbuild instance.
  */
 
-static osbool stringbuild_too_long = FALSE;
-
-/* Macros. */
+#define stringbuild_remaining(instance) ((instance)->end - ((instance)->ptr + 1))
 
-/**
- * Check whether the current stringbuilder information is valid.
- */
+/* Static Function Prototypes. */
 
-#define stringbuild_valid() ((stringbuild_buffer != NULL) && (stringbuild_ptr != NULL) && (stringbuild_end != NULL))
+static void stringbuild_find_end(struct stringbuild_block *instance);
 
-#define stringbuild_remaining() (stringbuild_end - (stringbuild_ptr + 1))
 
 /**
  * Initialise a new stringbuild session, using a supplied memory buffer to
  * construct the new line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *buffer		Pointer to a buffer to use for assembling the string.
  * \param length		The length of the supplied buffer.
  * \return			TRUE if successful; FALSE on error.
  */
 
-osbool stringbuild_initialise(char *buffer, size_t length)
+osbool stringbuild_initialise(struct stringbuild_block *instance, char *buffer, size_t length)
 {
+	if (instance == NULL)
+		return FALSE;
+
+	instance->too_long = FALSE;
+
 	if (buffer == NULL || length <= 0) {
-		stringbuild_reset();
+		instance->buffer = NULL;
+		instance->ptr = NULL;
+		instance->end = NULL;
 		return FALSE;
 	}
 
-	stringbuild_buffer = buffer;
-	stringbuild_ptr = buffer;
-	stringbuild_end = buffer + length - 1;
+	instance->buffer = buffer;
+	instance->ptr = buffer;
+	instance->end = buffer + length - 1;
 
 	/* Terminate the string. */
 
-	*stringbuild_end = '\0';
-
-	/* Reset the too long flag. */
-
-	stringbuild_too_long = FALSE;
+	*(instance->end) = '\0';
 
 	return TRUE;
 }
@@ -124,70 +111,82 @@ osbool stringbuild_initialise(char *buffer, size_t length)
 /**
  * Terminate a stringbuild session, resetting the pointers to prevent further
  * use of the existing buffer.
+ *
+ * \param *instance		The stringbuild instance to use.
  */
 
-void stringbuild_cancel(void)
+void stringbuild_cancel(struct stringbuild_block *instance)
 {
-	stringbuild_buffer = NULL;
-	stringbuild_ptr = NULL;
-	stringbuild_end = NULL;
+	if (instance == NULL)
+		return;
 
-	if (stringbuild_too_long)
+	instance->buffer = NULL;
+	instance->ptr = NULL;
+	instance->end = NULL;
+
+	if (instance->too_long)
 		error_msgs_report_error("StringTooLong");
 
-	stringbuild_too_long = FALSE;
+	instance->too_long = FALSE;
 }
 
 
 /**
  * Clear the contents of a stringbuild settion, ready for a new string to be
  * assembled in the buffer.
+ *
+ * \param *instance		The stringbuild instance to use.
  */
 
-void stringbuild_reset(void)
+void stringbuild_reset(struct stringbuild_block *instance)
 {
-	stringbuild_ptr = stringbuild_buffer;
+	if (instance == NULL)
+		return;
+
+	instance->ptr = instance->buffer;
 }
 
 
 /**
  * Terminate the current string, and return a pointer to it.
  *
+ * \param *instance		The stringbuild instance to use.
  * \return			Pointer to the string, or NULL if there is none.
  */
 
-char *stringbuild_get_line(void)
+char *stringbuild_get_line(struct stringbuild_block *instance)
 {
-	if (!stringbuild_valid())
+	if (!stringbuild_valid(instance))
 		return NULL;
 
 	/* If the buffer has overrun, do nothing. */
 
-	if (stringbuild_ptr >= stringbuild_end) {
-		stringbuild_too_long = TRUE;
+	if (instance->ptr >= instance->end) {
+		instance->too_long = TRUE;
 		return NULL;
 	}
 
 	/* Terminate the buffer and return the string it holds. */
 
-	*stringbuild_ptr = '\0';
+	*(instance->ptr) = '\0';
 
-	return stringbuild_buffer;
+	return instance->buffer;
 }
 
 
 /**
  * Terminate the current string, and write it to the specified report.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *report		The report to write to.
  * \param bar			The tab bar to use.
  */
 
-void stringbuild_report_line(struct report *report, int tab_bar)
+void stringbuild_report_line(struct stringbuild_block *instance, struct report *report, int tab_bar)
 {
 	char *line;
 
-	line = stringbuild_get_line();
+	line = stringbuild_get_line(instance);
 	if (line != NULL)
 		report_write_line(report, tab_bar, line);
 }
@@ -196,24 +195,28 @@ void stringbuild_report_line(struct report *report, int tab_bar)
 /**
  * Add a string to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *string		Pointer to the string to be added.
  */
 
-void stringbuild_add_string(char *string)
+void stringbuild_add_string(struct stringbuild_block *instance, char *string)
 {
-	size_t	length, chars_to_write;
+	char	*ptr, *end;
 
-	if (string == NULL)
+	if (!stringbuild_valid(instance) || string == NULL)
 		return;
 
-	length = strlen(string);
-	chars_to_write = (length <= stringbuild_remaining()) ? length : stringbuild_remaining();
+	/* Copy the string in a single pass, stopping at whichever comes
+	 * first of its terminator or the end of the available space.
+	 */
 
-	if (chars_to_write <= 0)
-		return;
+	ptr = instance->ptr;
+	end = instance->end - 1;
 
-	strncpy(stringbuild_ptr, string, chars_to_write);
-	stringbuild_ptr += chars_to_write;
+	while (ptr < end && *string != '\0')
+		*ptr++ = *string++;
+
+	instance->ptr = ptr;
 }
 
 
@@ -221,25 +224,28 @@ void stringbuild_add_string(char *string)
  * Add a string to the end of the current line, using the standard printf()
  * syntax and functionality.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *cntrl_string		A standard printf() formatting string.
  * \param ...			Additional printf() parameters as required.
  * \return			The number of characters written, or <0 for error.
  */
 
-int stringbuild_add_printf(char *cntrl_string, ...)
+int stringbuild_add_printf(struct stringbuild_block *instance, char *cntrl_string, ...)
 {
 	int		chars_written;
 	va_list		ap;
 
+	if (!stringbuild_valid(instance) || stringbuild_remaining(instance) <= 0)
+		return -1;
+
 	va_start(ap, cntrl_string);
-	chars_written = vsnprintf(stringbuild_ptr, stringbuild_remaining(), cntrl_string, ap);
+	chars_written = vsnprintf(instance->ptr, stringbuild_remaining(instance), cntrl_string, ap);
+	va_end(ap);
 
-	if (chars_written >= 0) {
-		stringbuild_ptr += chars_written;
-	} else {
-		while (stringbuild_ptr < stringbuild_end && *stringbuild_ptr != '\0')
-			stringbuild_ptr++;
-	}
+	if (chars_written >= 0)
+		instance->ptr += chars_written;
+	else
+		stringbuild_find_end(instance);
 
 	return chars_written;
 }
@@ -249,19 +255,18 @@ int stringbuild_add_printf(char *cntrl_string, ...)
  * Add a string looked up from the application messages to the end of the
  * current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *token		Pointer to the token of the message to
  *				be added.
  */
 
-void stringbuild_add_message(char *token)
+void stringbuild_add_message(struct stringbuild_block *instance, char *token)
 {
-	if (stringbuild_remaining() <= 0)
+	if (!stringbuild_valid(instance) || stringbuild_remaining(instance) <= 0)
 		return;
 
-	msgs_lookup(token, stringbuild_ptr, stringbuild_remaining());
-
-	while (stringbuild_ptr < stringbuild_end && *stringbuild_ptr != '\0')
-		stringbuild_ptr++;
+	msgs_lookup(token, instance->ptr, stringbuild_remaining(instance));
+	stringbuild_find_end(instance);
 }
 
 
@@ -269,6 +274,7 @@ void stringbuild_add_message(char *token)
  * Add a string looked up from the application messages to the end of the
  * current line, allowing for paramater substitution.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *token		Pointer to the token of the message to
  *				be added.
  * \param *a			Pointer to parameter %0, or NULL.
@@ -277,71 +283,80 @@ void stringbuild_add_message(char *token)
  * \param *d			Pointer to parameter %3, or NULL.
  */
 
-void stringbuild_add_message_param(char *token, char *a, char *b, char *c, char *d)
+void stringbuild_add_message_param(struct stringbuild_block *instance, char *token, char *a, char *b, char *c, char *d)
 {
-	if (stringbuild_remaining() <= 0)
+	if (!stringbuild_valid(instance) || stringbuild_remaining(instance) <= 0)
 		return;
 
-	msgs_param_lookup(token, stringbuild_ptr, stringbuild_remaining(), a, b, c, d);
-
-	while (stringbuild_ptr < stringbuild_end && *stringbuild_ptr != '\0')
-		stringbuild_ptr++;
+	msgs_param_lookup(token, instance->ptr, stringbuild_remaining(instance), a, b, c, d);
+	stringbuild_find_end(instance);
 }
 
 
 /**
  * Add a currency value to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param value			The value to be converted.
  * \param print_zeros		TRUE to convert zero values as 0; FALSE to
  *				return a blank string.
  */
 
-void stringbuild_add_currency(amt_t value, osbool print_zeros)
+void stringbuild_add_currency(struct stringbuild_block *instance, amt_t value, osbool print_zeros)
 {
-	if (stringbuild_remaining() <= 0)
+	if (!stringbuild_valid(instance) || stringbuild_remaining(instance) <= 0)
 		return;
 
-	currency_flexible_convert_to_string(value, stringbuild_ptr, stringbuild_remaining(), print_zeros);
-
-	while (stringbuild_ptr < stringbuild_end && *stringbuild_ptr != '\0')
-		stringbuild_ptr++;
+	currency_flexible_convert_to_string(value, instance->ptr, stringbuild_remaining(instance), print_zeros);
+	stringbuild_find_end(instance);
 }
 
 
 /**
  * Add a date value to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param value			The date to be converted.
  */
 
-void stringbuild_add_date(date_t date)
+void stringbuild_add_date(struct stringbuild_block *instance, date_t date)
 {
-	if (stringbuild_remaining() <= 0)
+	if (!stringbuild_valid(instance) || stringbuild_remaining(instance) <= 0)
 		return;
 
-	date_convert_to_string(date, stringbuild_ptr, stringbuild_remaining());
-
-	while (stringbuild_ptr < stringbuild_end && *stringbuild_ptr != '\0')
-		stringbuild_ptr++;
+	date_convert_to_string(date, instance->ptr, stringbuild_remaining(instance));
+	stringbuild_find_end(instance);
 }
 
 
 /**
  * Add an icon's contents to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param window		The window containing the icon.
  * \param icon			The icon to copy text from.
  */
 
-void stringbuild_add_icon(wimp_w window, wimp_i icon)
+void stringbuild_add_icon(struct stringbuild_block *instance, wimp_w window, wimp_i icon)
 {
-	if (stringbuild_remaining() <= 0)
+	if (!stringbuild_valid(instance) || stringbuild_remaining(instance) <= 0)
 		return;
 
-	icons_copy_text(window, icon, stringbuild_ptr, stringbuild_remaining());
+	icons_copy_text(window, icon, instance->ptr, stringbuild_remaining(instance));
+	stringbuild_find_end(instance);
+}
 
-	while (stringbuild_ptr < stringbuild_end && *stringbuild_ptr != '\0')
-		stringbuild_ptr++;
+
+/**
+ * Move the insertion point of a stringbuild instance on to the terminator
+ * of any text which has just been written into the buffer.
+ *
+ * \param *instance		The stringbuild instance to update.
+ */
+
+static void stringbuild_find_end(struct stringbuild_block *instance)
+{
+	while (instance->ptr < instance->end && *(instance->ptr) != '\0')
+		instance->ptr++;
 }
 
@@ -33,89 +33,114 @@
 
 #include "currency.h"
 
+/**
+ * A stringbuild instance. The contents are private to the stringbuild
+ * module, but the structure is made public so that clients can hold an
+ * instance on the stack alongside the buffer that it uses.
+ */
+
+struct stringbuild_block {
+	char		*buffer;			/**< The buffer into which the string is being constructed, or NULL for none.	*/
+	char		*ptr;				/**< The first unused location in the buffer, or NULL if none.			*/
+	char		*end;				/**< The location of the final character in the buffer, or NULL if none.	*/
+	osbool		too_long;			/**< Set TRUE if a line was too long for the buffer.				*/
+};
+
+
 /**
  * Initialise a new stringbuild session, using a supplied memory buffer to
  * construct the new line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *buffer		Pointer to a buffer to use for assembling the string.
  * \param length		The length of the supplied buffer.
  * \return			TRUE if successful; FALSE on error.
  */
 
-osbool stringbuild_initialise(char *buffer, size_t length);
+osbool stringbuild_initialise(struct stringbuild_block *instance, char *buffer, size_t length);
 
 
 /**
  * Terminate a stringbuild session, resetting the pointers to prevent further
  * use of the existing buffer.
+ *
+ * \param *instance		The stringbuild instance to use.
  */
 
-void stringbuild_cancel(void);
+void stringbuild_cancel(struct stringbuild_block *instance);
 
 
 /**
  * Clear the contents of a stringbuild settion, ready for a new string to be
  * assembled in the buffer.
+ *
+ * \param *instance		The stringbuild instance to use.
  */
 
-void stringbuild_reset(void);
+void stringbuild_reset(struct stringbuild_block *instance);
 
 
 /**
  * Terminate the current string, and return a pointer to it.
  *
+ * \param *instance		The stringbuild instance to use.
  * \return			Pointer to the string, or NULL if there is none.
  */
 
-char *stringbuild_get_line(void);
+char *stringbuild_get_line(struct stringbuild_block *instance);
 
 
 /**
  * Terminate the current string, and write it to the specified report.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *report		The report to write to.
  * \param bar			The tab bar to use.
  */
 
-void stringbuild_report_line(struct report *report, int tab_bar);
+void stringbuild_report_line(struct stringbuild_block *instance, struct report *report, int tab_bar);
 
 
 /**
  * Add a string to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *string		Pointer to the string to be added.
  */
 
-void stringbuild_add_string(char *string);
+void stringbuild_add_string(struct stringbuild_block *instance, char *string);
 
 
 /**
  * Add a string to the end of the current line, using the standard printf()
  * syntax and functionality.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *cntrl_string		A standard printf() formatting string.
  * \param ...			Additional printf() parameters as required.
  * \return			The number of characters written, or <0 for error.
  */
 
-int stringbuild_add_printf(char *cntrl_string, ...);
+int stringbuild_add_printf(struct stringbuild_block *instance, char *cntrl_string, ...);
 
 
 /**
  * Add a string looked up from the application messages to the end of the
  * current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *token		Pointer to the token of the message to
  *				be added.
  */
 
-void stringbuild_add_message(char *token);
+void stringbuild_add_message(struct stringbuild_block *instance, char *token);
 
 
 /**
  * Add a string looked up from the application messages to the end of the
  * current line, allowing for paramater substitution.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param *token		Pointer to the token of the message to
  *				be added.
  * \param *a			Pointer to parameter %0, or NULL.
@@ -124,37 +149,40 @@ void stringbuild_add_message(char *token);
  * \param *d			Pointer to parameter %3, or NULL.
  */
 
-void stringbuild_add_message_param(char *token, char *a, char *b, char *c, char *d);
+void stringbuild_add_message_param(struct stringbuild_block *instance, char *token, char *a, char *b, char *c, char *d);
 
 
 /**
  * Add a currency value to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param value			The value to be converted.
  * \param print_zeros		TRUE to convert zero values as 0; FALSE to
  *				return a blank string.
  */
 
-void stringbuild_add_currency(amt_t value, osbool print_zeros);
+void stringbuild_add_currency(struct stringbuild_block *instance, amt_t value, osbool print_zeros);
 
 
 /**
  * Add a date value to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param value			The date to be converted.
  */
 
-void stringbuild_add_date(date_t date);
+void stringbuild_add_date(struct stringbuild_block *instance, date_t date);
 
 
 /**
  * Add an icon's contents to the end of the current line.
  *
+ * \param *instance		The stringbuild instance to use.
  * \param window		The window containing the icon.
  * \param icon			The icon to copy text from.
  */
 
-void stringbuild_add_icon(wimp_w window, wimp_i icon);
+void stringbuild_add_icon(struct stringbuild_block *instance, wimp_w window, wimp_i icon);
 
 #endif
 
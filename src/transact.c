@@ -74,8 +74,10 @@
 #include "accview.h"
 #include "analysis.h"
 #include "analysis_template_menu.h"
+#include "archive.h"
 #include "budget.h"
 #include "caret.h"
+#include "checkpoint.h"
 #include "column.h"
 #include "currency.h"
 #include "date.h"
@@ -100,6 +102,14 @@
 #include "window.h"
 
 
+/**
+ * The minimum number of extra transactions to allocate space for when the
+ * data block is extended during a batch update.
+ */
+
+#define TRANSACT_BATCH_ALLOCATION 64
+
+
 /**
  * Transatcion data structure
  */
@@ -178,14 +188,28 @@ struct transact_block {
 	 */
 	int				trans_count;
 
+	/**
+	 * The number of transactions for which space is allocated in the
+	 * data block; this can exceed trans_count during a batch update.
+	 */
+	int				trans_allocation;
+
 	/**
 	 * Is the transaction data sorted correctly into date order?
 	 */
 	osbool				date_sort_valid;
+
+	/**
+	 * The periodic account balance checkpoints.
+	 */
+	struct checkpoint_block		*checkpoints;
 };
 
 /* Static Function Prototypes. */
 
+static osbool transact_archive_purgeable(struct file_block *file, date_t cutoff);
+static osbool transact_is_purgeable(struct file_block *file, tran_t transaction, date_t cutoff);
+
 
 /**
  * Test whether a transaction number is safe to look up in the transaction data array.
@@ -227,9 +251,12 @@ struct transact_block *transact_create_instance(struct file_block *file)
 
 	new->transactions = NULL;
 	new->trans_count = 0;
+	new->trans_allocation = 0;
 
 	new->date_sort_valid = TRUE;
 
+	new->checkpoints = NULL;
+
 	/* Initialise the transaction window. */
 
 	new->transact_window = transact_list_window_create_instance(new);
@@ -245,6 +272,14 @@ struct transact_block *transact_create_instance(struct file_block *file)
 		return NULL;
 	}
 
+	/* Initialise the balance checkpoints. */
+
+	new->checkpoints = checkpoint_create_instance(file);
+	if (new->checkpoints == NULL) {
+		transact_delete_instance(new);
+		return NULL;
+	}
+
 	return new;
 }
 
@@ -261,6 +296,7 @@ void transact_delete_instance(struct transact_block *windat)
 		return;
 
 	transact_list_window_delete_instance(windat->transact_window);
+	checkpoint_delete_instance(windat->checkpoints);
 
 	if (windat->transactions != NULL)
 		flexutils_free((void **) &(windat->transactions));
@@ -480,6 +516,46 @@ int transact_get_count(struct file_block *file)
 }
 
 
+/**
+ * Calculate the total of the transactions into and out of each account in
+ * a file, up to and including a given date, starting from the nearest
+ * balance checkpoint. Opening balances are not included.
+ *
+ * \param *file			The file to calculate the totals for.
+ * \param date			The last date to include, or NULL_DATE for all.
+ * \param *balances		Pointer to an array to take the totals, with an
+ *				entry for each account in the file.
+ * \param count			The number of entries in the array.
+ * \return			The number of transactions included in the
+ *				totals, or -1 on failure.
+ */
+
+int transact_get_balances(struct file_block *file, date_t date, amt_t *balances, int count)
+{
+	if (file == NULL || file->transacts == NULL)
+		return -1;
+
+	return checkpoint_get_balances(file->transacts->checkpoints, date, balances, count);
+}
+
+
+/**
+ * Check a file's balance checkpoints against a full recalculation from the
+ * start of the file, discarding them if any disagree.
+ *
+ * \param *file			The file to check.
+ * \return			TRUE if the checkpoints were consistent; else FALSE.
+ */
+
+osbool transact_verify_checkpoints(struct file_block *file)
+{
+	if (file == NULL || file->transacts == NULL)
+		return FALSE;
+
+	return checkpoint_verify(file->transacts->checkpoints);
+}
+
+
 /**
  * Return the file associated with a transactions instance.
  *
@@ -532,22 +608,41 @@ int transact_get_caret_line(struct file_block *file)
 void transact_add_raw_entry(struct file_block *file, date_t date, acct_t from, acct_t to, enum transact_flags flags,
 		amt_t amount, char *ref, char *description)
 {
-	int new;
+	int new, allocation;
 
 	if (file == NULL || file->transacts == NULL)
 		return;
 
-	if (!flexutils_resize((void **) &(file->transacts->transactions), sizeof(struct transaction), file->transacts->trans_count + 1)) {
-		error_msgs_report_error("NoMemNewTrans");
-		return;
+	/* Extend the data block if there's no space left in it. During a
+	 * batch update, space is allocated in larger chunks and any excess
+	 * is released when the batch completes.
+	 */
+
+	if (file->transacts->trans_count >= file->transacts->trans_allocation) {
+		allocation = file->transacts->trans_count + 1;
+
+		if (file_defer_batch_effects(file, FILE_BATCH_TRANSACT_MEMORY))
+			allocation += (file->transacts->trans_count / 2 > TRANSACT_BATCH_ALLOCATION) ?
+					file->transacts->trans_count / 2 : TRANSACT_BATCH_ALLOCATION;
+
+		if (!flexutils_resize((void **) &(file->transacts->transactions), sizeof(struct transaction), allocation)) {
+			error_msgs_report_error("NoMemNewTrans");
+			return;
+		}
+
+		file->transacts->trans_allocation = allocation;
 	}
 
 	new = file->transacts->trans_count++;
 
+	checkpoint_invalidate(file->transacts->checkpoints, date);
+
 	file->transacts->transactions[new].date = date;
 	file->transacts->transactions[new].amount = amount;
 	file->transacts->transactions[new].from = from;
 	file->transacts->transactions[new].to = to;
+	account_change_usage(file, NULL_ACCOUNT, from);
+	account_change_usage(file, NULL_ACCOUNT, to);
 	file->transacts->transactions[new].flags = flags;
 	string_copy(file->transacts->transactions[new].reference, (ref != NULL) ? ref : "", TRANSACT_REF_FIELD_LEN);
 	string_copy(file->transacts->transactions[new].description, (description != NULL) ? description : "", TRANSACT_DESCRIPT_FIELD_LEN);
@@ -560,6 +655,103 @@ void transact_add_raw_entry(struct file_block *file, date_t date, acct_t from, a
 }
 
 
+/**
+ * Add a run of empty transactions to the end of the list in one go, ready
+ * to be filled in with transact_set_raw_entry(). Space for the whole run is
+ * claimed at once, rather than one transaction at a time.
+ *
+ * \param *file			The file to add the transactions to.
+ * \param count			The number of transactions to add.
+ * \return			The index of the first new transaction, or
+ *				NULL_TRANSACTION on failure.
+ */
+
+tran_t transact_add_raw_entries(struct file_block *file, int count)
+{
+	tran_t	first;
+	int	allocation, i;
+
+	if (file == NULL || file->transacts == NULL || count <= 0)
+		return NULL_TRANSACTION;
+
+	if (file->transacts->trans_count + count > file->transacts->trans_allocation) {
+		allocation = file->transacts->trans_count + count;
+
+		if (!flexutils_resize((void **) &(file->transacts->transactions), sizeof(struct transaction), allocation)) {
+			error_msgs_report_error("NoMemNewTrans");
+			return NULL_TRANSACTION;
+		}
+
+		file->transacts->trans_allocation = allocation;
+	}
+
+	first = file->transacts->trans_count;
+
+	for (i = first; i < first + count; i++) {
+		file->transacts->transactions[i].date = NULL_DATE;
+		file->transacts->transactions[i].amount = NULL_CURRENCY;
+		file->transacts->transactions[i].from = NULL_ACCOUNT;
+		file->transacts->transactions[i].to = NULL_ACCOUNT;
+		file->transacts->transactions[i].flags = TRANS_FLAGS_NONE;
+		*file->transacts->transactions[i].reference = '\0';
+		*file->transacts->transactions[i].description = '\0';
+	}
+
+	file->transacts->trans_count += count;
+
+	transact_list_window_add_transactions(file->transacts->transact_window, first, count);
+
+	file_set_data_integrity(file, TRUE);
+
+	return first;
+}
+
+
+/**
+ * Set the details of a transaction in a file directly, without any of the
+ * checks or updates made when editing from the transaction window. This is
+ * intended for filling in the transactions created by
+ * transact_add_raw_entries().
+ *
+ * \param *file			The file containing the transaction.
+ * \param transaction		The transaction to be set.
+ * \param date			The date of the transaction, or NULL_DATE.
+ * \param from			The account to transfer from, or NULL_ACCOUNT.
+ * \param to			The account to transfer to, or NULL_ACCOUNT.
+ * \param flags			The transaction flags.
+ * \param amount		The amount to transfer, or NULL_CURRENCY.
+ * \param *ref			Pointer to the transaction reference, or NULL.
+ * \param *description		Pointer to the transaction description, or NULL.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool transact_set_raw_entry(struct file_block *file, tran_t transaction, date_t date, acct_t from, acct_t to,
+		enum transact_flags flags, amt_t amount, char *ref, char *description)
+{
+	if (file == NULL || file->transacts == NULL || !transact_valid(file->transacts, transaction))
+		return FALSE;
+
+	account_change_usage(file, file->transacts->transactions[transaction].from, from);
+	account_change_usage(file, file->transacts->transactions[transaction].to, to);
+
+	checkpoint_invalidate(file->transacts->checkpoints, file->transacts->transactions[transaction].date);
+	checkpoint_invalidate(file->transacts->checkpoints, date);
+
+	file->transacts->transactions[transaction].date = date;
+	file->transacts->transactions[transaction].amount = amount;
+	file->transacts->transactions[transaction].from = from;
+	file->transacts->transactions[transaction].to = to;
+	file->transacts->transactions[transaction].flags = flags;
+	string_copy(file->transacts->transactions[transaction].reference, (ref != NULL) ? ref : "", TRANSACT_REF_FIELD_LEN);
+	string_copy(file->transacts->transactions[transaction].description, (description != NULL) ? description : "", TRANSACT_DESCRIPT_FIELD_LEN);
+
+	file_set_data_integrity(file, TRUE);
+	file->transacts->date_sort_valid = FALSE;
+
+	return TRUE;
+}
+
+
 /**
  * Clear a transaction from a file, returning it to an empty state. Note that
  * the transaction remains in-situ, and no memory is cleared. It will be
@@ -574,6 +766,11 @@ void transact_clear_raw_entry(struct file_block *file, tran_t transaction)
 	if (file == NULL || file->transacts == NULL || !transact_valid(file->transacts, transaction))
 		return;
 
+	account_change_usage(file, file->transacts->transactions[transaction].from, NULL_ACCOUNT);
+	account_change_usage(file, file->transacts->transactions[transaction].to, NULL_ACCOUNT);
+
+	checkpoint_invalidate(file->transacts->checkpoints, file->transacts->transactions[transaction].date);
+
 	file->transacts->transactions[transaction].date = NULL_DATE;
 	file->transacts->transactions[transaction].from = NULL_ACCOUNT;
 	file->transacts->transactions[transaction].to = NULL_ACCOUNT;
@@ -635,12 +832,31 @@ void transact_strip_blanks_from_end(struct file_block *file)
 	if (transaction < file->transacts->trans_count - 1) {
 		file->transacts->trans_count = transaction + 1;
 
-		if (!flexutils_resize((void **) &(file->transacts->transactions), sizeof(struct transaction), file->transacts->trans_count))
+		if (flexutils_resize((void **) &(file->transacts->transactions), sizeof(struct transaction), file->transacts->trans_count))
+			file->transacts->trans_allocation = file->transacts->trans_count;
+		else
 			error_msgs_report_error("BadDelete");
 	}
 }
 
 
+/**
+ * Release any spare space left at the end of the transaction data block
+ * by a batch update.
+ *
+ * \param *file			The file to be processed.
+ */
+
+void transact_release_spare_memory(struct file_block *file)
+{
+	if (file == NULL || file->transacts == NULL || file->transacts->trans_allocation <= file->transacts->trans_count)
+		return;
+
+	if (flexutils_resize((void **) &(file->transacts->transactions), sizeof(struct transaction), file->transacts->trans_count))
+		file->transacts->trans_allocation = file->transacts->trans_count;
+}
+
+
 /**
  * Find and return the line number of the first blank line in a file, based on
  * display order.
@@ -885,6 +1101,9 @@ osbool transact_change_date(struct file_block *file, tran_t transaction, date_t
 	if (old_date != file->transacts->transactions[transaction].date) {
 		changed = TRUE;
 		file->transacts->date_sort_valid = FALSE;
+
+		checkpoint_invalidate(file->transacts->checkpoints, old_date);
+		checkpoint_invalidate(file->transacts->checkpoints, new_date);
 	}
 
 	/* Return the line to the calculations. This will automatically update
@@ -910,9 +1129,12 @@ osbool transact_change_date(struct file_block *file, tran_t transaction, date_t
 	 * The big assumption here is that, because no from or to entries
 	 * have changed, none of the accounts will change length and so a
 	 * full rebuild is not required.
+	 *
+	 * During a batch update, a single rebuild is left until the end.
 	 */
 
-	accview_recalculate_all(file);
+	if (!file_defer_batch_effects(file, FILE_BATCH_ACCVIEWS))
+		accview_recalculate_all(file);
 
 	/* Force a redraw of the affected line. */
 
@@ -966,6 +1188,10 @@ osbool transact_change_account(struct file_block *file, tran_t transaction, enum
 		old_flags = file->transacts->transactions[transaction].flags;
 
 		file->transacts->transactions[transaction].from = new_account;
+		account_change_usage(file, old_acct, new_account);
+
+		if (old_acct != new_account)
+			checkpoint_invalidate(file->transacts->checkpoints, file->transacts->transactions[transaction].date);
 
 		if (reconciled)
 			file->transacts->transactions[transaction].flags |= TRANS_REC_FROM;
@@ -980,6 +1206,10 @@ osbool transact_change_account(struct file_block *file, tran_t transaction, enum
 		old_flags = file->transacts->transactions[transaction].flags;
 
 		file->transacts->transactions[transaction].to = new_account;
+		account_change_usage(file, old_acct, new_account);
+
+		if (old_acct != new_account)
+			checkpoint_invalidate(file->transacts->checkpoints, file->transacts->transactions[transaction].date);
 
 		if (reconciled)
 			file->transacts->transactions[transaction].flags |= TRANS_REC_TO;
@@ -1015,19 +1245,25 @@ osbool transact_change_account(struct file_block *file, tran_t transaction, enum
 	if (changed == FALSE)
 		return FALSE;
 
-	switch (target) {
-	case TRANSACT_FIELD_FROM:
-		accview_rebuild(file, old_acct);
-		accview_rebuild(file, file->transacts->transactions[transaction].from);
-		accview_redraw_transaction(file, file->transacts->transactions[transaction].to, transaction);
-		break;
-	case TRANSACT_FIELD_TO:
-		accview_rebuild(file, old_acct);
-		accview_rebuild(file, file->transacts->transactions[transaction].to);
-		accview_redraw_transaction(file, file->transacts->transactions[transaction].from, transaction);
-		break;
-	default:
-		break;
+	/* Update the affected account views, unless a batch update will
+	 * rebuild them later.
+	 */
+
+	if (!file_defer_batch_effects(file, FILE_BATCH_ACCVIEWS)) {
+		switch (target) {
+		case TRANSACT_FIELD_FROM:
+			accview_rebuild(file, old_acct);
+			accview_rebuild(file, file->transacts->transactions[transaction].from);
+			accview_redraw_transaction(file, file->transacts->transactions[transaction].to, transaction);
+			break;
+		case TRANSACT_FIELD_TO:
+			accview_rebuild(file, old_acct);
+			accview_rebuild(file, file->transacts->transactions[transaction].to);
+			accview_redraw_transaction(file, file->transacts->transactions[transaction].from, transaction);
+			break;
+		default:
+			break;
+		}
 	}
 
 	/* Force a redraw of the affected line. */
@@ -1089,10 +1325,12 @@ osbool transact_toggle_reconcile_flag(struct file_block *file, tran_t transactio
 	if (changed == FALSE)
 		return FALSE;
 
-	if (change_flag == TRANS_REC_FROM)
-		accview_redraw_transaction(file, file->transacts->transactions[transaction].from, transaction);
-	else
-		accview_redraw_transaction(file, file->transacts->transactions[transaction].to, transaction);
+	if (!file_defer_batch_effects(file, FILE_BATCH_ACCVIEWS)) {
+		if (change_flag == TRANS_REC_FROM)
+			accview_redraw_transaction(file, file->transacts->transactions[transaction].from, transaction);
+		else
+			accview_redraw_transaction(file, file->transacts->transactions[transaction].to, transaction);
+	}
 
 	/* Force a redraw of the affected line. */
 
@@ -1132,6 +1370,8 @@ osbool transact_change_amount(struct file_block *file, tran_t transaction, amt_t
 	if (new_amount != file->transacts->transactions[transaction].amount) {
 		changed = TRUE;
 		file->transacts->transactions[transaction].amount = new_amount;
+
+		checkpoint_invalidate(file->transacts->checkpoints, file->transacts->transactions[transaction].date);
 	}
 
 	/* Return the line to the calculations.   This will automatically update all
@@ -1147,8 +1387,10 @@ osbool transact_change_amount(struct file_block *file, tran_t transaction, amt_t
 	if (changed == FALSE)
 		return FALSE;
 
-	accview_recalculate(file, file->transacts->transactions[transaction].from, transaction);
-	accview_recalculate(file, file->transacts->transactions[transaction].to, transaction);
+	if (!file_defer_batch_effects(file, FILE_BATCH_ACCVIEWS)) {
+		accview_recalculate(file, file->transacts->transactions[transaction].from, transaction);
+		accview_recalculate(file, file->transacts->transactions[transaction].to, transaction);
+	}
 
 	/* Force a redraw of the affected line. */
 
@@ -1211,8 +1453,10 @@ osbool transact_change_refdesc(struct file_block *file, tran_t transaction, enum
 
 	/* Refresh any account views that may be affected. */
 
-	accview_redraw_transaction(file, file->transacts->transactions[transaction].from, transaction);
-	accview_redraw_transaction(file, file->transacts->transactions[transaction].to, transaction);
+	if (!file_defer_batch_effects(file, FILE_BATCH_ACCVIEWS)) {
+		accview_redraw_transaction(file, file->transacts->transactions[transaction].from, transaction);
+		accview_redraw_transaction(file, file->transacts->transactions[transaction].to, transaction);
+	}
 
 	/* Force a redraw of the affected line. */
 
@@ -1235,6 +1479,9 @@ void transact_sort(struct transact_block *windat)
 	if (windat == NULL)
 		return;
 
+	if (file_defer_batch_effects(windat->file, FILE_BATCH_TRANSACT_SORT))
+		return;
+
 	transact_list_window_sort(windat->transact_window);
 }
 
@@ -1316,32 +1563,142 @@ void transact_sort_file_data(struct file_block *file)
 
 
 /**
- * Purge unused transactions from a file.
+ * Bring a file's transactions back into date order after a run of new
+ * transactions, themselves in date order, has been added to the end of
+ * the list. The new transactions are merged into the existing ones in a
+ * single pass; if either set turns out not to be in order, the file is
+ * sorted in full instead.
+ *
+ * \param *file			The file to be sorted.
+ * \param first			The index of the first of the new transactions.
+ */
+
+void transact_merge_raw_entries(struct file_block *file, tran_t first)
+{
+	struct transaction	*added;
+	int			i, count, existing, tail, out;
+
+	if (file == NULL || file->transacts == NULL || !transact_valid(file->transacts, first))
+		return;
+
+	count = file->transacts->trans_count - first;
+
+	/* Check that both the existing and the new transactions are in date
+	 * order; if not, or if there's no room to hold the new ones while
+	 * they are merged, fall back to a full sort.
+	 */
+
+	for (i = 1; i < file->transacts->trans_count; i++) {
+		if (i != first && file->transacts->transactions[i].date < file->transacts->transactions[i - 1].date)
+			break;
+	}
+
+	added = (i == file->transacts->trans_count) ? heap_alloc(sizeof(struct transaction) * count) : NULL;
+
+	if (added == NULL) {
+		file->transacts->date_sort_valid = FALSE;
+		transact_sort_file_data(file);
+		return;
+	}
+
+#ifdef DEBUG
+	debug_printf("Merging %d new transactions", count);
+#endif
+
+	hourglass_on();
+
+	for (i = 0; i < file->transacts->trans_count; i++)
+		file->transacts->transactions[i].saved_sort = i;
+
+	memcpy(added, file->transacts->transactions + first, sizeof(struct transaction) * count);
+
+	/* Merge from the end of the array backwards. Where dates are equal,
+	 * the existing transactions stay ahead of the new ones, just as they
+	 * would with a full sort.
+	 */
+
+	existing = first - 1;
+	tail = count - 1;
+	out = file->transacts->trans_count - 1;
+
+	while (tail >= 0) {
+		if (existing >= 0 && file->transacts->transactions[existing].date > added[tail].date)
+			file->transacts->transactions[out--] = file->transacts->transactions[existing--];
+		else
+			file->transacts->transactions[out--] = added[tail--];
+	}
+
+	heap_free(added);
+
+	/* Finally, restore the order of the transactions on display in the
+	 * main window and any account view windows which are open.
+	 */
+
+	for (i = 0; i < file->transacts->trans_count; i++)
+		file->transacts->transactions[file->transacts->transactions[i].saved_sort].new_sort_index = i;
+
+	accview_reindex_all(file);
+	transact_list_window_reindex(file->transacts->transact_window);
+
+	file->transacts->date_sort_valid = TRUE;
+
+	hourglass_off();
+}
+
+
+/**
+ * Purge unused transactions from a file, optionally writing them out to
+ * an archive segment first.
  *
  * \param *file			The file to purge.
  * \param cutoff		The cutoff date before which transactions should be removed.
+ * \param archive		TRUE to archive the purged transactions; else FALSE.
+ * \return			TRUE if the purge went ahead; FALSE if nothing was changed.
  */
 
-void transact_purge(struct file_block *file, date_t cutoff)
+osbool transact_purge(struct file_block *file, date_t cutoff, osbool archive)
 {
-	tran_t			transaction;
-	enum transact_flags	flags;
+	tran_t			transaction, *remap, count, out = 0;
 	acct_t			from, to;
-	date_t			date;
 	amt_t			amount;
 
 	if (file == NULL || file->transacts == NULL)
-		return;
+		return FALSE;
 
-	for (transaction = 0; transaction < file->transacts->trans_count; transaction++) {
-		date = transact_get_date(file, transaction);
-		flags = transact_get_flags(file, transaction);
+	count = file->transacts->trans_count;
+
+	remap = (count > 0) ? heap_alloc(sizeof(tran_t) * count) : NULL;
+	if (count > 0 && remap == NULL) {
+		error_msgs_report_error("NoMemPurge");
+		return FALSE;
+	}
+
+	/* If the purged transactions are to be kept, write them out to a new
+	 * archive segment before anything is changed, so that nothing is lost
+	 * if the segment can't be completed.
+	 */
+
+	if (archive && !transact_archive_purgeable(file, cutoff)) {
+		if (remap != NULL)
+			heap_free(remap);
+
+		return FALSE;
+	}
+
+	file_begin_batch(file);
 
-		if ((flags & (TRANS_REC_FROM | TRANS_REC_TO)) == (TRANS_REC_FROM | TRANS_REC_TO) &&
-				(cutoff == NULL_DATE || date < cutoff)) {
-			from = transact_get_from(file, transaction);
-			to = transact_get_to(file, transaction);
-			amount = transact_get_amount(file, transaction);
+	/* Work through the transactions in a single pass, folding the purged
+	 * ones into the account opening balances and closing up the gaps that
+	 * they leave. Blank transactions are kept where they are. The order
+	 * of the remaining transactions is unchanged, and the new index of
+	 * each old transaction is recorded so that the windows can follow.
+	 */
+
+	for (transaction = 0; transaction < count; transaction++) {
+		if (transact_is_purgeable(file, transaction, cutoff)) {
+			from = file->transacts->transactions[transaction].from;
+			to = file->transacts->transactions[transaction].to;
+			amount = file->transacts->transactions[transaction].amount;
 
 			/* If the from and to accounts are full accounts, */
 
@@ -1351,13 +1708,135 @@ void transact_purge(struct file_block *file, date_t cutoff)
 			if (to != NULL_ACCOUNT && (account_get_type(file, to) & ACCOUNT_FULL) != 0)
 				account_adjust_opening_balance(file, to, +amount);
 
-			transact_clear_raw_entry(file, transaction);
+			account_change_usage(file, from, NULL_ACCOUNT);
+			account_change_usage(file, to, NULL_ACCOUNT);
+
+			remap[transaction] = NULL_TRANSACTION;
+		} else {
+			if (out != transaction)
+				file->transacts->transactions[out] = file->transacts->transactions[transaction];
+
+			remap[transaction] = out++;
 		}
 	}
 
-	transact_sort_file_data(file);
+	/* Any blank transactions which are now left at the end of the file
+	 * are stripped off, as transact_strip_blanks_from_end() would do.
+	 */
+
+	while (out > 0 && transact_is_blank(file, out - 1))
+		out--;
+
+	for (transaction = 0; transaction < count; transaction++) {
+		if (remap[transaction] != NULL_TRANSACTION && remap[transaction] >= out)
+			remap[transaction] = NULL_TRANSACTION;
+	}
+
+	#ifdef DEBUG
+	debug_printf("Purged %d of %d transactions", count - out, count);
+	#endif
+
+	/* Release the space at the end of the data, and bring the windows
+	 * into line with the new transaction numbering.
+	 */
+
+	if (out < count) {
+		file->transacts->trans_count = out;
+
+		checkpoint_invalidate_all(file->transacts->checkpoints);
+
+		if (!flexutils_resize((void **) &(file->transacts->transactions), sizeof(struct transaction), out))
+			file_defer_batch_effects(file, FILE_BATCH_TRANSACT_MEMORY);
+		else
+			file->transacts->trans_allocation = out;
+
+		if (!transact_list_window_remap_transactions(file->transacts->transact_window, remap, count))
+			error_msgs_report_error("BadDelete");
 
-	transact_strip_blanks_from_end(file);
+		file_defer_batch_effects(file, FILE_BATCH_ACCVIEWS);
+	}
+
+	if (remap != NULL)
+		heap_free(remap);
+
+	file_commit_batch(file);
+
+	return TRUE;
+}
+
+
+/**
+ * Write all of the transactions which would be removed by a purge out to
+ * a new archive segment, which will be placed next to the file when it
+ * is saved.
+ *
+ * \param *file			The file to archive transactions from.
+ * \param cutoff		The cutoff date before which transactions are purged.
+ * \return			TRUE if the segment was written and sealed;
+ *				FALSE on failure.
+ */
+
+static osbool transact_archive_purgeable(struct file_block *file, date_t cutoff)
+{
+	struct archive_writer	*archive;
+	struct transaction	*entry;
+	tran_t			transaction;
+	osbool			success = TRUE;
+
+	if (file == NULL || file->transacts == NULL)
+		return FALSE;
+
+	/* There's no point leaving an empty segment behind. */
+
+	for (transaction = 0; transaction < file->transacts->trans_count; transaction++) {
+		if (transact_is_purgeable(file, transaction, cutoff))
+			break;
+	}
+
+	if (transaction >= file->transacts->trans_count)
+		return TRUE;
+
+	archive = archive_begin_segment(file, cutoff);
+	if (archive == NULL)
+		return FALSE;
+
+	for (transaction = 0; success && transaction < file->transacts->trans_count; transaction++) {
+		if (!transact_is_purgeable(file, transaction, cutoff))
+			continue;
+
+		entry = file->transacts->transactions + transaction;
+
+		success = archive_add_transaction(archive, entry->date, entry->from, entry->to, entry->flags,
+				entry->amount, entry->reference, entry->description);
+	}
+
+	/* The writer is freed, and any failure reported, by ending the segment. */
+
+	return archive_end_segment(archive);
+}
+
+
+/**
+ * Test whether a transaction would be removed by a purge: that is, whether
+ * it is reconciled at both ends and dated before the cutoff.
+ *
+ * \param *file			The file containing the transaction.
+ * \param transaction		The transaction to test.
+ * \param cutoff		The cutoff date before which transactions are purged.
+ * \return			TRUE if the transaction can be purged; else FALSE.
+ */
+
+static osbool transact_is_purgeable(struct file_block *file, tran_t transaction, date_t cutoff)
+{
+	struct transaction	*entry;
+
+	if (file == NULL || file->transacts == NULL || !transact_valid(file->transacts, transaction))
+		return FALSE;
+
+	entry = file->transacts->transactions + transaction;
+
+	return ((entry->flags & (TRANS_REC_FROM | TRANS_REC_TO)) == (TRANS_REC_FROM | TRANS_REC_TO) &&
+			(cutoff == NULL_DATE || entry->date < cutoff)) ? TRUE : FALSE;
 }
 
 
@@ -1435,6 +1914,7 @@ osbool transact_read_file(struct file_block *file, struct filing_block *in)
 	/* The load is probably going to invalidate the sort order. */
 
 	file->transacts->date_sort_valid = FALSE;
+	checkpoint_invalidate_all(file->transacts->checkpoints);
 
 	/* Identify the current size of the flex block allocation. */
 
@@ -1501,6 +1981,8 @@ osbool transact_read_file(struct file_block *file, struct filing_block *in)
 		return FALSE;
 	}
 
+	file->transacts->trans_allocation = file->transacts->trans_count;
+
 	/* Initialise the transaction list window contents. */
 
 	if (!transact_list_window_initialise_entries(file->transacts->transact_window, file->transacts->trans_count)) {
@@ -1606,27 +2088,3 @@ void transact_place_caret(struct file_block *file, int line, enum transact_field
 	transact_list_window_place_caret(file->transacts->transact_window, line, field);
 }
 
-
-/**
- * Check the transactions in a file to see if the given account is used
- * in any of them.
- *
- * \param *file			The file to check.
- * \param account		The account to search for.
- * \return			TRUE if the account is used; FALSE if not.
- */
-
-osbool transact_check_account(struct file_block *file, acct_t account)
-{
-	int		i;
-
-	if (file == NULL || file->transacts == NULL)
-		return FALSE;
-
-	for (i = 0; i < file->transacts->trans_count; i++)
-		if (file->transacts->transactions[i].from == account || file->transacts->transactions[i].to == account)
-			return TRUE;
-
-	return FALSE;
-}
-
@@ -287,6 +287,34 @@ tran_t transact_get_transaction_from_line(struct file_block *file, int line);
 int transact_get_count(struct file_block *file);
 
 
+/**
+ * Calculate the total of the transactions into and out of each account in
+ * a file, up to and including a given date, starting from the nearest
+ * balance checkpoint. Opening balances are not included.
+ *
+ * \param *file			The file to calculate the totals for.
+ * \param date			The last date to include, or NULL_DATE for all.
+ * \param *balances		Pointer to an array to take the totals, with an
+ *				entry for each account in the file.
+ * \param count			The number of entries in the array.
+ * \return			The number of transactions included in the
+ *				totals, or -1 on failure.
+ */
+
+int transact_get_balances(struct file_block *file, date_t date, amt_t *balances, int count);
+
+
+/**
+ * Check a file's balance checkpoints against a full recalculation from the
+ * start of the file, discarding them if any disagree.
+ *
+ * \param *file			The file to check.
+ * \return			TRUE if the checkpoints were consistent; else FALSE.
+ */
+
+osbool transact_verify_checkpoints(struct file_block *file);
+
+
 /**
  * Return the file associated with a transactions instance.
  *
@@ -345,6 +373,42 @@ void transact_add_raw_entry(struct file_block *file, date_t date, acct_t from, a
 		amt_t amount, char *ref, char *description);
 
 
+/**
+ * Add a run of empty transactions to the end of the list in one go, ready
+ * to be filled in with transact_set_raw_entry(). Space for the whole run is
+ * claimed at once, rather than one transaction at a time.
+ *
+ * \param *file			The file to add the transactions to.
+ * \param count			The number of transactions to add.
+ * \return			The index of the first new transaction, or
+ *				NULL_TRANSACTION on failure.
+ */
+
+tran_t transact_add_raw_entries(struct file_block *file, int count);
+
+
+/**
+ * Set the details of a transaction in a file directly, without any of the
+ * checks or updates made when editing from the transaction window. This is
+ * intended for filling in the transactions created by
+ * transact_add_raw_entries().
+ *
+ * \param *file			The file containing the transaction.
+ * \param transaction		The transaction to be set.
+ * \param date			The date of the transaction, or NULL_DATE.
+ * \param from			The account to transfer from, or NULL_ACCOUNT.
+ * \param to			The account to transfer to, or NULL_ACCOUNT.
+ * \param flags			The transaction flags.
+ * \param amount		The amount to transfer, or NULL_CURRENCY.
+ * \param *ref			Pointer to the transaction reference, or NULL.
+ * \param *description		Pointer to the transaction description, or NULL.
+ * \return			TRUE if successful; FALSE on failure.
+ */
+
+osbool transact_set_raw_entry(struct file_block *file, tran_t transaction, date_t date, acct_t from, acct_t to,
+		enum transact_flags flags, amt_t amount, char *ref, char *description);
+
+
 /**
  * Clear a transaction from a file, returning it to an empty state. Note that
  * the transaction remains in-situ, and no memory is cleared.
@@ -378,6 +442,16 @@ osbool transact_is_blank(struct file_block *file, tran_t transaction);
 void transact_strip_blanks_from_end(struct file_block *file);
 
 
+/**
+ * Release any spare space left at the end of the transaction data block
+ * by a batch update.
+ *
+ * \param *file			The file to be processed.
+ */
+
+void transact_release_spare_memory(struct file_block *file);
+
+
 /**
  * Return the date of a transaction.
  *
@@ -596,13 +670,30 @@ void transact_sort_file_data(struct file_block *file);
 
 
 /**
- * Purge unused transactions from a file.
+ * Bring a file's transactions back into date order after a run of new
+ * transactions, themselves in date order, has been added to the end of
+ * the list. The new transactions are merged into the existing ones in a
+ * single pass; if either set turns out not to be in order, the file is
+ * sorted in full instead.
+ *
+ * \param *file			The file to be sorted.
+ * \param first			The index of the first of the new transactions.
+ */
+
+void transact_merge_raw_entries(struct file_block *file, tran_t first);
+
+
+/**
+ * Purge unused transactions from a file, optionally writing them out to
+ * an archive segment first.
  *
  * \param *file			The file to purge.
  * \param cutoff		The cutoff date before which transactions should be removed.
+ * \param archive		TRUE to archive the purged transactions; else FALSE.
+ * \return			TRUE if the purge went ahead; FALSE if nothing was changed.
  */
 
-void transact_purge(struct file_block *file, date_t cutoff);
+osbool transact_purge(struct file_block *file, date_t cutoff, osbool archive);
 
 
 /**
@@ -720,15 +811,4 @@ void transact_place_caret(struct file_block *file, int line, enum transact_field
 enum transact_field transact_search(struct file_block *file, int *line, osbool back, osbool case_sensitive, osbool logic_and,
 		date_t date, acct_t from, acct_t to, enum transact_flags flags, amt_t amount, char *ref, char *desc);
 
-/**
- * Check the transactions in a file to see if the given account is used
- * in any of them.
- *
- * \param *file			The file to check.
- * \param account		The account to search for.
- * \return			TRUE if the account is used; FALSE if not.
- */
-
-osbool transact_check_account(struct file_block *file, acct_t account);
-
 #endif
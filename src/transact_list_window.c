@@ -72,6 +72,7 @@
 #include "account_list_menu.h"
 #include "account_menu.h"
 #include "accview.h"
+#include "accrual_report.h"
 #include "analysis.h"
 #include "analysis_template_menu.h"
 #include "budget.h"
@@ -86,7 +87,9 @@
 #include "filing.h"
 #include "find.h"
 #include "flexutils.h"
+#include "forecast_report.h"
 #include "goto.h"
+#include "linecache.h"
 #include "preset.h"
 #include "preset_menu.h"
 #include "print_dialogue.h"
@@ -182,6 +185,8 @@
 #define TRANSACT_LIST_WINDOW_MENU_ANALYSIS_CASHFLOW 4
 #define TRANSACT_LIST_WINDOW_MENU_ANALYSIS_BALANCE 5
 #define TRANSACT_LIST_WINDOW_MENU_ANALYSIS_SOREP 6
+#define TRANSACT_LIST_WINDOW_MENU_ANALYSIS_FORECAST 7
+#define TRANSACT_LIST_WINDOW_MENU_ANALYSIS_INTEREST 8
 
 /* Transaction List Sort Window icons. */
 
@@ -233,6 +238,12 @@
 
 #define TRANSACT_LIST_WINDOW_OPEN_OFFSET_LIMIT 8
 
+/**
+ * The number of lines of formatted text to cache for redraws.
+ */
+
+#define TRANSACT_LIST_WINDOW_CACHE_LINES 128
+
 /* The Transaction List Window column map. */
 
 static struct column_map transact_list_window_columns[TRANSACT_LIST_WINDOW_COLUMNS] = {
@@ -285,6 +296,43 @@ struct transact_list_window_redraw {
 	tran_t					transaction;
 };
 
+/**
+ * Transaction List Window cached line text, held to avoid formatting the
+ * contents of each row every time that it is redrawn.
+ */
+
+struct transact_list_window_cache {
+	/**
+	 * The formatted transaction date.
+	 */
+	char					date[DATE_FIELD_LEN];
+
+	/**
+	 * The ident of the From account.
+	 */
+	char					from_ident[ACCOUNT_IDENT_LEN];
+
+	/**
+	 * The name of the From account.
+	 */
+	char					from_name[ACCOUNT_NAME_LEN];
+
+	/**
+	 * The ident of the To account.
+	 */
+	char					to_ident[ACCOUNT_IDENT_LEN];
+
+	/**
+	 * The name of the To account.
+	 */
+	char					to_name[ACCOUNT_NAME_LEN];
+
+	/**
+	 * The formatted transaction amount.
+	 */
+	char					amount[AMOUNT_FIELD_LEN];
+};
+
 /**
  * Transaction List Window instance data structure.
  */
@@ -345,6 +393,12 @@ struct transact_list_window {
 	 */
 	struct transact_list_window_redraw	*line_data;
 
+	/**
+	 * Cache of formatted text for the lines in the window, keyed on
+	 * transaction number.
+	 */
+	struct linecache_block			*line_cache;
+
 	/**
 	 * True if reconcile should automatically jump to the next unreconciled entry.
 	 */
@@ -631,6 +685,7 @@ struct transact_list_window *transact_list_window_create_instance(struct transac
 
 	new->display_lines = 0;
 	new->line_data = NULL;
+	new->line_cache = NULL;
 
 	new->auto_reconcile = FALSE;
 
@@ -660,6 +715,14 @@ struct transact_list_window *transact_list_window_create_instance(struct transac
 		return NULL;
 	}
 
+	/* Set up the redraw text cache. */
+
+	new->line_cache = linecache_create(TRANSACT_LIST_WINDOW_CACHE_LINES, sizeof(struct transact_list_window_cache));
+	if (new->line_cache == NULL) {
+		transact_list_window_delete_instance(new);
+		return NULL;
+	}
+
 	return new;
 }
 
@@ -678,6 +741,8 @@ void transact_list_window_delete_instance(struct transact_list_window *windat)
 	if (windat->line_data != NULL)
 		flexutils_free((void **) &(windat->line_data));
 
+	linecache_destroy(windat->line_cache);
+
 	column_delete_instance(windat->columns);
 	sort_delete_instance(windat->sort);
 
@@ -878,6 +943,7 @@ static void transact_list_window_delete(struct transact_list_window *windat)
 	if (windat->transaction_window != NULL) {
 		ihelp_remove_window(windat->transaction_window);
 		event_delete_window(windat->transaction_window);
+		window_cancel_redraws(windat->transaction_window);
 		wimp_delete_window(windat->transaction_window);
 		dataxfer_delete_drop_target(dataxfer_TYPE_CSV, windat->transaction_window, -1);
 		windat->transaction_window = NULL;
@@ -1576,6 +1642,8 @@ static void transact_list_window_menu_selection_handler(wimp_w w, wimp_menu *men
 			template = analysis_template_menu_decode(selection->items[2]);
 			if (template != NULL_TEMPLATE)
 				analysis_open_template(file->analysis, &pointer, template, config_opt_read("RememberValues"));
+			else if (analysis_template_menu_decode_run_all(selection->items[2]))
+				analysis_run_all_templates(file->analysis);
 			break;
 
 		case TRANSACT_LIST_WINDOW_MENU_ANALYSIS_MONTHREP:
@@ -1597,6 +1665,14 @@ static void transact_list_window_menu_selection_handler(wimp_w w, wimp_menu *men
 		case TRANSACT_LIST_WINDOW_MENU_ANALYSIS_SOREP:
 			sorder_full_report(file);
 			break;
+
+		case TRANSACT_LIST_WINDOW_MENU_ANALYSIS_FORECAST:
+			forecast_report(file);
+			break;
+
+		case TRANSACT_LIST_WINDOW_MENU_ANALYSIS_INTEREST:
+			accrual_report(file);
+			break;
 		}
 		break;
 	}
@@ -1722,6 +1798,7 @@ static void transact_list_window_scroll_handler(wimp_scroll *scroll)
 static void transact_list_window_redraw_handler(wimp_draw *redraw)
 {
 	struct transact_list_window	*windat;
+	struct transact_list_window_cache	*cache;
 	struct file_block		*file;
 	int				top, base, y, entry_line;
 	tran_t				transaction;
@@ -1729,7 +1806,7 @@ static void transact_list_window_redraw_handler(wimp_draw *redraw)
 	enum transact_flags		flags;
 	wimp_colour			shade_rec_col, icon_fg_col;
 	char				icon_buffer[TRANSACT_DESCRIPT_FIELD_LEN]; /* Assumes descript is longest. */
-	osbool				shade_rec, more;
+	osbool				shade_rec, more, cached;
 
 	windat = event_get_window_user_data(redraw->w);
 	if (windat == NULL || windat->instance == NULL || windat->columns == NULL)
@@ -1790,29 +1867,47 @@ static void transact_list_window_redraw_handler(wimp_draw *redraw)
 				continue;
 			}
 
+			/* Find the formatted text for the line, building it if it
+			 * isn't already in the cache.
+			 */
+
+			cache = linecache_find(windat->line_cache, transaction, &cached);
+			if (cache == NULL)
+				continue;
+
+			if (!cached) {
+				date_convert_to_string(transact_get_date(file, transaction), cache->date, DATE_FIELD_LEN);
+
+				account = transact_get_from(file, transaction);
+				string_copy(cache->from_ident, account_get_ident(file, account), ACCOUNT_IDENT_LEN);
+				string_copy(cache->from_name, account_get_name(file, account), ACCOUNT_NAME_LEN);
+
+				account = transact_get_to(file, transaction);
+				string_copy(cache->to_ident, account_get_ident(file, account), ACCOUNT_IDENT_LEN);
+				string_copy(cache->to_name, account_get_name(file, account), ACCOUNT_NAME_LEN);
+
+				currency_convert_to_string(transact_get_amount(file, transaction), cache->amount, AMOUNT_FIELD_LEN);
+			}
+
 			/* Row field. */
 
 			window_plot_int_field(TRANSACT_LIST_WINDOW_ROW, transact_get_transaction_number(transaction), icon_fg_col);
 
 			/* Date field */
 
-			window_plot_date_field(TRANSACT_LIST_WINDOW_DATE, transact_get_date(file, transaction), icon_fg_col);
+			window_plot_text_field(TRANSACT_LIST_WINDOW_DATE, cache->date, icon_fg_col);
 
 			/* From field */
 
-			account = transact_get_from(file, transaction);
-
-			window_plot_text_field(TRANSACT_LIST_WINDOW_FROM, account_get_ident(file, account), icon_fg_col);
+			window_plot_text_field(TRANSACT_LIST_WINDOW_FROM, cache->from_ident, icon_fg_col);
 			window_plot_reconciled_field(TRANSACT_LIST_WINDOW_FROM_REC, (flags & TRANS_REC_FROM), icon_fg_col);
-			window_plot_text_field(TRANSACT_LIST_WINDOW_FROM_NAME, account_get_name(file, account), icon_fg_col);
+			window_plot_text_field(TRANSACT_LIST_WINDOW_FROM_NAME, cache->from_name, icon_fg_col);
 
 			/* To field */
 
-			account = transact_get_to(file, transaction);
-
-			window_plot_text_field(TRANSACT_LIST_WINDOW_TO, account_get_ident(file, account), icon_fg_col);
+			window_plot_text_field(TRANSACT_LIST_WINDOW_TO, cache->to_ident, icon_fg_col);
 			window_plot_reconciled_field(TRANSACT_LIST_WINDOW_TO_REC, (flags & TRANS_REC_TO), icon_fg_col);
-			window_plot_text_field(TRANSACT_LIST_WINDOW_TO_NAME, account_get_name(file, account), icon_fg_col);
+			window_plot_text_field(TRANSACT_LIST_WINDOW_TO_NAME, cache->to_name, icon_fg_col);
 
 			/* Reference field */
 
@@ -1820,7 +1915,7 @@ static void transact_list_window_redraw_handler(wimp_draw *redraw)
 
 			/* Amount field */
 
-			window_plot_currency_field(TRANSACT_LIST_WINDOW_AMOUNT, transact_get_amount(file, transaction), icon_fg_col);
+			window_plot_text_field(TRANSACT_LIST_WINDOW_AMOUNT, cache->amount, icon_fg_col);
 
 			/* Description field */
 
@@ -2184,11 +2279,18 @@ void transact_list_window_reindex(struct transact_list_window *windat)
 	struct file_block	*file;
 	int			line, transaction;
 
+	if (windat == NULL)
+		return;
+
 	file = transact_get_file(windat->instance);
 	if (file == NULL)
 		return;
 
-	if (windat == NULL || windat->line_data == NULL || windat->transaction_window == NULL)
+	/* The transactions have all been renumbered, so the cache is invalid. */
+
+	linecache_invalidate_all(windat->line_cache);
+
+	if (windat->line_data == NULL || windat->transaction_window == NULL)
 		return;
 
 	for (line = 0; line < windat->display_lines; line++) {
@@ -2204,9 +2306,11 @@ void transact_list_window_reindex(struct transact_list_window *windat)
 
 /**
  * Force the redraw of one or all of the transactions in a given
- * Transaction List window.
+ * Transaction List window. Any cached text for the affected transactions
+ * is discarded, so this must be called whenever their contents change.
  *
  * \param *windat		The transaction window to redraw.
+ * \param transaction		The transaction to redraw, or NULL_TRANSACTION for all.
  */
 
 void transact_list_window_redraw(struct transact_list_window *windat, tran_t transaction)
@@ -2217,13 +2321,20 @@ void transact_list_window_redraw(struct transact_list_window *windat, tran_t tra
 		return;
 
 	if (transaction != NULL_TRANSACTION) {
+		linecache_invalidate(windat->line_cache, transaction);
 		from = transact_list_window_get_line_from_transaction(windat, transaction);
 		to = from;
 	} else {
+		linecache_invalidate_all(windat->line_cache);
 		from = 0;
 		to = windat->display_lines - 1;
 	}
 
+	/* During a batch update, the whole window is redrawn at the end. */
+
+	if (file_defer_batch_effects(transact_get_file(windat->instance), FILE_BATCH_TRANSACT_WINDOW))
+		return;
+
 	transact_list_window_force_redraw(windat, from, to, wimp_ICON_WINDOW);
 }
 
@@ -2280,7 +2391,7 @@ static void transact_list_window_force_redraw(struct transact_list_window *winda
 	window.extent.y1 = WINDOW_ROW_TOP(TRANSACT_LIST_WINDOW_TOOLBAR_HEIGHT, from);
 	window.extent.y0 = WINDOW_ROW_BASE(TRANSACT_LIST_WINDOW_TOOLBAR_HEIGHT, to);
 
-	wimp_force_redraw(windat->transaction_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
+	window_queue_redraw(windat->transaction_window, window.extent.x0, window.extent.y0, window.extent.x1, window.extent.y1);
 }
 
 
@@ -3448,7 +3559,12 @@ osbool transact_list_window_insert_preset_into_line(struct transact_list_window
 
 	transaction = windat->line_data[line].transaction;
 
-	/* Update the transaction from the preset, piece by piece. */
+	/* Update the transaction from the preset, piece by piece. The changes
+	 * are made as a batch, so that the accounts and views are only updated
+	 * once all of the fields have been set.
+	 */
+
+	file_begin_batch(file);
 
 	flags = preset_get_flags(file, preset);
 
@@ -3499,6 +3615,8 @@ osbool transact_list_window_insert_preset_into_line(struct transact_list_window
 	if (*text != '\0' && transact_change_refdesc(file, transaction, TRANSACT_FIELD_DESC, text))
 		changed |= TRANSACT_FIELD_DESC;
 
+	file_commit_batch(file);
+
 	/* Replace the edit line to make it pick up the changes. */
 
 	transact_list_window_place_edit_line(windat, line);
@@ -3986,6 +4104,8 @@ static struct report *transact_list_window_print(struct report *report, void *da
 	date_t				date;
 	char				rec_char[REC_FIELD_LEN];
 	wimp_i				columns[TRANSACT_LIST_WINDOW_COLUMNS];
+	struct stringbuild_block	builder;
+	char				buffer[PRINT_MAX_LINE_LEN];
 
 	if (report == NULL || windat == NULL || windat->instance == NULL)
 		return NULL;
@@ -3999,26 +4119,29 @@ static struct report *transact_list_window_print(struct report *report, void *da
 
 	msgs_lookup("RecChar", rec_char, REC_FIELD_LEN);
 
+	if (!stringbuild_initialise(&builder, buffer, PRINT_MAX_LINE_LEN))
+		return NULL;
+
 	hourglass_on();
 
 	/* Output the page title. */
 
-	stringbuild_reset();
+	stringbuild_reset(&builder);
 
-	stringbuild_add_string("\\b\\u");
-	stringbuild_add_message_param("TransTitle",
+	stringbuild_add_string(&builder, "\\b\\u");
+	stringbuild_add_message_param(&builder, "TransTitle",
 			file_get_leafname(file, NULL, 0),
 			NULL, NULL, NULL);
 
-	stringbuild_report_line(report, 1);
+	stringbuild_report_line(&builder, report, 1);
 
 	report_write_line(report, 1, "");
 
 	/* Output the headings line, taking the text from the window icons. */
 
-	stringbuild_reset();
-	columns_print_heading_names(windat->columns, windat->transaction_pane);
-	stringbuild_report_line(report, 0);
+	stringbuild_reset(&builder);
+	columns_print_heading_names(windat->columns, windat->transaction_pane, &builder);
+	stringbuild_report_line(&builder, report, 0);
 
 	/* Output the transaction data as a set of delimited lines. */
 
@@ -4030,65 +4153,67 @@ static struct report *transact_list_window_print(struct report *report, void *da
 		if ((from != NULL_DATE && date < from) || (to != NULL_DATE && date > to))
 			continue;
 
-		stringbuild_reset();
+		stringbuild_reset(&builder);
 
 		for (column = 0; column < TRANSACT_LIST_WINDOW_COLUMNS; column++) {
 			if (column == 0)
-				stringbuild_add_string("\\k");
+				stringbuild_add_string(&builder, "\\k");
 			else
-				stringbuild_add_string("\\t");
+				stringbuild_add_string(&builder, "\\t");
 
 			switch (columns[column]) {
 			case TRANSACT_LIST_WINDOW_ROW:
-				stringbuild_add_printf("\\v\\d\\r%d", transact_get_transaction_number(transaction));
+				stringbuild_add_printf(&builder, "\\v\\d\\r%d", transact_get_transaction_number(transaction));
 				break;
 			case TRANSACT_LIST_WINDOW_DATE:
-				stringbuild_add_string("\\v\\c");
-				stringbuild_add_date(date);
+				stringbuild_add_string(&builder, "\\v\\c");
+				stringbuild_add_date(&builder, date);
 				break;
 			case TRANSACT_LIST_WINDOW_FROM:
-				stringbuild_add_string(account_get_ident(file, transact_get_from(file, transaction)));
+				stringbuild_add_string(&builder, account_get_ident(file, transact_get_from(file, transaction)));
 				break;
 			case TRANSACT_LIST_WINDOW_FROM_REC:
 				if (transact_get_flags(file, transaction) & TRANS_REC_FROM)
-					stringbuild_add_string(rec_char);
+					stringbuild_add_string(&builder, rec_char);
 				break;
 			case TRANSACT_LIST_WINDOW_FROM_NAME:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(account_get_name(file, transact_get_from(file, transaction)));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, account_get_name(file, transact_get_from(file, transaction)));
 				break;
 			case TRANSACT_LIST_WINDOW_TO:
-				stringbuild_add_string(account_get_ident(file, transact_get_to(file, transaction)));
+				stringbuild_add_string(&builder, account_get_ident(file, transact_get_to(file, transaction)));
 				break;
 			case TRANSACT_LIST_WINDOW_TO_REC:
 				if (transact_get_flags(file, transaction) & TRANS_REC_TO)
-					stringbuild_add_string(rec_char);
+					stringbuild_add_string(&builder, rec_char);
 				break;
 			case TRANSACT_LIST_WINDOW_TO_NAME:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(account_get_name(file, transact_get_to(file, transaction)));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, account_get_name(file, transact_get_to(file, transaction)));
 				break;
 			case TRANSACT_LIST_WINDOW_REFERENCE:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(transact_get_reference(file, transaction, NULL, 0));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, transact_get_reference(file, transaction, NULL, 0));
 				break;
 			case TRANSACT_LIST_WINDOW_AMOUNT:
-				stringbuild_add_string("\\v\\d\\r");
-				stringbuild_add_currency(transact_get_amount(file, transaction), FALSE);
+				stringbuild_add_string(&builder, "\\v\\d\\r");
+				stringbuild_add_currency(&builder, transact_get_amount(file, transaction), FALSE);
 				break;
 			case TRANSACT_LIST_WINDOW_DESCRIPTION:
-				stringbuild_add_string("\\v");
-				stringbuild_add_string(transact_get_description(file, transaction, NULL, 0));
+				stringbuild_add_string(&builder, "\\v");
+				stringbuild_add_string(&builder, transact_get_description(file, transaction, NULL, 0));
 				break;
 			default:
-				stringbuild_add_string("\\s");
+				stringbuild_add_string(&builder, "\\s");
 				break;
 			}
 		}
 
-		stringbuild_report_line(report, 0);
+		stringbuild_report_line(&builder, report, 0);
 	}
 
+	stringbuild_cancel(&builder);
+
 	hourglass_off();
 
 	return report;
@@ -4246,6 +4371,8 @@ osbool transact_list_window_initialise_entries(struct transact_list_window *wind
 	for (i = 0; i < transacts; i++)
 		windat->line_data[i].transaction = i;
 
+	linecache_invalidate_all(windat->line_cache);
+
 	transact_list_window_sort(windat);
 
 	return TRUE;
@@ -4262,25 +4389,54 @@ osbool transact_list_window_initialise_entries(struct transact_list_window *wind
 
 osbool transact_list_window_add_transaction(struct transact_list_window *windat, tran_t transaction)
 {
-	if (windat == NULL || windat->line_data == NULL)
+	return transact_list_window_add_transactions(windat, transaction, 1);
+}
+
+
+/**
+ * Add a run of new transactions to an instance of the transaction list
+ * window, extending the line data only once.
+ *
+ * \param *windat		The transaction list window instance to add to.
+ * \param first			The index of the first transaction to add.
+ * \param count			The number of consecutive transactions to add.
+ * \return			TRUE on success; FALSE on failure.
+ */
+
+osbool transact_list_window_add_transactions(struct transact_list_window *windat, tran_t first, int count)
+{
+	int	line, i;
+
+	if (windat == NULL || windat->line_data == NULL || count <= 0)
 		return FALSE;
 
-	debug_printf("Adding a new transaction to the window: transaction=%d, index=%d", transaction, windat->display_lines);
+	debug_printf("Adding new transactions to the window: first=%d, count=%d, index=%d", first, count, windat->display_lines);
 
 	/* Extend the index array. */
 
-	if (!flexutils_resize((void **) &(windat->line_data), sizeof(struct transact_list_window_redraw), windat->display_lines + 1))
+	if (!flexutils_resize((void **) &(windat->line_data), sizeof(struct transact_list_window_redraw), windat->display_lines + count))
 		return FALSE;
 
-	windat->display_lines++;
+	line = windat->display_lines;
+	windat->display_lines += count;
 
-	/* Add the new entry, expand the window and sort the entries. */
+	/* Add the new entries, expand the window and sort the entries. */
 
-	windat->line_data[windat->display_lines - 1].transaction = transaction;
+	for (i = 0; i < count; i++) {
+		windat->line_data[line + i].transaction = first + i;
+		linecache_invalidate(windat->line_cache, first + i);
+	}
+
+	/* During a batch update, the window is resized and redrawn once the
+	 * batch has completed.
+	 */
+
+	if (file_defer_batch_effects(transact_get_file(windat->instance), FILE_BATCH_TRANSACT_WINDOW))
+		return TRUE;
 
 	transact_list_window_set_extent(windat);
 
-	transact_list_window_force_redraw(windat, windat->display_lines - 1, windat->display_lines - 1, wimp_ICON_WINDOW);
+	transact_list_window_force_redraw(windat, line, windat->display_lines - 1, wimp_ICON_WINDOW);
 
 	return TRUE;
 }
@@ -4320,7 +4476,14 @@ osbool transact_list_window_delete_transaction(struct transact_list_window *wind
 
 	windat->display_lines--;
 
-	/* Update the preset window. */
+	/* The following transactions have been renumbered, so the cache is invalid. */
+
+	linecache_invalidate_all(windat->line_cache);
+
+	/* Update the preset window, unless a batch update will do it later. */
+
+	if (file_defer_batch_effects(transact_get_file(windat->instance), FILE_BATCH_TRANSACT_WINDOW))
+		return TRUE;
 
 	transact_list_window_set_extent(windat);
 
@@ -4332,6 +4495,66 @@ osbool transact_list_window_delete_transaction(struct transact_list_window *wind
 }
 
 
+/**
+ * Remove any number of transactions from an instance of the transaction
+ * list window in a single pass, following the compaction of the underlying
+ * transaction data, and renumber the remaining entries to match.
+ *
+ * \param *windat		The transaction list window instance to update.
+ * \param *remap		An array giving the new index of each of the old
+ *				transactions, or NULL_TRANSACTION if removed.
+ * \param count			The number of entries in the remap array.
+ * \return			TRUE on success; FALSE on failure.
+ */
+
+osbool transact_list_window_remap_transactions(struct transact_list_window *windat, tran_t *remap, int count)
+{
+	int	line, lines = 0;
+	tran_t	transaction;
+
+	if (windat == NULL || windat->line_data == NULL || remap == NULL)
+		return FALSE;
+
+	/* Renumber the lines which remain, and close up any gaps left by
+	 * those which have gone, keeping the display order intact.
+	 */
+
+	for (line = 0; line < windat->display_lines; line++) {
+		transaction = windat->line_data[line].transaction;
+
+		if (transaction < 0 || transaction >= count || remap[transaction] == NULL_TRANSACTION)
+			continue;
+
+		windat->line_data[lines].transaction = remap[transaction];
+		lines++;
+	}
+
+	debug_printf("Remapping transactions in the window: lines=%d, remaining=%d", windat->display_lines, lines);
+
+	if (lines < windat->display_lines && !flexutils_resize((void **) &(windat->line_data), sizeof(struct transact_list_window_redraw), lines))
+		return FALSE;
+
+	windat->display_lines = lines;
+
+	/* The transactions have been renumbered, so the cache is invalid. */
+
+	linecache_invalidate_all(windat->line_cache);
+
+	/* Update the window, unless a batch update will do it later. */
+
+	if (file_defer_batch_effects(transact_get_file(windat->instance), FILE_BATCH_TRANSACT_WINDOW))
+		return TRUE;
+
+	transact_list_window_set_extent(windat);
+
+	windows_open(windat->transaction_window);
+
+	transact_list_window_force_redraw(windat, 0, windat->display_lines, wimp_ICON_WINDOW);
+
+	return TRUE;
+}
+
+
 /**
  * Save the transaction list window details from a window to a CashBook
  * file. This assumes that the caller has already created a suitable section
@@ -136,9 +136,11 @@ void transact_list_window_reindex(struct transact_list_window *windat);
 
 /**
  * Force the redraw of one or all of the transactions in a given
- * Transaction List window.
+ * Transaction List window. Any cached text for the affected transactions
+ * is discarded, so this must be called whenever their contents change.
  *
  * \param *windat		The transaction window to redraw.
+ * \param transaction		The transaction to redraw, or NULL_TRANSACTION for all.
  */
 
 void transact_list_window_redraw(struct transact_list_window *windat, tran_t transaction);
@@ -304,6 +306,19 @@ osbool transact_list_window_initialise_entries(struct transact_list_window *wind
 osbool transact_list_window_add_transaction(struct transact_list_window *windat, tran_t transaction);
 
 
+/**
+ * Add a run of new transactions to an instance of the transaction list
+ * window, extending the line data only once.
+ *
+ * \param *windat		The transaction list window instance to add to.
+ * \param first			The index of the first transaction to add.
+ * \param count			The number of consecutive transactions to add.
+ * \return			TRUE on success; FALSE on failure.
+ */
+
+osbool transact_list_window_add_transactions(struct transact_list_window *windat, tran_t first, int count);
+
+
 /**
  * Remove a transaction from an instance of the transaction list window,
  * and update the other entries to allow for its deletion.
@@ -316,6 +331,21 @@ osbool transact_list_window_add_transaction(struct transact_list_window *windat,
 osbool transact_list_window_delete_transaction(struct transact_list_window *windat, tran_t transaction);
 
 
+/**
+ * Remove any number of transactions from an instance of the transaction
+ * list window in a single pass, following the compaction of the underlying
+ * transaction data, and renumber the remaining entries to match.
+ *
+ * \param *windat		The transaction list window instance to update.
+ * \param *remap		An array giving the new index of each of the old
+ *				transactions, or NULL_TRANSACTION if removed.
+ * \param count			The number of entries in the remap array.
+ * \return			TRUE on success; FALSE on failure.
+ */
+
+osbool transact_list_window_remap_transactions(struct transact_list_window *windat, tran_t *remap, int count);
+
+
 /**
  * Save the transaction list window details from a window to a CashBook
  * file. This assumes that the caller has already created a suitable section
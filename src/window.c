@@ -55,6 +55,33 @@
 #include "date.h"
 #include "interest.h"
 
+/**
+ * The number of pending redraw regions which can be held in the queue.
+ */
+
+#define WINDOW_REDRAW_REGIONS 32
+
+/**
+ * A pending redraw region, in work area coordinates.
+ */
+
+struct window_redraw_region {
+	wimp_w			w;			/**< The window to which the region applies.		*/
+	os_box			box;			/**< The work area extent to be redrawn.		*/
+};
+
+/**
+ * The queue of pending redraw regions.
+ */
+
+static struct window_redraw_region	window_redraw_queue[WINDOW_REDRAW_REGIONS];
+
+/**
+ * The number of regions currently held in the redraw queue.
+ */
+
+static int				window_redraw_count = 0;
+
 /**
  * The window template block currently being used for plotting icons.
  */
@@ -66,6 +93,11 @@ static wimp_window	*window_icon_templates = NULL;
 
 static char		window_reconciled_symbol[REC_FIELD_LEN];
 
+/* Static Function Prototypes. */
+
+static osbool		window_redraw_regions_touch(os_box *a, os_box *b);
+static void		window_redraw_regions_merge(os_box *target, os_box *source);
+
 
 /**
  * Set up the extent and visible area of a window in its creation block so that
@@ -272,6 +304,145 @@ void window_set_extent(wimp_w window, int lines, int pane_height, int width)
 }
 
 
+/**
+ * Queue a region of a window to be redrawn at the end of the current poll
+ * cycle. Any pending regions of the same window which overlap or touch the
+ * new one are merged with it, so that repeated updates to the same lines
+ * only result in a single call to Wimp_ForceRedraw.
+ *
+ * \param w			The window to be redrawn.
+ * \param x0			The minimum X work area coordinate to redraw.
+ * \param y0			The minimum Y work area coordinate to redraw.
+ * \param x1			The maximum X work area coordinate to redraw.
+ * \param y1			The maximum Y work area coordinate to redraw.
+ */
+
+void window_queue_redraw(wimp_w w, int x0, int y0, int x1, int y1)
+{
+	os_box	box;
+	int	i;
+
+	if (w == NULL || x0 >= x1 || y0 >= y1)
+		return;
+
+	box.x0 = x0;
+	box.y0 = y0;
+	box.x1 = x1;
+	box.y1 = y1;
+
+	/* Absorb any pending regions for the window which touch the new one.
+	 * As the region grows, it might come to touch others which have
+	 * already been tested, so the scan restarts after each merge.
+	 */
+
+	i = 0;
+
+	while (i < window_redraw_count) {
+		if (window_redraw_queue[i].w == w && window_redraw_regions_touch(&(window_redraw_queue[i].box), &box)) {
+			window_redraw_regions_merge(&box, &(window_redraw_queue[i].box));
+			window_redraw_queue[i] = window_redraw_queue[--window_redraw_count];
+			i = 0;
+		} else {
+			i++;
+		}
+	}
+
+	/* If the queue is full, merge the region into any other one pending
+	 * for the same window; failing that, flush the queue to make room.
+	 */
+
+	if (window_redraw_count >= WINDOW_REDRAW_REGIONS) {
+		for (i = 0; i < window_redraw_count; i++) {
+			if (window_redraw_queue[i].w == w) {
+				window_redraw_regions_merge(&(window_redraw_queue[i].box), &box);
+				return;
+			}
+		}
+
+		window_flush_redraws();
+	}
+
+	window_redraw_queue[window_redraw_count].w = w;
+	window_redraw_queue[window_redraw_count].box = box;
+	window_redraw_count++;
+}
+
+
+/**
+ * Discard any pending redraws for a window, which should be called before
+ * the window is deleted.
+ *
+ * \param w			The window whose redraws are to be discarded.
+ */
+
+void window_cancel_redraws(wimp_w w)
+{
+	int	i = 0;
+
+	while (i < window_redraw_count) {
+		if (window_redraw_queue[i].w == w)
+			window_redraw_queue[i] = window_redraw_queue[--window_redraw_count];
+		else
+			i++;
+	}
+}
+
+
+/**
+ * Pass all of the pending redraw regions on to the Wimp, and empty the
+ * queue. This should be called once per poll cycle, before control is
+ * returned to the Wimp.
+ */
+
+void window_flush_redraws(void)
+{
+	int	i;
+
+	for (i = 0; i < window_redraw_count; i++)
+		xwimp_force_redraw(window_redraw_queue[i].w, window_redraw_queue[i].box.x0, window_redraw_queue[i].box.y0,
+				window_redraw_queue[i].box.x1, window_redraw_queue[i].box.y1);
+
+	window_redraw_count = 0;
+}
+
+
+/**
+ * Test two redraw regions to see if they overlap or share an edge.
+ *
+ * \param *a			The first region to test.
+ * \param *b			The second region to test.
+ * \return			TRUE if the regions touch; else FALSE.
+ */
+
+static osbool window_redraw_regions_touch(os_box *a, os_box *b)
+{
+	return (a->x0 <= b->x1 && b->x0 <= a->x1 && a->y0 <= b->y1 && b->y0 <= a->y1) ? TRUE : FALSE;
+}
+
+
+/**
+ * Expand a redraw region so that it also covers a second one.
+ *
+ * \param *target		The region to be expanded.
+ * \param *source		The region to be included.
+ */
+
+static void window_redraw_regions_merge(os_box *target, os_box *source)
+{
+	if (source->x0 < target->x0)
+		target->x0 = source->x0;
+
+	if (source->y0 < target->y0)
+		target->y0 = source->y0;
+
+	if (source->x1 > target->x1)
+		target->x1 = source->x1;
+
+	if (source->y1 > target->y1)
+		target->y1 = source->y1;
+}
+
+
 /**
  * Calculate the row that the mouse was clicked over in the list window.
  *
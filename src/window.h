@@ -170,6 +170,41 @@ void window_process_scroll_event(wimp_scroll *scroll, int pane_size);
 void window_set_extent(wimp_w window, int lines, int pane_height, int width);
 
 
+/**
+ * Queue a region of a window to be redrawn at the end of the current poll
+ * cycle. Any pending regions of the same window which overlap or touch the
+ * new one are merged with it, so that repeated updates to the same lines
+ * only result in a single call to Wimp_ForceRedraw.
+ *
+ * \param w			The window to be redrawn.
+ * \param x0			The minimum X work area coordinate to redraw.
+ * \param y0			The minimum Y work area coordinate to redraw.
+ * \param x1			The maximum X work area coordinate to redraw.
+ * \param y1			The maximum Y work area coordinate to redraw.
+ */
+
+void window_queue_redraw(wimp_w w, int x0, int y0, int x1, int y1);
+
+
+/**
+ * Discard any pending redraws for a window, which should be called before
+ * the window is deleted.
+ *
+ * \param w			The window whose redraws are to be discarded.
+ */
+
+void window_cancel_redraws(wimp_w w);
+
+
+/**
+ * Pass all of the pending redraw regions on to the Wimp, and empty the
+ * queue. This should be called once per poll cycle, before control is
+ * returned to the Wimp.
+ */
+
+void window_flush_redraws(void);
+
+
 /**
  * Calculate the row that the mouse was clicked over in the list window.
  *